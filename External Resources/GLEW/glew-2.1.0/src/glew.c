@@ -32,7 +32,9 @@
 
 #ifndef GLEW_INCLUDE
 #include <GL/glew.h>
+#ifdef _WIN32
 #include<GL/wglew.h>
+#endif
 #else
 #include GLEW_INCLUDE
 #endif
@@ -92,6 +92,13 @@ enum
 	SOIL_FLAG_NTSC_SAFE_RGB: clamps RGB components to the range [16,235]
 	SOIL_FLAG_CoCg_Y: Google YCoCg; RGB=>CoYCg, RGBA=>CoCgAY
 	SOIL_FLAG_TEXTURE_RECTANGE: uses ARB_texture_rectangle ; pixel indexed & no repeat or MIPmaps or cubemaps
+	SOIL_FLAG_GAMMA_CORRECT_MIPMAPS: treats RGB as sRGB and averages MIPmaps in linear light (ignored with SOIL_FLAG_CoCg_Y)
+	SOIL_FLAG_MIPMAP_KAISER: builds MIPmaps with a Kaiser windowed sinc instead of a box filter
+	SOIL_FLAG_MIPMAP_LANCZOS: builds MIPmaps with a Lanczos filter instead of a box filter
+	SOIL_FLAG_COMPRESS_TO_BC: if the card can display them, will convert 1 channel to BC4, 2 channels to BC5, RGB(A) to BC7 (falls back to SOIL_FLAG_COMPRESS_TO_DXT)
+	SOIL_FLAG_BC5_NORMAL_MAP: with SOIL_FLAG_COMPRESS_TO_BC, keeps only R and G of RGB(A) images in BC5 (rebuild Z in the shader)
+	SOIL_FLAG_BC_QUALITY_FAST: the BC encoders fit each block once (the default is between FAST and SLOW)
+	SOIL_FLAG_BC_QUALITY_SLOW: the BC encoders also try their alternate block modes and search around the endpoints
 **/
 enum
 {
@@ -104,7 +111,14 @@ enum
 	SOIL_FLAG_DDS_LOAD_DIRECT = 64,
 	SOIL_FLAG_NTSC_SAFE_RGB = 128,
 	SOIL_FLAG_CoCg_Y = 256,
-	SOIL_FLAG_TEXTURE_RECTANGLE = 512
+	SOIL_FLAG_TEXTURE_RECTANGLE = 512,
+	SOIL_FLAG_GAMMA_CORRECT_MIPMAPS = 1024,
+	SOIL_FLAG_MIPMAP_KAISER = 2048,
+	SOIL_FLAG_MIPMAP_LANCZOS = 4096,
+	SOIL_FLAG_COMPRESS_TO_BC = 8192,
+	SOIL_FLAG_BC5_NORMAL_MAP = 16384,
+	SOIL_FLAG_BC_QUALITY_FAST = 32768,
+	SOIL_FLAG_BC_QUALITY_SLOW = 65536
 };
 
 /**
@@ -112,12 +126,14 @@ enum
 	(TGA supports uncompressed RGB / RGBA)
 	(BMP supports uncompressed RGB)
 	(DDS supports DXT1 and DXT5)
+	(DDS_BC is BC4 for 1 channel, BC5 for 2 and BC7 for RGB / RGBA)
 **/
 enum
 {
 	SOIL_SAVE_TYPE_TGA = 0,
 	SOIL_SAVE_TYPE_BMP = 1,
-	SOIL_SAVE_TYPE_DDS = 2
+	SOIL_SAVE_TYPE_DDS = 2,
+	SOIL_SAVE_TYPE_DDS_BC = 3
 };
 
 /**
@@ -134,12 +150,17 @@ enum
 	SOIL_HDR_RGBE:		RGB * pow( 2.0, A - 128.0 )
 	SOIL_HDR_RGBdivA:	RGB / A
 	SOIL_HDR_RGBdivA2:	RGB / (A*A)
+
+	SOIL_HDR_BC6H is not a fake format, the float RGB is
+	compressed to BC6H (or stored as 16 bit floats if the
+	card has no BPTC support).  rescale_to_max is ignored.
 **/
 enum
 {
 	SOIL_HDR_RGBE = 0,
 	SOIL_HDR_RGBdivA = 1,
-	SOIL_HDR_RGBdivA2 = 2
+	SOIL_HDR_RGBdivA2 = 2,
+	SOIL_HDR_BC6H = 3
 };
 
 /**
@@ -208,7 +229,7 @@ unsigned int
 /**
 	Loads an HDR image from disk into an OpenGL texture.
 	\param filename the name of the file to upload as a texture
-	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2
+	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2, SOIL_HDR_BC6H
 	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
 	\param flags can be any of SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_MULTIPLY_ALPHA | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT
 	\return 0-failed, otherwise returns the OpenGL texture handle
@@ -304,7 +325,8 @@ unsigned int
 
 /**
 	Creates a 2D OpenGL texture from raw image data.  Note that the raw data is
-	_NOT_ freed after the upload (so the user can load various versions).
+	_NOT_ freed after the upload (so the user can load various versions), nor
+	changed: it is only copied if the flags have to change the pixels.
 	\param data the raw data to be uploaded as an OpenGL texture
 	\param width the width of the image in pixels
 	\param height the height of the image in pixels
@@ -322,6 +344,28 @@ unsigned int
 		unsigned int flags
 	);
 
+/**
+	Same as SOIL_create_OGL_texture, but SOIL takes over the raw data: it
+	is changed in place for the flags that need it, and freed after the
+	upload.  The data must come from SOIL_load_image (or stbi_image_alloc),
+	and must not be used after this call, whether it succeeds or not.
+	\param data the raw data to be uploaded as an OpenGL texture, then freed
+	\param width the width of the image in pixels
+	\param height the height of the image in pixels
+	\param channels the number of channels: 1-luminous, 2-luminous/alpha, 3-RGB, 4-RGBA
+	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
+	\param flags can be any of SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_MULTIPLY_ALPHA | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT
+	\return 0-failed, otherwise returns the OpenGL texture handle
+**/
+unsigned int
+	SOIL_create_OGL_texture_from_owned_data
+	(
+		unsigned char *data,
+		int width, int height, int channels,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	);
+
 /**
 	Creates an OpenGL cubemap texture by splitting up 1 image into 6 parts.
 	\param data the raw data to be uploaded as an OpenGL texture
@@ -405,9 +449,10 @@ int
 	);
 
 /**
-	Frees the image data (note, this is just C's "free()"...this function is
-	present mostly so C++ programmers don't forget to use "free()" and call
-	"delete []" instead [8^)
+	Frees the image data.  It comes from stb_image's allocator (C's
+	"malloc()" unless stbi_set_allocator says otherwise, see also
+	SOIL_begin_batch), so don't use "free()", and C++ programmers
+	don't use "delete []" either [8^)
 **/
 void
 	SOIL_free_image_data
@@ -415,10 +460,54 @@ void
 		unsigned char *img_data
 	);
 
+/**
+	Turns on the texture cache: SOIL_load_OGL_texture and
+	SOIL_load_OGL_texture_from_memory keep what they finally
+	upload (flipped, resized, MIPmapped, compressed...) in
+	directory, and the next load of the same image file with
+	the same force_channels and flags on a driver that can do
+	the same things just maps that entry and uploads it.  The
+	least recently used entries are deleted once the directory
+	holds more than max_megabytes.  NULL turns the cache off
+	again (the default).  Cubemaps and HDR loads skip it.
+**/
+void
+	SOIL_set_texture_cache
+	(
+		const char *directory,
+		unsigned int max_megabytes
+	);
+
+/**
+	Starts a batch of loads on this thread: until SOIL_end_batch
+	the large buffers SOIL and stb_image allocate (decoded images,
+	resized and MIPmap copies, DXT output) come from a small pool,
+	so each load reuses the blocks the last one freed instead of
+	going back to the heap.  Images still held when the batch ends
+	are the caller's as usual.  Batches nest, only the outermost
+	pair starts and ends one.  Settings changed inside a batch
+	(stbi_set_... calls) last until it ends.
+**/
+void
+	SOIL_begin_batch
+	(
+		void
+	);
+
+/**
+	Ends the batch started by SOIL_begin_batch and releases the
+	pool's idle blocks.
+**/
+void
+	SOIL_end_batch
+	(
+		void
+	);
+
 /**
 	This function resturn a pointer to a string describing the last thing
 	that happened inside SOIL.  It can be used to determine why an image
-	failed to load.
+	failed to load.  Each thread has its own.
 **/
 const char*
 	SOIL_last_result
@@ -0,0 +1,84 @@
+/*
+	BC4 / BC5 / BC6H / BC7 block compression
+	(RGTC and BPTC in OpenGL terms)
+
+	public domain
+*/
+
+#ifndef HEADER_IMAGE_BC
+#define HEADER_IMAGE_BC
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+	How hard the encoders search for good endpoints.
+	FAST fits each block once, NORMAL refines the fit
+	and tries every p-bit / mode combination cheaply,
+	SLOW also tries the alternate block modes and
+	searches around the endpoints it found.
+**/
+enum
+{
+	BC_QUALITY_FAST = 0,
+	BC_QUALITY_NORMAL = 1,
+	BC_QUALITY_SLOW = 2
+};
+
+/**
+	Compresses 16 single channel values into an 8 byte BC4 block.
+	values[i*stride] is texel i, in rows of 4.
+**/
+void
+compress_BC4_block
+(
+    const unsigned char *const values, int stride,
+    int quality,
+    unsigned char compressed[8]
+);
+
+/**
+	Compresses a 4x4 RGBA block (64 bytes, in rows of 4)
+	into a 16 byte BC7 block, using the single subset
+	modes 6 and (at BC_QUALITY_SLOW) 5.
+**/
+void
+compress_BC7_block
+(
+    const unsigned char *const rgba,
+    int quality,
+    unsigned char compressed[16]
+);
+
+/**
+	Compresses a 4x4 block of unsigned HDR RGB floats
+	(48 floats, in rows of 4) into a 16 byte BC6H_UF16
+	block, using the single region modes 11 and
+	(at BC_QUALITY_SLOW) 12.  Negative values become 0.
+**/
+void
+compress_BC6H_block
+(
+    const float *const rgb,
+    int quality,
+    unsigned char compressed[16]
+);
+
+/**
+	Decodes a 16 byte BC7 block (any of the 8 modes) into
+	a 4x4 RGBA block (64 bytes, in rows of 4), bit exact
+	with what the GPU samples.
+**/
+void
+decode_BC7_block
+(
+    const unsigned char *const compressed,
+    unsigned char rgba[64]
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_IMAGE_BC	*/
@@ -10,6 +10,10 @@
 #ifndef HEADER_IMAGE_DXT
 #define HEADER_IMAGE_DXT
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
 	Converts an image from an array of unsigned chars (RGB or RGBA) to
 	DXT1 or DXT5, then saves the converted image to disk.
@@ -23,6 +27,41 @@ save_image_as_DDS
     const unsigned char *const data
 );
 
+/**
+	The block formats save_image_as_DDS_format and
+	convert_image_to_DDS_format can write.
+	DDS_FORMAT_AUTO picks DXT1 or DXT5 by the alpha channel,
+	BC4 keeps only red (or luminance), BC5 keeps red and
+	green (luminance and alpha for 2 channel images).
+	DXT3 can only be decoded.
+**/
+enum
+{
+	DDS_FORMAT_AUTO = 0,
+	DDS_FORMAT_DXT1 = 1,
+	DDS_FORMAT_DXT5 = 2,
+	DDS_FORMAT_BC4 = 3,
+	DDS_FORMAT_BC5 = 4,
+	DDS_FORMAT_BC7 = 5,
+	DDS_FORMAT_DXT3 = 6
+};
+
+/**
+	Same as save_image_as_DDS, in any of the DDS_FORMAT_ types.
+	BC4, BC5 and BC7 are written with a DX10 header.
+	quality is one of the BC_QUALITY_ values from image_BC.h
+	(the DXT formats ignore it).
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_image_as_DDS_format
+(
+    const char *filename,
+    int width, int height, int channels,
+    const unsigned char *const data,
+    int format, int quality
+);
+
 /**
 	take an image and convert it to DXT1 (no alpha)
 **/
@@ -45,6 +84,96 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	take an image and convert it to BC4 (red only, 8 bytes a block)
+**/
+unsigned char*
+convert_image_to_BC4
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int quality,
+    int *out_size
+);
+
+/**
+	take an image and convert it to BC5 (two channels, 16 bytes a block)
+**/
+unsigned char*
+convert_image_to_BC5
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int quality,
+    int *out_size
+);
+
+/**
+	take an image and convert it to BC7 (RGBA, 16 bytes a block)
+**/
+unsigned char*
+convert_image_to_BC7
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int quality,
+    int *out_size
+);
+
+/**
+	take a float image and convert its RGB to BC6H (unsigned, 16 bytes a block)
+**/
+unsigned char*
+convert_image_to_BC6H
+(
+    const float *const uncompressed,
+    int width, int height, int channels,
+    int quality,
+    int *out_size
+);
+
+/**
+	take an image and convert it to one of the DDS_FORMAT_ types
+**/
+unsigned char*
+convert_image_to_DDS_format
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int format, int quality,
+    int *out_size
+);
+
+/**
+	Decodes a compressed image in any of the DDS_FORMAT_ types
+	but AUTO to RGBA, reading what OpenGL would: BC4 comes out
+	as (R,0,0,255) and BC5 as (R,G,0,255).  For drivers without
+	S3TC / RGTC / BPTC support.  BC7 is bit exact, the others
+	follow the spec's formulas, drivers may round a step apart.
+	\return the RGBA image (release it with SOIL_free_image_data()) or NULL
+**/
+unsigned char*
+convert_DDS_format_to_image
+(
+    const unsigned char *const compressed,
+    int width, int height,
+    int format
+);
+
+/**
+	Controls how the converters above run.
+	Large images are split into bands of 4x4 block rows
+	compressed on threads, threads = 0 (the default) uses
+	one per processor and 1 keeps it all on the caller.
+	use_simd = 0 forces the plain C block compressor
+	(the output is the same either way).
+**/
+void
+set_DXT_compression_options
+(
+    int threads, int use_simd
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -85,6 +214,17 @@ typedef struct
 }
 DDS_header ;
 
+/*	follows DDS_header when sPixelFormat.dwFourCC is "DX10"	*/
+typedef struct
+{
+    unsigned int    dxgiFormat;
+    unsigned int    resourceDimension;
+    unsigned int    miscFlag;
+    unsigned int    arraySize;
+    unsigned int    miscFlags2;
+}
+DDS_header_DXT10 ;
+
 /*	the following constants were copied directly off the MSDN website	*/
 
 /*	The dwFlags member of the original DDSURFACEDESC2 structure
@@ -120,4 +260,18 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+/*	DXGI_FORMAT values used in the DX10 header	*/
+#define DXGI_FORMAT_BC1_UNORM	71
+#define DXGI_FORMAT_BC2_UNORM	74
+#define DXGI_FORMAT_BC3_UNORM	77
+#define DXGI_FORMAT_BC4_UNORM	80
+#define DXGI_FORMAT_BC5_UNORM	83
+#define DXGI_FORMAT_BC6H_UF16	95
+#define DXGI_FORMAT_BC7_UNORM	98
+#define DDS_DIMENSION_TEXTURE2D	3
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* HEADER_IMAGE_DXT	*/
@@ -0,0 +1,130 @@
+/*
+	on-disk cache of finished textures
+
+	Every entry is one file holding all the levels of a texture
+	the way they were handed to OpenGL (compressed blocks or raw
+	pixels), laid out so the file can be mapped and each level
+	uploaded straight out of the mapping.  Files are named by a
+	64 bit key, the least recently used ones are deleted once the
+	directory grows past its size cap.
+
+	public domain
+*/
+
+#ifndef HEADER_IMAGE_CACHE
+#define HEADER_IMAGE_CACHE
+
+#include "stb_image_aug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IMAGE_CACHE_MAX_LEVELS	32
+
+/**
+	One level, as it was uploaded.  format is the pixel format
+	glTexImage2D was given, 0 for compressed levels.
+**/
+typedef struct
+{
+	unsigned int internal_format;
+	unsigned int format;
+	int width, height;
+	int size;
+	const unsigned char *data;
+} image_cache_level;
+
+/**
+	A whole texture.  texture_type, flags and swizzle are kept
+	for the caller to set the texture up again.  While it is
+	being built the entry owns copies of the levels, once loaded
+	they point into the mapped file.
+**/
+typedef struct
+{
+	unsigned int texture_type;
+	unsigned int flags;
+	int swizzle;
+	int num_levels;
+	image_cache_level levels[IMAGE_CACHE_MAX_LEVELS];
+	/*	set when a level could not be added, the entry is then never saved	*/
+	int incomplete;
+	stbi_file_map map;
+} image_cache_entry;
+
+/**
+	64 bit hash of length bytes (xxHash64), chain calls through seed.
+**/
+unsigned long long
+image_cache_hash
+(
+    const void *data, int length,
+    unsigned long long seed
+);
+
+/**
+	Clears an entry before levels are added to it.
+**/
+void
+image_cache_init_entry
+(
+    image_cache_entry *entry
+);
+
+/**
+	Appends a copy of the next level to the entry.
+	\return 0 if failed (out of levels or memory), otherwise returns 1
+**/
+int
+image_cache_add_level
+(
+    image_cache_entry *entry,
+    unsigned int internal_format, unsigned int format,
+    int width, int height,
+    int size, const unsigned char *const data
+);
+
+/**
+	Writes the entry to directory (creating it if needed) under
+	key, then deletes the least recently used entries until the
+	directory holds at most max_bytes.  Entries bigger than that
+	on their own are not written at all.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+image_cache_save
+(
+    const char *directory,
+    unsigned long long key,
+    const image_cache_entry *entry,
+    unsigned long long max_bytes
+);
+
+/**
+	Maps the entry stored under key and marks it as just used.
+	Free it with image_cache_free_entry once it is uploaded.
+	\return 0 if there is no (valid) entry, otherwise returns 1
+**/
+int
+image_cache_load
+(
+    const char *directory,
+    unsigned long long key,
+    image_cache_entry *entry
+);
+
+/**
+	Releases the level copies or the mapping behind an entry.
+**/
+void
+image_cache_free_entry
+(
+    image_cache_entry *entry
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADER_IMAGE_CACHE	*/
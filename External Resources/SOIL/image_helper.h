@@ -43,6 +43,83 @@ int
 		int block_size_x, int block_size_y
 	);
 
+/**
+	Filters for mipmap_image_next_level().
+	BOX averages each 2x2 block, KAISER and LANCZOS
+	are 8 tap windowed sinc kernels which keep the
+	smaller levels sharper, at the price of a little
+	ringing around hard edges.
+**/
+enum
+{
+	MIPMAP_FILTER_BOX = 0,
+	MIPMAP_FILTER_KAISER = 1,
+	MIPMAP_FILTER_LANCZOS = 2
+};
+
+/**
+	This function builds the next MIPmap level
+	from the previous one, so a whole chain costs
+	about one extra pass over the base image.
+	The result is max(width/2,1) by max(height/2,1).
+	With gamma_correct the color channels are taken
+	to be sRGB and averaged as linear light (alpha,
+	the last of 2 or 4 channels, never is).
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	mipmap_image_next_level
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int filter, int gamma_correct
+	);
+
+/**
+	Transforms for transform_image(), any combination.
+	FLIP_Y turns the image upside down, NTSC_SAFE_RGB is
+	scale_image_RGB_to_NTSC_safe(), MULTIPLY_ALPHA goes
+	from straight to pre-multiplied alpha (2 and 4
+	channels only) and YCoCg is convert_RGB_to_YCoCg()
+	(3 and 4 channels only).  They are applied in that order.
+**/
+enum
+{
+	IMAGE_TRANSFORM_FLIP_Y = 1,
+	IMAGE_TRANSFORM_NTSC_SAFE_RGB = 2,
+	IMAGE_TRANSFORM_MULTIPLY_ALPHA = 4,
+	IMAGE_TRANSFORM_YCoCg = 8
+};
+
+/**
+	Applies every one of the transforms in a single pass,
+	row by row, writing result (which may be orig).  With
+	a separate result it is also the copy.  Large images
+	are split into bands of rows done on threads.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	transform_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* result,
+		unsigned int transforms
+	);
+
+/**
+	Controls how transform_image() runs.  threads = 0
+	(the default) uses one per processor and 1 keeps it
+	all on the caller.  use_simd = 0 forces the plain C
+	row loops (the output is the same either way).
+**/
+void
+	set_image_transform_options
+	(
+		int threads, int use_simd
+	);
+
 /**
 	This function takes the RGB components of the image
 	and scales each channel from [0,255] to [16,235].
@@ -0,0 +1,160 @@
+/*
+	Internal helpers shared by the threaded paths of SOIL
+	(image_helper, image_DXT and stb_image_aug).  Work is split
+	into bands, one per thread, and the calling thread does the
+	first band itself.  A band whose thread can't be started is
+	done by the caller too, so the output is always complete.
+
+	Everything here is static, include it from .c files only.
+	Files that only need IMAGE_THREAD_LOCAL define
+	IMAGE_THREADS_NO_RUNNER before including it.
+
+	public domain
+*/
+
+#ifndef HEADER_IMAGE_THREADS
+#define HEADER_IMAGE_THREADS
+
+/*	state kept per thread, so loads on different threads don't mix it up	*/
+#if defined(_MSC_VER)
+	#define IMAGE_THREAD_LOCAL	__declspec(thread)
+#elif defined(__GNUC__)
+	#define IMAGE_THREAD_LOCAL	__thread
+#else
+	#define IMAGE_THREAD_LOCAL	_Thread_local
+#endif
+
+#ifndef IMAGE_THREADS_NO_RUNNER
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*	no call is ever split into more bands than this	*/
+#define IMAGE_THREADS_MAX	64
+
+static int
+	image_threads_processor_count
+	(
+		void
+	)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return (count > 0) ? (int)count : 1;
+#endif
+}
+
+/*
+	How many bands to split 'work' units across: 'requested'
+	threads, or one per processor when that is 0, but never
+	less than 'min_work' units per band, more than 'bands'
+	bands, or more than IMAGE_THREADS_MAX.  Always at least 1.
+*/
+static int
+	image_threads_count
+	(
+		int requested, int work, int min_work, int bands
+	)
+{
+	int count = (requested > 0) ? requested : image_threads_processor_count();
+	if( count > work / min_work )
+	{
+		count = work / min_work;
+	}
+	if( count > bands )
+	{
+		count = bands;
+	}
+	if( count > IMAGE_THREADS_MAX )
+	{
+		count = IMAGE_THREADS_MAX;
+	}
+	return (count < 1) ? 1 : count;
+}
+
+typedef struct
+{
+	void (*run)( void *job );
+	void *job;
+} image_threads_band;
+
+#ifdef _WIN32
+static DWORD WINAPI image_threads_proc( LPVOID band )
+{
+	((image_threads_band*)band)->run( ((image_threads_band*)band)->job );
+	return 0;
+}
+#else
+static void* image_threads_proc( void *band )
+{
+	((image_threads_band*)band)->run( ((image_threads_band*)band)->job );
+	return NULL;
+}
+#endif
+
+/*
+	Calls run( job ) for each of the 'count' jobs, which are
+	'job_size' bytes apart starting at 'jobs', and returns
+	once all of them are done.
+*/
+static void
+	image_threads_run
+	(
+		void (*run)( void *job ),
+		void *jobs, int job_size, int count
+	)
+{
+	image_threads_band bands[IMAGE_THREADS_MAX];
+#ifdef _WIN32
+	HANDLE threads[IMAGE_THREADS_MAX];
+#else
+	pthread_t threads[IMAGE_THREADS_MAX];
+#endif
+	int started[IMAGE_THREADS_MAX];
+	int t;
+	if( count > IMAGE_THREADS_MAX )
+	{
+		count = IMAGE_THREADS_MAX;
+	}
+	for( t = 1; t < count; ++t )
+	{
+		bands[t].run = run;
+		bands[t].job = (unsigned char*)jobs + (size_t)t * job_size;
+#ifdef _WIN32
+		threads[t] = CreateThread( NULL, 0, image_threads_proc, &bands[t], 0, NULL );
+		started[t] = (threads[t] != NULL);
+#else
+		started[t] = (pthread_create( &threads[t], NULL, image_threads_proc, &bands[t] ) == 0);
+#endif
+	}
+	run( jobs );
+	for( t = 1; t < count; ++t )
+	{
+		if( !started[t] )
+		{
+			run( bands[t].job );
+			continue;
+		}
+#ifdef _WIN32
+		WaitForSingleObject( threads[t], INFINITE );
+		CloseHandle( threads[t] );
+#else
+		pthread_join( threads[t], NULL );
+#endif
+	}
+}
+
+#endif /* IMAGE_THREADS_NO_RUNNER	*/
+
+#endif /* HEADER_IMAGE_THREADS	*/
@@ -13,7 +13,12 @@
       HDR (radiance rgbE format)
       writes BMP,TGA (define STBI_NO_WRITE to remove code)
       decoded from memory or through stdio FILE (define STBI_NO_STDIO to remove code)
-      supports installable dequantizing-IDCT, YCbCr-to-RGB conversion (define STBI_SIMD)
+      SSE2 dequantizing-IDCT, YCbCr-to-RGB and 4:2:0 upsampling, picked at runtime;
+         installable replacements for the first two (stbi_install_idct etc)
+      JPEG restart intervals decoded, and colour converted, on one thread per core
+         (stbi_set_jpeg_threads; define STBI_NO_THREADS to remove code)
+      JPEG/PNG/BMP/TGA decoded from a read callback and handed out a band of rows
+         at a time, without the whole file or image in memory (stbi_load_rows_from_callbacks)
         
    TODO:
       stbi_info_*
@@ -71,7 +76,7 @@
 // Limitations:
 //    - no progressive/interlaced support (jpeg, png)
 //    - 8-bit samples only (jpeg, png)
-//    - not threadsafe
+//    - threadsafe only through contexts (see CONTEXTS below)
 //    - channel subsampling of at most 2 in each dimension (jpeg)
 //    - no delayed line count (jpeg) -- IJG doesn't support either
 //
@@ -157,6 +162,7 @@
 #ifndef STBI_NO_STDIO
 #include <stdio.h>
 #endif
+#include <stddef.h> // size_t
 
 #define STBI_VERSION 1
 
@@ -197,6 +203,21 @@ extern int      stbi_info_from_file  (FILE *f,                  int *x, int *y,
 extern stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 
+#ifndef STBI_NO_STDIO
+// the whole of a file, mapped read-only where the OS allows it (mmap / MapViewOfFile),
+// otherwise read into one malloc'd buffer. every load-by-filename goes through this
+typedef struct
+{
+   stbi_uc const *data;
+   int len;
+   int mapped;  // 0 when data is the malloc'd copy
+} stbi_file_map;
+
+// returns 0 (and sets the failure reason) if the file can't be opened
+extern int      stbi_map_file        (char const *filename,     stbi_file_map *map);
+extern void     stbi_unmap_file      (stbi_file_map *map);
+#endif
+
 #ifndef STBI_NO_HDR
 #ifndef STBI_NO_STDIO
 extern float *stbi_loadf            (char const *filename,     int *x, int *y, int *comp, int req_comp);
@@ -213,10 +234,11 @@ extern void   stbi_ldr_to_hdr_scale(float scale);
 #endif // STBI_NO_HDR
 
 // get a VERY brief reason for failure
-// NOT THREADSAFE
+// kept per thread, or per context for a thread using one of its own
 extern char    *stbi_failure_reason  (void); 
 
-// free the loaded image -- this is just free()
+// free the loaded image (or any other buffer stb_image hands back) with
+// the current context's allocator, see CONTEXTS below
 extern void     stbi_image_free      (void *retval_from_stbi_load);
 
 // get image dimensions & components without fully decoding
@@ -229,6 +251,7 @@ extern int      stbi_is_hdr_from_file(FILE *f);
 #endif
 
 // ZLIB client - used by PNG, available for other purposes
+// (the _malloc versions' results are freed with stbi_image_free)
 
 extern char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
 extern char *stbi_zlib_decode_malloc(const char *buffer, int len, int *outlen);
@@ -237,6 +260,33 @@ extern int   stbi_zlib_decode_buffer(char *obuffer, int olen, const char *ibuffe
 extern char *stbi_zlib_decode_noheader_malloc(const char *buffer, int len, int *outlen);
 extern int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char *ibuffer, int ilen);
 
+// STREAMING API - JPEG, PNG, BMP and TGA only
+//
+// the file comes in through read (which returns how many bytes it put in data,
+// 0 at the end, and may block until more arrive) and skip (which may be NULL,
+// then skipped bytes are read and dropped). pixels go out through rows, count
+// finished rows at a time starting at row y, each row *x pixels of req_comp (or
+// *comp) components; x, y and comp are filled in before the first call. the
+// rows are only valid during the call. BMP and TGA files stored bottom-up come
+// out bottom-up, one row at a time; JPEGs with one component per scan come out
+// only after all of their scans. returns 0 if loading failed part way, in which
+// case some rows may already have been handed out.
+//
+// gray and RGB PNGs with a tRNS chunk come out with the alpha channel it adds,
+// and *comp counts it: an RGB+tRNS file gives 4 here where stbi_load gives 3.
+// the same user pointer goes to read, skip and rows, so one struct has to
+// carry whatever all three need.
+
+typedef struct
+{
+   int  (*read)(void *user, char *data, int size);
+   void (*skip)(void *user, int n);
+} stbi_io_callbacks;
+
+typedef void (*stbi_rows_callback)(void *user, stbi_uc const *pixels, int y, int count);
+
+extern int      stbi_load_rows_from_callbacks(stbi_io_callbacks const *io, stbi_rows_callback rows, void *user, int *x, int *y, int *comp, int req_comp);
+
 // TYPE-SPECIFIC ACCESS
 
 // is it a jpeg?
@@ -302,6 +352,7 @@ extern int      stbi_hdr_test_memory      (stbi_uc const *buffer, int len);
 extern float *  stbi_hdr_load             (char const *filename,     int *x, int *y, int *comp, int req_comp);
 extern float *  stbi_hdr_load_from_memory (stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 extern stbi_uc *stbi_hdr_load_rgbe        (char const *filename,           int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_hdr_load_rgbe_memory (stbi_uc *buffer, int len, int *x, int *y, int *comp, int req_comp);
 extern float *  stbi_hdr_load_from_memory (stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 #ifndef STBI_NO_STDIO
 extern int      stbi_hdr_test_file        (FILE *f);
@@ -320,19 +371,22 @@ typedef struct
    #endif
 } stbi_loader;
 
+#define STBI_MAX_LOADERS  32
+
 // register a loader by filling out the above structure (you must defined ALL functions)
+// with the current context (see CONTEXTS below)
 // returns 1 if added or already added, 0 if not added (too many loaders)
-// NOT THREADSAFE
 extern int stbi_register_loader(stbi_loader *loader);
 
-// define faster low-level operations (typically SIMD support)
-#if STBI_SIMD
-typedef void (*stbi_idct_8x8)(uint8 *out, int out_stride, short data[64], unsigned short *dequantize);
+// replace the low-level JPEG operations (the built-in ones already use SSE2
+// when the CPU has it) in the current context; install NULL to go back to
+// the built-in one
+typedef void (*stbi_idct_8x8)(stbi_uc *out, int out_stride, short data[64], unsigned short *dequantize);
 // compute an integer IDCT on "input"
 //     input[x] = data[x] * dequantize[x]
 //     write results to 'out': 64 samples, each run of 8 spaced by 'out_stride'
 //                             CLAMP results to 0..255
-typedef void (*stbi_YCbCr_to_RGB_run)(uint8 *output, uint8 const *y, uint8 const *cb, uint8 const *cr, int count, int step);
+typedef void (*stbi_YCbCr_to_RGB_run)(stbi_uc *output, stbi_uc const *y, stbi_uc const *cb, stbi_uc const *cr, int count, int step);
 // compute a conversion from YCbCr to RGB
 //     'count' pixels
 //     write pixels to 'output'; each pixel is 'step' bytes (either 3 or 4; if 4, write '255' as 4th), order R,G,B
@@ -342,7 +396,57 @@ typedef void (*stbi_YCbCr_to_RGB_run)(uint8 *output, uint8 const *y, uint8 const
 
 extern void stbi_install_idct(stbi_idct_8x8 func);
 extern void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func);
-#endif // STBI_SIMD
+
+// how many threads a JPEG decode may use: restart intervals are decoded in
+// parallel (images loaded from memory or by filename), then bands of rows
+// are colour converted in parallel. 0 = one per core (the default), 1 = all
+// on the calling thread. Small images always stay on the calling thread.
+// Set in the current context.
+extern void stbi_set_jpeg_threads(int threads);
+
+// CONTEXTS
+//
+// everything a load reads or reports besides its arguments: the settings
+// above (HDR conversion, installed JPEG kernels, JPEG threads), registered
+// loaders, the allocator and the failure reason. each call works in the calling thread's
+// current context, which is the default one until stbi_use_context binds
+// another. the setters change the current context, so in the default one
+// they belong before other threads start loading; failure reasons are
+// kept per thread even there. threads that each use their own context
+// share nothing and can load, save and change settings at will.
+
+typedef struct
+{
+   char *failure_reason;
+   float hdr_to_ldr_gamma, hdr_to_ldr_scale;  // as given to the setters
+   float ldr_to_hdr_gamma, ldr_to_hdr_scale;
+   stbi_idct_8x8 idct;                        // NULL for the built-in kernels
+   stbi_YCbCr_to_RGB_run YCbCr_to_RGB;
+   int jpeg_threads;
+   stbi_loader *loaders[STBI_MAX_LOADERS];
+   int num_loaders;
+   // NULL for the C library's; all three are set together
+   void *(*malloc_fn)(void *user, size_t size);
+   void *(*realloc_fn)(void *user, void *p, size_t size);
+   void  (*free_fn)(void *user, void *p);
+   void  *alloc_user;
+} stbi_context;
+
+// fill ctx in with the default context's settings and loaders
+extern void          stbi_context_init(stbi_context *ctx);
+// make ctx the calling thread's current context (NULL for the default
+// one), returning the one it replaces
+extern stbi_context *stbi_use_context(stbi_context *ctx);
+
+// have the current context allocate every buffer (images included) through
+// these, which get user back; NULLs restore the C library's. buffers must
+// be freed under the allocator they came from
+extern void          stbi_set_allocator(void *(*malloc_fn)(void *user, size_t size),
+                                        void *(*realloc_fn)(void *user, void *p, size_t size),
+                                        void  (*free_fn)(void *user, void *p), void *user);
+// a buffer from the current allocator, for code that hands out images of
+// its own alongside stb_image's (to be freed with stbi_image_free)
+extern void         *stbi_image_alloc(size_t size);
 
 #ifdef __cplusplus
 }
@@ -326,7 +326,7 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 			dwPitchOrLinearSize == 0	*/
 		//	passed all the tests, get the RAM for decoding
 		sz = (s->img_x)*(s->img_y)*4*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)stbi_malloc( sz );
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
@@ -414,7 +414,7 @@ static stbi_uc *dds_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 		}
 		*comp = s->img_n;
 		sz = s->img_x*s->img_y*s->img_n*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)stbi_malloc( sz );
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
@@ -495,10 +495,10 @@ stbi_uc *stbi_dds_load_from_file   (FILE *f,                  int *x, int *y, in
 stbi_uc *stbi_dds_load             (char *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_dds_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_dds_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 #endif
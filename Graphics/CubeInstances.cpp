@@ -0,0 +1,84 @@
+#include "CubeInstances.h"
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#include <cmath>
+#include <cstddef>
+
+std::vector<CubeInstance> layoutCubeInstances(size_t count)
+{
+    std::vector<CubeInstance> instances(count);
+    if (count == 1) {
+        instances[0].model = glm::mat4(1.0f);
+        instances[0].color = glm::vec4(1.0f);
+        return instances;
+    }
+
+    //Square grid covering [-2, 2] in x and y, cubes scaled to leave a gap and sitting on the floor (z = -0.5)
+    size_t side = (size_t)std::ceil(std::sqrt((double)count));
+    float spacing = 4.0f / side;
+    float scale = spacing * 0.6f;
+    for (size_t i = 0; i < count; ++i) {
+        float x = -2.0f + spacing * ((i % side) + 0.5f);
+        float y = -2.0f + spacing * ((i / side) + 0.5f);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -0.5f + 0.5f * scale));
+        instances[i].model = glm::scale(model, glm::vec3(scale));
+
+        //Cheap integer hash so neighbouring cubes get visibly different, but reproducible, tints
+        unsigned int h = (unsigned int)i * 2654435761u;
+        instances[i].color = glm::vec4(0.5f + 0.5f * ((h >> 8) & 0xFF) / 255.0f,
+                                       0.5f + 0.5f * ((h >> 16) & 0xFF) / 255.0f,
+                                       0.5f + 0.5f * ((h >> 24) & 0xFF) / 255.0f,
+                                       1.0f);
+    }
+    return instances;
+}
+
+InstanceAttributes findInstanceAttributes(const ShaderProgram& shaderProgram)
+{
+    InstanceAttributes attributes;
+    attributes.model = shaderProgram.attributeLocation("instanceModel");
+    attributes.color = shaderProgram.attributeLocation("instanceColor");
+    return attributes;
+}
+
+void specifyInstanceAttributes(const InstanceAttributes& attributes, GLuint buffer)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    //A mat4 attribute is four vec4 columns in consecutive locations
+    for (GLint column = 0; column < 4; ++column) {
+        GLint location = attributes.model + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance),
+                              (void*)(offsetof(CubeInstance, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(attributes.color);
+    glVertexAttribPointer(attributes.color, 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, color));
+    glVertexAttribDivisor(attributes.color, 1);
+}
+
+void setConstantInstance(const InstanceAttributes& attributes, const CubeInstance& instance)
+{
+    for (GLint column = 0; column < 4; ++column)
+        glVertexAttrib4fv(attributes.model + column, glm::value_ptr(instance.model[column]));
+    glVertexAttrib4fv(attributes.color, glm::value_ptr(instance.color));
+}
+
+void CubeInstanceBuffer::create()
+{
+    glGenBuffers(1, &buffer);
+}
+
+void CubeInstanceBuffer::destroy()
+{
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    instances.clear();
+}
+
+void CubeInstanceBuffer::upload(const std::vector<CubeInstance>& data)
+{
+    instances = data;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CubeInstance), instances.data(), GL_STATIC_DRAW);
+}
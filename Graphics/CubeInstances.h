@@ -0,0 +1,43 @@
+#pragma once
+#include "ShaderProgram.h"
+#include <glm.hpp>
+#include <vector>
+
+//Per-instance data of the scene cubes, one element per cube in the instance buffer
+struct CubeInstance
+{
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+//Lays count cubes out on a square grid resting on the floor
+//A count of 1 gives the original single white cube at the origin
+std::vector<CubeInstance> layoutCubeInstances(size_t count);
+
+//Attribute locations of the per-instance inputs (instanceModel takes four consecutive locations)
+struct InstanceAttributes
+{
+    GLint model = -1;
+    GLint color = -1;
+};
+
+InstanceAttributes findInstanceAttributes(const ShaderProgram& shaderProgram);
+
+//Points the instance attributes of the currently bound VAO at buffer, advancing once per instance
+void specifyInstanceAttributes(const InstanceAttributes& attributes, GLuint buffer);
+
+//For VAOs without instance arrays (the floor, the per-cube fallback): sets the instance inputs as constant vertex attributes
+void setConstantInstance(const InstanceAttributes& attributes, const CubeInstance& instance);
+
+//Instance buffer for the cube draws, a CPU copy is kept for the one-draw-per-cube comparison path
+class CubeInstanceBuffer
+{
+public:
+    GLuint buffer = 0;
+    std::vector<CubeInstance> instances;
+
+    void create();
+    void destroy();
+    void upload(const std::vector<CubeInstance>& data);
+    GLsizei count() const { return (GLsizei)instances.size(); }
+};
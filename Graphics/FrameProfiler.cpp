@@ -0,0 +1,265 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+static const char* passNames[PassCount] = {
+    "scene_cubes",
+    "stencil_floor",
+    "reflection",
+    "grid",
+    "post_process"
+};
+
+const char* renderPassName(RenderPass pass)
+{
+    return passNames[pass];
+}
+
+//Nearest-rank percentiles, good enough for a few hundred to a few thousand frames
+static Percentiles computePercentiles(std::vector<double> samples)
+{
+    Percentiles result;
+    if (samples.empty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double p) {
+        size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+        return samples[std::min(index, samples.size() - 1)];
+    };
+    double sum = 0.0;
+    for (double s : samples)
+        sum += s;
+    result.mean = sum / samples.size();
+    result.p50 = rank(0.50);
+    result.p95 = rank(0.95);
+    result.p99 = rank(0.99);
+    result.max = samples.back();
+    return result;
+}
+
+FrameProfiler::FrameProfiler()
+{
+    for (int i = 0; i < QueryLatency; ++i) {
+        querySlotFrame[i] = -1;
+        for (int p = 0; p < PassCount; ++p)
+            queries[i][p] = 0;
+    }
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if (initialized)
+        glDeleteQueries(QueryLatency * PassCount, &queries[0][0]);
+}
+
+void FrameProfiler::init(int warmupFrames)
+{
+    warmup = warmupFrames;
+    glGenQueries(QueryLatency * PassCount, &queries[0][0]);
+    initialized = true;
+}
+
+void FrameProfiler::beginFrame()
+{
+    int slot = frames.size() % QueryLatency;
+    //The slot still holds the queries from QueryLatency frames ago, read them before reuse
+    collectQueries(slot);
+    querySlotFrame[slot] = (long)frames.size();
+    frames.push_back(FrameTiming());
+    frameStart = Clock::now();
+}
+
+void FrameProfiler::beginPass(RenderPass pass)
+{
+    int slot = (frames.size() - 1) % QueryLatency;
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass]);
+    passStart[pass] = Clock::now();
+}
+
+void FrameProfiler::endPass(RenderPass pass)
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    frames.back().cpuMs[pass] = std::chrono::duration<double, std::milli>(Clock::now() - passStart[pass]).count();
+}
+
+void FrameProfiler::endFrame()
+{
+    frames.back().frameMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+}
+
+void FrameProfiler::collectQueries(int slot)
+{
+    long frame = querySlotFrame[slot];
+    if (frame < 0)
+        return;
+    for (int p = 0; p < PassCount; ++p) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[slot][p], GL_QUERY_RESULT, &elapsed);
+        frames[frame].gpuMs[p] = elapsed / 1.0e6;
+    }
+    querySlotFrame[slot] = -1;
+}
+
+void FrameProfiler::finish()
+{
+    for (int i = 0; i < QueryLatency; ++i)
+        collectQueries(i);
+}
+
+void FrameProfiler::reset()
+{
+    finish();
+    frames.clear();
+}
+
+//Pass timings of the non-warmup frames, pass == PassCount gives whole frame times
+std::vector<double> FrameProfiler::samples(int pass, bool gpu) const
+{
+    std::vector<double> result;
+    for (size_t f = warmup; f < frames.size(); ++f) {
+        if (pass == PassCount)
+            result.push_back(frames[f].frameMs);
+        else
+            result.push_back(gpu ? frames[f].gpuMs[pass] : frames[f].cpuMs[pass]);
+    }
+    return result;
+}
+
+BenchmarkRun FrameProfiler::summarize(long parameter) const
+{
+    BenchmarkRun run;
+    run.parameter = parameter;
+    run.frame = computePercentiles(samples(PassCount, false));
+    for (int p = 0; p < PassCount; ++p) {
+        run.cpu[p] = computePercentiles(samples(p, false));
+        run.gpu[p] = computePercentiles(samples(p, true));
+    }
+    return run;
+}
+
+void FrameProfiler::printSummary() const
+{
+    std::vector<double> frameMs = samples(PassCount, false);
+    Percentiles total = computePercentiles(frameMs);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Benchmark: " << frameMs.size() << " frames (" << warmup << " warmup)\n";
+    std::cout << "  frame          mean " << total.mean << " ms  p50 " << total.p50 << "  p95 " << total.p95 << "  p99 " << total.p99 << "\n";
+    for (int p = 0; p < PassCount; ++p) {
+        Percentiles c = computePercentiles(samples(p, false)), g = computePercentiles(samples(p, true));
+        std::cout << "  " << std::left << std::setw(14) << passNames[p] << std::right
+                  << " cpu p50 " << c.p50 << "  p99 " << c.p99
+                  << " | gpu p50 " << g.p50 << "  p99 " << g.p99 << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+static void writeJsonPercentiles(std::ofstream& out, const Percentiles& p)
+{
+    out << "{ \"mean\": " << p.mean << ", \"p50\": " << p.p50 << ", \"p95\": " << p.p95
+        << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << " }";
+}
+
+bool FrameProfiler::writeResults(const std::string& path) const
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open benchmark output " << path << "\n";
+        return false;
+    }
+    out << std::setprecision(6);
+
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        out << "frame,warmup,frame_ms";
+        for (int p = 0; p < PassCount; ++p)
+            out << "," << passNames[p] << "_cpu_ms," << passNames[p] << "_gpu_ms";
+        out << "\n";
+        for (size_t f = 0; f < frames.size(); ++f) {
+            out << f << "," << (f < (size_t)warmup ? 1 : 0) << "," << frames[f].frameMs;
+            for (int p = 0; p < PassCount; ++p)
+                out << "," << frames[f].cpuMs[p] << "," << frames[f].gpuMs[p];
+            out << "\n";
+        }
+        return true;
+    }
+
+    std::vector<double> frameMs = samples(PassCount, false);
+
+    out << "{\n  \"frames\": " << frameMs.size() << ",\n  \"warmup\": " << warmup << ",\n";
+    out << "  \"frame_ms\": ";
+    writeJsonPercentiles(out, computePercentiles(frameMs));
+    out << ",\n  \"passes\": {\n";
+    for (int p = 0; p < PassCount; ++p) {
+        out << "    \"" << passNames[p] << "\": { \"cpu_ms\": ";
+        writeJsonPercentiles(out, computePercentiles(samples(p, false)));
+        out << ", \"gpu_ms\": ";
+        writeJsonPercentiles(out, computePercentiles(samples(p, true)));
+        out << " }" << (p + 1 < PassCount ? "," : "") << "\n";
+    }
+    out << "  },\n  \"frame_ms_per_frame\": [";
+    for (size_t i = 0; i < frameMs.size(); ++i)
+        out << (i ? ", " : "") << frameMs[i];
+    out << "]\n}\n";
+    return true;
+}
+
+bool writeSweepResults(const std::string& path, const char* parameterName, const std::vector<BenchmarkRun>& runs)
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open benchmark output " << path << "\n";
+        return false;
+    }
+    out << std::setprecision(6);
+
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        out << parameterName << ",frame_p50_ms,frame_p95_ms,frame_p99_ms";
+        for (int p = 0; p < PassCount; ++p)
+            out << "," << passNames[p] << "_cpu_p50_ms," << passNames[p] << "_gpu_p50_ms";
+        out << "\n";
+        for (const BenchmarkRun& run : runs) {
+            out << run.parameter << "," << run.frame.p50 << "," << run.frame.p95 << "," << run.frame.p99;
+            for (int p = 0; p < PassCount; ++p)
+                out << "," << run.cpu[p].p50 << "," << run.gpu[p].p50;
+            out << "\n";
+        }
+        return true;
+    }
+
+    out << "[\n";
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const BenchmarkRun& run = runs[r];
+        out << "  { \"" << parameterName << "\": " << run.parameter << ", \"frame_ms\": ";
+        writeJsonPercentiles(out, run.frame);
+        out << ", \"passes\": {";
+        for (int p = 0; p < PassCount; ++p) {
+            out << (p ? ", " : " ") << "\"" << passNames[p] << "\": { \"cpu_ms\": ";
+            writeJsonPercentiles(out, run.cpu[p]);
+            out << ", \"gpu_ms\": ";
+            writeJsonPercentiles(out, run.gpu[p]);
+            out << " }";
+        }
+        out << " } }" << (r + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+    return true;
+}
+
+void printSweepResults(const char* parameterName, const std::vector<BenchmarkRun>& runs)
+{
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Sweep over " << parameterName << " (p50 ms)\n";
+    std::cout << std::setw(12) << parameterName << std::setw(10) << "frame"
+              << std::setw(12) << "cubes cpu" << std::setw(12) << "cubes gpu"
+              << std::setw(12) << "refl cpu" << std::setw(12) << "refl gpu" << "\n";
+    for (const BenchmarkRun& run : runs) {
+        std::cout << std::setw(12) << run.parameter << std::setw(10) << run.frame.p50
+                  << std::setw(12) << run.cpu[PassSceneCubes].p50 << std::setw(12) << run.gpu[PassSceneCubes].p50
+                  << std::setw(12) << run.cpu[PassReflection].p50 << std::setw(12) << run.gpu[PassReflection].p50 << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "RenderContext.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+//Passes of the render loop that get their own CPU and GPU timings
+enum RenderPass
+{
+    PassSceneCubes,
+    PassStencilFloor,
+    PassReflection,
+    PassGrid,
+    PassPostProcess,
+    PassCount
+};
+
+const char* renderPassName(RenderPass pass);
+
+struct Percentiles
+{
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+//Statistics of one benchmark run, one row of a sweep
+struct BenchmarkRun
+{
+    long parameter = 0;
+    Percentiles frame;
+    Percentiles cpu[PassCount];
+    Percentiles gpu[PassCount];
+};
+
+//Times every pass of every frame with CPU timestamps and GL_TIME_ELAPSED queries
+//Queries are kept in a small ring so reading a result never waits on the frame that was just submitted
+class FrameProfiler
+{
+public:
+    FrameProfiler();
+    ~FrameProfiler();
+
+    //Frames below warmupFrames are recorded but left out of the statistics
+    void init(int warmupFrames);
+    void beginFrame();
+    void beginPass(RenderPass pass);
+    void endPass(RenderPass pass);
+    //Call after the frame has been presented so the frame time includes the present
+    void endFrame();
+    //Reads back every query still in flight, call before reporting
+    void finish();
+    //Drops all recorded frames so the same profiler can time the next run of a sweep
+    void reset();
+
+    void printSummary() const;
+    //Per-frame rows for .csv paths, percentile summary plus per-frame arrays for anything else (.json)
+    bool writeResults(const std::string& path) const;
+    //Statistics of the non-warmup frames, tagged with the swept parameter (e.g. the instance count)
+    BenchmarkRun summarize(long parameter) const;
+
+private:
+    static const int QueryLatency = 4;
+
+    struct FrameTiming
+    {
+        double frameMs = 0.0;
+        double cpuMs[PassCount] = {};
+        double gpuMs[PassCount] = {};
+    };
+
+    void collectQueries(int slot);
+    std::vector<double> samples(int pass, bool gpu) const;
+
+    typedef std::chrono::steady_clock Clock;
+    GLuint queries[QueryLatency][PassCount];
+    long querySlotFrame[QueryLatency];
+    Clock::time_point frameStart;
+    Clock::time_point passStart[PassCount];
+    std::vector<FrameTiming> frames;
+    int warmup = 0;
+    bool initialized = false;
+};
+
+//One row per run, the parameter column is named after what was swept. CSV for .csv paths, JSON otherwise
+bool writeSweepResults(const std::string& path, const char* parameterName, const std::vector<BenchmarkRun>& runs);
+void printSweepResults(const char* parameterName, const std::vector<BenchmarkRun>& runs);
@@ -0,0 +1,27 @@
+#include "FrameUniforms.h"
+#include <cstring>
+
+void FrameUniformBuffer::create()
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), NULL, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameUniformBinding, buffer);
+}
+
+void FrameUniformBuffer::destroy()
+{
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void FrameUniformBuffer::update(const FrameUniformData& data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    void* mapped = glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        memcpy(mapped, &data, sizeof(FrameUniformData));
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "RenderContext.h"
+#include <glm.hpp>
+
+//Binding point every program's FrameData block is attached to
+const GLuint FrameUniformBinding = 0;
+
+//Mirrors the std140 layout of the FrameData block declared in the shaders:
+//    layout(std140) uniform FrameData { mat4 view; mat4 proj; mat4 viewProj; vec4 cameraPos; float time; };
+//mat4 and vec4 are already 16-byte aligned, the trailing float is padded out to a full vec4
+struct FrameUniformData
+{
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 viewProj;
+    glm::vec4 cameraPos;
+    float time;
+    float padding[3];
+};
+static_assert(sizeof(FrameUniformData) == 3 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4), "FrameUniformData must match the std140 FrameData block");
+
+//One uniform buffer shared by every program that declares FrameData, written once per frame
+class FrameUniformBuffer
+{
+public:
+    GLuint buffer = 0;
+
+    void create();
+    void destroy();
+    //Orphans the previous frame's storage so the driver never waits for draws still reading it
+    void update(const FrameUniformData& data);
+};
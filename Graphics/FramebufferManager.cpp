@@ -0,0 +1,174 @@
+#include "FramebufferManager.h"
+#include <algorithm>
+#include <iostream>
+
+static void allocateTarget(RenderTarget& target)
+{
+    const RenderTargetDesc& desc = target.desc;
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+
+    if (desc.samples > 1) {
+        glGenRenderbuffers(1, &target.colorRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.colorRenderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.colorFormat, desc.width, desc.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRenderbuffer);
+    }
+    else {
+        glGenTextures(1, &target.colorTexture);
+        glBindTexture(GL_TEXTURE_2D, target.colorTexture);
+        //No data is uploaded, the format/type pair only has to be legal for the internal format
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.colorFormat, desc.width, desc.height, 0,
+                     desc.colorFormat == GL_RGB8 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        //Blur and edge taps near the border must not wrap around to the other side
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+    }
+
+    if (desc.depthStencilFormat != GL_NONE) {
+        glGenRenderbuffers(1, &target.depthStencilRenderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depthStencilRenderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples > 1 ? desc.samples : 0,
+                                         desc.depthStencilFormat, desc.width, desc.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depthStencilRenderbuffer);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Render target " << desc.width << "x" << desc.height << " format 0x" << std::hex << desc.colorFormat
+                  << std::dec << " samples " << desc.samples << " is incomplete\n";
+}
+
+static void freeTarget(RenderTarget& target)
+{
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteTextures(1, &target.colorTexture);
+    glDeleteRenderbuffers(1, &target.colorRenderbuffer);
+    glDeleteRenderbuffers(1, &target.depthStencilRenderbuffer);
+    target.framebuffer = target.colorTexture = target.colorRenderbuffer = target.depthStencilRenderbuffer = 0;
+}
+
+//What the driver most likely stores per sample, RGB8 is padded to four bytes
+static size_t bytesPerSample(GLenum format)
+{
+    switch (format) {
+    case GL_NONE: return 0;
+    case GL_RGBA16F: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+    }
+}
+
+static size_t targetBytes(const RenderTargetDesc& desc)
+{
+    size_t pixels = (size_t)desc.width * desc.height * std::max(desc.samples, 1);
+    return pixels * (bytesPerSample(desc.colorFormat) + bytesPerSample(desc.depthStencilFormat));
+}
+
+void FramebufferManager::init(int width, int height)
+{
+    screenWidth = width;
+    screenHeight = height;
+}
+
+void FramebufferManager::destroy()
+{
+    for (auto& target : persistents)
+        freeTarget(*target);
+    for (auto& target : transients)
+        freeTarget(*target);
+    persistents.clear();
+    transients.clear();
+}
+
+RenderTargetDesc FramebufferManager::screenDesc(GLenum colorFormat) const
+{
+    RenderTargetDesc desc;
+    desc.width = screenWidth;
+    desc.height = screenHeight;
+    desc.colorFormat = colorFormat;
+    return desc;
+}
+
+RenderTarget* FramebufferManager::createTarget(const RenderTargetDesc& desc, bool screenSized)
+{
+    std::unique_ptr<RenderTarget> target(new RenderTarget());
+    target->desc = desc;
+    target->screenSized = screenSized;
+    if (screenSized) {
+        target->desc.width = screenWidth;
+        target->desc.height = screenHeight;
+    }
+    allocateTarget(*target);
+    persistents.push_back(std::move(target));
+    return persistents.back().get();
+}
+
+RenderTarget* FramebufferManager::acquireTransient(const RenderTargetDesc& desc)
+{
+    for (auto& target : transients) {
+        if (!target->inUse && target->desc == desc) {
+            target->inUse = true;
+            return target.get();
+        }
+    }
+    std::unique_ptr<RenderTarget> target(new RenderTarget());
+    target->desc = desc;
+    target->inUse = true;
+    allocateTarget(*target);
+    transients.push_back(std::move(target));
+    return transients.back().get();
+}
+
+void FramebufferManager::releaseTransient(RenderTarget* target)
+{
+    if (target)
+        target->inUse = false;
+}
+
+bool FramebufferManager::resize(int width, int height)
+{
+    //Minimized windows report 0x0, keep the old targets until there is something to draw again
+    if (width <= 0 || height <= 0 || (width == screenWidth && height == screenHeight))
+        return false;
+    screenWidth = width;
+    screenHeight = height;
+
+    for (auto& target : persistents) {
+        if (!target->screenSized)
+            continue;
+        freeTarget(*target);
+        target->desc.width = width;
+        target->desc.height = height;
+        allocateTarget(*target);
+    }
+    //Pooled targets were sized for the old screen, let the next frame allocate what it actually needs
+    for (auto& target : transients) {
+        if (!target->inUse)
+            freeTarget(*target);
+    }
+    auto unused = std::remove_if(transients.begin(), transients.end(),
+                                 [](const std::unique_ptr<RenderTarget>& target) { return target->framebuffer == 0; });
+    transients.erase(unused, transients.end());
+    return true;
+}
+
+size_t FramebufferManager::allocatedBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& target : persistents)
+        bytes += targetBytes(target->desc);
+    for (const auto& target : transients)
+        bytes += targetBytes(target->desc);
+    return bytes;
+}
+
+void resolveRenderTarget(const RenderTarget& source, const RenderTarget& destination)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination.framebuffer);
+    glBlitFramebuffer(0, 0, source.desc.width, source.desc.height, 0, 0, destination.desc.width, destination.desc.height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
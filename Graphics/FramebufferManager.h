@@ -0,0 +1,71 @@
+#pragma once
+#include "RenderContext.h"
+#include <memory>
+#include <vector>
+
+//What a render target needs to be allocated: size, color and depth/stencil formats and MSAA samples
+//colorFormat GL_RGBA16F gives an HDR target, depthStencilFormat GL_NONE leaves the depth/stencil attachment out
+struct RenderTargetDesc
+{
+    int width = 0;
+    int height = 0;
+    GLenum colorFormat = GL_RGB8;
+    GLenum depthStencilFormat = GL_NONE;
+    int samples = 1;
+
+    bool operator==(const RenderTargetDesc& other) const
+    {
+        return width == other.width && height == other.height && colorFormat == other.colorFormat &&
+               depthStencilFormat == other.depthStencilFormat && samples == other.samples;
+    }
+};
+
+//A framebuffer with its attachments. Single-sampled color is a texture so later passes can sample it,
+//multisampled color is a renderbuffer that has to be resolved first (resolveRenderTarget)
+struct RenderTarget
+{
+    RenderTargetDesc desc;
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;
+    GLuint colorRenderbuffer = 0;
+    GLuint depthStencilRenderbuffer = 0;
+    bool screenSized = false;
+    bool inUse = false;
+};
+
+//Owns every offscreen target of the renderer
+//Persistent targets live for the whole run, screen-sized ones are reallocated in place when the framebuffer size changes
+//Transient targets are borrowed for a pass or two and returned to a pool, the next request with the same descriptor reuses them
+class FramebufferManager
+{
+public:
+    void init(int width, int height);
+    void destroy();
+
+    int width() const { return screenWidth; }
+    int height() const { return screenHeight; }
+    //Descriptor of a screen-sized color target without depth, the usual post-process intermediate
+    RenderTargetDesc screenDesc(GLenum colorFormat) const;
+
+    //The pointer stays valid until destroy(), resizes only swap the GL objects behind it
+    //For screen-sized targets the descriptor's width and height are ignored
+    RenderTarget* createTarget(const RenderTargetDesc& desc, bool screenSized);
+
+    RenderTarget* acquireTransient(const RenderTargetDesc& desc);
+    void releaseTransient(RenderTarget* target);
+
+    //Reallocates screen-sized targets and frees pooled transient ones, returns false if the size didn't change
+    bool resize(int width, int height);
+
+    size_t allocatedBytes() const;
+    size_t transientCount() const { return transients.size(); }
+
+private:
+    std::vector<std::unique_ptr<RenderTarget>> persistents;
+    std::vector<std::unique_ptr<RenderTarget>> transients;
+    int screenWidth = 0;
+    int screenHeight = 0;
+};
+
+//Blits color from a (multisampled) target into a single-sampled one of the same size
+void resolveRenderTarget(const RenderTarget& source, const RenderTarget& destination);
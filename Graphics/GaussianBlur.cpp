@@ -0,0 +1,157 @@
+#include "GaussianBlur.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+const GLchar* fullscreenVertexSource = R"glsl(
+        #version 330 core
+        out vec2 Texcoord;
+        void main()
+        {
+            vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            Texcoord = corner;
+            gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        }
+    )glsl";
+
+//A bilinear fetch at the shared corner of four texels averages them, which is the 2x2 box of a halving
+static const GLchar* copyFragmentSource = R"glsl(
+        #version 330 core
+        in vec2 Texcoord;
+        out vec4 outColor;
+        uniform sampler2D source;
+        void main()
+        {
+            outColor = texture(source, Texcoord);
+        }
+    )glsl";
+
+BlurKernel computeLinearBlurKernel(int radius, float sigma)
+{
+    std::vector<float> discrete(radius + 1);
+    float sum = 0.0f;
+    for (int i = 0; i <= radius; ++i) {
+        discrete[i] = std::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+        sum += i == 0 ? discrete[i] : 2.0f * discrete[i];
+    }
+    for (float& w : discrete)
+        w /= sum;
+
+    //Sampling between texels i and i+1 at the weighted offset reads w_i * t_i + w_i+1 * t_i+1 in one fetch
+    BlurKernel kernel;
+    kernel.offsets.push_back(0.0f);
+    kernel.weights.push_back(discrete[0]);
+    for (int i = 1; i <= radius; i += 2) {
+        if (i + 1 > radius) {
+            kernel.offsets.push_back((float)i);
+            kernel.weights.push_back(discrete[i]);
+            break;
+        }
+        float weight = discrete[i] + discrete[i + 1];
+        kernel.offsets.push_back((i * discrete[i] + (i + 1) * discrete[i + 1]) / weight);
+        kernel.weights.push_back(weight);
+    }
+    return kernel;
+}
+
+//The kernel is baked into the shader as constants so the loop unrolls into plain fetches
+static std::string blurFragmentSource(const BlurKernel& kernel)
+{
+    std::ostringstream source;
+    source << std::fixed << std::setprecision(8);
+    source << "#version 330 core\n"
+              "in vec2 Texcoord;\n"
+              "out vec4 outColor;\n"
+              "uniform sampler2D source;\n"
+              "uniform vec2 direction;\n"
+              "const int TapCount = " << kernel.offsets.size() << ";\n";
+    source << "const float offsets[TapCount] = float[](";
+    for (size_t i = 0; i < kernel.offsets.size(); ++i)
+        source << (i ? ", " : "") << kernel.offsets[i];
+    source << ");\nconst float weights[TapCount] = float[](";
+    for (size_t i = 0; i < kernel.weights.size(); ++i)
+        source << (i ? ", " : "") << kernel.weights[i];
+    source << ");\n"
+              "void main()\n"
+              "{\n"
+              "    vec2 texelStep = direction / vec2(textureSize(source, 0));\n"
+              "    vec4 sum = texture(source, Texcoord) * weights[0];\n"
+              "    for (int i = 1; i < TapCount; ++i) {\n"
+              "        sum += texture(source, Texcoord + texelStep * offsets[i]) * weights[i];\n"
+              "        sum += texture(source, Texcoord - texelStep * offsets[i]) * weights[i];\n"
+              "    }\n"
+              "    outColor = sum;\n"
+              "}\n";
+    return source.str();
+}
+
+bool GaussianBlur::create(int downsampleFactor, int radius, float sigma)
+{
+    downsample = downsampleFactor;
+    if (!copyProgram.create(fullscreenVertexSource, copyFragmentSource) ||
+        !blurProgram.create(fullscreenVertexSource, blurFragmentSource(computeLinearBlurKernel(radius, sigma)).c_str()))
+        return false;
+    uniDirection = blurProgram.uniformLocation("direction", GL_FLOAT_VEC2);
+    glUseProgram(copyProgram.id);
+    glUniform1i(copyProgram.uniformLocation("source", GL_SAMPLER_2D), 0);
+    glUseProgram(blurProgram.id);
+    glUniform1i(blurProgram.uniformLocation("source", GL_SAMPLER_2D), 0);
+
+    glGenVertexArrays(1, &emptyVao);
+    return true;
+}
+
+void GaussianBlur::destroy()
+{
+    copyProgram.destroy();
+    blurProgram.destroy();
+    glDeleteVertexArrays(1, &emptyVao);
+    emptyVao = 0;
+}
+
+void GaussianBlur::drawInto(const RenderTarget& target, GLuint texture)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.desc.width, target.desc.height);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+RenderTarget* GaussianBlur::apply(FramebufferManager& framebuffers, const RenderTarget& source) const
+{
+    glBindVertexArray(emptyVao);
+    glActiveTexture(GL_TEXTURE0);
+
+    //Every intermediate is a pooled target, a level is handed back as soon as the next one has read it
+    RenderTargetDesc desc;
+    desc.width = source.desc.width;
+    desc.height = source.desc.height;
+    desc.colorFormat = source.desc.colorFormat;
+    const RenderTarget* current = &source;
+    RenderTarget* level = nullptr;
+    if (downsample > 1) {
+        glUseProgram(copyProgram.id);
+        for (int factor = 2; factor <= downsample; factor *= 2) {
+            desc.width = std::max(desc.width / 2, 1);
+            desc.height = std::max(desc.height / 2, 1);
+            RenderTarget* next = framebuffers.acquireTransient(desc);
+            drawInto(*next, current->colorTexture);
+            framebuffers.releaseTransient(level);
+            current = level = next;
+        }
+    }
+
+    glUseProgram(blurProgram.id);
+    RenderTarget* horizontal = framebuffers.acquireTransient(desc);
+    glUniform2f(uniDirection, 1.0f, 0.0f);
+    drawInto(*horizontal, current->colorTexture);
+    framebuffers.releaseTransient(level);
+
+    RenderTarget* vertical = framebuffers.acquireTransient(desc);
+    glUniform2f(uniDirection, 0.0f, 1.0f);
+    drawInto(*vertical, horizontal->colorTexture);
+    framebuffers.releaseTransient(horizontal);
+    return vertical;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ShaderProgram.h"
+#include "FramebufferManager.h"
+#include <vector>
+
+//Full-screen triangle without vertex data, texcoords cover [0, 1] over the viewport
+//Draw with glDrawArrays(GL_TRIANGLES, 0, 3) and any VAO bound
+extern const GLchar* fullscreenVertexSource;
+
+//One side of a symmetric Gaussian with neighbouring taps folded into a single bilinear fetch
+//offsets are in texels, offsets[0] is the center tap, every other entry is fetched on both sides
+struct BlurKernel
+{
+    std::vector<float> offsets;
+    std::vector<float> weights;
+};
+
+//Discrete Gaussian over [-radius, radius], normalized, with taps (1,2), (3,4), ... folded pairwise
+//A radius of 4 gives 9 texels per axis for 5 texture fetches
+BlurKernel computeLinearBlurKernel(int radius, float sigma);
+
+//Separable two-pass Gaussian blur of a full-screen texture
+//With downsample 2 or 4 the source is first box-filtered down (one bilinear fetch per halving)
+//and both passes run at that size, the caller samples the result with linear filtering to scale it back up
+class GaussianBlur
+{
+public:
+    bool create(int downsample, int radius, float sigma);
+    void destroy();
+
+    //Blurs source into a transient target of the same color format and returns it, release it once it has been read
+    //Leaves that target bound with its viewport, rebind the caller's framebuffer and viewport afterwards
+    RenderTarget* apply(FramebufferManager& framebuffers, const RenderTarget& source) const;
+
+private:
+    static void drawInto(const RenderTarget& target, GLuint texture);
+
+    int downsample = 1;
+    ShaderProgram copyProgram, blurProgram;
+    GLint uniDirection = -1;
+    //Full-screen triangles come from gl_VertexID, core profile still wants a VAO bound
+    GLuint emptyVao = 0;
+};
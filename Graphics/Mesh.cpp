@@ -0,0 +1,269 @@
+#include "Mesh.h"
+#include <gtc/packing.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+static const size_t MaxIndexedVertices = 65536;
+
+//Vertex cache model used to order triangles, roughly what current GPUs keep of recently shaded vertices
+static const int OptimizerCacheSize = 32;
+
+//Tom Forsyth's linear-speed vertex cache optimisation scores: vertices just used score high,
+//vertices with few triangles left score high so they get finished off instead of being evicted half used
+static float vertexScore(int cachePosition, int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        //The last triangle's three vertices get a fixed score, otherwise the triangle just drawn would win again
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (cachePosition - 3) / (float)(OptimizerCacheSize - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt((float)remainingTriangles);
+}
+
+//Reorders the triangles of indices[first, first + count) in place
+static void optimizeTriangleOrder(std::vector<GLushort>& indices, size_t first, size_t count, size_t vertexCount)
+{
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+        return;
+    const GLushort* source = &indices[first];
+
+    //Triangles using each vertex, as one flat array with per-vertex offsets
+    std::vector<int> remaining(vertexCount, 0), offset(vertexCount + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+        ++remaining[source[i]];
+    for (size_t v = 0; v < vertexCount; ++v)
+        offset[v + 1] = offset[v] + remaining[v];
+    std::vector<int> vertexTriangles(count), fill(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+        vertexTriangles[fill[source[i]]++] = (int)(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = score[source[t * 3]] + score[source[t * 3 + 1]] + score[source[t * 3 + 2]];
+
+    std::vector<GLushort> result;
+    result.reserve(count);
+    std::vector<int> cache, nextCache;
+    size_t scanCursor = 0;
+    int best = -1;
+    while (result.size() < count) {
+        //Nothing in the cache has triangles left, start again from the best remaining triangle
+        if (best < 0) {
+            float bestScore = -1.0f;
+            for (size_t t = scanCursor; t < triangleCount; ++t) {
+                if (!emitted[t] && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                ++scanCursor;
+        }
+
+        emitted[best] = true;
+        nextCache.clear();
+        for (int k = 0; k < 3; ++k) {
+            GLushort v = source[best * 3 + k];
+            result.push_back(v);
+            nextCache.push_back(v);
+            //Drop the emitted triangle from the vertex's list
+            int* begin = &vertexTriangles[offset[v]];
+            int* end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            --remaining[v];
+        }
+        for (int v : cache) {
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+        }
+
+        //Rescore everything that was or is in the cache, then pick the best triangle touching the cache
+        for (size_t i = 0; i < nextCache.size(); ++i)
+            cachePosition[nextCache[i]] = i < (size_t)OptimizerCacheSize ? (int)i : -1;
+        for (int v : nextCache)
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        best = -1;
+        float bestScore = -1.0f;
+        for (int v : nextCache) {
+            for (int i = 0; i < remaining[v]; ++i) {
+                int t = vertexTriangles[offset[v] + i];
+                triangleScore[t] = score[source[t * 3]] + score[source[t * 3 + 1]] + score[source[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)OptimizerCacheSize)
+            nextCache.resize(OptimizerCacheSize);
+        cache.swap(nextCache);
+    }
+    std::copy(result.begin(), result.end(), indices.begin() + first);
+}
+
+MeshRange appendTriangles(IndexedMesh& mesh, const GLfloat* interleaved, size_t vertexCount)
+{
+    MeshRange range;
+    std::vector<GLushort> indices;
+    indices.reserve(vertexCount);
+
+    //Weld on exact bit patterns, the authored arrays repeat corners verbatim
+    typedef std::array<GLfloat, 8> VertexKey;
+    std::map<VertexKey, GLushort> welded;
+    std::vector<MeshVertex> vertices = mesh.vertices;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        VertexKey key;
+        std::memcpy(key.data(), interleaved + i * 8, sizeof(key));
+        auto found = welded.find(key);
+        if (found != welded.end()) {
+            indices.push_back(found->second);
+            continue;
+        }
+        if (vertices.size() >= MaxIndexedVertices) {
+            std::cerr << "Mesh has more than " << MaxIndexedVertices << " unique vertices, 16-bit indices can't address it\n";
+            return range;
+        }
+        MeshVertex vertex;
+        vertex.position = glm::vec3(key[0], key[1], key[2]);
+        vertex.color = glm::vec3(key[3], key[4], key[5]);
+        vertex.texcoord = glm::vec2(key[6], key[7]);
+        GLushort index = (GLushort)vertices.size();
+        vertices.push_back(vertex);
+        welded[key] = index;
+        indices.push_back(index);
+    }
+
+    range.first = (GLsizei)mesh.indices.size();
+    range.count = (GLsizei)indices.size();
+    mesh.vertices.swap(vertices);
+    mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+    optimizeTriangleOrder(mesh.indices, range.first, range.count, mesh.vertices.size());
+    return range;
+}
+
+void optimizeVertexFetch(IndexedMesh& mesh)
+{
+    std::vector<int> remap(mesh.vertices.size(), -1);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (GLushort& index : mesh.indices) {
+        if (remap[index] < 0) {
+            remap[index] = (int)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = (GLushort)remap[index];
+    }
+    //Vertices no index refers to are dropped
+    mesh.vertices.swap(vertices);
+}
+
+float averageCacheMissRatio(const IndexedMesh& mesh, const MeshRange& range, int cacheSize)
+{
+    if (range.count < 3)
+        return 0.0f;
+    std::vector<int> fifo;
+    int misses = 0;
+    for (GLsizei i = range.first; i < range.first + range.count; ++i) {
+        int v = mesh.indices[i];
+        if (std::find(fifo.begin(), fifo.end(), v) != fifo.end())
+            continue;
+        ++misses;
+        fifo.push_back(v);
+        if ((int)fifo.size() > cacheSize)
+            fifo.erase(fifo.begin());
+    }
+    return misses / (range.count / 3.0f);
+}
+
+std::vector<PackedMeshVertex> packMeshVertices(const std::vector<MeshVertex>& vertices)
+{
+    std::vector<PackedMeshVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const MeshVertex& v = vertices[i];
+        PackedMeshVertex& p = packed[i];
+        for (int k = 0; k < 3; ++k) {
+            p.position[k] = glm::packHalf1x16(v.position[k]);
+            p.color[k] = glm::packUnorm1x8(v.color[k]);
+        }
+        p.position[3] = glm::packHalf1x16(1.0f);
+        p.color[3] = 255;
+        p.texcoord[0] = glm::packUnorm1x16(v.texcoord.x);
+        p.texcoord[1] = glm::packUnorm1x16(v.texcoord.y);
+    }
+    return packed;
+}
+
+void MeshBuffer::create(const IndexedMesh& mesh, bool packedVertices)
+{
+    packed = packedVertices;
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (packed) {
+        std::vector<PackedMeshVertex> vertices = packMeshVertices(mesh.vertices);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PackedMeshVertex), vertices.data(), GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(MeshVertex), mesh.vertices.data(), GL_STATIC_DRAW);
+    }
+
+    //The element array binding is VAO state, upload through whatever VAO is bound and attach it in specifyAttributes
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLushort), mesh.indices.data(), GL_STATIC_DRAW);
+}
+
+void MeshBuffer::destroy()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    vertexBuffer = indexBuffer = 0;
+}
+
+void MeshBuffer::specifyAttributes(const ShaderProgram& shaderProgram) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    GLint posAttrib = shaderProgram.attributeLocation("position");
+    GLint colAttrib = shaderProgram.attributeLocation("color");
+    GLint texAttrib = shaderProgram.attributeLocation("texcoord");
+    glEnableVertexAttribArray(posAttrib);
+    glEnableVertexAttribArray(colAttrib);
+    glEnableVertexAttribArray(texAttrib);
+    if (packed) {
+        glVertexAttribPointer(posAttrib, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedMeshVertex), (void*)offsetof(PackedMeshVertex, position));
+        glVertexAttribPointer(colAttrib, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedMeshVertex), (void*)offsetof(PackedMeshVertex, color));
+        glVertexAttribPointer(texAttrib, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedMeshVertex), (void*)offsetof(PackedMeshVertex, texcoord));
+    }
+    else {
+        glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+        glVertexAttribPointer(colAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, color));
+        glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, texcoord));
+    }
+}
+
+void drawMeshRange(const MeshRange& range, GLsizei instanceCount)
+{
+    const void* offset = (const void*)(range.first * sizeof(GLushort));
+    if (instanceCount == 1)
+        glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT, offset);
+    else
+        glDrawElementsInstanced(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT, offset, instanceCount);
+}
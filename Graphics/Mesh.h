@@ -0,0 +1,67 @@
+#pragma once
+#include "ShaderProgram.h"
+#include <glm.hpp>
+#include <vector>
+
+//Scene vertex as authored in the interleaved arrays: position, color, texcoord (8 floats, 32 bytes)
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec2 texcoord;
+};
+
+//Compact scene vertex, 16 bytes: half-float position, normalized-byte color, 16-bit UNORM texcoords
+//Colors and texcoords are clamped to [0, 1], positions keep about three significant digits
+struct PackedMeshVertex
+{
+    GLushort position[4];   //w is padding so color starts 4-byte aligned
+    GLubyte color[4];       //alpha unused
+    GLushort texcoord[2];
+};
+
+//Slice of the index buffer that is drawn with one call
+struct MeshRange
+{
+    GLsizei first = 0;
+    GLsizei count = 0;
+};
+
+//Deduplicated vertices with 16-bit triangle list indices, several ranges can share one mesh
+struct IndexedMesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<GLushort> indices;
+};
+
+//Welds identical vertices of an interleaved triangle list into mesh and orders its triangles for the post-transform cache
+//Returns an empty range (with an error) if the mesh would outgrow 16-bit indices
+MeshRange appendTriangles(IndexedMesh& mesh, const GLfloat* interleaved, size_t vertexCount);
+
+//Renumbers vertices in the order the index buffer first uses them, so vertex fetch walks memory forwards
+//Call once after the last appendTriangles
+void optimizeVertexFetch(IndexedMesh& mesh);
+
+//Average cache miss ratio (vertex shader runs per triangle) of a range with a FIFO cache of cacheSize entries
+float averageCacheMissRatio(const IndexedMesh& mesh, const MeshRange& range, int cacheSize = 16);
+
+std::vector<PackedMeshVertex> packMeshVertices(const std::vector<MeshVertex>& vertices);
+
+//Vertex and index buffers of an IndexedMesh, uploaded either packed or as plain floats
+class MeshBuffer
+{
+public:
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    bool packed = true;
+
+    void create(const IndexedMesh& mesh, bool packedVertices);
+    void destroy();
+    GLsizei vertexSize() const { return packed ? sizeof(PackedMeshVertex) : sizeof(MeshVertex); }
+
+    //Binds both buffers to the current VAO and points position/color/texcoord at the vertex buffer
+    void specifyAttributes(const ShaderProgram& shaderProgram) const;
+};
+
+//glDrawElements(Instanced) for a range of the element buffer bound to the current VAO
+void drawMeshRange(const MeshRange& range, GLsizei instanceCount = 1);
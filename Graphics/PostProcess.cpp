@@ -0,0 +1,207 @@
+#include "PostProcess.h"
+#include <cstring>
+#include <iostream>
+
+//Shared body of every pass program, the #defines in front of it pick the permutation:
+//EDGES reads a Sobel gradient instead of a single texel, APPLY_PIXEL_EFFECTS lists the merged per-pixel effects
+static const char* postFragmentBody = R"glsl(
+        in vec2 Texcoord;
+        out vec4 outColor;
+        uniform sampler2D source;
+
+        vec4 invertColor(vec4 c)
+        {
+            return vec4(1.0) - c;
+        }
+
+        vec4 greyscale(vec4 c)
+        {
+            float avg = (c.r + c.g + c.b) / 3.0;
+            return vec4(avg, avg, avg, 1.0);
+        }
+
+        void main()
+        {
+        #ifdef EDGES
+            // Sobel gradient magnitude, one texel apart
+            vec2 texel = 1.0 / vec2(textureSize(source, 0));
+            vec4 top = texture(source, Texcoord + vec2(0.0,  texel.y));
+            vec4 bottom = texture(source, Texcoord + vec2(0.0, -texel.y));
+            vec4 left = texture(source, Texcoord + vec2(-texel.x, 0.0));
+            vec4 right = texture(source, Texcoord + vec2( texel.x, 0.0));
+            vec4 topLeft = texture(source, Texcoord + vec2(-texel.x,  texel.y));
+            vec4 topRight = texture(source, Texcoord + vec2( texel.x,  texel.y));
+            vec4 bottomLeft = texture(source, Texcoord + vec2(-texel.x, -texel.y));
+            vec4 bottomRight = texture(source, Texcoord + vec2( texel.x, -texel.y));
+            vec4 sx = -topLeft - 2.0 * left - bottomLeft + topRight + 2.0 * right + bottomRight;
+            vec4 sy = -topLeft - 2.0 * top - topRight + bottomLeft + 2.0 * bottom + bottomRight;
+            vec4 c = sqrt(sx * sx + sy * sy);
+        #else
+            vec4 c = texture(source, Texcoord);
+        #endif
+            APPLY_PIXEL_EFFECTS
+            outColor = c;
+        }
+    )glsl";
+
+static const struct { const char* name; PostEffect effect; } effectNames[] = {
+    { "invert", PostEffect::Invert },
+    { "greyscale", PostEffect::Greyscale },
+    { "grayscale", PostEffect::Greyscale },
+    { "blur", PostEffect::Blur },
+    { "edges", PostEffect::Edges }
+};
+
+bool parsePostEffects(const char* list, std::vector<PostEffect>& effects)
+{
+    effects.clear();
+    if (strcmp(list, "none") == 0)
+        return true;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        bool found = false;
+        for (const auto& entry : effectNames) {
+            if (strlen(entry.name) == length && strncmp(list, entry.name, length) == 0) {
+                effects.push_back(entry.effect);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown post effect: " << std::string(list, length) << "\n";
+            return false;
+        }
+        list += length;
+        if (*list == ',')
+            ++list;
+    }
+    return true;
+}
+
+std::vector<PostEffect> postEffectsForSelector(int selector)
+{
+    switch (selector) {
+    case 1: return { PostEffect::Invert };
+    case 2: return { PostEffect::Greyscale };
+    case 3: return { PostEffect::Blur };
+    case 4: return { PostEffect::Edges };
+    default: return {};
+    }
+}
+
+static bool isPixelEffect(PostEffect effect)
+{
+    return effect == PostEffect::Invert || effect == PostEffect::Greyscale;
+}
+
+bool PostProcessGraph::create(FramebufferManager& framebufferManager, int blurDownsample)
+{
+    framebuffers = &framebufferManager;
+    if (!blur.create(blurDownsample, 4, 2.0f))
+        return false;
+    glGenVertexArrays(1, &emptyVao);
+    return true;
+}
+
+void PostProcessGraph::destroy()
+{
+    for (auto& entry : programs)
+        entry.second.destroy();
+    programs.clear();
+    passes.clear();
+    blur.destroy();
+    glDeleteVertexArrays(1, &emptyVao);
+    emptyVao = 0;
+}
+
+const ShaderProgram* PostProcessGraph::findProgram(const Pass& pass)
+{
+    std::string defines = "#version 330 core\n";
+    if (pass.kind == PassEdges)
+        defines += "#define EDGES\n";
+    defines += "#define APPLY_PIXEL_EFFECTS";
+    for (PostEffect effect : pass.pixelEffects)
+        defines += effect == PostEffect::Invert ? " c = invertColor(c);" : " c = greyscale(c);";
+    defines += "\n";
+
+    auto found = programs.find(defines);
+    if (found != programs.end())
+        return &found->second;
+
+    ShaderProgram program;
+    if (!program.create(fullscreenVertexSource, (defines + postFragmentBody).c_str()))
+        return nullptr;
+    glUseProgram(program.id);
+    glUniform1i(program.uniformLocation("source", GL_SAMPLER_2D), 0);
+    return &(programs[defines] = program);
+}
+
+bool PostProcessGraph::setEffects(const std::vector<PostEffect>& effects)
+{
+    chain = effects;
+    passes.clear();
+    for (PostEffect effect : chain) {
+        if (isPixelEffect(effect)) {
+            //Per-pixel effects ride along at the end of whatever pass produced the pixel, blur passes excepted
+            if (passes.empty() || passes.back().kind == PassBlur)
+                passes.push_back(Pass());
+            passes.back().pixelEffects.push_back(effect);
+        }
+        else {
+            Pass pass;
+            pass.kind = effect == PostEffect::Blur ? PassBlur : PassEdges;
+            passes.push_back(pass);
+        }
+    }
+    //The blur writes into its own targets, something still has to draw it into the output
+    if (!passes.empty() && passes.back().kind == PassBlur)
+        passes.push_back(Pass());
+
+    for (Pass& pass : passes) {
+        if (pass.kind == PassBlur)
+            continue;
+        pass.program = findProgram(pass);
+        if (!pass.program) {
+            passes.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void PostProcessGraph::execute(const RenderTarget& scene, GLuint outputFramebuffer) const
+{
+    int width = framebuffers->width(), height = framebuffers->height();
+    if (passes.empty()) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scene.framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+        glBlitFramebuffer(0, 0, scene.desc.width, scene.desc.height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        return;
+    }
+
+    //current is what the next pass reads, owned is the pooled target behind it once it isn't the scene any more
+    const RenderTarget* current = &scene;
+    RenderTarget* owned = nullptr;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const Pass& pass = passes[i];
+        RenderTarget* next = nullptr;
+        if (pass.kind == PassBlur) {
+            next = blur.apply(*framebuffers, *current);
+        }
+        else {
+            bool last = i + 1 == passes.size();
+            if (!last)
+                next = framebuffers->acquireTransient(framebuffers->screenDesc(scene.desc.colorFormat));
+            glBindFramebuffer(GL_FRAMEBUFFER, last ? outputFramebuffer : next->framebuffer);
+            glViewport(0, 0, width, height);
+            glBindVertexArray(emptyVao);
+            glUseProgram(pass.program->id);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, current->colorTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        framebuffers->releaseTransient(owned);
+        current = owned = next;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "GaussianBlur.h"
+#include <map>
+#include <string>
+#include <vector>
+
+enum class PostEffect
+{
+    Invert,
+    Greyscale,
+    Blur,
+    Edges
+};
+
+//Comma separated effect names in the order they apply, e.g. "greyscale,blur,invert"; "none" is the empty chain
+bool parsePostEffects(const char* list, std::vector<PostEffect>& effects);
+//The old single-effect selector: 0 none, 1 invert, 2 greyscale, 3 blur, 4 edges
+std::vector<PostEffect> postEffectsForSelector(int selector);
+
+//Turns an ordered effect chain into as few full-screen passes as possible
+//Per-pixel effects (invert, greyscale) are merged into the pass before them, each pass runs a program
+//specialized for exactly its effects, and intermediate passes ping-pong between two pooled targets
+class PostProcessGraph
+{
+public:
+    //Intermediate targets are borrowed from framebuffers while execute() runs
+    bool create(FramebufferManager& framebuffers, int blurDownsample);
+    void destroy();
+
+    //Rebuilds the pass list, each shader permutation is compiled the first time a chain needs it
+    bool setEffects(const std::vector<PostEffect>& effects);
+    const std::vector<PostEffect>& effects() const { return chain; }
+    size_t passCount() const { return passes.size(); }
+
+    //Runs every pass reading the (single-sampled) scene and writes the final one into outputFramebuffer at screen size
+    //Intermediates keep the scene's color format so HDR scenes stay HDR until the output. An empty chain is a plain blit
+    void execute(const RenderTarget& scene, GLuint outputFramebuffer) const;
+
+private:
+    enum PassKind { PassSample, PassEdges, PassBlur };
+
+    struct Pass
+    {
+        PassKind kind = PassSample;
+        std::vector<PostEffect> pixelEffects;
+        const ShaderProgram* program = nullptr;
+    };
+
+    const ShaderProgram* findProgram(const Pass& pass);
+
+    FramebufferManager* framebuffers = nullptr;
+    std::vector<PostEffect> chain;
+    std::vector<Pass> passes;
+    std::map<std::string, ShaderProgram> programs;
+    GaussianBlur blur;
+    GLuint emptyVao = 0;
+};
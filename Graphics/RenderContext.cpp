@@ -0,0 +1,288 @@
+#include "RenderContext.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#ifdef GRAPHICS_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+static double steadySeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ContextBackend defaultContextBackend()
+{
+#ifndef GRAPHICS_NO_GLFW
+    return ContextBackend::Window;
+#else
+    return ContextBackend::Surfaceless;
+#endif
+}
+
+bool parseContextBackend(const char* name, ContextBackend& backend)
+{
+#ifndef GRAPHICS_NO_GLFW
+    if (strcmp(name, "window") == 0) {
+        backend = ContextBackend::Window;
+        return true;
+    }
+#endif
+#ifdef GRAPHICS_HAS_EGL
+    if (strcmp(name, "egl") == 0 || strcmp(name, "surfaceless") == 0) {
+        backend = ContextBackend::Surfaceless;
+        return true;
+    }
+#endif
+    return false;
+}
+
+const char* contextBackendName(ContextBackend backend)
+{
+    return backend == ContextBackend::Window ? "window" : "egl";
+}
+
+#ifndef GRAPHICS_NO_GLFW
+static bool createWindowContext(RenderContext& context, const char* title)
+{
+    // Initialize GLFW
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW\n";
+        return false;
+    }
+
+    // Ask for OpenGL 3.3 Core Profile (common baseline)
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef GLEW_EGL
+    //GLEW was built to load through EGL, so the window's context has to come from EGL as well
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+
+    // Create a window
+    context.window = glfwCreateWindow(context.width, context.height, title, nullptr, nullptr);
+    if (!context.window) {
+        std::cerr << "Failed to create GLFW window\n";
+        glfwTerminate();
+        return false;
+    }
+
+    // Make context current before using GLEW
+    glfwMakeContextCurrent(context.window);
+    return true;
+}
+#endif
+
+#ifdef GRAPHICS_HAS_EGL
+static bool createSurfacelessContext(RenderContext& context)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    //Prefer Mesa's surfaceless platform, it needs neither X11 nor a DRM device
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "Failed to initialize EGL display\n";
+        return false;
+    }
+
+    const char* displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!displayExtensions || !strstr(displayExtensions, "EGL_KHR_surfaceless_context")) {
+        std::cerr << "EGL display does not support surfaceless contexts\n";
+        eglTerminate(display);
+        return false;
+    }
+
+    //No surface is ever created, but the default EGL_SURFACE_TYPE (window) would match nothing on surfaceless displays
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1) {
+        std::cerr << "Failed to find an EGL config for desktop OpenGL\n";
+        eglTerminate(display);
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    // Ask for OpenGL 3.3 Core Profile, same as the window backend
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create EGL context\n";
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        std::cerr << "Failed to make EGL context current\n";
+        eglDestroyContext(display, eglContext);
+        eglTerminate(display);
+        return false;
+    }
+
+    context.eglDisplay = display;
+    context.eglContext = eglContext;
+    return true;
+}
+
+//A surfaceless context has no default framebuffer, so give it one to present into
+static bool createPresentFramebuffer(RenderContext& context)
+{
+    glGenFramebuffers(1, &context.presentFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, context.presentFramebuffer);
+
+    glGenRenderbuffers(1, &context.presentColorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, context.presentColorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, context.width, context.height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, context.presentColorBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+        std::cerr << "Offscreen present framebuffer is incomplete\n";
+    //Without a surface the initial viewport is empty, windows get theirs sized at make-current
+    glViewport(0, 0, context.width, context.height);
+    return complete;
+}
+#endif
+
+bool createRenderContext(RenderContext& context, ContextBackend backend, int width, int height, const char* title)
+{
+    context.backend = backend;
+    context.width = width;
+    context.height = height;
+
+    bool created = false;
+#ifndef GRAPHICS_NO_GLFW
+    if (backend == ContextBackend::Window)
+        created = createWindowContext(context, title);
+#endif
+#ifdef GRAPHICS_HAS_EGL
+    if (backend == ContextBackend::Surfaceless)
+        created = createSurfacelessContext(context);
+#endif
+    if (!created)
+        return false;
+
+    // Initialize GLEW
+    glewExperimental = GL_TRUE; // Needed for core profile
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW\n";
+        destroyRenderContext(context);
+        return false;
+    }
+    //glewInit can leave a GL_INVALID_ENUM behind on core profiles
+    glGetError();
+
+#ifdef GRAPHICS_HAS_EGL
+    if (backend == ContextBackend::Surfaceless && !createPresentFramebuffer(context)) {
+        destroyRenderContext(context);
+        return false;
+    }
+#endif
+
+    std::cout << "OpenGL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER)
+              << " (" << contextBackendName(backend) << " backend)\n";
+
+    context.startTime = steadySeconds();
+    return true;
+}
+
+void destroyRenderContext(RenderContext& context)
+{
+    if (context.presentFramebuffer) {
+        glDeleteFramebuffers(1, &context.presentFramebuffer);
+        glDeleteRenderbuffers(1, &context.presentColorBuffer);
+        context.presentFramebuffer = 0;
+        context.presentColorBuffer = 0;
+    }
+#ifndef GRAPHICS_NO_GLFW
+    if (context.window) {
+        glfwDestroyWindow(context.window);
+        glfwTerminate();
+        context.window = nullptr;
+    }
+#endif
+#ifdef GRAPHICS_HAS_EGL
+    if (context.eglDisplay) {
+        eglMakeCurrent(context.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context.eglContext)
+            eglDestroyContext(context.eglDisplay, context.eglContext);
+        eglTerminate(context.eglDisplay);
+        context.eglDisplay = nullptr;
+        context.eglContext = nullptr;
+    }
+#endif
+}
+
+bool contextShouldClose(const RenderContext& context)
+{
+#ifndef GRAPHICS_NO_GLFW
+    if (context.window)
+        return glfwWindowShouldClose(context.window);
+#endif
+    return false;
+}
+
+void contextPresent(RenderContext& context)
+{
+#ifndef GRAPHICS_NO_GLFW
+    if (context.window) {
+        glfwSwapBuffers(context.window);
+        return;
+    }
+#endif
+    //Nothing to swap, but make sure the frame actually executes before the next one is queued
+    glFinish();
+}
+
+void contextPollEvents(RenderContext& context)
+{
+#ifndef GRAPHICS_NO_GLFW
+    if (context.window)
+        glfwPollEvents();
+#endif
+}
+
+bool contextUpdateFramebufferSize(RenderContext& context)
+{
+#ifndef GRAPHICS_NO_GLFW
+    if (context.window) {
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(context.window, &width, &height);
+        //Minimized windows report 0x0, keep drawing at the last real size
+        if (width > 0 && height > 0 && (width != context.width || height != context.height)) {
+            context.width = width;
+            context.height = height;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+double contextGetTime(const RenderContext& context)
+{
+    return steadySeconds() - context.startTime;
+}
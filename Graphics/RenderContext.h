@@ -0,0 +1,59 @@
+#pragma once
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+//GRAPHICS_NO_GLFW is set by the CMake build when GLFW is not available (headless Linux nodes)
+#ifndef GRAPHICS_NO_GLFW
+#include <GLFW/glfw3.h>
+#endif
+
+//Which kind of OpenGL context main() renders into
+//Window: a GLFW window with a real default framebuffer, driven by keyboard and mouse
+//Surfaceless: an EGL context with no window system at all (Mesa llvmpipe on render farm nodes), rendered into an offscreen framebuffer
+enum class ContextBackend
+{
+    Window,
+    Surfaceless
+};
+
+struct RenderContext
+{
+    ContextBackend backend = ContextBackend::Window;
+    int width = 0;
+    int height = 0;
+
+    //Framebuffer the final image is presented to, 0 for a window, an offscreen FBO for surfaceless contexts
+    GLuint presentFramebuffer = 0;
+    GLuint presentColorBuffer = 0;
+
+#ifndef GRAPHICS_NO_GLFW
+    GLFWwindow* window = nullptr;
+#endif
+    //EGLDisplay and EGLContext, kept opaque so callers don't need the EGL headers
+    void* eglDisplay = nullptr;
+    void* eglContext = nullptr;
+
+    double startTime = 0.0;
+};
+
+//Backend used when none is asked for on the command line: a window if GLFW was built in, surfaceless otherwise
+ContextBackend defaultContextBackend();
+//Parses "window" / "egl" / "surfaceless", returns false for anything else or a backend that isn't built in
+bool parseContextBackend(const char* name, ContextBackend& backend);
+const char* contextBackendName(ContextBackend backend);
+
+//Creates an OpenGL 3.3 core context of the requested backend, makes it current and initializes GLEW
+bool createRenderContext(RenderContext& context, ContextBackend backend, int width, int height, const char* title);
+void destroyRenderContext(RenderContext& context);
+
+bool contextShouldClose(const RenderContext& context);
+//Swaps buffers for windows, flushes the queued frame for surfaceless contexts
+void contextPresent(RenderContext& context);
+void contextPollEvents(RenderContext& context);
+//Picks up window resizes (in pixels, not screen coordinates), returns true when width/height changed
+//Surfaceless contexts keep the size they were created with
+bool contextUpdateFramebufferSize(RenderContext& context);
+//Seconds since the context was created
+double contextGetTime(const RenderContext& context);
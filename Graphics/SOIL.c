@@ -21,8 +21,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 	#include <GL/glew.h>   // Use GLEW instead
+#ifdef _WIN32
 	#include <windows.h>
 	#include <wingdi.h>
+#endif
 
 	#include <GL/glew.h>
 
@@ -31,12 +33,42 @@
 #include "stb_image_aug.h"
 #include "image_helper.h"
 #include "image_DXT.h"
+#include "image_BC.h"
+#include "image_cache.h"
+#define IMAGE_THREADS_NO_RUNNER
+#include "image_threads.h"
 
 #include <stdlib.h>
 #include <string.h>
 
-/*	error reporting	*/
-char *result_string_pointer = "SOIL initialized";
+/*	error reporting, per thread so loads on different threads don't mix them up	*/
+static IMAGE_THREAD_LOCAL char *result_string_pointer = "SOIL initialized";
+
+/*	see SOIL_set_texture_cache(), an empty directory means it is off	*/
+static char SOIL_cache_directory[1000] = "";
+static unsigned long long SOIL_cache_max_bytes = 0;
+
+/*	see SOIL_begin_batch(), buffers smaller than SOIL_POOL_MIN_SIZE skip the pool	*/
+#define SOIL_POOL_SIZE		8
+#define SOIL_POOL_MIN_SIZE	(64 << 10)
+typedef struct
+{
+	int depth;
+	stbi_context context;
+	stbi_context *previous;
+	/*	the allocator the pool sits on, NULL for the C library's	*/
+	void *(*malloc_fn)(void *user, size_t size);
+	void *(*realloc_fn)(void *user, void *p, size_t size);
+	void (*free_fn)(void *user, void *p);
+	void *alloc_user;
+	struct
+	{
+		void *data;
+		size_t size;
+		int in_use;
+	} blocks[SOIL_POOL_SIZE];
+} SOIL_batch;
+static IMAGE_THREAD_LOCAL SOIL_batch current_batch;
 
 /*	for loading cube maps	*/
 enum{
@@ -75,7 +107,23 @@ int query_DXT_capability( void );
 #define SOIL_RGBA_S3TC_DXT1		0x83F1
 #define SOIL_RGBA_S3TC_DXT3		0x83F2
 #define SOIL_RGBA_S3TC_DXT5		0x83F3
-typedef void (APIENTRY * P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC) (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid * data);
+/*	for the BCn formats (RGTC is BC4/BC5, BPTC is BC6H/BC7)	*/
+static int has_RGTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_RGTC_capability( void );
+static int has_BPTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_BPTC_capability( void );
+#define SOIL_RED_RGTC1					0x8DBB
+#define SOIL_RG_RGTC2					0x8DBD
+#define SOIL_RGBA_BPTC_UNORM			0x8E8C
+#define SOIL_RGB_BPTC_UNSIGNED_FLOAT	0x8E8F
+#define SOIL_RGB16F						0x881B
+#define SOIL_TEXTURE_SWIZZLE_RGBA		0x8E46
+#define SOIL_BGR						0x80E0
+#define SOIL_BGRA						0x80E1
+/*	works with both the old extension string and the core profile's glGetStringi	*/
+static int SOIL_internal_has_extension( const char *name );
+static int SOIL_internal_GL_version( void );
+typedef void (GLAPIENTRY * P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC) (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid * data);
 P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC soilGlCompressedTexImage2D = NULL;
 unsigned int SOIL_direct_load_DDS(
 		const char *filename,
@@ -94,11 +142,37 @@ unsigned int
 	(
 		const unsigned char *const data,
 		int width, int height, int channels,
+		int data_is_owned,
 		unsigned int reuse_texture_ID,
 		unsigned int flags,
 		unsigned int opengl_texture_type,
 		unsigned int opengl_texture_target,
-		unsigned int texture_check_size_enum
+		unsigned int texture_check_size_enum,
+		image_cache_entry *cache_entry
+	);
+static unsigned int
+	SOIL_internal_load_OGL_texture_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int force_channels,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	);
+static void
+	SOIL_internal_set_texture_parameters
+	(
+		unsigned int opengl_texture_type,
+		unsigned int flags,
+		int swizzle_channels
+	);
+void check_for_GL_errors( const char *calling_location );
+static unsigned int
+	SOIL_internal_load_BC6H_texture
+	(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
 	);
 
 /*	and the code magic begins here [8^)	*/
@@ -112,8 +186,7 @@ unsigned int
 	)
 {
 	/*	variables	*/
-	unsigned char* img;
-	int width, height, channels;
+	stbi_file_map map;
 	unsigned int tex_id;
 	/*	does the user want direct uploading of the image as a DDS file?	*/
 	if( flags & SOIL_FLAG_DDS_LOAD_DIRECT )
@@ -129,27 +202,18 @@ unsigned int
 			return tex_id;
 		}
 	}
-	/*	try to load the image	*/
-	img = SOIL_load_image( filename, &width, &height, &channels, force_channels );
-	/*	channels holds the original number of channels, which may have been forced	*/
-	if( (force_channels >= 1) && (force_channels <= 4) )
-	{
-		channels = force_channels;
-	}
-	if( NULL == img )
+	/*	map the file, both the decoder and the cache
+		lookup read it straight from there	*/
+	if( !stbi_map_file( filename, &map ) )
 	{
 		/*	image loading failed	*/
 		result_string_pointer = stbi_failure_reason();
 		return 0;
 	}
-	/*	OK, make it a texture!	*/
-	tex_id = SOIL_internal_create_OGL_texture(
-			img, width, height, channels,
-			reuse_texture_ID, flags,
-			GL_TEXTURE_2D, GL_TEXTURE_2D,
-			GL_MAX_TEXTURE_SIZE );
-	/*	and nuke the image data	*/
-	SOIL_free_image_data( img );
+	tex_id = SOIL_internal_load_OGL_texture_from_memory(
+			map.data, map.len,
+			force_channels, reuse_texture_ID, flags );
+	stbi_unmap_file( &map );
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -169,6 +233,11 @@ unsigned int
 	int width, height, channels;
 	unsigned int tex_id;
 	/*	no direct uploading of the image as a DDS file	*/
+	if( fake_HDR_format == SOIL_HDR_BC6H )
+	{
+		/*	real HDR, it doesn't go through the 8 bit path at all	*/
+		return SOIL_internal_load_BC6H_texture( filename, reuse_texture_ID, flags );
+	}
 	/* error check */
 	if( (fake_HDR_format != SOIL_HDR_RGBE) &&
 		(fake_HDR_format != SOIL_HDR_RGBdivA) &&
@@ -196,12 +265,11 @@ unsigned int
 	}
 	/*	OK, make it a texture!	*/
 	tex_id = SOIL_internal_create_OGL_texture(
-			img, width, height, channels,
+			img, width, height, channels, 1,
 			reuse_texture_ID, flags,
 			GL_TEXTURE_2D, GL_TEXTURE_2D,
-			GL_MAX_TEXTURE_SIZE );
-	/*	and nuke the image data	*/
-	SOIL_free_image_data( img );
+			GL_MAX_TEXTURE_SIZE,
+			NULL );
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
@@ -217,8 +285,6 @@ unsigned int
 	)
 {
 	/*	variables	*/
-	unsigned char* img;
-	int width, height, channels;
 	unsigned int tex_id;
 	/*	does the user want direct uploading of the image as a DDS file?	*/
 	if( flags & SOIL_FLAG_DDS_LOAD_DIRECT )
@@ -236,6 +302,142 @@ unsigned int
 			return tex_id;
 		}
 	}
+	/*	decode it (or find it in the cache)	*/
+	return SOIL_internal_load_OGL_texture_from_memory(
+			buffer, buffer_length,
+			force_channels, reuse_texture_ID, flags );
+}
+
+/*
+	Everything that changes what SOIL_internal_create_OGL_texture
+	uploads for a given image: the flags, the channels and what
+	the driver can do.
+*/
+static unsigned long long
+	SOIL_internal_cache_key
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int force_channels,
+		unsigned int flags
+	)
+{
+	int state[10];
+	GLint max_supported_size = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &max_supported_size );
+	state[0] = force_channels;
+	state[1] = (int)flags;
+	state[2] = query_NPOT_capability();
+	state[3] = (flags & SOIL_FLAG_TEXTURE_RECTANGLE) ? query_tex_rectangle_capability() : 0;
+	state[4] = query_DXT_capability();
+	state[5] = query_RGTC_capability();
+	state[6] = query_BPTC_capability();
+	state[7] = max_supported_size;
+	state[8] = (SOIL_internal_GL_version() >= 33) || SOIL_internal_has_extension( "GL_ARB_texture_swizzle" );
+	state[9] = sizeof( image_cache_level );
+	return image_cache_hash( state, sizeof( state ),
+			image_cache_hash( buffer, buffer_length, 0 ) );
+}
+
+/*
+	SOIL's images have no padding between rows, but OpenGL's
+	default unpack alignment of 4 reads every row as if it had,
+	running past the end of RGB and LA images whose rows aren't
+	a multiple of 4 bytes.  Returns the alignment to restore.
+*/
+static int
+	SOIL_internal_unpack_rows_tightly
+	(
+		void
+	)
+{
+	GLint alignment = 4;
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	return (int)alignment;
+}
+
+/*
+	Replays the uploads of a cached texture.
+*/
+static unsigned int
+	SOIL_internal_upload_cached_texture
+	(
+		const image_cache_entry *entry,
+		unsigned int reuse_texture_ID
+	)
+{
+	unsigned int tex_id = reuse_texture_ID;
+	int unpack_alignment;
+	int i;
+	if( tex_id == 0 )
+	{
+		glGenTextures( 1, &tex_id );
+	}
+	check_for_GL_errors( "glGenTextures" );
+	if( tex_id == 0 )
+	{
+		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
+		return 0;
+	}
+	glBindTexture( entry->texture_type, tex_id );
+	check_for_GL_errors( "glBindTexture" );
+	/*	the levels are stored exactly as they were uploaded	*/
+	unpack_alignment = SOIL_internal_unpack_rows_tightly();
+	for( i = 0; i < entry->num_levels; ++i )
+	{
+		const image_cache_level *level = &entry->levels[i];
+		if( level->format == 0 )
+		{
+			soilGlCompressedTexImage2D(
+				entry->texture_type, i,
+				level->internal_format, level->width, level->height, 0,
+				level->size, level->data );
+			check_for_GL_errors( "glCompressedTexImage2D" );
+		} else
+		{
+			glTexImage2D(
+				entry->texture_type, i,
+				level->internal_format, level->width, level->height, 0,
+				level->format, GL_UNSIGNED_BYTE, level->data );
+			check_for_GL_errors( "glTexImage2D" );
+		}
+	}
+	glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_alignment );
+	SOIL_internal_set_texture_parameters( entry->texture_type, entry->flags, entry->swizzle );
+	result_string_pointer = "Image loaded from the texture cache";
+	return tex_id;
+}
+
+static unsigned int
+	SOIL_internal_load_OGL_texture_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int force_channels,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	)
+{
+	/*	variables	*/
+	unsigned char* img;
+	int width, height, channels;
+	unsigned int tex_id;
+	int use_cache = (SOIL_cache_directory[0] != 0);
+	unsigned long long cache_key = 0;
+	image_cache_entry cache_entry;
+	/*	seen it before?	*/
+	if( use_cache )
+	{
+		cache_key = SOIL_internal_cache_key( buffer, buffer_length, force_channels, flags );
+		if( image_cache_load( SOIL_cache_directory, cache_key, &cache_entry ) )
+		{
+			tex_id = SOIL_internal_upload_cached_texture( &cache_entry, reuse_texture_ID );
+			image_cache_free_entry( &cache_entry );
+			return tex_id;
+		}
+		image_cache_init_entry( &cache_entry );
+	}
 	/*	try to load the image	*/
 	img = SOIL_load_image_from_memory(
 					buffer, buffer_length,
@@ -254,16 +456,229 @@ unsigned int
 	}
 	/*	OK, make it a texture!	*/
 	tex_id = SOIL_internal_create_OGL_texture(
-			img, width, height, channels,
+			img, width, height, channels, 1,
 			reuse_texture_ID, flags,
 			GL_TEXTURE_2D, GL_TEXTURE_2D,
-			GL_MAX_TEXTURE_SIZE );
-	/*	and nuke the image data	*/
-	SOIL_free_image_data( img );
+			GL_MAX_TEXTURE_SIZE,
+			use_cache ? &cache_entry : NULL );
+	/*	keep what was uploaded for next time	*/
+	if( use_cache )
+	{
+		if( tex_id )
+		{
+			image_cache_save( SOIL_cache_directory, cache_key, &cache_entry, SOIL_cache_max_bytes );
+		}
+		image_cache_free_entry( &cache_entry );
+	}
 	/*	and return the handle, such as it is	*/
 	return tex_id;
 }
 
+void
+	SOIL_set_texture_cache
+	(
+		const char *directory,
+		unsigned int max_megabytes
+	)
+{
+	if( (NULL == directory) || (strlen( directory ) >= sizeof( SOIL_cache_directory )) )
+	{
+		SOIL_cache_directory[0] = 0;
+		return;
+	}
+	strcpy( SOIL_cache_directory, directory );
+	SOIL_cache_max_bytes = (unsigned long long)max_megabytes << 20;
+}
+
+/*	the allocator under the pool	*/
+static void *batch_underlying_malloc( SOIL_batch *batch, size_t size )
+{
+	if( batch->malloc_fn )
+	{
+		return batch->malloc_fn( batch->alloc_user, size );
+	}
+	return malloc( size );
+}
+
+static void batch_underlying_free( SOIL_batch *batch, void *p )
+{
+	if( batch->free_fn )
+	{
+		batch->free_fn( batch->alloc_user, p );
+	} else
+	{
+		free( p );
+	}
+}
+
+static int batch_find_block( SOIL_batch *batch, void *p )
+{
+	int i;
+	for( i = 0; i < SOIL_POOL_SIZE; ++i )
+	{
+		if( (NULL != p) && (batch->blocks[i].data == p) )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+	Hands out the smallest idle block that fits, else a new
+	block in an empty slot (or in place of an idle one too
+	small to be of use), else an allocation the pool doesn't track
+*/
+static void *batch_malloc( void *user, size_t size )
+{
+	SOIL_batch *batch = (SOIL_batch*)user;
+	int i, best = -1, slot = -1;
+	if( size < SOIL_POOL_MIN_SIZE )
+	{
+		return batch_underlying_malloc( batch, size );
+	}
+	for( i = 0; i < SOIL_POOL_SIZE; ++i )
+	{
+		if( batch->blocks[i].in_use )
+		{
+			continue;
+		}
+		if( NULL == batch->blocks[i].data )
+		{
+			if( (slot < 0) || (NULL != batch->blocks[slot].data) )
+			{
+				slot = i;
+			}
+		} else if( batch->blocks[i].size >= size )
+		{
+			if( (best < 0) || (batch->blocks[i].size < batch->blocks[best].size) )
+			{
+				best = i;
+			}
+		} else if( slot < 0 )
+		{
+			slot = i;
+		}
+	}
+	if( best >= 0 )
+	{
+		batch->blocks[best].in_use = 1;
+		return batch->blocks[best].data;
+	}
+	if( slot < 0 )
+	{
+		return batch_underlying_malloc( batch, size );
+	}
+	if( NULL != batch->blocks[slot].data )
+	{
+		batch_underlying_free( batch, batch->blocks[slot].data );
+		batch->blocks[slot].data = NULL;
+	}
+	batch->blocks[slot].data = batch_underlying_malloc( batch, size );
+	if( NULL == batch->blocks[slot].data )
+	{
+		return NULL;
+	}
+	batch->blocks[slot].size = size;
+	batch->blocks[slot].in_use = 1;
+	return batch->blocks[slot].data;
+}
+
+static void *batch_realloc( void *user, void *p, size_t size )
+{
+	SOIL_batch *batch = (SOIL_batch*)user;
+	int i = batch_find_block( batch, p );
+	void *q;
+	if( NULL == p )
+	{
+		return batch_malloc( user, size );
+	}
+	if( (i >= 0) && (batch->blocks[i].size >= size) )
+	{
+		return p;
+	}
+	if( batch->realloc_fn )
+	{
+		q = batch->realloc_fn( batch->alloc_user, p, size );
+	} else
+	{
+		q = realloc( p, size );
+	}
+	if( (i >= 0) && (NULL != q) )
+	{
+		batch->blocks[i].data = q;
+		batch->blocks[i].size = size;
+	}
+	return q;
+}
+
+/*	pool blocks just go idle until the batch ends	*/
+static void batch_free( void *user, void *p )
+{
+	SOIL_batch *batch = (SOIL_batch*)user;
+	int i = batch_find_block( batch, p );
+	if( i >= 0 )
+	{
+		batch->blocks[i].in_use = 0;
+	} else if( NULL != p )
+	{
+		batch_underlying_free( batch, p );
+	}
+}
+
+void
+	SOIL_begin_batch
+	(
+		void
+	)
+{
+	SOIL_batch *batch = &current_batch;
+	if( batch->depth++ > 0 )
+	{
+		return;
+	}
+	/*	the batch works in a copy of whatever context was current	*/
+	batch->previous = stbi_use_context( NULL );
+	if( NULL != batch->previous )
+	{
+		batch->context = *batch->previous;
+	} else
+	{
+		stbi_context_init( &batch->context );
+	}
+	batch->malloc_fn = batch->context.malloc_fn;
+	batch->realloc_fn = batch->context.realloc_fn;
+	batch->free_fn = batch->context.free_fn;
+	batch->alloc_user = batch->context.alloc_user;
+	memset( batch->blocks, 0, sizeof( batch->blocks ) );
+	stbi_use_context( &batch->context );
+	stbi_set_allocator( batch_malloc, batch_realloc, batch_free, batch );
+}
+
+void
+	SOIL_end_batch
+	(
+		void
+	)
+{
+	SOIL_batch *batch = &current_batch;
+	int i;
+	if( (batch->depth <= 0) || (--batch->depth > 0) )
+	{
+		return;
+	}
+	/*	blocks still handed out belong to the caller now, to free under the old allocator	*/
+	for( i = 0; i < SOIL_POOL_SIZE; ++i )
+	{
+		if( (NULL != batch->blocks[i].data) && !batch->blocks[i].in_use )
+		{
+			batch_underlying_free( batch, batch->blocks[i].data );
+		}
+		batch->blocks[i].data = NULL;
+	}
+	stbi_use_context( batch->previous );
+}
+
 unsigned int
 	SOIL_load_OGL_cubemap
 	(
@@ -314,12 +729,11 @@ unsigned int
 	}
 	/*	upload the texture, and create a texture ID if necessary	*/
 	tex_id = SOIL_internal_create_OGL_texture(
-			img, width, height, channels,
+			img, width, height, channels, 1,
 			reuse_texture_ID, flags,
 			SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_X,
-			SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-	/*	and nuke the image data	*/
-	SOIL_free_image_data( img );
+			SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+			NULL );
 	/*	continue?	*/
 	if( tex_id != 0 )
 	{
@@ -338,12 +752,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -363,12 +776,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -388,12 +800,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -413,12 +824,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -438,12 +848,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	and return the handle, such as it is	*/
 	return tex_id;
@@ -507,12 +916,11 @@ unsigned int
 	}
 	/*	upload the texture, and create a texture ID if necessary	*/
 	tex_id = SOIL_internal_create_OGL_texture(
-			img, width, height, channels,
+			img, width, height, channels, 1,
 			reuse_texture_ID, flags,
 			SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_X,
-			SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-	/*	and nuke the image data	*/
-	SOIL_free_image_data( img );
+			SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+			NULL );
 	/*	continue?	*/
 	if( tex_id != 0 )
 	{
@@ -533,12 +941,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -560,12 +967,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_Y,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -587,12 +993,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -614,12 +1019,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_POSITIVE_Z,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	continue?	*/
 	if( tex_id != 0 )
@@ -641,12 +1045,11 @@ unsigned int
 		}
 		/*	upload the texture, but reuse the assigned texture ID	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				img, width, height, channels,
+				img, width, height, channels, 1,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP, SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
-		/*	and nuke the image data	*/
-		SOIL_free_image_data( img );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	and return the handle, such as it is	*/
 	return tex_id;
@@ -886,7 +1289,7 @@ unsigned int
 		dh = width;
 	}
 	sz = dw+dh;
-	sub_img = (unsigned char *)malloc( sz*sz*channels );
+	sub_img = (unsigned char *)stbi_image_alloc( sz*sz*channels );
 	/*	do the splitting and uploading	*/
 	tex_id = reuse_texture_ID;
 	for( i = 0; i < 6; ++i )
@@ -927,11 +1330,12 @@ unsigned int
 		}
 		/*	upload it as a texture	*/
 		tex_id = SOIL_internal_create_OGL_texture(
-				sub_img, sz, sz, channels,
+				sub_img, sz, sz, channels, 0,
 				tex_id, flags,
 				SOIL_TEXTURE_CUBE_MAP,
 				cubemap_target,
-				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE );
+				SOIL_MAX_CUBE_MAP_TEXTURE_SIZE,
+				NULL );
 	}
 	/*	and nuke the image and sub-image data	*/
 	SOIL_free_image_data( sub_img );
@@ -950,10 +1354,29 @@ unsigned int
 {
 	/*	wrapper function for 2D textures	*/
 	return SOIL_internal_create_OGL_texture(
-				data, width, height, channels,
+				data, width, height, channels, 0,
+				reuse_texture_ID, flags,
+				GL_TEXTURE_2D, GL_TEXTURE_2D,
+				GL_MAX_TEXTURE_SIZE,
+				NULL );
+}
+
+unsigned int
+	SOIL_create_OGL_texture_from_owned_data
+	(
+		unsigned char *data,
+		int width, int height, int channels,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	)
+{
+	/*	wrapper function for 2D textures, SOIL frees data when done	*/
+	return SOIL_internal_create_OGL_texture(
+				data, width, height, channels, 1,
 				reuse_texture_ID, flags,
 				GL_TEXTURE_2D, GL_TEXTURE_2D,
-				GL_MAX_TEXTURE_SIZE );
+				GL_MAX_TEXTURE_SIZE,
+				NULL );
 }
 
 #if SOIL_CHECK_FOR_GL_ERRORS
@@ -974,24 +1397,213 @@ void check_for_GL_errors( const char *calling_location )
 }
 #endif
 
-unsigned int
-	SOIL_internal_create_OGL_texture
+/*
+	Filtering, wrapping and (for 1 and 2 channel images in the
+	red / green formats, swizzle_channels) the swizzle that makes
+	them read as luminance (alpha) again.
+*/
+static void
+	SOIL_internal_set_texture_parameters
 	(
-		const unsigned char *const data,
-		int width, int height, int channels,
+		unsigned int opengl_texture_type,
+		unsigned int flags,
+		int swizzle_channels
+	)
+{
+	if( (swizzle_channels > 0) &&
+		((SOIL_internal_GL_version() >= 33) ||
+			SOIL_internal_has_extension( "GL_ARB_texture_swizzle" )) )
+	{
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		if( swizzle_channels == 2 )
+		{
+			swizzle[3] = GL_GREEN;
+		}
+		glTexParameteriv( opengl_texture_type, SOIL_TEXTURE_SWIZZLE_RGBA, swizzle );
+		check_for_GL_errors( "GL_TEXTURE_SWIZZLE_RGBA" );
+	}
+	if( flags & SOIL_FLAG_MIPMAPS )
+	{
+		/*	instruct OpenGL to use the MIPmaps	*/
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		check_for_GL_errors( "GL_TEXTURE_MIN/MAG_FILTER" );
+	} else
+	{
+		/*	instruct OpenGL _NOT_ to use the MIPmaps	*/
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		check_for_GL_errors( "GL_TEXTURE_MIN/MAG_FILTER" );
+	}
+	/*	does the user want clamping, or wrapping?	*/
+	if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+	{
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		if( opengl_texture_type == SOIL_TEXTURE_CUBE_MAP )
+		{
+			/*	SOIL_TEXTURE_WRAP_R is invalid if cubemaps aren't supported	*/
+			glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT );
+		}
+		check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+	} else
+	{
+		/*	unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;	*/
+		unsigned int clamp_mode = GL_CLAMP;
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode );
+		if( opengl_texture_type == SOIL_TEXTURE_CUBE_MAP )
+		{
+			/*	SOIL_TEXTURE_WRAP_R is invalid if cubemaps aren't supported	*/
+			glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode );
+		}
+		check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+	}
+}
+
+/*
+	Uploads one level of a texture, compressed here first if
+	compress_format is one of the DDS_FORMAT_ types (-1 for none),
+	and adds what was uploaded to cache_entry (unless it is NULL).
+*/
+static void
+	SOIL_internal_upload_image
+	(
+		const unsigned char *const img,
+		int width, int height, int channels,
+		unsigned int opengl_texture_target, int level,
+		unsigned int internal_texture_format,
+		unsigned int original_texture_format,
+		int compress_format, int compress_quality,
+		image_cache_entry *cache_entry
+	)
+{
+	if( compress_format >= 0 )
+	{
+		/*	user wants me to do the conversion!	*/
+		int DDS_size;
+		unsigned char *DDS_data = convert_image_to_DDS_format(
+				img, width, height, channels,
+				compress_format, compress_quality, &DDS_size );
+		if( DDS_data )
+		{
+			soilGlCompressedTexImage2D(
+				opengl_texture_target, level,
+				internal_texture_format, width, height, 0,
+				DDS_size, DDS_data );
+			check_for_GL_errors( "glCompressedTexImage2D" );
+			if( cache_entry )
+			{
+				image_cache_add_level( cache_entry,
+					internal_texture_format, 0,
+					width, height, DDS_size, DDS_data );
+			}
+			SOIL_free_image_data( DDS_data );
+			/*	printf( "Internal DXT compressor\n" );	*/
+			return;
+		}
+		/*	my compression failed, try the OpenGL driver's version	*/
+	}
+	/*	user want OpenGL to do all the work!	*/
+	glTexImage2D(
+		opengl_texture_target, level,
+		internal_texture_format, width, height, 0,
+		original_texture_format, GL_UNSIGNED_BYTE, img );
+	check_for_GL_errors( "glTexImage2D" );
+	if( cache_entry )
+	{
+		image_cache_add_level( cache_entry,
+			internal_texture_format, original_texture_format,
+			width, height, width*height*channels, img );
+	}
+}
+
+/*
+	Runs the image_helper transforms over *img in one pass.  The
+	caller's pixels are never changed: unless *img_is_owned the
+	pass writes a new image, which is then the one that is owned.
+*/
+static int
+	SOIL_internal_transform_image
+	(
+		unsigned char **img,
+		int *img_is_owned,
+		int width, int height, int channels,
+		unsigned int transforms
+	)
+{
+	unsigned char *result = *img;
+	if( !*img_is_owned )
+	{
+		result = (unsigned char*)stbi_image_alloc( width*height*channels );
+		if( NULL == result )
+		{
+			result_string_pointer = "Out of memory";
+			return 0;
+		}
+	}
+	transform_image( *img, width, height, channels, result, transforms );
+	*img = result;
+	*img_is_owned = 1;
+	return 1;
+}
+
+/*
+	Whether SOIL_internal_create_OGL_texture will resize an image,
+	to a power of two or to fit under max_supported_size
+*/
+static int
+	SOIL_internal_will_resize
+	(
+		int width, int height,
+		unsigned int flags,
+		int max_supported_size
+	)
+{
+	int new_width = width, new_height = height;
+	if( (flags & SOIL_FLAG_POWER_OF_TWO) || (flags & SOIL_FLAG_MIPMAPS) ||
+		(width > max_supported_size) || (height > max_supported_size) )
+	{
+		new_width = 1;
+		new_height = 1;
+		while( new_width < width )
+		{
+			new_width *= 2;
+		}
+		while( new_height < height )
+		{
+			new_height *= 2;
+		}
+	}
+	return (new_width != width) || (new_height != height) ||
+		(new_width > max_supported_size) || (new_height > max_supported_size);
+}
+
+unsigned int
+	SOIL_internal_create_OGL_texture
+	(
+		const unsigned char *const data,
+		int width, int height, int channels,
+		int data_is_owned,
 		unsigned int reuse_texture_ID,
 		unsigned int flags,
 		unsigned int opengl_texture_type,
 		unsigned int opengl_texture_target,
-		unsigned int texture_check_size_enum
+		unsigned int texture_check_size_enum,
+		image_cache_entry *cache_entry
 	)
 {
 	/*	variables	*/
-	unsigned char* img;
+	unsigned char* img = (unsigned char*)data;
+	int img_is_owned = data_is_owned;
 	unsigned int tex_id;
 	unsigned int internal_texture_format = 0, original_texture_format = 0;
-	int DXT_mode = SOIL_CAPABILITY_UNKNOWN;
+	int compress_format = -1;
+	int swizzle_channels = 0;
+	int compress_quality = BC_QUALITY_NORMAL;
 	int max_supported_size;
+	int unpack_alignment;
+	unsigned int transforms = 0;
 	/*	If the user wants to use the texture rectangle I kill a few flags	*/
 	if( flags & SOIL_FLAG_TEXTURE_RECTANGLE )
 	{
@@ -1019,71 +1631,52 @@ unsigned int
 		{
 			/*	can't do it, and that is a breakable offense (uv coords use pixels instead of [0,1]!)	*/
 			result_string_pointer = "Texture Rectangle extension unsupported";
+			if( img_is_owned )
+			{
+				SOIL_free_image_data( img );
+			}
 			return 0;
 		}
 	}
-	/*	create a copy the image data	*/
-	img = (unsigned char*)malloc( width*height*channels );
-	memcpy( img, data, width*height*channels );
+	/*	if the user can't support NPOT textures, make sure we force the POT option	*/
+	if( (query_NPOT_capability() == SOIL_CAPABILITY_NONE) &&
+		!(flags & SOIL_FLAG_TEXTURE_RECTANGLE) )
+	{
+		/*	add in the POT flag */
+		flags |= SOIL_FLAG_POWER_OF_TWO;
+	}
+	/*	how large of a texture can this OpenGL implementation handle?	*/
+	/*	texture_check_size_enum will be GL_MAX_TEXTURE_SIZE or SOIL_MAX_CUBE_MAP_TEXTURE_SIZE	*/
+	glGetIntegerv( texture_check_size_enum, &max_supported_size );
 	/*	does the user want me to invert the image?	*/
 	if( flags & SOIL_FLAG_INVERT_Y )
 	{
-		int i, j;
-		for( j = 0; j*2 < height; ++j )
-		{
-			int index1 = j * width * channels;
-			int index2 = (height - 1 - j) * width * channels;
-			for( i = width * channels; i > 0; --i )
-			{
-				unsigned char temp = img[index1];
-				img[index1] = img[index2];
-				img[index2] = temp;
-				++index1;
-				++index2;
-			}
-		}
+		transforms |= IMAGE_TRANSFORM_FLIP_Y;
 	}
 	/*	does the user want me to scale the colors into the NTSC safe RGB range?	*/
 	if( flags & SOIL_FLAG_NTSC_SAFE_RGB )
 	{
-		scale_image_RGB_to_NTSC_safe( img, width, height, channels );
+		transforms |= IMAGE_TRANSFORM_NTSC_SAFE_RGB;
 	}
 	/*	does the user want me to convert from straight to pre-multiplied alpha?
 		(and do we even _have_ alpha?)	*/
-	if( flags & SOIL_FLAG_MULTIPLY_ALPHA )
+	if( (flags & SOIL_FLAG_MULTIPLY_ALPHA) && ((channels == 2) || (channels == 4)) )
 	{
-		int i;
-		switch( channels )
-		{
-		case 2:
-			for( i = 0; i < 2*width*height; i += 2 )
-			{
-				img[i] = (img[i] * img[i+1] + 128) >> 8;
-			}
-			break;
-		case 4:
-			for( i = 0; i < 4*width*height; i += 4 )
-			{
-				img[i+0] = (img[i+0] * img[i+3] + 128) >> 8;
-				img[i+1] = (img[i+1] * img[i+3] + 128) >> 8;
-				img[i+2] = (img[i+2] * img[i+3] + 128) >> 8;
-			}
-			break;
-		default:
-			/*	no other number of channels contains alpha data	*/
-			break;
-		}
+		transforms |= IMAGE_TRANSFORM_MULTIPLY_ALPHA;
 	}
-	/*	if the user can't support NPOT textures, make sure we force the POT option	*/
-	if( (query_NPOT_capability() == SOIL_CAPABILITY_NONE) &&
-		!(flags & SOIL_FLAG_TEXTURE_RECTANGLE) )
+	/*	YCoCg comes after any resizing, so it can only join in if there is none
+		(and this will only work with RGB and RGBA images)	*/
+	if( (flags & SOIL_FLAG_CoCg_Y) && (channels >= 3) &&
+		!SOIL_internal_will_resize( width, height, flags, max_supported_size ) )
 	{
-		/*	add in the POT flag */
-		flags |= SOIL_FLAG_POWER_OF_TWO;
+		transforms |= IMAGE_TRANSFORM_YCoCg;
+	}
+	/*	all of them in one pass (which is also the copy, if the pixels are the caller's)	*/
+	if( transforms &&
+		!SOIL_internal_transform_image( &img, &img_is_owned, width, height, channels, transforms ) )
+	{
+		return 0;
 	}
-	/*	how large of a texture can this OpenGL implementation handle?	*/
-	/*	texture_check_size_enum will be GL_MAX_TEXTURE_SIZE or SOIL_MAX_CUBE_MAP_TEXTURE_SIZE	*/
-	glGetIntegerv( texture_check_size_enum, &max_supported_size );
 	/*	do I need to make it a power of 2?	*/
 	if(
 		(flags & SOIL_FLAG_POWER_OF_TWO) ||	/*	user asked for it	*/
@@ -1105,7 +1698,7 @@ unsigned int
 		if( (new_width != width) || (new_height != height) )
 		{
 			/*	yep, resize	*/
-			unsigned char *resampled = (unsigned char*)malloc( channels*new_width*new_height );
+			unsigned char *resampled = (unsigned char*)stbi_image_alloc( channels*new_width*new_height );
 			up_scale_image(
 					img, width, height, channels,
 					resampled, new_width, new_height );
@@ -1115,9 +1708,13 @@ unsigned int
 							new_width, new_height, channels,
 							resampled );
 			*/
-			/*	nuke the old guy, then point it at the new guy	*/
-			SOIL_free_image_data( img );
+			/*	nuke the old guy (if he's mine), then point it at the new guy	*/
+			if( img_is_owned )
+			{
+				SOIL_free_image_data( img );
+			}
 			img = resampled;
+			img_is_owned = 1;
 			width = new_width;
 			height = new_height;
 		}
@@ -1140,21 +1737,28 @@ unsigned int
 		}
 		new_width = width / reduce_block_x;
 		new_height = height / reduce_block_y;
-		resampled = (unsigned char*)malloc( channels*new_width*new_height );
+		resampled = (unsigned char*)stbi_image_alloc( channels*new_width*new_height );
 		/*	perform the actual reduction	*/
 		mipmap_image(	img, width, height, channels,
 						resampled, reduce_block_x, reduce_block_y );
-		/*	nuke the old guy, then point it at the new guy	*/
-		SOIL_free_image_data( img );
+		/*	nuke the old guy (if he's mine), then point it at the new guy	*/
+		if( img_is_owned )
+		{
+			SOIL_free_image_data( img );
+		}
 		img = resampled;
+		img_is_owned = 1;
 		width = new_width;
 		height = new_height;
 	}
-	/*	does the user want us to use YCoCg color space?	*/
-	if( flags & SOIL_FLAG_CoCg_Y )
+	/*	does the user want us to use YCoCg color space, and wasn't it done yet?	*/
+	if( (flags & SOIL_FLAG_CoCg_Y) && (channels >= 3) &&
+		!(transforms & IMAGE_TRANSFORM_YCoCg) )
 	{
-		/*	this will only work with RGB and RGBA images */
-		convert_RGB_to_YCoCg( img, width, height, channels );
+		if( !SOIL_internal_transform_image( &img, &img_is_owned, width, height, channels, IMAGE_TRANSFORM_YCoCg ) )
+		{
+			return 0;
+		}
 		/*
 		save_image_as_DDS( "CoCg_Y.dds", width, height, channels, img );
 		*/
@@ -1187,20 +1791,51 @@ unsigned int
 			break;
 		}
 		internal_texture_format = original_texture_format;
+		/*	does the user want me to, and can I, use the BCn formats?	*/
+		if( flags & SOIL_FLAG_BC_QUALITY_FAST )
+		{
+			compress_quality = BC_QUALITY_FAST;
+		} else if( flags & SOIL_FLAG_BC_QUALITY_SLOW )
+		{
+			compress_quality = BC_QUALITY_SLOW;
+		}
+		if( flags & SOIL_FLAG_COMPRESS_TO_BC )
+		{
+			if( (channels < 3) || (flags & SOIL_FLAG_BC5_NORMAL_MAP) )
+			{
+				if( query_RGTC_capability() == SOIL_CAPABILITY_PRESENT )
+				{
+					/*	1 channel = BC4, otherwise two channels in BC5	*/
+					compress_format = (channels == 1) ? DDS_FORMAT_BC4 : DDS_FORMAT_BC5;
+					internal_texture_format = (channels == 1) ? SOIL_RED_RGTC1 : SOIL_RG_RGTC2;
+				}
+			} else if( query_BPTC_capability() == SOIL_CAPABILITY_PRESENT )
+			{
+				/*	RGB or RGBA = BC7	*/
+				compress_format = DDS_FORMAT_BC7;
+				internal_texture_format = SOIL_RGBA_BPTC_UNORM;
+			}
+			if( compress_format < 0 )
+			{
+				/*	the card can't, DXT is the next best thing	*/
+				flags |= SOIL_FLAG_COMPRESS_TO_DXT;
+			}
+		}
 		/*	does the user want me to, and can I, save as DXT?	*/
-		if( flags & SOIL_FLAG_COMPRESS_TO_DXT )
+		if( (compress_format < 0) && (flags & SOIL_FLAG_COMPRESS_TO_DXT) )
 		{
-			DXT_mode = query_DXT_capability();
-			if( DXT_mode == SOIL_CAPABILITY_PRESENT )
+			if( query_DXT_capability() == SOIL_CAPABILITY_PRESENT )
 			{
 				/*	I can use DXT, whether I compress it or OpenGL does	*/
 				if( (channels & 1) == 1 )
 				{
 					/*	1 or 3 channels = DXT1	*/
+					compress_format = DDS_FORMAT_DXT1;
 					internal_texture_format = SOIL_RGB_S3TC_DXT1;
 				} else
 				{
 					/*	2 or 4 channels = DXT5	*/
+					compress_format = DDS_FORMAT_DXT5;
 					internal_texture_format = SOIL_RGBA_S3TC_DXT5;
 				}
 			}
@@ -1208,49 +1843,19 @@ unsigned int
 		/*  bind an OpenGL texture ID	*/
 		glBindTexture( opengl_texture_type, tex_id );
 		check_for_GL_errors( "glBindTexture" );
+		unpack_alignment = SOIL_internal_unpack_rows_tightly();
 		/*  upload the main image	*/
-		if( DXT_mode == SOIL_CAPABILITY_PRESENT )
-		{
-			/*	user wants me to do the DXT conversion!	*/
-			int DDS_size;
-			unsigned char *DDS_data = NULL;
-			if( (channels & 1) == 1 )
-			{
-				/*	RGB, use DXT1	*/
-				DDS_data = convert_image_to_DXT1( img, width, height, channels, &DDS_size );
-			} else
-			{
-				/*	RGBA, use DXT5	*/
-				DDS_data = convert_image_to_DXT5( img, width, height, channels, &DDS_size );
-			}
-			if( DDS_data )
-			{
-				soilGlCompressedTexImage2D(
-					opengl_texture_target, 0,
-					internal_texture_format, width, height, 0,
-					DDS_size, DDS_data );
-				check_for_GL_errors( "glCompressedTexImage2D" );
-				SOIL_free_image_data( DDS_data );
-				/*	printf( "Internal DXT compressor\n" );	*/
-			} else
-			{
-				/*	my compression failed, try the OpenGL driver's version	*/
-				glTexImage2D(
-					opengl_texture_target, 0,
-					internal_texture_format, width, height, 0,
-					original_texture_format, GL_UNSIGNED_BYTE, img );
-				check_for_GL_errors( "glTexImage2D" );
-				/*	printf( "OpenGL DXT compressor\n" );	*/
-			}
-		} else
-		{
-			/*	user want OpenGL to do all the work!	*/
-			glTexImage2D(
+		SOIL_internal_upload_image(
+				img, width, height, channels,
 				opengl_texture_target, 0,
-				internal_texture_format, width, height, 0,
-				original_texture_format, GL_UNSIGNED_BYTE, img );
-			check_for_GL_errors( "glTexImage2D" );
-			/*printf( "OpenGL DXT compressor\n" );	*/
+				internal_texture_format, original_texture_format,
+				compress_format, compress_quality,
+				cache_entry );
+		/*	the red / green formats still read as luminance (alpha)	*/
+		if( ((compress_format == DDS_FORMAT_BC4) || (compress_format == DDS_FORMAT_BC5)) &&
+			(channels < 3) )
+		{
+			swizzle_channels = channels;
 		}
 		/*	are any MIPmaps desired?	*/
 		if( flags & SOIL_FLAG_MIPMAPS )
@@ -1258,106 +1863,228 @@ unsigned int
 			int MIPlevel = 1;
 			int MIPwidth = (width+1) / 2;
 			int MIPheight = (height+1) / 2;
-			unsigned char *resampled = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+			int MIPfilter = MIPMAP_FILTER_BOX;
+			int MIPgamma = (flags & SOIL_FLAG_GAMMA_CORRECT_MIPMAPS) && !(flags & SOIL_FLAG_CoCg_Y);
+			/*	each level is built from the one before it, ping-ponging
+				between two buffers (the second one only ever holds level 2
+				and smaller)	*/
+			const unsigned char *previous = img;
+			int previous_width = width, previous_height = height;
+			unsigned char *resampled = (unsigned char*)stbi_image_alloc( channels*MIPwidth*MIPheight );
+			unsigned char *spare = (unsigned char*)stbi_image_alloc( channels*((MIPwidth+1)/2)*((MIPheight+1)/2) );
+			if( flags & SOIL_FLAG_MIPMAP_KAISER )
+			{
+				MIPfilter = MIPMAP_FILTER_KAISER;
+			} else if( flags & SOIL_FLAG_MIPMAP_LANCZOS )
+			{
+				MIPfilter = MIPMAP_FILTER_LANCZOS;
+			}
 			while( ((1<<MIPlevel) <= width) || ((1<<MIPlevel) <= height) )
 			{
 				/*	do this MIPmap level	*/
-				mipmap_image(
-						img, width, height, channels,
-						resampled,
-						(1 << MIPlevel), (1 << MIPlevel) );
+				mipmap_image_next_level(
+						previous, previous_width, previous_height, channels,
+						resampled, MIPfilter, MIPgamma );
 				/*  upload the MIPmaps	*/
-				if( DXT_mode == SOIL_CAPABILITY_PRESENT )
-				{
-					/*	user wants me to do the DXT conversion!	*/
-					int DDS_size;
-					unsigned char *DDS_data = NULL;
-					if( (channels & 1) == 1 )
-					{
-						/*	RGB, use DXT1	*/
-						DDS_data = convert_image_to_DXT1(
-								resampled, MIPwidth, MIPheight, channels, &DDS_size );
-					} else
-					{
-						/*	RGBA, use DXT5	*/
-						DDS_data = convert_image_to_DXT5(
-								resampled, MIPwidth, MIPheight, channels, &DDS_size );
-					}
-					if( DDS_data )
-					{
-						soilGlCompressedTexImage2D(
-							opengl_texture_target, MIPlevel,
-							internal_texture_format, MIPwidth, MIPheight, 0,
-							DDS_size, DDS_data );
-						check_for_GL_errors( "glCompressedTexImage2D" );
-						SOIL_free_image_data( DDS_data );
-					} else
-					{
-						/*	my compression failed, try the OpenGL driver's version	*/
-						glTexImage2D(
-							opengl_texture_target, MIPlevel,
-							internal_texture_format, MIPwidth, MIPheight, 0,
-							original_texture_format, GL_UNSIGNED_BYTE, resampled );
-						check_for_GL_errors( "glTexImage2D" );
-					}
-				} else
-				{
-					/*	user want OpenGL to do all the work!	*/
-					glTexImage2D(
+				SOIL_internal_upload_image(
+						resampled, MIPwidth, MIPheight, channels,
 						opengl_texture_target, MIPlevel,
-						internal_texture_format, MIPwidth, MIPheight, 0,
-						original_texture_format, GL_UNSIGNED_BYTE, resampled );
-					check_for_GL_errors( "glTexImage2D" );
-				}
+						internal_texture_format, original_texture_format,
+						compress_format, compress_quality,
+						cache_entry );
 				/*	prep for the next level	*/
 				++MIPlevel;
+				previous = resampled;
+				previous_width = MIPwidth;
+				previous_height = MIPheight;
+				resampled = spare;
+				spare = (unsigned char*)previous;
 				MIPwidth = (MIPwidth + 1) / 2;
 				MIPheight = (MIPheight + 1) / 2;
 			}
 			SOIL_free_image_data( resampled );
-			/*	instruct OpenGL to use the MIPmaps	*/
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-			check_for_GL_errors( "GL_TEXTURE_MIN/MAG_FILTER" );
-		} else
-		{
-			/*	instruct OpenGL _NOT_ to use the MIPmaps	*/
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-			check_for_GL_errors( "GL_TEXTURE_MIN/MAG_FILTER" );
+			SOIL_free_image_data( spare );
 		}
-		/*	does the user want clamping, or wrapping?	*/
-		if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_alignment );
+		SOIL_internal_set_texture_parameters( opengl_texture_type, flags, swizzle_channels );
+		/*	and what it takes to redo that from the cache	*/
+		if( cache_entry )
+		{
+			cache_entry->texture_type = opengl_texture_type;
+			cache_entry->flags = flags;
+			cache_entry->swizzle = swizzle_channels;
+		}
+		/*	done	*/
+		result_string_pointer = "Image loaded as an OpenGL texture";
+	} else
+	{
+		/*	failed	*/
+		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
+	}
+	if( img_is_owned )
+	{
+		SOIL_free_image_data( img );
+	}
+	return tex_id;
+}
+
+/*
+	Uploads one level of a float RGB image, as BC6H if the card
+	has BPTC, otherwise as 16 bit floats.
+*/
+static void
+	SOIL_internal_upload_HDR_image
+	(
+		const float *const img,
+		int width, int height, int level,
+		int use_BC6H, int quality
+	)
+{
+	if( use_BC6H )
+	{
+		int BC6H_size;
+		unsigned char *BC6H_data = convert_image_to_BC6H(
+				img, width, height, 3, quality, &BC6H_size );
+		if( BC6H_data )
+		{
+			soilGlCompressedTexImage2D(
+				GL_TEXTURE_2D, level,
+				SOIL_RGB_BPTC_UNSIGNED_FLOAT, width, height, 0,
+				BC6H_size, BC6H_data );
+			check_for_GL_errors( "glCompressedTexImage2D" );
+			SOIL_free_image_data( BC6H_data );
+			return;
+		}
+	}
+	glTexImage2D(
+		GL_TEXTURE_2D, level,
+		SOIL_RGB16F, width, height, 0,
+		GL_RGB, GL_FLOAT, img );
+	check_for_GL_errors( "glTexImage2D" );
+}
+
+/*
+	SOIL_HDR_BC6H: only MIPmaps, flipping and wrapping apply,
+	the rest of the flags work on 8 bit images.
+*/
+static unsigned int
+	SOIL_internal_load_BC6H_texture
+	(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		unsigned int flags
+	)
+{
+	/*	variables	*/
+	float *img;
+	int width, height, channels;
+	unsigned int tex_id;
+	int use_BC6H;
+	int quality = BC_QUALITY_NORMAL;
+	/*	try to load the image as floats	*/
+	img = stbi_loadf( filename, &width, &height, &channels, 3 );
+	if( NULL == img )
+	{
+		/*	image loading failed	*/
+		result_string_pointer = stbi_failure_reason();
+		return 0;
+	}
+	if( flags & SOIL_FLAG_INVERT_Y )
+	{
+		int j;
+		size_t row_size = (size_t)width * 3;
+		for( j = 0; j*2 < height; ++j )
 		{
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT );
-			if( opengl_texture_type == SOIL_TEXTURE_CUBE_MAP )
+			float *row1 = img + j * row_size;
+			float *row2 = img + (height - 1 - j) * row_size;
+			size_t i;
+			for( i = 0; i < row_size; ++i )
 			{
-				/*	SOIL_TEXTURE_WRAP_R is invalid if cubemaps aren't supported	*/
-				glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT );
+				float temp = row1[i];
+				row1[i] = row2[i];
+				row2[i] = temp;
 			}
-			check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
-		} else
+		}
+	}
+	if( flags & SOIL_FLAG_BC_QUALITY_FAST )
+	{
+		quality = BC_QUALITY_FAST;
+	} else if( flags & SOIL_FLAG_BC_QUALITY_SLOW )
+	{
+		quality = BC_QUALITY_SLOW;
+	}
+	use_BC6H = (query_BPTC_capability() == SOIL_CAPABILITY_PRESENT);
+	/*	create a texture ID to hold it	*/
+	tex_id = reuse_texture_ID;
+	if( tex_id == 0 )
+	{
+		glGenTextures( 1, &tex_id );
+	}
+	check_for_GL_errors( "glGenTextures" );
+	if( tex_id )
+	{
+		glBindTexture( GL_TEXTURE_2D, tex_id );
+		check_for_GL_errors( "glBindTexture" );
+		SOIL_internal_upload_HDR_image( img, width, height, 0, use_BC6H, quality );
+		if( flags & SOIL_FLAG_MIPMAPS )
 		{
-			/*	unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;	*/
-			unsigned int clamp_mode = GL_CLAMP;
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode );
-			if( opengl_texture_type == SOIL_TEXTURE_CUBE_MAP )
+			/*	2x2 box filter, in place (the odd last row / column
+				is repeated)	*/
+			int MIPlevel = 1;
+			int MIPwidth = width, MIPheight = height;
+			while( (MIPwidth > 1) || (MIPheight > 1) )
 			{
-				/*	SOIL_TEXTURE_WRAP_R is invalid if cubemaps aren't supported	*/
-				glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode );
+				int next_width = (MIPwidth + 1) / 2;
+				int next_height = (MIPheight + 1) / 2;
+				int x, y, c;
+				for( y = 0; y < next_height; ++y )
+				{
+					int y0 = y * 2, y1 = (y * 2 + 1 < MIPheight) ? y * 2 + 1 : y * 2;
+					for( x = 0; x < next_width; ++x )
+					{
+						int x0 = x * 2, x1 = (x * 2 + 1 < MIPwidth) ? x * 2 + 1 : x * 2;
+						for( c = 0; c < 3; ++c )
+						{
+							img[(y * next_width + x) * 3 + c] = 0.25f * (
+								img[(y0 * MIPwidth + x0) * 3 + c] +
+								img[(y0 * MIPwidth + x1) * 3 + c] +
+								img[(y1 * MIPwidth + x0) * 3 + c] +
+								img[(y1 * MIPwidth + x1) * 3 + c] );
+						}
+					}
+				}
+				MIPwidth = next_width;
+				MIPheight = next_height;
+				SOIL_internal_upload_HDR_image( img, MIPwidth, MIPheight, MIPlevel, use_BC6H, quality );
+				++MIPlevel;
 			}
-			check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		} else
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 		}
-		/*	done	*/
-		result_string_pointer = "Image loaded as an OpenGL texture";
+		check_for_GL_errors( "GL_TEXTURE_MIN/MAG_FILTER" );
+		if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		} else
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, SOIL_CLAMP_TO_EDGE );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, SOIL_CLAMP_TO_EDGE );
+		}
+		check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+		result_string_pointer = use_BC6H ?
+				"Image loaded as a BC6H OpenGL texture" :
+				"Image loaded as a 16 bit float OpenGL texture";
 	} else
 	{
 		/*	failed	*/
 		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
 	}
-	SOIL_free_image_data( img );
+	stbi_image_free( img );
 	return tex_id;
 }
 
@@ -1392,7 +2119,7 @@ int
 	}
 
     /*  Get the data from OpenGL	*/
-    pixel_data = (unsigned char*)malloc( 3*width*height );
+    pixel_data = (unsigned char*)stbi_image_alloc( 3*width*height );
     glReadPixels (x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
 
     /*	invert the image	*/
@@ -1495,6 +2222,15 @@ int
 		save_result = save_image_as_DDS( filename,
 				width, height, channels, (const unsigned char *const)data );
 	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_BC )
+	{
+		/*	BC4 for 1 channel, BC5 for 2, BC7 for RGB(A)	*/
+		int format = (channels == 1) ? DDS_FORMAT_BC4 :
+				((channels == 2) ? DDS_FORMAT_BC5 : DDS_FORMAT_BC7);
+		save_result = save_image_as_DDS_format( filename,
+				width, height, channels, (const unsigned char *const)data,
+				format, BC_QUALITY_NORMAL );
+	} else
 	{
 		save_result = 0;
 	}
@@ -1514,7 +2250,7 @@ void
 		unsigned char *img_data
 	)
 {
-	free( (void*)img_data );
+	stbi_image_free( img_data );
 }
 
 const char*
@@ -1526,6 +2262,39 @@ const char*
 	return result_string_pointer;
 }
 
+/*
+	Uploads one level of a compressed DDS image, or decodes it
+	first if the driver can't take that block format.
+*/
+static void
+	SOIL_internal_upload_DDS_level
+	(
+		unsigned int target, int level,
+		unsigned int S3TC_type, int DDS_format, int decode,
+		int width, int height,
+		int size, const unsigned char *data
+	)
+{
+	if( decode )
+	{
+		unsigned char *rgba = convert_DDS_format_to_image( data, width, height, DDS_format );
+		if( rgba )
+		{
+			glTexImage2D(
+				target, level,
+				GL_RGBA, width, height, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, rgba );
+			SOIL_free_image_data( rgba );
+		}
+	} else
+	{
+		soilGlCompressedTexImage2D(
+			target, level,
+			S3TC_type, width, height, 0,
+			size, data );
+	}
+}
+
 unsigned int SOIL_direct_load_DDS_from_memory(
 		const unsigned char *const buffer,
 		int buffer_length,
@@ -1535,11 +2304,15 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 {
 	/*	variables	*/
 	DDS_header header;
+	DDS_header_DXT10 header10;
 	unsigned int buffer_index = 0;
 	unsigned int tex_ID = 0;
 	/*	file reading variables	*/
 	unsigned int S3TC_type = 0;
-	unsigned char *DDS_data;
+	unsigned int BGR_type = 0;
+	int DDS_format = DDS_FORMAT_AUTO;
+	int decode = 0;
+	const unsigned char *DDS_data;
 	unsigned int DDS_main_size;
 	unsigned int DDS_full_size;
 	unsigned int width, height;
@@ -1547,6 +2320,7 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	unsigned int flag;
 	unsigned int cf_target, ogl_target_start, ogl_target_end;
 	unsigned int opengl_texture_type;
+	int unpack_alignment;
 	int i;
 	/*	1st off, does the filename even exist?	*/
 	if( NULL == buffer )
@@ -1583,14 +2357,68 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	if( header.sPixelFormat.dwSize != 32 ) {goto quick_exit;}
 	if( (header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0 ) {goto quick_exit;}
 	/*	make sure it is a type we can upload	*/
-	if( (header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
-		!(
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24))) ||
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('3'<<24))) ||
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('5'<<24)))
-		) )
+	if( header.sPixelFormat.dwFlags & DDPF_FOURCC )
 	{
-		goto quick_exit;
+		switch( header.sPixelFormat.dwFourCC )
+		{
+		case ('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24):
+			DDS_format = DDS_FORMAT_DXT1;
+			break;
+		case ('D'<<0)|('X'<<8)|('T'<<16)|('3'<<24):
+			DDS_format = DDS_FORMAT_DXT3;
+			break;
+		case ('D'<<0)|('X'<<8)|('T'<<16)|('5'<<24):
+			DDS_format = DDS_FORMAT_DXT5;
+			break;
+		case ('A'<<0)|('T'<<8)|('I'<<16)|('1'<<24):
+		case ('B'<<0)|('C'<<8)|('4'<<16)|('U'<<24):
+			DDS_format = DDS_FORMAT_BC4;
+			break;
+		case ('A'<<0)|('T'<<8)|('I'<<16)|('2'<<24):
+		case ('B'<<0)|('C'<<8)|('5'<<16)|('U'<<24):
+			DDS_format = DDS_FORMAT_BC5;
+			break;
+		case ('D'<<0)|('X'<<8)|('1'<<16)|('0'<<24):
+			/*	the real format is in the extended header	*/
+			if( buffer_length < sizeof( DDS_header ) + sizeof( DDS_header_DXT10 ) ) {goto quick_exit;}
+			memcpy( (void*)(&header10), (const void *)(buffer + buffer_index), sizeof( DDS_header_DXT10 ) );
+			buffer_index += sizeof( DDS_header_DXT10 );
+			if( header10.resourceDimension != DDS_DIMENSION_TEXTURE2D ) {goto quick_exit;}
+			switch( header10.dxgiFormat )
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+			case DXGI_FORMAT_BC1_UNORM + 1:
+				DDS_format = DDS_FORMAT_DXT1;
+				break;
+			case DXGI_FORMAT_BC2_UNORM:
+			case DXGI_FORMAT_BC2_UNORM + 1:
+				DDS_format = DDS_FORMAT_DXT3;
+				break;
+			case DXGI_FORMAT_BC3_UNORM:
+			case DXGI_FORMAT_BC3_UNORM + 1:
+				DDS_format = DDS_FORMAT_DXT5;
+				break;
+			case DXGI_FORMAT_BC4_UNORM:
+				DDS_format = DDS_FORMAT_BC4;
+				break;
+			case DXGI_FORMAT_BC5_UNORM:
+				DDS_format = DDS_FORMAT_BC5;
+				break;
+			case DXGI_FORMAT_BC6H_UF16:
+				/*	HDR, there is no 8 bit software path for it	*/
+				DDS_format = -1;
+				break;
+			case DXGI_FORMAT_BC7_UNORM:
+			case DXGI_FORMAT_BC7_UNORM + 1:
+				DDS_format = DDS_FORMAT_BC7;
+				break;
+			default:
+				goto quick_exit;
+			}
+			break;
+		default:
+			goto quick_exit;
+		}
 	}
 	/*	OK, validated the header, let's load the image data	*/
 	result_string_pointer = "DDS header loaded and validated";
@@ -1601,37 +2429,63 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	if( uncompressed )
 	{
 		S3TC_type = GL_RGB;
+		BGR_type = SOIL_BGR;
 		block_size = 3;
 		if( header.sPixelFormat.dwFlags & DDPF_ALPHAPIXELS )
 		{
 			S3TC_type = GL_RGBA;
+			BGR_type = SOIL_BGRA;
 			block_size = 4;
 		}
 		DDS_main_size = width * height * block_size;
 	} else
 	{
-		/*	can we even handle direct uploading to OpenGL DXT compressed images?	*/
-		if( query_DXT_capability() != SOIL_CAPABILITY_PRESENT )
-		{
-			/*	we can't do it!	*/
-			result_string_pointer = "Direct upload of S3TC images not supported by the OpenGL driver";
-			return 0;
-		}
-		/*	well, we know it is DXT1/3/5, because we checked above	*/
-		switch( (header.sPixelFormat.dwFourCC >> 24) - '0' )
+		/*	can the driver take the blocks as they are?	*/
+		int capability;
+		block_size = 16;
+		switch( DDS_format )
 		{
-		case 1:
+		case DDS_FORMAT_DXT1:
 			S3TC_type = SOIL_RGBA_S3TC_DXT1;
 			block_size = 8;
+			capability = query_DXT_capability();
 			break;
-		case 3:
+		case DDS_FORMAT_DXT3:
 			S3TC_type = SOIL_RGBA_S3TC_DXT3;
-			block_size = 16;
+			capability = query_DXT_capability();
 			break;
-		case 5:
+		case DDS_FORMAT_DXT5:
 			S3TC_type = SOIL_RGBA_S3TC_DXT5;
-			block_size = 16;
+			capability = query_DXT_capability();
+			break;
+		case DDS_FORMAT_BC4:
+			S3TC_type = SOIL_RED_RGTC1;
+			block_size = 8;
+			capability = query_RGTC_capability();
 			break;
+		case DDS_FORMAT_BC5:
+			S3TC_type = SOIL_RG_RGTC2;
+			capability = query_RGTC_capability();
+			break;
+		case DDS_FORMAT_BC7:
+			S3TC_type = SOIL_RGBA_BPTC_UNORM;
+			capability = query_BPTC_capability();
+			break;
+		default:
+			S3TC_type = SOIL_RGB_BPTC_UNSIGNED_FLOAT;
+			capability = query_BPTC_capability();
+			break;
+		}
+		if( capability != SOIL_CAPABILITY_PRESENT )
+		{
+			if( DDS_format < 0 )
+			{
+				/*	we can't do it!	*/
+				result_string_pointer = "Direct upload of BC6H images not supported by the OpenGL driver";
+				return 0;
+			}
+			/*	no, decode them here and upload RGBA	*/
+			decode = 1;
 		}
 		DDS_main_size = ((width+3)>>2)*((height+3)>>2)*block_size;
 	}
@@ -1669,23 +2523,13 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	}
 	if( (header.sCaps.dwCaps1 & DDSCAPS_MIPMAP) && (header.dwMipMapCount > 1) )
 	{
-		int shift_offset;
 		mipmaps = header.dwMipMapCount - 1;
 		DDS_full_size = DDS_main_size;
-		if( uncompressed )
-		{
-			/*	uncompressed DDS, simple MIPmap size calculation	*/
-			shift_offset = 0;
-		} else
-		{
-			/*	compressed DDS, MIPmap size calculation is block based	*/
-			shift_offset = 2;
-		}
 		for( i = 1; i <= mipmaps; ++ i )
 		{
 			int w, h;
-			w = width >> (shift_offset + i);
-			h = height >> (shift_offset + i);
+			w = width >> i;
+			h = height >> i;
 			if( w < 1 )
 			{
 				w = 1;
@@ -1694,15 +2538,23 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			{
 				h = 1;
 			}
-			DDS_full_size += w*h*block_size;
+			if( uncompressed )
+			{
+				/*	uncompressed DDS, simple MIPmap size calculation	*/
+				DDS_full_size += w*h*block_size;
+			} else
+			{
+				/*	compressed DDS, MIPmap size calculation is block based
+					(a partial block still takes a whole one)	*/
+				DDS_full_size += ((w+3)>>2)*((h+3)>>2)*block_size;
+			}
 		}
 	} else
 	{
 		mipmaps = 0;
 		DDS_full_size = DDS_main_size;
 	}
-	DDS_data = (unsigned char*)malloc( DDS_full_size );
-	/*	got the image data RAM, create or use an existing OpenGL texture handle	*/
+	/*	create or use an existing OpenGL texture handle	*/
 	tex_ID = reuse_texture_ID;
 	if( tex_ID == 0 )
 	{
@@ -1710,34 +2562,33 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 	}
 	/*  bind an OpenGL texture ID	*/
 	glBindTexture( opengl_texture_type, tex_ID );
+	/*	uncompressed levels are read straight from the file, which pads no rows	*/
+	unpack_alignment = SOIL_internal_unpack_rows_tightly();
 	/*	do this for each face of the cubemap!	*/
 	for( cf_target = ogl_target_start; cf_target <= ogl_target_end; ++cf_target )
 	{
 		if( buffer_index + DDS_full_size <= buffer_length )
 		{
 			unsigned int byte_offset = DDS_main_size;
-			memcpy( (void*)DDS_data, (const void*)(&buffer[buffer_index]), DDS_full_size );
+			/*	the levels go to OpenGL straight out of the buffer
+				(which SOIL_direct_load_DDS maps from the file)	*/
+			DDS_data = &buffer[buffer_index];
 			buffer_index += DDS_full_size;
 			/*	upload the main chunk	*/
 			if( uncompressed )
 			{
 				/*	and remember, DXT uncompressed uses BGR(A),
-					so swap to RGB(A) for ALL MIPmap levels	*/
-				for( i = 0; i < DDS_full_size; i += block_size )
-				{
-					unsigned char temp = DDS_data[i];
-					DDS_data[i] = DDS_data[i+2];
-					DDS_data[i+2] = temp;
-				}
+					which OpenGL can read directly for ALL MIPmap levels	*/
 				glTexImage2D(
 					cf_target, 0,
 					S3TC_type, width, height, 0,
-					S3TC_type, GL_UNSIGNED_BYTE, DDS_data );
+					BGR_type, GL_UNSIGNED_BYTE, DDS_data );
 			} else
 			{
-				soilGlCompressedTexImage2D(
+				SOIL_internal_upload_DDS_level(
 					cf_target, 0,
-					S3TC_type, width, height, 0,
+					S3TC_type, DDS_format, decode,
+					width, height,
 					DDS_main_size, DDS_data );
 			}
 			/*	upload the mipmaps, if we have them	*/
@@ -1761,13 +2612,14 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 					glTexImage2D(
 						cf_target, i,
 						S3TC_type, w, h, 0,
-						S3TC_type, GL_UNSIGNED_BYTE, &DDS_data[byte_offset] );
+						BGR_type, GL_UNSIGNED_BYTE, &DDS_data[byte_offset] );
 				} else
 				{
 					mip_size = ((w+3)/4)*((h+3)/4)*block_size;
-					soilGlCompressedTexImage2D(
+					SOIL_internal_upload_DDS_level(
 						cf_target, i,
-						S3TC_type, w, h, 0,
+						S3TC_type, DDS_format, decode,
+						w, h,
 						mip_size, &DDS_data[byte_offset] );
 				}
 				/*	and move to the next mipmap	*/
@@ -1783,7 +2635,7 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			result_string_pointer = "DDS file was too small for expected image data";
 		}
 	}/* end reading each face */
-	SOIL_free_image_data( DDS_data );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_alignment );
 	if( tex_ID )
 	{
 		/*	did I have MIPmaps?	*/
@@ -1825,9 +2677,7 @@ unsigned int SOIL_direct_load_DDS(
 		int flags,
 		int loading_as_cubemap )
 {
-	FILE *f;
-	unsigned char *buffer;
-	size_t buffer_length, bytes_read;
+	stbi_file_map map;
 	unsigned int tex_ID = 0;
 	/*	error checks	*/
 	if( NULL == filename )
@@ -1835,35 +2685,18 @@ unsigned int SOIL_direct_load_DDS(
 		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	f = fopen_s(&f, filename, "rb" );
-	if( NULL == f )
+	/*	map the file, the blocks are uploaded without another copy	*/
+	if( !stbi_map_file( filename, &map ) )
 	{
 		/*	the file doesn't seem to exist (or be open-able)	*/
 		result_string_pointer = "Can not find DDS file";
 		return 0;
 	}
-	fseek( f, 0, SEEK_END );
-	buffer_length = ftell( f );
-	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
-	if( NULL == buffer )
-	{
-		result_string_pointer = "malloc failed";
-		fclose( f );
-		return 0;
-	}
-	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
-	fclose( f );
-	if( bytes_read < buffer_length )
-	{
-		/*	huh?	*/
-		buffer_length = bytes_read;
-	}
 	/*	now try to do the loading	*/
 	tex_ID = SOIL_direct_load_DDS_from_memory(
-		(const unsigned char *const)buffer, buffer_length,
+		map.data, map.len,
 		reuse_texture_ID, flags, loading_as_cubemap );
-	SOIL_free_image_data( buffer );
+	stbi_unmap_file( &map );
 	return tex_ID;
 }
 
@@ -1874,8 +2707,7 @@ int query_NPOT_capability( void )
 	{
 		/*	we haven't yet checked for the capability, do so	*/
 		if(
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_ARB_texture_non_power_of_two" ) )
+			!SOIL_internal_has_extension( "GL_ARB_texture_non_power_of_two" )
 			)
 		{
 			/*	not there, flag the failure	*/
@@ -1897,14 +2729,11 @@ int query_tex_rectangle_capability( void )
 	{
 		/*	we haven't yet checked for the capability, do so	*/
 		if(
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_ARB_texture_rectangle" ) )
+			!SOIL_internal_has_extension( "GL_ARB_texture_rectangle" )
 		&&
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_EXT_texture_rectangle" ) )
+			!SOIL_internal_has_extension( "GL_EXT_texture_rectangle" )
 		&&
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_NV_texture_rectangle" ) )
+			!SOIL_internal_has_extension( "GL_NV_texture_rectangle" )
 			)
 		{
 			/*	not there, flag the failure	*/
@@ -1926,11 +2755,9 @@ int query_cubemap_capability( void )
 	{
 		/*	we haven't yet checked for the capability, do so	*/
 		if(
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_ARB_texture_cube_map" ) )
+			!SOIL_internal_has_extension( "GL_ARB_texture_cube_map" )
 		&&
-			(NULL == strstr( (char const*)glGetString( GL_EXTENSIONS ),
-				"GL_EXT_texture_cube_map" ) )
+			!SOIL_internal_has_extension( "GL_EXT_texture_cube_map" )
 			)
 		{
 			/*	not there, flag the failure	*/
@@ -1951,9 +2778,7 @@ int query_DXT_capability( void )
 	if( has_DXT_capability == SOIL_CAPABILITY_UNKNOWN )
 	{
 		/*	we haven't yet checked for the capability, do so	*/
-		if( NULL == strstr(
-				(char const*)glGetString( GL_EXTENSIONS ),
-				"GL_EXT_texture_compression_s3tc" ) )
+		if( !SOIL_internal_has_extension( "GL_EXT_texture_compression_s3tc" ) )
 		{
 			/*	not there, flag the failure	*/
 			has_DXT_capability = SOIL_CAPABILITY_NONE;
@@ -1991,6 +2816,10 @@ int query_DXT_capability( void )
 				CFRelease( bundleURL );
 				CFRelease( extensionName );
 				CFRelease( bundle );
+			#elif defined(SOIL_GLEW)
+				/*	GLEW already resolved it for whatever context is current	*/
+				ext_addr = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)
+						glCompressedTexImage2DARB;
 			#else
 				ext_addr = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)
 						glXGetProcAddressARB
@@ -2019,3 +2848,119 @@ int query_DXT_capability( void )
 	/*	let the user know if we can do DXT or not	*/
 	return has_DXT_capability;
 }
+
+int query_RGTC_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_RGTC_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	core since OpenGL 3.0	*/
+		if( (SOIL_internal_GL_version() < 30) &&
+			!SOIL_internal_has_extension( "GL_ARB_texture_compression_rgtc" ) &&
+			!SOIL_internal_has_extension( "GL_EXT_texture_compression_rgtc" ) )
+		{
+			/*	not there, flag the failure	*/
+			has_RGTC_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			/*	glCompressedTexImage2D has been core since 1.3, GLEW has it	*/
+			if( NULL == soilGlCompressedTexImage2D )
+			{
+				soilGlCompressedTexImage2D = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)
+						glCompressedTexImage2D;
+			}
+			has_RGTC_capability = (NULL == soilGlCompressedTexImage2D) ?
+					SOIL_CAPABILITY_NONE : SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do BC4/BC5 or not	*/
+	return has_RGTC_capability;
+}
+
+int query_BPTC_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_BPTC_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	core since OpenGL 4.2	*/
+		if( (SOIL_internal_GL_version() < 42) &&
+			!SOIL_internal_has_extension( "GL_ARB_texture_compression_bptc" ) &&
+			!SOIL_internal_has_extension( "GL_EXT_texture_compression_bptc" ) )
+		{
+			/*	not there, flag the failure	*/
+			has_BPTC_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			if( NULL == soilGlCompressedTexImage2D )
+			{
+				soilGlCompressedTexImage2D = (P_SOIL_GLCOMPRESSEDTEXIMAGE2DPROC)
+						glCompressedTexImage2D;
+			}
+			has_BPTC_capability = (NULL == soilGlCompressedTexImage2D) ?
+					SOIL_CAPABILITY_NONE : SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do BC6H/BC7 or not	*/
+	return has_BPTC_capability;
+}
+
+static int SOIL_internal_GL_version( void )
+{
+	/*	"major.minor[.release] vendor stuff", as 10*major + minor	*/
+	const char *version = (const char*)glGetString( GL_VERSION );
+	int major = 0, minor = 0;
+	if( NULL == version )
+	{
+		return 0;
+	}
+	while( (*version != 0) && ((*version < '0') || (*version > '9')) )
+	{
+		/*	skips "OpenGL ES "	*/
+		++version;
+	}
+	while( (*version >= '0') && (*version <= '9') )
+	{
+		major = major * 10 + (*version++ - '0');
+	}
+	if( *version == '.' )
+	{
+		++version;
+		if( (*version >= '0') && (*version <= '9') )
+		{
+			minor = *version - '0';
+		}
+	}
+	return major * 10 + minor;
+}
+
+static int SOIL_internal_has_extension( const char *name )
+{
+	const char *extensions;
+	size_t length = strlen( name );
+	if( SOIL_internal_GL_version() >= 30 )
+	{
+		/*	a core profile has no GL_EXTENSIONS string, ask one by one	*/
+		GLint count = 0, i;
+		glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+		for( i = 0; i < count; ++i )
+		{
+			const char *extension = (const char*)glGetStringi( GL_EXTENSIONS, i );
+			if( (NULL != extension) && (0 == strcmp( extension, name )) )
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+	extensions = (const char*)glGetString( GL_EXTENSIONS );
+	while( (NULL != extensions) && (NULL != (extensions = strstr( extensions, name ))) )
+	{
+		/*	whole words only, GL_EXT_foo must not match GL_EXT_foo_bar	*/
+		if( (extensions[length] == ' ') || (extensions[length] == 0) )
+		{
+			return 1;
+		}
+		extensions += length;
+	}
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "ShaderProgram.h"
+#include <iostream>
+
+static GLuint compileShader(GLenum stage, const GLchar* source)
+{
+    GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint ok;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char buf[1024]; glGetShaderInfoLog(shader, 1024, NULL, buf);
+        std::cerr << (stage == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT") << " COMPILE ERROR: " << buf << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool ShaderProgram::create(const GLchar* vertSrc, const GLchar* fragSrc)
+{
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertSrc);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+    if (!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return false;
+    }
+
+    // Link the vertex and fragment shader into a shader program
+    id = glCreateProgram();
+    glAttachShader(id, vertexShader);
+    glAttachShader(id, fragmentShader);
+    glBindFragDataLocation(id, 0, "outColor");
+    glLinkProgram(id);
+
+    //The program keeps the linked code, the shader objects aren't needed anymore
+    glDetachShader(id, vertexShader);
+    glDetachShader(id, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint ok;
+    glGetProgramiv(id, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char buf[1024]; glGetProgramInfoLog(id, 1024, NULL, buf);
+        std::cerr << "LINK ERROR: " << buf << std::endl;
+        destroy();
+        return false;
+    }
+
+    reflect();
+    return true;
+}
+
+void ShaderProgram::destroy()
+{
+    if (id)
+        glDeleteProgram(id);
+    id = 0;
+    uniforms.clear();
+    attributes.clear();
+}
+
+//Ask the driver for every active uniform and attribute, this is the only place names are resolved
+void ShaderProgram::reflect()
+{
+    GLint count = 0, maxLength = 0;
+    std::vector<GLchar> name;
+
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for (GLint i = 0; i < count; ++i) {
+        ShaderVariable variable;
+        glGetActiveUniform(id, i, (GLsizei)name.size(), NULL, &variable.size, &variable.type, name.data());
+        variable.name = name.data();
+        //Arrays are reported as "name[0]", look them up by their plain name
+        size_t bracket = variable.name.find('[');
+        if (bracket != std::string::npos)
+            variable.name.erase(bracket);
+        //Uniforms inside uniform blocks have no location of their own
+        variable.location = glGetUniformLocation(id, name.data());
+        uniforms.push_back(variable);
+    }
+
+    glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for (GLint i = 0; i < count; ++i) {
+        ShaderVariable variable;
+        glGetActiveAttrib(id, i, (GLsizei)name.size(), NULL, &variable.size, &variable.type, name.data());
+        variable.name = name.data();
+        variable.location = glGetAttribLocation(id, name.data());
+        attributes.push_back(variable);
+    }
+}
+
+GLint ShaderProgram::uniformLocation(const char* name, GLenum expectedType) const
+{
+    for (const ShaderVariable& variable : uniforms) {
+        if (variable.name != name)
+            continue;
+        if (variable.type != expectedType) {
+            std::cerr << "Uniform " << name << " has GLSL type 0x" << std::hex << variable.type
+                      << ", expected 0x" << expectedType << std::dec << std::endl;
+            return -1;
+        }
+        return variable.location;
+    }
+    std::cerr << "Uniform " << name << " is not active in program " << id << std::endl;
+    return -1;
+}
+
+GLint ShaderProgram::attributeLocation(const char* name) const
+{
+    for (const ShaderVariable& variable : attributes) {
+        if (variable.name == name)
+            return variable.location;
+    }
+    std::cerr << "Attribute " << name << " is not active in program " << id << std::endl;
+    return -1;
+}
+
+bool ShaderProgram::bindUniformBlock(const char* name, GLuint binding) const
+{
+    GLuint index = glGetUniformBlockIndex(id, name);
+    if (index == GL_INVALID_INDEX) {
+        std::cerr << "Uniform block " << name << " is not active in program " << id << std::endl;
+        return false;
+    }
+    glUniformBlockBinding(id, index, binding);
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "RenderContext.h"
+#include <string>
+#include <vector>
+
+//An active uniform or vertex attribute as reported by the driver after linking
+struct ShaderVariable
+{
+    std::string name;
+    GLint location;
+    GLenum type;
+    GLint size;
+};
+
+//Compiles and links a program once, checks compile/link status once, and records every active uniform and attribute
+//Look locations up right after create() and keep them, the render loop should never need a name
+class ShaderProgram
+{
+public:
+    GLuint id = 0;
+    std::vector<ShaderVariable> uniforms;
+    std::vector<ShaderVariable> attributes;
+
+    //Returns false (and prints the info log) if either stage fails to compile or the program fails to link
+    bool create(const GLchar* vertSrc, const GLchar* fragSrc);
+    void destroy();
+
+    //Location of an active uniform, -1 with a warning if it's missing or its GLSL type isn't expectedType
+    GLint uniformLocation(const char* name, GLenum expectedType) const;
+    //Location of an active vertex attribute, -1 with a warning if it's missing
+    GLint attributeLocation(const char* name) const;
+    //Attaches the named uniform block to a buffer binding point, false with a warning if the block isn't active
+    bool bindUniformBlock(const char* name, GLuint binding) const;
+
+private:
+    void reflect();
+};
@@ -1,93 +1,30 @@
-﻿#define GLEW_STATIC
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
+﻿#include "RenderContext.h"
+#include "FrameProfiler.h"
+#include "ShaderProgram.h"
+#include "FrameUniforms.h"
+#include "CubeInstances.h"
+#include "Mesh.h"
+#include "PostProcess.h"
+#include "FramebufferManager.h"
+#include "TextureStreamer.h"
+#include "TextureBenchmark.h"
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
+#include <gtc/constants.hpp>
 #include <iostream>
 #include <chrono>
-#include <SOIL.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 using namespace std;
-//Create Texture from an image file
-GLuint loadTexture(const GLchar* path)
-{
-    GLuint texture;
-    glGenTextures(1, &texture);
-
-    int width, height;
-    unsigned char* image;
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-    image = SOIL_load_image(path, &width, &height, 0, SOIL_LOAD_RGB);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    SOIL_free_image_data(image);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    return texture;
-}
-//Set pointers to vertex attributes in the shader to be changed and used in rendering the scene
-void specifySceneVertexAttributes(GLuint shaderProgram)
-{
-    GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
-    glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), 0);
-
-    GLint colAttrib = glGetAttribLocation(shaderProgram, "color");
-    glEnableVertexAttribArray(colAttrib);
-    glVertexAttribPointer(colAttrib, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
 
-    GLint texAttrib = glGetAttribLocation(shaderProgram, "texcoord");
-    glEnableVertexAttribArray(texAttrib);
-    glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
-}
-
-// Set pointers to vertex attributes in the shader to be changed and used in rendering the screen
-void specifyScreenVertexAttributes(GLuint shaderProgram)
-{
-    GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
-    glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-
-    GLint texAttrib = glGetAttribLocation(shaderProgram, "texcoord");
-    glEnableVertexAttribArray(texAttrib);
-    glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
-}
-
-void createShaderProgram(const GLchar* vertSrc, const GLchar* fragSrc, GLuint& vertexShader, GLuint& fragmentShader,GLuint& shaderProgram)
-{
-    // Create and compile the vertex shader
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertSrc, NULL);
-    glCompileShader(vertexShader);
-
-    // Create and compile the fragment shader
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragSrc, NULL);
-    glCompileShader(fragmentShader);
-
-    // Link the vertex and fragment shader into a shader program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glBindFragDataLocation(shaderProgram, 0, "outColor");
-    glLinkProgram(shaderProgram);
-}
-
-void createShaderProgram( GLuint& gridVertex, GLuint& gridFrag, GLuint& shaderProgram)
-{
-    // Link the vertex and fragment shader into a shader program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, gridVertex);
-    glAttachShader(shaderProgram, gridFrag);
-	glLinkProgram(shaderProgram);
-    glBindFragDataLocation(shaderProgram, 0, "outColor");
-    glLinkProgram(shaderProgram);
-}
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
@@ -101,6 +38,7 @@ float lastX = 0;
 float lastY = 0;
 float yaw = 180;
 float pitch = 0;
+#ifndef GRAPHICS_NO_GLFW
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if (firstMouse)
     {
@@ -152,12 +90,56 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
+#endif
+
+//Benchmark camera: replaces mouse_callback/processInput with an orbit around the cube, one turn every 600 frames
+//Driven by the frame index rather than the clock so every run renders the same frames
+void scriptedCamera(long frame)
+{
+    float angle = frame * (2.0f * glm::pi<float>() / 600.0f);
+    cameraPos = glm::vec3(3.0f * cos(angle), 1.0f, 3.0f * sin(angle));
+    cameraFront = glm::normalize(glm::vec3(0.0f, 0.0f, 0.0f) - cameraPos);
+    yaw = glm::degrees(atan2(cameraFront.z, cameraFront.x));
+    pitch = glm::degrees(asin(cameraFront.y));
+}
+
+//Draws every cube with whatever model uniform is set: one instanced call, or one call per cube to compare submission cost
+void drawSceneCubes(bool instanced, GLuint vaoCube, GLuint vaoCubeSingle, const MeshRange& cubeRange,
+                    const CubeInstanceBuffer& cubeInstances, const InstanceAttributes& instanceAttributes)
+{
+    if (instanced) {
+        glBindVertexArray(vaoCube);
+        drawMeshRange(cubeRange, cubeInstances.count());
+        return;
+    }
+    glBindVertexArray(vaoCubeSingle);
+    for (const CubeInstance& instance : cubeInstances.instances) {
+        setConstantInstance(instanceAttributes, instance);
+        drawMeshRange(cubeRange);
+    }
+}
+
+//Parses a comma separated list of counts such as "1,1000,100000"
+std::vector<long> parseCountList(const char* list)
+{
+    std::vector<long> counts;
+    char* end = nullptr;
+    for (const char* p = list; *p; p = *end ? end + 1 : end) {
+        long count = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (count > 0)
+            counts.push_back(count);
+    }
+    return counts;
+}
 
 //Handles attributes as they appear in the vertex array, positions, and 3d Transformations
 //Model matrix: position of model to real world
 //View matrix: position of camera to real world
 //Order matters in matrix multiplication! Projection looks at the view matrix which looks at the model matrix
 //Projection matrix: 3D to 2D Razterization
+//View and projection come from the shared FrameData uniform block (FrameUniforms.h), written once per frame for every program
 const GLchar* sceneVertexSource = R"glsl(
         #version 330 core
         in vec3 position;
@@ -167,14 +149,22 @@ const GLchar* sceneVertexSource = R"glsl(
         out vec3 Color;
         out vec2 Texcoord;    
 
+        layout(std140) uniform FrameData {
+            mat4 view;
+            mat4 proj;
+            mat4 viewProj;
+            vec4 cameraPos;
+            float time;
+        };
+        //Per-cube placement and tint, model is the transform shared by every cube (spin, reflection)
+        in mat4 instanceModel;
+        in vec4 instanceColor;
         uniform vec3 overrideColor;
         uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 proj;
         void main(){
-            Color = overrideColor * color;
+            Color = overrideColor * instanceColor.rgb * color;
             Texcoord = texcoord;
-            gl_Position = proj * view *  model * vec4(position, 1.0);
+            gl_Position = viewProj * model * instanceModel * vec4(position, 1.0);
         }
     )glsl";
 //Handles coloring of pixels using glsl
@@ -183,7 +173,6 @@ const GLchar* sceneVertexSource = R"glsl(
 const GLchar* sceneFragmentSource = R"glsl(
         #version 330 core
         in vec3 Color;
-        uniform float time;
         out vec4 outColor;
         uniform int selector;
 
@@ -225,9 +214,14 @@ const GLchar* sceneGridLinesVertexSource = R"glsl(
         #version 330 core
         layout (location = 0) in vec3 aPos;
 
+        layout(std140) uniform FrameData {
+            mat4 view;
+            mat4 proj;
+            mat4 viewProj;
+            vec4 cameraPos;
+            float time;
+        };
         uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
 
         out vec3 FragPos;
 
@@ -235,75 +229,10 @@ const GLchar* sceneGridLinesVertexSource = R"glsl(
         {
             vec4 worldPos = model * vec4(aPos, 1.0);
             FragPos = worldPos.xyz;
-            gl_Position = projection * view * worldPos;
-        }
-    )glsl";
-const GLchar* screenFragmentSource = R"glsl(
-        #version 330 core
-        in vec2 Texcoord;
-        out vec4 outColor;
-        uniform sampler2D texFramebuffer;
-        uniform int selector;
-        
-        const float blurSizeH = 1.0 / 300.0;
-        const float blurSizeV = 1.0 / 200.0;
-
-        void main()
-        {
-            if (selector == 1) {
-                // Inverse Color
-                outColor = vec4(1.0) - texture(texFramebuffer, Texcoord);
-            } 
-            else if (selector == 2) {
-                // Greyscale
-                vec4 c = texture(texFramebuffer, Texcoord);
-                float avg = (c.r + c.g + c.b) / 3.0;
-                outColor = vec4(avg, avg, avg, 1.0);
-            } 
-            else if (selector == 3) {
-                // Simple blur
-                vec4 sum = vec4(0.0);
-                for (int y = -4; y <= 4; ++y) {
-                    for (int x = -4; x <= 4; ++x) {
-                        sum += texture(texFramebuffer,
-                                       Texcoord + vec2(float(x) * blurSizeH,
-                                                       float(y) * blurSizeV));
-                    }
-                }
-                outColor = sum / (9.0 * 9.0);
-            } 
-            else if (selector == 4) {
-                // Edge detection (Sobel-like)
-                vec4 top = texture(texFramebuffer, Texcoord + vec2(0.0,  blurSizeV));
-                vec4 bottom = texture(texFramebuffer, Texcoord + vec2(0.0, -blurSizeV));
-                vec4 left = texture(texFramebuffer, Texcoord + vec2(-blurSizeH, 0.0));
-                vec4 right = texture(texFramebuffer, Texcoord + vec2( blurSizeH, 0.0));
-                vec4 topLeft = texture(texFramebuffer, Texcoord + vec2(-blurSizeH,  blurSizeV));
-                vec4 topRight = texture(texFramebuffer, Texcoord + vec2( blurSizeH,  blurSizeV));
-                vec4 bottomLeft = texture(texFramebuffer, Texcoord + vec2(-blurSizeH, -blurSizeV));
-                vec4 bottomRight = texture(texFramebuffer, Texcoord + vec2( blurSizeH, -blurSizeV));
-                vec4 sx = -topLeft - 2.0 * left - bottomLeft + topRight + 2.0 * right + bottomRight;
-                vec4 sy = -topLeft - 2.0 * top - topRight + bottomLeft + 2.0 * bottom + bottomRight;
-                outColor = sqrt(sx * sx + sy * sy);
-            } 
-            else {
-                // Default: just pass through
-                outColor = texture(texFramebuffer, Texcoord);
-            }
-        }
-)glsl";
-const GLchar* screenVertexSource = R"glsl(
-        #version 330 core
-        in vec2 position;
-        in vec2 texcoord;
-        out vec2 Texcoord;
-        void main()
-        {
-            Texcoord = texcoord;
-            gl_Position = vec4(position, 0.0, 1.0);
+            gl_Position = viewProj * worldPos;
         }
     )glsl";
-// Cube vertices
+// Cube vertices, followed by the floor quad (last 6). Welded into an indexed mesh at startup (Mesh.cpp)
 GLfloat cubeVertices[] = {
     -0.5f, -0.5f, -0.5f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
      0.5f, -0.5f, -0.5f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
@@ -355,16 +284,6 @@ GLfloat cubeVertices[] = {
     -1.0f, -1.0f, -0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f
 };
 
-// Quad vertices
-GLfloat quadVertices[] = {
-    -1.0f,  1.0f,  0.0f, 1.0f,
-     1.0f,  1.0f,  1.0f, 1.0f,
-     1.0f, -1.0f,  1.0f, 0.0f,
-
-     1.0f, -1.0f,  1.0f, 0.0f,
-    -1.0f, -1.0f,  0.0f, 0.0f,
-    -1.0f,  1.0f,  0.0f, 1.0f
-};
 float groundVertices[] = {
     -5000.0f, 0.0f, -5000.0f,
      5000.0f, 0.0f, -5000.0f,
@@ -375,37 +294,121 @@ float groundVertices[] = {
     -5000.0f, 0.0f,  5000.0f
 };
 
-int main() {
+const size_t TextureUploadBudget = 4 * 1024 * 1024;
+
+//Command line: --backend=window|egl picks the context backend, --frames=N stops after N frames (0 runs until the window closes)
+//Surfaceless runs default to a fixed number of frames so batch jobs terminate
+//--benchmark=N renders N timed frames (after --warmup=K, default 10) with the scripted camera and a fixed time step,
+//--benchmark-out=file.csv|file.json writes the timings, --effect=N picks one post effect (0 none, 1 invert, 2 greyscale,
+//3 blur, 4 edges), --effects=greyscale,blur,... chains them in order
+//--instances=N draws N cubes, --sweep-instances=1,1000,... benchmarks each count in turn (writing one row per count),
+//--draw-mode=loop issues one draw call per cube instead of a single instanced call
+//--vertex-format=float uploads the mesh as 32-byte float vertices instead of the 16-byte packed format
+//--blur-downsample=2|4 runs the blur effect (--effect=3) at half or quarter resolution
+//--size=WxH sets the initial framebuffer size, --msaa=N renders the scene with N samples, --hdr renders it to RGBA16F
+//--dxt-benchmark[=image] times the DXT texture compressors in MPix/s (on a generated image by default) and exits
+int main(int argc, char** argv) {
     auto t_start = std::chrono::high_resolution_clock::now();
 
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW\n";
-        return -1;
+    ContextBackend backend = defaultContextBackend();
+    long frameLimit = -1;
+    long benchmarkFrames = 0;
+    long warmupFrames = 10;
+    std::string benchmarkOut;
+    int curSelector = 0;
+    std::vector<PostEffect> postEffects;
+    std::vector<long> instanceCounts(1, 1);
+    bool sweepInstances = false;
+    bool instancedDraw = true;
+    bool packedVertices = true;
+    int blurDownsample = 1;
+    int width = 800, height = 600;
+    int msaaSamples = 1;
+    bool hdr = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--backend=", 10) == 0) {
+            if (!parseContextBackend(argv[i] + 10, backend)) {
+                std::cerr << "Unknown or unavailable backend: " << argv[i] + 10 << "\n";
+                return -1;
+            }
+        }
+        else if (strncmp(argv[i], "--frames=", 9) == 0) {
+            frameLimit = strtol(argv[i] + 9, nullptr, 10);
+        }
+        else if (strncmp(argv[i], "--benchmark=", 12) == 0) {
+            benchmarkFrames = strtol(argv[i] + 12, nullptr, 10);
+        }
+        else if (strncmp(argv[i], "--warmup=", 9) == 0) {
+            warmupFrames = strtol(argv[i] + 9, nullptr, 10);
+        }
+        else if (strncmp(argv[i], "--benchmark-out=", 16) == 0) {
+            benchmarkOut = argv[i] + 16;
+        }
+        else if (strncmp(argv[i], "--effect=", 9) == 0) {
+            curSelector = (int)strtol(argv[i] + 9, nullptr, 10);
+            postEffects = postEffectsForSelector(curSelector);
+        }
+        else if (strncmp(argv[i], "--effects=", 10) == 0) {
+            if (!parsePostEffects(argv[i] + 10, postEffects))
+                return -1;
+        }
+        else if (strncmp(argv[i], "--instances=", 12) == 0) {
+            instanceCounts = parseCountList(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--sweep-instances=", 18) == 0) {
+            instanceCounts = parseCountList(argv[i] + 18);
+            sweepInstances = true;
+        }
+        else if (strcmp(argv[i], "--draw-mode=loop") == 0 || strcmp(argv[i], "--draw-mode=instanced") == 0) {
+            instancedDraw = strcmp(argv[i] + 12, "instanced") == 0;
+        }
+        else if (strcmp(argv[i], "--vertex-format=packed") == 0 || strcmp(argv[i], "--vertex-format=float") == 0) {
+            packedVertices = strcmp(argv[i] + 16, "packed") == 0;
+        }
+        else if (strcmp(argv[i], "--blur-downsample=1") == 0 || strcmp(argv[i], "--blur-downsample=2") == 0 ||
+                 strcmp(argv[i], "--blur-downsample=4") == 0) {
+            blurDownsample = argv[i][18] - '0';
+        }
+        else if (strncmp(argv[i], "--size=", 7) == 0) {
+            if (sscanf(argv[i] + 7, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Expected --size=WIDTHxHEIGHT\n";
+                return -1;
+            }
+        }
+        else if (strncmp(argv[i], "--msaa=", 7) == 0) {
+            msaaSamples = std::max((int)strtol(argv[i] + 7, nullptr, 10), 1);
+        }
+        else if (strcmp(argv[i], "--hdr") == 0) {
+            hdr = true;
+        }
+        else if (strcmp(argv[i], "--dxt-benchmark") == 0 || strncmp(argv[i], "--dxt-benchmark=", 16) == 0) {
+            //Needs no context, so it runs right here
+            return runDxtBenchmark(argv[i][15] == '=' ? argv[i] + 16 : nullptr, 5) ? 0 : -1;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--backend=window|egl] [--frames=N]"
+                      << " [--benchmark=N] [--warmup=K] [--benchmark-out=file.csv|file.json] [--effect=0-4] [--effects=a,b,...]"
+                      << " [--instances=N] [--sweep-instances=N,N,...] [--draw-mode=instanced|loop]"
+                      << " [--vertex-format=packed|float] [--blur-downsample=1|2|4]"
+                      << " [--size=WxH] [--msaa=N] [--hdr] [--dxt-benchmark[=image]]\n";
+            return -1;
+        }
     }
-
-    // Ask for OpenGL 3.3 Core Profile (common baseline)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // Create a window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "GLEW + GLFW Test", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
+    if (instanceCounts.empty()) {
+        std::cerr << "Instance counts must be positive numbers\n";
         return -1;
     }
-
-    // Make context current before using GLEW
-    glfwMakeContextCurrent(window);
-
-    // Initialize GLEW
-    glewExperimental = GL_TRUE; // Needed for core profile
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW\n";
+    if (sweepInstances && benchmarkFrames <= 0)
+        benchmarkFrames = 100;
+    bool benchmark = benchmarkFrames > 0;
+    if (benchmark)
+        frameLimit = warmupFrames + benchmarkFrames;
+    else if (frameLimit < 0)
+        frameLimit = backend == ContextBackend::Surfaceless ? 600 : 0;
+
+    RenderContext context;
+    if (!createRenderContext(context, backend, width, height, "GLEW + GLFW Test"))
         return -1;
-    }
 
 	//Depth tests are good for removing objects behind other objects, Stencil tests are good for outlining objects/shapes to make mirrors, windows, and masking models
 	//Tests Depths to make sure not overlapping objects are drawn
@@ -415,52 +418,46 @@ int main() {
     // Create some primitive
 
 
-         
-    //Unsigned int elements referring to vertices bound to GL_ARRAY_BUFFER if we want to draw them in order
-    GLuint elements[] = {
-        0, 1, 2,
-        2, 3, 0
-	};  
 // Create VAOsGLint success;
 
-    GLuint vaoCube, vaoQuad;
+    GLuint vaoCube, vaoCubeSingle;
     glGenVertexArrays(1, &vaoCube);
-    glGenVertexArrays(1, &vaoQuad);
-// Create Vertix Buffer Objects (VBOs)
-    GLuint vboCube, vboQuad;
-    glGenBuffers(1, &vboCube);
-    glGenBuffers(1, &vboQuad);
-// Create shader programs
-    GLuint sceneVertexShader, sceneFragmentShader, sceneShaderProgram, gridShaderProgram, gridVertexShader, gridFragmentShader;
-
-    GLuint screenVertexShader, screenFragmentShader, screenShaderProgram;
-    createShaderProgram(screenVertexSource, screenFragmentSource, screenVertexShader, screenFragmentShader, screenShaderProgram);
-    createShaderProgram(sceneVertexSource, sceneFragmentSource, sceneVertexShader, sceneFragmentShader, sceneShaderProgram);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vboCube);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-// Create grid shaders
-    gridVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(gridVertexShader, 1, &sceneGridLinesVertexSource, NULL);
-    glCompileShader(gridVertexShader);
-
-    gridFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(gridFragmentShader, 1, &sceneGridLinesFragmentSource, NULL);
-    glCompileShader(gridFragmentShader);
-    
-    createShaderProgram(gridVertexShader, gridFragmentShader, gridShaderProgram);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, vboQuad);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &vaoCubeSingle);
+// Create shader programs, compile and link status are checked here once instead of every frame
+    ShaderProgram sceneShaderProgram, gridShaderProgram;
+    if (!sceneShaderProgram.create(sceneVertexSource, sceneFragmentSource) ||
+        !gridShaderProgram.create(sceneGridLinesVertexSource, sceneGridLinesFragmentSource)) {
+        destroyRenderContext(context);
+        return -1;
+    }
+
+    //Weld the 42 authored vertices into 16-bit indexed cube and floor ranges sharing one vertex and index buffer
+    IndexedMesh sceneMesh;
+    MeshRange cubeRange = appendTriangles(sceneMesh, cubeVertices, 36);
+    MeshRange floorRange = appendTriangles(sceneMesh, cubeVertices + 36 * 8, 6);
+    optimizeVertexFetch(sceneMesh);
+    MeshBuffer sceneMeshBuffer;
+    sceneMeshBuffer.create(sceneMesh, packedVertices);
+    if (benchmark) {
+        std::cout << "Scene mesh: " << sceneMesh.vertices.size() << " vertices x " << sceneMeshBuffer.vertexSize() << " bytes, "
+                  << sceneMesh.indices.size() << " indices, cube ACMR " << averageCacheMissRatio(sceneMesh, cubeRange) << "\n";
+    }
+
  
 // Specify the layout of the vertex data
+    //vaoCube reads per-cube data from the instance buffer, vaoCubeSingle leaves the instance inputs as constant attributes
+    CubeInstanceBuffer cubeInstances;
+    cubeInstances.create();
+    cubeInstances.upload(layoutCubeInstances(instanceCounts[0]));
+    InstanceAttributes instanceAttributes = findInstanceAttributes(sceneShaderProgram);
+
     glBindVertexArray(vaoCube);
-    glBindBuffer(GL_ARRAY_BUFFER, vboCube);
-    specifySceneVertexAttributes(sceneShaderProgram);
+    sceneMeshBuffer.specifyAttributes(sceneShaderProgram);
+    specifyInstanceAttributes(instanceAttributes, cubeInstances.buffer);
 
-    glBindVertexArray(vaoQuad);
-    glBindBuffer(GL_ARRAY_BUFFER, vboQuad);
-    specifyScreenVertexAttributes(screenShaderProgram);
+    glBindVertexArray(vaoCubeSingle);
+    sceneMeshBuffer.specifyAttributes(sceneShaderProgram);
+    CubeInstance floorInstance = layoutCubeInstances(1)[0];
 
 // Create grid VAO and VBO
     unsigned int gridVAO, gridVBO;
@@ -478,48 +475,51 @@ int main() {
     glBindVertexArray(0); // unbind
 
    
-    GLuint texKitten = loadTexture("textures/cat.png");
-    GLuint texPuppy = loadTexture("textures/puppy.png");
-
-    glUseProgram(sceneShaderProgram);
-    glUniform1i(glGetUniformLocation(sceneShaderProgram, "texKitten"), 0);
-    glUniform1i(glGetUniformLocation(sceneShaderProgram, "texPuppy"), 1);
-
-    glUseProgram(screenShaderProgram);
-    glUniform1i(glGetUniformLocation(screenShaderProgram, "texFramebuffer"), 0);
-
-    GLint posAttrib = glGetAttribLocation(screenShaderProgram, "position");
-    if (posAttrib != -1) {
-        glEnableVertexAttribArray(posAttrib);
-        glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
+    //Textures decode on worker threads and show a white placeholder until they are uploaded
+    TextureStreamer textureStreamer;
+    textureStreamer.start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    GLuint texKitten = textureStreamer.request("textures/cat.png");
+    GLuint texPuppy = textureStreamer.request("textures/puppy.png");
+    //Timed frames must all see the same textures
+    if (benchmark)
+        textureStreamer.finishAll();
+
+    glUseProgram(sceneShaderProgram.id);
+    glUniform1i(sceneShaderProgram.uniformLocation("texKitten", GL_SAMPLER_2D), 0);
+    glUniform1i(sceneShaderProgram.uniformLocation("texPuppy", GL_SAMPLER_2D), 1);
+
+    //Every location the render loop uses, resolved once from the programs' uniform tables
+    GLint uniModel = sceneShaderProgram.uniformLocation("model", GL_FLOAT_MAT4);
+
+    //The grid never moves, so its model matrix is uploaded once
+    glUseProgram(gridShaderProgram.id);
+    glm::mat4 gridModel = glm::mat4(6.0f);
+    glUniformMatrix4fv(gridShaderProgram.uniformLocation("model", GL_FLOAT_MAT4), 1, GL_FALSE, glm::value_ptr(gridModel));
+
+    //Camera matrices for every program live in one uniform buffer
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.create();
+    sceneShaderProgram.bindUniformBlock("FrameData", FrameUniformBinding);
+    gridShaderProgram.bindUniformBlock("FrameData", FrameUniformBinding);
+
+    // Create the scene framebuffer: color, depth and stencil, all following the window size
+    FramebufferManager framebuffers;
+    framebuffers.init(context.width, context.height);
+    GLenum sceneFormat = hdr ? GL_RGBA16F : GL_RGB8;
+    RenderTargetDesc sceneDesc = framebuffers.screenDesc(sceneFormat);
+    sceneDesc.depthStencilFormat = GL_DEPTH24_STENCIL8;
+    sceneDesc.samples = msaaSamples;
+    RenderTarget* sceneTarget = framebuffers.createTarget(sceneDesc, true);
+    //Multisampled color can't be sampled by the post passes, it is resolved into a plain texture first
+    RenderTarget* resolvedScene = msaaSamples > 1 ? framebuffers.createTarget(framebuffers.screenDesc(sceneFormat), true) : sceneTarget;
+
+    // Post-process passes, one specialized program per pass instead of a selector branch per pixel
+    PostProcessGraph postProcess;
+    if (!postProcess.create(framebuffers, blurDownsample) || !postProcess.setEffects(postEffects)) {
+        destroyRenderContext(context);
+        return -1;
     }
 
-    GLint uniModel = glGetUniformLocation(sceneShaderProgram, "model");
-
-    // Create framebuffer
-    GLuint frameBuffer;
-    glGenFramebuffers(1, &frameBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-
-    // Create texture to hold color buffer
-    GLuint texColorBuffer;
-    glGenTextures(1, &texColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 800, 600, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-
-    // Create Renderbuffer Object to hold depth and stencil buffers
-    GLuint rboDepthStencil;
-    glGenRenderbuffers(1, &rboDepthStencil);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepthStencil);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, 800, 600);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepthStencil);
-
     // Set up projection
 	glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
 	//Gram-Schmidt process to find the right and up vectors of the camera
@@ -530,46 +530,79 @@ int main() {
 	glm::vec3 cameraUp = glm::cross(cameraDirection, cameraRight);
    
     
-    glUseProgram(sceneShaderProgram);
+    glUseProgram(sceneShaderProgram.id);
 
 
-    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 1.0f, 10.0f);
-    GLint uniProj = glGetUniformLocation(sceneShaderProgram, "proj");
-    glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)context.width / context.height, 1.0f, 10.0f);
 
-    GLint uniColor = glGetUniformLocation(sceneShaderProgram, "overrideColor");
+    GLint uniColor = sceneShaderProgram.uniformLocation("overrideColor", GL_FLOAT_VEC3);
 
-    glUseProgram(screenShaderProgram);
-    GLint selection = glGetUniformLocation(screenShaderProgram, "selector");
-    int curSelector = 0;
-	glUniform1i(selection, curSelector);
-    GLenum e = glGetError();
-    if (e != GL_NO_ERROR) std::cerr << "GL error after uniform1i: " << e << std::endl;
     
-    GLint uniView = glGetUniformLocation(sceneShaderProgram, "view");
         cameraFront = glm::normalize(glm::vec3(0.0f, 0.0f, 0.0f) - cameraPos);
         yaw = glm::degrees(atan2(cameraFront.z, cameraFront.x)) - 90.0f;
         pitch = glm::degrees(asin(cameraFront.y));
+#ifndef GRAPHICS_NO_GLFW
+    //Benchmarks ignore the mouse and keyboard so runs stay reproducible
+    GLFWwindow* window = benchmark ? nullptr : context.window;
+    if (window) {
         glfwSetCursorPosCallback(window, mouse_callback);
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    while (!glfwWindowShouldClose(window)) {        
-        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    }
+#endif
+
+    FrameProfiler profiler;
+    if (benchmark)
+        profiler.init(warmupFrames);
+
+    std::vector<BenchmarkRun> sweepRuns;
+    size_t sweepStep = 0;
+
+    long frameCount = 0;
+    //frameCount restarts at every sweep step, the summary line covers the whole loop
+    long totalFrames = 0;
+    double loopStart = contextGetTime(context);
+#ifndef GRAPHICS_NO_GLFW
+    //The chain from --effects stays until a number key picks another one
+    int appliedSelector = curSelector;
+#endif
+    while (!contextShouldClose(context) && (frameLimit == 0 || frameCount < frameLimit)) {
+        if (benchmark) {
+            profiler.beginFrame();
+            scriptedCamera(frameCount);
+        }
+        //Window resizes reallocate every screen-sized target and change the aspect ratio
+        if (contextUpdateFramebufferSize(context) && framebuffers.resize(context.width, context.height))
+            proj = glm::perspective(glm::radians(45.0f), (float)context.width / context.height, 1.0f, 10.0f);
+        //Finished decodes go up a few MiB per frame so a large texture never costs one long frame
+        textureStreamer.pump(TextureUploadBudget);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->framebuffer);
+        glViewport(0, 0, context.width, context.height);
         glEnable(GL_DEPTH_TEST);
 
-        float currentFrame = glfwGetTime();
+        float currentFrame = benchmark ? frameCount / 60.0f : contextGetTime(context);
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        if (benchmark) profiler.beginPass(PassSceneCubes);
         glBindVertexArray(vaoCube);
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glUseProgram(sceneShaderProgram);
-        if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) curSelector = 1;
-        if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) curSelector = 2;
-        if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) curSelector = 3;
-        if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) curSelector = 4;
-        if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) curSelector = 0;
+        glUseProgram(sceneShaderProgram.id);
+#ifndef GRAPHICS_NO_GLFW
+        if (window) {
+            if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) curSelector = 1;
+            if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) curSelector = 2;
+            if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) curSelector = 3;
+            if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) curSelector = 4;
+            if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) curSelector = 0;
+            //Only rebuild the passes when the selection actually changes
+            if (curSelector != appliedSelector) {
+                appliedSelector = curSelector;
+                if (!postProcess.setEffects(postEffectsForSelector(curSelector)))
+                    std::cerr << "Failed to build the post-process passes for selector " << curSelector << "\n";
+            }
+        }
+#endif
 
         up = glm::vec3(0.0f, 1.0f, 0.0f);
 
@@ -581,14 +614,16 @@ int main() {
 
         cameraRight = glm::normalize(glm::cross(cameraFront, up));
         cameraUp = glm::normalize(glm::cross(cameraRight, cameraFront));
-        processInput(window);
+#ifndef GRAPHICS_NO_GLFW
+        if (window)
+            processInput(window);
+#endif
 
         glm::mat4 view;
 	    float radius = 10.0f;
-        float camX = sin(glfwGetTime() * radius);
-	    float camZ = cos(glfwGetTime() * radius);
+        float camX = sin(contextGetTime(context) * radius);
+	    float camZ = cos(contextGetTime(context) * radius);
         view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-	    glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texKitten);
         glActiveTexture(GL_TEXTURE1);
@@ -599,6 +634,16 @@ int main() {
         // Calculate transformation
         auto t_now = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration_cast<std::chrono::duration<float>>(t_now - t_start).count();
+        if (benchmark)
+            time = currentFrame;
+
+        FrameUniformData frameData;
+        frameData.view = view;
+        frameData.proj = proj;
+        frameData.viewProj = proj * view;
+        frameData.cameraPos = glm::vec4(cameraPos, 1.0f);
+        frameData.time = time;
+        frameUniforms.update(frameData);
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::rotate(
@@ -608,9 +653,11 @@ int main() {
         );
         glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
 
-        // Draw cube
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        // Draw cubes
+        drawSceneCubes(instancedDraw, vaoCube, vaoCubeSingle, cubeRange, cubeInstances, instanceAttributes);
+        if (benchmark) profiler.endPass(PassSceneCubes);
 
+        if (benchmark) profiler.beginPass(PassStencilFloor);
         glEnable(GL_STENCIL_TEST);
 
         // Draw floor
@@ -620,9 +667,13 @@ int main() {
         glDepthMask(GL_FALSE);
         glClear(GL_STENCIL_BUFFER_BIT);
 
-        glDrawArrays(GL_TRIANGLES, 36, 6);
+        glBindVertexArray(vaoCubeSingle);
+        setConstantInstance(instanceAttributes, floorInstance);
+        drawMeshRange(floorRange);
+        if (benchmark) profiler.endPass(PassStencilFloor);
 
         // Draw cube reflection
+        if (benchmark) profiler.beginPass(PassReflection);
         glStencilFunc(GL_EQUAL, 1, 0xFF);
         glStencilMask(0x00);
         glDepthMask(GL_TRUE);
@@ -632,78 +683,85 @@ int main() {
         glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
 
         glUniform3f(uniColor, 0.3f, 0.3f, 0.3f);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        drawSceneCubes(instancedDraw, vaoCube, vaoCubeSingle, cubeRange, cubeInstances, instanceAttributes);
         glUniform3f(uniColor, 1.0f, 1.0f, 1.0f);
+        if (benchmark) profiler.endPass(PassReflection);
 
     //Draw Grid
-            glUseProgram(gridShaderProgram);
-
-            // set uniforms
-
-            glUniformMatrix4fv(glGetUniformLocation(gridShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(gridShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(proj));
-
-        
-            glm::mat4 gridModel = glm::mat4(6.0f);
-            glUniformMatrix4fv(glGetUniformLocation(gridShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(gridModel));
-
+            if (benchmark) profiler.beginPass(PassGrid);
+            glUseProgram(gridShaderProgram.id);
 
             // draw grid quad
             glDisable(GL_STENCIL_TEST);
             glBindVertexArray(gridVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
             glBindVertexArray(0);
+            if (benchmark) profiler.endPass(PassGrid);
 
 
 
         // Bind default framebuffer and draw contents of our framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindVertexArray(vaoQuad);
+        if (benchmark) profiler.beginPass(PassPostProcess);
         glDisable(GL_DEPTH_TEST);
-        glUseProgram(screenShaderProgram);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-
-        glUseProgram(screenShaderProgram);
-        glUniform1i(selection, curSelector);GLint ok;
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glGetProgramiv(screenFragmentShader, GL_LINK_STATUS, &ok);
-        if (!ok) {
-            char buf[1024]; glGetProgramInfoLog(screenFragmentShader, 1024, NULL, buf);
-            std::cerr << "LINK ERROR: " << buf << std::endl;
+        if (resolvedScene != sceneTarget)
+            resolveRenderTarget(*sceneTarget, *resolvedScene);
+        postProcess.execute(*resolvedScene, context.presentFramebuffer);
+        if (benchmark) profiler.endPass(PassPostProcess);
+
+        contextPresent(context);
+        contextPollEvents(context);
+        if (benchmark) profiler.endFrame();
+        ++frameCount;
+        ++totalFrames;
+
+        //Instance sweep: record this count, then start over with the next one
+        if (sweepInstances && frameCount == frameLimit && sweepStep + 1 < instanceCounts.size()) {
+            profiler.finish();
+            sweepRuns.push_back(profiler.summarize(instanceCounts[sweepStep]));
+            profiler.reset();
+            cubeInstances.upload(layoutCubeInstances(instanceCounts[++sweepStep]));
+            frameCount = 0;
         }
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    double loopSeconds = contextGetTime(context) - loopStart;
+    if (totalFrames > 0 && loopSeconds > 0.0)
+        std::cout << totalFrames << " frames in " << loopSeconds << " s (" << totalFrames / loopSeconds << " fps)\n";
+    if (sweepInstances) {
+        profiler.finish();
+        sweepRuns.push_back(profiler.summarize(instanceCounts[sweepStep]));
+        printSweepResults("instances", sweepRuns);
+        if (!benchmarkOut.empty())
+            writeSweepResults(benchmarkOut, "instances", sweepRuns);
+    }
+    else if (benchmark) {
+        profiler.finish();
+        profiler.printSummary();
+        std::cout << "Render targets: " << framebuffers.allocatedBytes() / (1024.0 * 1024.0) << " MiB ("
+                  << framebuffers.transientCount() << " pooled)\n";
+        if (!benchmarkOut.empty())
+            profiler.writeResults(benchmarkOut);
     }
 
     // Cleanup
-    glDeleteRenderbuffers(1, &rboDepthStencil);
-    glDeleteTextures(1, &texColorBuffer);
-    glDeleteFramebuffers(1, &frameBuffer);
+    framebuffers.destroy();
 
+    textureStreamer.destroy();
     glDeleteTextures(1, &texKitten);
     glDeleteTextures(1, &texPuppy);
 
-    glDeleteProgram(screenShaderProgram);
-    glDeleteShader(screenFragmentShader);
-    glDeleteShader(screenVertexShader);
-
-    glDeleteProgram(sceneShaderProgram);
-    glDeleteShader(sceneFragmentShader);
-    glDeleteShader(sceneVertexShader);
-    glDeleteShader(gridVertexShader);
-    glDeleteShader(gridFragmentShader);
+    frameUniforms.destroy();
+    postProcess.destroy();
+    cubeInstances.destroy();
+    sceneShaderProgram.destroy();
+    gridShaderProgram.destroy();
 
-    glDeleteBuffers(1, &vboCube);
-    glDeleteBuffers(1, &vboQuad);
+    sceneMeshBuffer.destroy();
 
     glDeleteVertexArrays(1, &vaoCube);
-    glDeleteVertexArrays(1, &vaoQuad);
+    glDeleteVertexArrays(1, &vaoCubeSingle);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    destroyRenderContext(context);
     return 0;
 }
 /*
@@ -712,37 +770,51 @@ int main() {
     Include headers for OpenGL, GLFW, GLEW, GLM, SOIL, and Windows.
 2) Initialization
     Start a timer with std::chrono
-    Initialize GLFW and request an OpenGL 3.3 core profile context
-        Create a window and make its OpenGL context current
+    Pick a context backend from the command line (RenderContext.cpp)
+        Window: initialize GLFW, request an OpenGL 3.3 core profile context, create a window and make it current
+        Surfaceless (EGL): create a windowless 3.3 core context and an offscreen framebuffer to present into
     Initialize GLEW for OpenGL extension management
     
     Enable depth testing (GL_DEPTH_TEST) and stencil testing (GL_STENCIL_TEST
 3) Vertex Data
    Define vertex data for a cube and a floor (position, color, texture coordinates
+   Weld duplicate vertices into one indexed mesh with 16-bit indices, triangles ordered for the vertex cache (Mesh.cpp).
    Generate VAOs (vertex array object) and bind it.
-   Generate VBOs (vertex buffer object), bind it, and upload vertex data.
- (element buffer object), bind it, and upload element indices (not used in drawing).
+   Upload the vertices packed to 16 bytes (half-float position, byte color, 16-bit texcoords) and the element buffer.
 4) Shaders
     Write and compile our vertex shaders (handles positions, colors, and matrices).
-		For scene vs. screen, and from various objects (grid lines) to our cubes shaders
+		For the scene, from various objects (grid lines) to our cubes shaders; post-process programs are built per pass
     Write and compile our fragment shaders (mixes two textures and outputs color).
         same as above
-    Link shaders into a shader program and check for errors.
+    Link shaders into a shader program and check for errors once (ShaderProgram.cpp).
+        Every active uniform and attribute is recorded at link time, the render loop only uses cached locations.
     Get attribute locations (position, color, texcoord) and configure them with glVertexAttribPointer.
     Enable vertex attributes in the VAO.
 5) Textures
-    Load two textures (cat.png, puppy.png) with SOIL, bind them to texture units 0 and 1, and set parameters.
+    Request two textures (cat.png, puppy.png) from TextureStreamer.cpp: worker threads decode them with stb_image while
+        the scene renders with a white placeholder, and once per frame finished images are uploaded through
+        double-buffered pixel unpack buffers. Bind them to texture units 0 and 1.
+    Allocate the scene render target (color, depth/stencil; RGBA16F with --hdr, multisampled with --msaa) through
+        FramebufferManager.cpp, which reallocates screen-sized targets on resize and pools the post-process intermediates.
 6) Transformations
-    Get uniform locations (model, view, proj, overrideColor) and upload view/projection matrices.
+    Get uniform locations (model, overrideColor) and create the FrameData uniform buffer (view, proj, viewProj, camera position, time)
+        shared by the scene and grid programs through one binding point.
 7) Main loop: drawing, clearing, updating
     Enter the main render loop:
         Clear color, depth, and stencil buffers.
         Update the model matrix to rotate the cube over time.
-        Draw the cube (glDrawArrays with 36 vertices).
+        All scene geometry is drawn with glDrawElements(Instanced) from the shared element buffer.
+        Draw the cubes, one glDrawElementsInstanced call (drawMeshRange) reading per-cube model matrices and tints from the instance buffer
+            (CubeInstances.cpp); --draw-mode=loop draws them one call at a time for comparison.
         Draw Reflection Quad
         Draw grid lines
         Configure stencil buffer, draw the floor, then draw the cube’s reflection with inverted Z and darker color.
+        Post-process into the default framebuffer (PostProcess.cpp): the effect chain is split into passes, invert/greyscale
+            are merged into the pass before them, each pass uses a program compiled for just its effects, and passes
+            ping-pong between two targets. Blur is a separable Gaussian (GaussianBlur.cpp, optionally at half/quarter resolution).
+            With no effects the scene is simply blitted.
         Swap buffers and poll for input events.
+        In benchmark mode a scripted camera replaces input and FrameProfiler times each pass.
 8) Clean Up
     delete shaders, program, buffers, VAO, and destroy the window.
     Terminate GLFW and exit.
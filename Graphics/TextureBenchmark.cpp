@@ -0,0 +1,135 @@
+#include "TextureBenchmark.h"
+#include <image_DXT.h>
+#include <stb_image_aug.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+struct DxtVariant
+{
+    const char* name;
+    int threads;
+    int useSimd;
+};
+
+static const DxtVariant dxtVariants[] = {
+    { "scalar, 1 thread", 1, 0 },
+    { "simd, 1 thread", 1, 1 },
+    { "simd, all cores", 0, 1 }
+};
+
+//Smooth gradients with some noise on top, roughly what photos and painted textures give the endpoint search
+static std::vector<unsigned char> generateImage(int width, int height)
+{
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    unsigned seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            unsigned char* p = &pixels[((size_t)y * width + x) * 4];
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 28) - 8;
+            p[0] = (unsigned char)std::min(std::max(x * 255 / width + noise, 0), 255);
+            p[1] = (unsigned char)std::min(std::max(y * 255 / height - noise, 0), 255);
+            p[2] = (unsigned char)(((x / 64) ^ (y / 64)) & 1 ? 200 : 40);
+            p[3] = (unsigned char)((x + y) & 255);
+        }
+    }
+    return pixels;
+}
+
+bool runDxtBenchmark(const char* imagePath, int iterations)
+{
+    int width = 2048, height = 2048;
+    std::vector<unsigned char> rgba;
+    if (imagePath) {
+        int channels = 0;
+        unsigned char* pixels = stbi_load(imagePath, &width, &height, &channels, 4);
+        if (!pixels) {
+            std::cerr << "Failed to load " << imagePath << ": " << stbi_failure_reason() << std::endl;
+            return false;
+        }
+        rgba.assign(pixels, pixels + (size_t)width * height * 4);
+        stbi_image_free(pixels);
+    }
+    else {
+        rgba = generateImage(width, height);
+    }
+    std::vector<unsigned char> rgb((size_t)width * height * 3);
+    for (size_t i = 0; i < (size_t)width * height; ++i)
+        memcpy(&rgb[i * 3], &rgba[i * 4], 3);
+
+    if (iterations < 1)
+        iterations = 1;
+    double megapixels = (double)width * height / 1e6;
+    std::cout << "DXT compression and decoding of " << width << "x" << height << ", best of " << iterations << "\n";
+    bool matches = true;
+    for (int format = 0; format < 2; ++format) {
+        bool dxt5 = format == 1;
+        std::vector<unsigned char> reference;
+        for (const DxtVariant& variant : dxtVariants) {
+            set_DXT_compression_options(variant.threads, variant.useSimd);
+            double best = 0.0;
+            std::vector<unsigned char> output;
+            for (int i = 0; i < iterations; ++i) {
+                int size = 0;
+                auto start = std::chrono::steady_clock::now();
+                unsigned char* compressed = dxt5 ? convert_image_to_DXT5(rgba.data(), width, height, 4, &size)
+                                                 : convert_image_to_DXT1(rgb.data(), width, height, 3, &size);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (!compressed) {
+                    std::cerr << "DXT" << (dxt5 ? "5" : "1") << " compression failed (" << variant.name << ")" << std::endl;
+                    set_DXT_compression_options(0, 1);
+                    return false;
+                }
+                if (i == 0 || seconds < best)
+                    best = seconds;
+                output.assign(compressed, compressed + size);
+                stbi_image_free(compressed);
+            }
+            if (reference.empty())
+                reference = output;
+            bool same = output == reference;
+            matches = matches && same;
+            std::cout << "  " << (dxt5 ? "DXT5 " : "DXT1 ") << std::left << std::setw(18) << variant.name << std::right
+                      << std::fixed << std::setprecision(1) << std::setw(8) << megapixels / best << " MPix/s"
+                      << (same ? "" : "  (output differs!)") << "\n";
+        }
+
+        //Decoding the same blocks back, the fallback for drivers without S3TC
+        std::vector<unsigned char> decodedReference;
+        for (const DxtVariant& variant : dxtVariants) {
+            set_DXT_compression_options(variant.threads, variant.useSimd);
+            double best = 0.0;
+            std::vector<unsigned char> output;
+            for (int i = 0; i < iterations; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                unsigned char* decoded = convert_DDS_format_to_image(reference.data(), width, height,
+                                                                     dxt5 ? DDS_FORMAT_DXT5 : DDS_FORMAT_DXT1);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (!decoded) {
+                    std::cerr << "DXT" << (dxt5 ? "5" : "1") << " decoding failed (" << variant.name << ")" << std::endl;
+                    set_DXT_compression_options(0, 1);
+                    return false;
+                }
+                if (i == 0 || seconds < best)
+                    best = seconds;
+                output.assign(decoded, decoded + (size_t)width * height * 4);
+                stbi_image_free(decoded);
+            }
+            if (decodedReference.empty())
+                decodedReference = output;
+            bool same = output == decodedReference;
+            matches = matches && same;
+            std::cout << "  " << (dxt5 ? "DXT5 decode " : "DXT1 decode ") << std::left << std::setw(18) << variant.name << std::right
+                      << std::fixed << std::setprecision(1) << std::setw(8) << megapixels / best << " MPix/s"
+                      << (same ? "" : "  (output differs!)") << "\n";
+        }
+    }
+    //Back to the defaults for anything that compresses afterwards
+    set_DXT_compression_options(0, 1);
+    return matches;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+//Times SOIL's DXT1/DXT5 compressors and decoders on one image (or a generated 2048x2048 one when imagePath is null)
+//in MPix/s: the plain C block code on one thread, the SSE2 one on one thread, and the SSE2 one on every core.
+//Every variant's output is checked against the plain one. Returns false if the image can't be loaded or they differ
+bool runDxtBenchmark(const char* imagePath, int iterations);
@@ -0,0 +1,160 @@
+#include "TextureStreamer.h"
+#include <stb_image_aug.h>
+#include <cstring>
+#include <iostream>
+
+//Shown until the image lands, and for good if it never does (batch nodes don't always ship the texture folder)
+//Multiplying by white leaves the scene colors alone
+static void setPlaceholder(GLuint texture)
+{
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void TextureStreamer::start(unsigned workerCount)
+{
+    stopping = false;
+    if (workerCount == 0)
+        workerCount = 1;
+    for (unsigned i = 0; i < workerCount; ++i)
+        workers.emplace_back(&TextureStreamer::workerLoop, this);
+    glGenBuffers(2, unpackBuffers);
+}
+
+void TextureStreamer::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+
+    for (Job& job : decodeQueue)
+        stbi_image_free(job.pixels);
+    for (Job& job : completionQueue)
+        stbi_image_free(job.pixels);
+    decodeQueue.clear();
+    completionQueue.clear();
+    inFlight = 0;
+
+    glDeleteBuffers(2, unpackBuffers);
+    unpackBuffers[0] = unpackBuffers[1] = 0;
+}
+
+GLuint TextureStreamer::request(const char* path)
+{
+    Job job;
+    glGenTextures(1, &job.texture);
+    setPlaceholder(job.texture);
+    job.path = path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decodeQueue.push_back(job);
+        ++inFlight;
+    }
+    jobAdded.notify_one();
+    return job.texture;
+}
+
+void TextureStreamer::workerLoop()
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return stopping || !decodeQueue.empty(); });
+            if (stopping)
+                return;
+            job = decodeQueue.front();
+            decodeQueue.pop_front();
+        }
+
+        //Always four channels: rows stay 4-byte aligned whatever the width, and the PBO copy is one memcpy
+        int channels = 0;
+        job.pixels = stbi_load(job.path.c_str(), &job.width, &job.height, &channels, 4);
+        if (!job.pixels)
+            std::cerr << "Failed to load texture " << job.path << ": " << stbi_failure_reason() << std::endl;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completionQueue.push_back(job);
+        }
+        jobDecoded.notify_all();
+    }
+}
+
+void TextureStreamer::upload(const Job& job)
+{
+    size_t size = (size_t)job.width * job.height * 4;
+    GLuint buffer = unpackBuffers[nextUnpackBuffer];
+    nextUnpackBuffer ^= 1;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    //Orphan the old storage so mapping never waits for a transfer the driver hasn't finished
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        memcpy(mapped, job.pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, job.width, job.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    }
+    else {
+        std::cerr << "Failed to map the texture upload buffer for " << job.path << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::pump(size_t uploadBudget)
+{
+    size_t uploaded = 0;
+    bool first = true;
+    for (;;) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (completionQueue.empty())
+                return;
+            job = completionQueue.front();
+            //One big image may blow the budget, but it must not wait forever either
+            if (!first && uploaded + (size_t)job.width * job.height * 4 > uploadBudget)
+                return;
+            completionQueue.pop_front();
+            --inFlight;
+        }
+        first = false;
+        //Failed decodes keep their placeholder
+        if (job.pixels) {
+            upload(job);
+            uploaded += (size_t)job.width * job.height * 4;
+            stbi_image_free(job.pixels);
+        }
+    }
+}
+
+void TextureStreamer::finishAll()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (inFlight == 0)
+                return;
+            jobDecoded.wait(lock, [this] { return !completionQueue.empty(); });
+        }
+        pump((size_t)-1);
+    }
+}
+
+size_t TextureStreamer::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return inFlight;
+}
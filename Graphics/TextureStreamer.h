@@ -0,0 +1,57 @@
+#pragma once
+#include "RenderContext.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Loads textures without stalling the render thread
+//request() hands out a texture right away, showing a white placeholder texel; worker threads decode the file
+//(PNG/JPEG/TGA/BMP/DDS through stb_image_aug) and pump(), called once per frame, uploads finished images
+//through two alternating pixel unpack buffers into the same texture name
+class TextureStreamer
+{
+public:
+    //At least one worker is started
+    void start(unsigned workerCount);
+    //Joins the workers and frees the upload buffers, textures handed out by request() belong to the caller
+    void destroy();
+
+    GLuint request(const char* path);
+
+    //Uploads decoded images until uploadBudget bytes have been copied this call (always at least one image)
+    //Must run on the thread that owns the GL context
+    void pump(size_t uploadBudget);
+    //Decodes and uploads everything requested so far before returning, for runs that must not see placeholders
+    void finishAll();
+
+    size_t pending() const;
+
+private:
+    struct Job
+    {
+        GLuint texture = 0;
+        std::string path;
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    void workerLoop();
+    void upload(const Job& job);
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDecoded;
+    std::deque<Job> decodeQueue;
+    std::deque<Job> completionQueue;
+    size_t inFlight = 0;
+    bool stopping = false;
+
+    //Filling one buffer while the driver may still be copying out of the other keeps the memcpy from waiting
+    GLuint unpackBuffers[2] = { 0, 0 };
+    int nextUnpackBuffer = 0;
+};
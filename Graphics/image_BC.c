@@ -0,0 +1,1195 @@
+/*
+	BC4 / BC5 / BC6H / BC7 block compression
+	(RGTC and BPTC in OpenGL terms)
+
+	Only the single subset / single region modes are used:
+	BC7 modes 6 and 5, BC6H modes 11 and 12.  They need no
+	partition tables and are what most fast encoders lean on,
+	the partitioned modes would only help blocks with two
+	unrelated colors in them.  The BC7 decoder at the end
+	reads every mode, it is the fallback for drivers without
+	BPTC.
+
+	public domain
+*/
+
+#include <image_BC.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*	interpolation weights, out of 64	*/
+static const int BC_weights2[4] = { 0, 21, 43, 64 };
+static const int BC_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/*	packs fields LSB first, the output must start zeroed	*/
+typedef struct
+{
+	unsigned char *data;
+	int position;
+}
+BC_bit_writer;
+
+static void write_bits( BC_bit_writer *writer, unsigned int value, int count )
+{
+	int i;
+	for( i = 0; i < count; ++i, ++writer->position )
+	{
+		writer->data[writer->position >> 3] |= ((value >> i) & 1) << (writer->position & 7);
+	}
+}
+
+static int clamp_int( int x, int lo, int hi )
+{
+	return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+/*
+	The mean and the direction of greatest variance of 16 texels,
+	by power iteration on the covariance matrix
+*/
+static void
+	principal_axis
+	(
+		const float texels[16][4], int channels,
+		float mean[4], float axis[4]
+	)
+{
+	float cov[4][4];
+	float length;
+	int i, j, k, iteration;
+	for( j = 0; j < channels; ++j )
+	{
+		mean[j] = 0.0f;
+		for( i = 0; i < 16; ++i )
+		{
+			mean[j] += texels[i][j];
+		}
+		mean[j] *= 1.0f / 16.0f;
+	}
+	for( j = 0; j < channels; ++j )
+	{
+		for( k = j; k < channels; ++k )
+		{
+			float sum = 0.0f;
+			for( i = 0; i < 16; ++i )
+			{
+				sum += (texels[i][j] - mean[j]) * (texels[i][k] - mean[k]);
+			}
+			cov[j][k] = cov[k][j] = sum;
+		}
+	}
+	/*	start away from any axis, so opposing channels can't cancel out	*/
+	for( j = 0; j < channels; ++j )
+	{
+		axis[j] = 1.0f + 0.618f * j;
+	}
+	for( iteration = 0; iteration < 8; ++iteration )
+	{
+		float next[4];
+		length = 0.0f;
+		for( j = 0; j < channels; ++j )
+		{
+			next[j] = 0.0f;
+			for( k = 0; k < channels; ++k )
+			{
+				next[j] += cov[j][k] * axis[k];
+			}
+			length += next[j] * next[j];
+		}
+		if( length < 1e-12f )
+		{
+			/*	a flat block, any direction will do	*/
+			break;
+		}
+		length = 1.0f / (float)sqrt( length );
+		for( j = 0; j < channels; ++j )
+		{
+			axis[j] = next[j] * length;
+		}
+	}
+}
+
+/*	the extremes of the texels projected on the axis	*/
+static void
+	axis_endpoints
+	(
+		const float texels[16][4], int channels,
+		const float mean[4], const float axis[4],
+		float lo, float hi,
+		float e0[4], float e1[4]
+	)
+{
+	float t_min = 1e30f, t_max = -1e30f;
+	int i, j;
+	for( i = 0; i < 16; ++i )
+	{
+		float t = 0.0f;
+		for( j = 0; j < channels; ++j )
+		{
+			t += (texels[i][j] - mean[j]) * axis[j];
+		}
+		if( t < t_min ) { t_min = t; }
+		if( t > t_max ) { t_max = t; }
+	}
+	for( j = 0; j < channels; ++j )
+	{
+		e0[j] = mean[j] + t_min * axis[j];
+		e1[j] = mean[j] + t_max * axis[j];
+		if( e0[j] < lo ) { e0[j] = lo; } else if( e0[j] > hi ) { e0[j] = hi; }
+		if( e1[j] < lo ) { e1[j] = lo; } else if( e1[j] > hi ) { e1[j] = hi; }
+	}
+}
+
+/*
+	Least squares endpoints for fixed indices: minimizes the error of
+	(1-w)*e0 + w*e1 over the block, for each channel at once.
+	Returns 0 if every texel uses the same weight.
+*/
+static int
+	refit_endpoints
+	(
+		const float texels[16][4], int first, int channels,
+		const unsigned char indices[16], const int *weights,
+		float lo, float hi,
+		float e0[4], float e1[4]
+	)
+{
+	float a = 0.0f, b = 0.0f, c = 0.0f, det;
+	float x0[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, x1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	int i, j;
+	for( i = 0; i < 16; ++i )
+	{
+		float w = weights[indices[i]] * (1.0f / 64.0f);
+		a += (1.0f - w) * (1.0f - w);
+		b += (1.0f - w) * w;
+		c += w * w;
+		for( j = 0; j < channels; ++j )
+		{
+			x0[j] += (1.0f - w) * texels[i][first + j];
+			x1[j] += w * texels[i][first + j];
+		}
+	}
+	det = a * c - b * b;
+	if( fabs( det ) < 1e-6f )
+	{
+		return 0;
+	}
+	det = 1.0f / det;
+	for( j = 0; j < channels; ++j )
+	{
+		e0[j] = (c * x0[j] - b * x1[j]) * det;
+		e1[j] = (a * x1[j] - b * x0[j]) * det;
+		if( e0[j] < lo ) { e0[j] = lo; } else if( e0[j] > hi ) { e0[j] = hi; }
+		if( e1[j] < lo ) { e1[j] = lo; } else if( e1[j] > hi ) { e1[j] = hi; }
+	}
+	return 1;
+}
+
+/********* BC4 *********/
+
+static void BC4_palette( int e0, int e1, int palette[8] )
+{
+	int i;
+	palette[0] = e0;
+	palette[1] = e1;
+	if( e0 > e1 )
+	{
+		/*	6 interpolated values	*/
+		for( i = 1; i < 7; ++i )
+		{
+			palette[i+1] = ((7-i)*e0 + i*e1 + 3) / 7;
+		}
+	} else
+	{
+		/*	4 interpolated values, plus exact 0 and 255	*/
+		for( i = 1; i < 5; ++i )
+		{
+			palette[i+1] = ((5-i)*e0 + i*e1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static int
+	BC4_fit
+	(
+		const unsigned char *const values, int stride,
+		int e0, int e1,
+		unsigned char indices[16]
+	)
+{
+	int palette[8];
+	int i, k, error = 0;
+	BC4_palette( e0, e1, palette );
+	for( i = 0; i < 16; ++i )
+	{
+		int v = values[i*stride];
+		int best = 0, best_error = 256*256;
+		for( k = 0; k < 8; ++k )
+		{
+			int d = (v - palette[k]) * (v - palette[k]);
+			if( d < best_error )
+			{
+				best_error = d;
+				best = k;
+			}
+		}
+		indices[i] = (unsigned char)best;
+		error += best_error;
+	}
+	return error;
+}
+
+void
+	compress_BC4_block
+	(
+		const unsigned char *const values, int stride,
+		int quality,
+		unsigned char compressed[8]
+	)
+{
+	unsigned char indices[16], trial[16];
+	int lo = 255, hi = 0, inner_lo = 255, inner_hi = -1;
+	int best_e0, best_e1, best_error;
+	int i;
+	BC_bit_writer writer;
+	for( i = 0; i < 16; ++i )
+	{
+		int v = values[i*stride];
+		if( v < lo ) { lo = v; }
+		if( v > hi ) { hi = v; }
+		/*	0 and 255 come for free in the 6 value mode	*/
+		if( (v > 0) && (v < 255) )
+		{
+			if( v < inner_lo ) { inner_lo = v; }
+			if( v > inner_hi ) { inner_hi = v; }
+		}
+	}
+	/*	8 value mode across the whole range (a flat block ends up in the other mode, exactly)	*/
+	best_e0 = hi;
+	best_e1 = lo;
+	best_error = BC4_fit( values, stride, best_e0, best_e1, indices );
+	if( (quality >= BC_QUALITY_NORMAL) && (best_error > 0) && (inner_hi >= 0) )
+	{
+		int error = BC4_fit( values, stride, inner_lo, inner_hi, trial );
+		if( error < best_error )
+		{
+			best_error = error;
+			best_e0 = inner_lo;
+			best_e1 = inner_hi;
+			memcpy( indices, trial, 16 );
+		}
+	}
+	if( (quality >= BC_QUALITY_SLOW) && (best_error > 0) )
+	{
+		/*	nudge both endpoints around, staying in the same mode	*/
+		const int center0 = best_e0, center1 = best_e1;
+		const int eight_values = center0 > center1;
+		int d0, d1;
+		for( d0 = -3; d0 <= 3; ++d0 )
+		{
+			for( d1 = -3; d1 <= 3; ++d1 )
+			{
+				int e0 = clamp_int( center0 + d0, 0, 255 );
+				int e1 = clamp_int( center1 + d1, 0, 255 );
+				int error;
+				if( (e0 > e1) != eight_values )
+				{
+					continue;
+				}
+				error = BC4_fit( values, stride, e0, e1, trial );
+				if( error < best_error )
+				{
+					best_error = error;
+					best_e0 = e0;
+					best_e1 = e1;
+					memcpy( indices, trial, 16 );
+				}
+			}
+		}
+	}
+	memset( compressed, 0, 8 );
+	compressed[0] = (unsigned char)best_e0;
+	compressed[1] = (unsigned char)best_e1;
+	writer.data = compressed;
+	writer.position = 16;
+	for( i = 0; i < 16; ++i )
+	{
+		write_bits( &writer, indices[i], 3 );
+	}
+}
+
+/********* BC7 *********/
+
+/*
+	Picks the nearest of index_count interpolated colors for every
+	texel (or, for a fast fit, the one its projection on the line is
+	nearest to) and returns the squared error.
+	e0/e1 are the 8 bit endpoints of channels first .. first+channels-1
+*/
+static int
+	BC7_select_indices
+	(
+		const float texels[16][4], int first, int channels,
+		const int *e0, const int *e1,
+		const int *weights, int index_count,
+		int exhaustive,
+		unsigned char indices[16]
+	)
+{
+	int palette[16][4];
+	int i, j, k, error = 0;
+	float line[4], line_scale = 0.0f;
+	for( k = 0; k < index_count; ++k )
+	{
+		for( j = 0; j < channels; ++j )
+		{
+			palette[k][j] = (e0[j] * (64 - weights[k]) + e1[j] * weights[k] + 32) >> 6;
+		}
+	}
+	for( j = 0; j < channels; ++j )
+	{
+		line[j] = (float)(e1[j] - e0[j]);
+		line_scale += line[j] * line[j];
+	}
+	if( line_scale > 0.0f )
+	{
+		line_scale = 1.0f / line_scale;
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		int best = 0, best_error = 0x7FFFFFFF;
+		int first_k = 0, last_k = index_count - 1;
+		if( !exhaustive )
+		{
+			/*	only look next to where the texel projects onto the line	*/
+			float t = 0.0f;
+			int guess;
+			for( j = 0; j < channels; ++j )
+			{
+				t += (texels[i][first + j] - e0[j]) * line[j];
+			}
+			t *= line_scale;
+			guess = clamp_int( (int)(t * (index_count - 1) + 0.5f), 0, index_count - 1 );
+			first_k = (guess > 0) ? guess - 1 : 0;
+			last_k = (guess < index_count - 1) ? guess + 1 : guess;
+		}
+		for( k = first_k; k <= last_k; ++k )
+		{
+			int e = 0;
+			for( j = 0; j < channels; ++j )
+			{
+				int d = (int)texels[i][first + j] - palette[k][j];
+				e += d * d;
+			}
+			if( e < best_error )
+			{
+				best_error = e;
+				best = k;
+			}
+		}
+		indices[i] = (unsigned char)best;
+		error += best_error;
+	}
+	return error;
+}
+
+typedef struct
+{
+	int error;
+	/*	mode 6: 7 bit RGBA endpoints and a p-bit each	*/
+	int q[2][4];
+	int p[2];
+	/*	mode 5: 7 bit RGB, 8 bit alpha endpoints	*/
+	int rotation;
+	unsigned char indices[16];
+	unsigned char alpha_indices[16];
+}
+BC7_fit;
+
+static void BC7_mode6_quantize( const float e[4], int p, int q[4], int expanded[4] )
+{
+	int j;
+	for( j = 0; j < 4; ++j )
+	{
+		q[j] = clamp_int( (int)floor( (e[j] - p) * 0.5f + 0.5f ), 0, 127 );
+		expanded[j] = (q[j] << 1) | p;
+	}
+}
+
+/*	tries every p-bit pair for these (unquantized) endpoints, keeps the best in fit	*/
+static void
+	BC7_mode6_try
+	(
+		const float texels[16][4],
+		const float e0[4], const float e1[4],
+		int quality,
+		BC7_fit *fit
+	)
+{
+	int p0, p1;
+	for( p0 = 0; p0 < 2; ++p0 )
+	{
+		for( p1 = 0; p1 < 2; ++p1 )
+		{
+			int q0[4], q1[4], x0[4], x1[4];
+			unsigned char indices[16];
+			int error;
+			if( quality == BC_QUALITY_FAST )
+			{
+				/*	just take the p-bit that suits each endpoint's alpha best	*/
+				if( (p0 != (clamp_int( (int)(e0[3] + 0.5f), 0, 255 ) & 1)) ||
+					(p1 != (clamp_int( (int)(e1[3] + 0.5f), 0, 255 ) & 1)) )
+				{
+					continue;
+				}
+			}
+			BC7_mode6_quantize( e0, p0, q0, x0 );
+			BC7_mode6_quantize( e1, p1, q1, x1 );
+			error = BC7_select_indices( texels, 0, 4, x0, x1, BC_weights4, 16,
+					quality != BC_QUALITY_FAST, indices );
+			if( error < fit->error )
+			{
+				fit->error = error;
+				memcpy( fit->q[0], q0, sizeof(q0) );
+				memcpy( fit->q[1], q1, sizeof(q1) );
+				fit->p[0] = p0;
+				fit->p[1] = p1;
+				memcpy( fit->indices, indices, 16 );
+			}
+		}
+	}
+}
+
+static void
+	BC7_mode6_fit
+	(
+		const float texels[16][4],
+		int quality,
+		BC7_fit *fit
+	)
+{
+	float mean[4], axis[4], e0[4], e1[4];
+	int iteration, iterations = (quality == BC_QUALITY_SLOW) ? 3 : ((quality == BC_QUALITY_NORMAL) ? 1 : 0);
+	fit->error = 0x7FFFFFFF;
+	principal_axis( texels, 4, mean, axis );
+	axis_endpoints( texels, 4, mean, axis, 0.0f, 255.0f, e0, e1 );
+	BC7_mode6_try( texels, e0, e1, quality, fit );
+	for( iteration = 0; (iteration < iterations) && (fit->error > 0); ++iteration )
+	{
+		if( !refit_endpoints( texels, 0, 4, fit->indices, BC_weights4, 0.0f, 255.0f, e0, e1 ) )
+		{
+			break;
+		}
+		BC7_mode6_try( texels, e0, e1, quality, fit );
+	}
+}
+
+static int BC7_expand7( int q )
+{
+	return (q << 1) | (q >> 6);
+}
+
+/*	mode 5 with one rotation: RGB on a 2 bit line, alpha on its own 2 bit line	*/
+static void
+	BC7_mode5_fit
+	(
+		const float rotated[16][4],
+		int rotation,
+		BC7_fit *fit
+	)
+{
+	float mean[4], axis[4], e0[4], e1[4];
+	float alpha_lo = 255.0f, alpha_hi = 0.0f;
+	int q0[4], q1[4], x0[4], x1[4];
+	unsigned char indices[16], alpha_indices[16];
+	int i, j, error, alpha_error, iteration;
+	principal_axis( rotated, 3, mean, axis );
+	axis_endpoints( rotated, 3, mean, axis, 0.0f, 255.0f, e0, e1 );
+	for( i = 0; i < 16; ++i )
+	{
+		if( rotated[i][3] < alpha_lo ) { alpha_lo = rotated[i][3]; }
+		if( rotated[i][3] > alpha_hi ) { alpha_hi = rotated[i][3]; }
+	}
+	/*	alpha endpoints keep all 8 bits	*/
+	x0[3] = q0[3] = (int)alpha_lo;
+	x1[3] = q1[3] = (int)alpha_hi;
+	alpha_error = BC7_select_indices( rotated, 3, 1, x0 + 3, x1 + 3, BC_weights2, 4, 1, alpha_indices );
+	if( alpha_error > 0 )
+	{
+		float a0[4], a1[4];
+		if( refit_endpoints( rotated, 3, 1, alpha_indices, BC_weights2, 0.0f, 255.0f, a0, a1 ) )
+		{
+			int y0 = (int)(a0[0] + 0.5f), y1 = (int)(a1[0] + 0.5f);
+			unsigned char trial[16];
+			int trial_error = BC7_select_indices( rotated, 3, 1, &y0, &y1, BC_weights2, 4, 1, trial );
+			if( trial_error < alpha_error )
+			{
+				alpha_error = trial_error;
+				q0[3] = y0;
+				q1[3] = y1;
+				memcpy( alpha_indices, trial, 16 );
+			}
+		}
+	}
+	error = 0x7FFFFFFF;
+	for( iteration = 0; iteration < 3; ++iteration )
+	{
+		int t0[3], t1[3], y0[3], y1[3];
+		unsigned char trial[16];
+		int trial_error;
+		for( j = 0; j < 3; ++j )
+		{
+			t0[j] = clamp_int( (int)(e0[j] * 127.0f / 255.0f + 0.5f), 0, 127 );
+			t1[j] = clamp_int( (int)(e1[j] * 127.0f / 255.0f + 0.5f), 0, 127 );
+			y0[j] = BC7_expand7( t0[j] );
+			y1[j] = BC7_expand7( t1[j] );
+		}
+		trial_error = BC7_select_indices( rotated, 0, 3, y0, y1, BC_weights2, 4, 1, trial );
+		if( trial_error < error )
+		{
+			error = trial_error;
+			memcpy( q0, t0, sizeof(t0) );
+			memcpy( q1, t1, sizeof(t1) );
+			memcpy( indices, trial, 16 );
+		}
+		if( (error == 0) ||
+			!refit_endpoints( rotated, 0, 3, indices, BC_weights2, 0.0f, 255.0f, e0, e1 ) )
+		{
+			break;
+		}
+	}
+	if( error + alpha_error < fit->error )
+	{
+		fit->error = error + alpha_error;
+		memcpy( fit->q[0], q0, sizeof(q0) );
+		memcpy( fit->q[1], q1, sizeof(q1) );
+		fit->rotation = rotation;
+		memcpy( fit->indices, indices, 16 );
+		memcpy( fit->alpha_indices, alpha_indices, 16 );
+	}
+}
+
+void
+	compress_BC7_block
+	(
+		const unsigned char *const rgba,
+		int quality,
+		unsigned char compressed[16]
+	)
+{
+	float texels[16][4];
+	BC7_fit mode6, mode5;
+	BC_bit_writer writer;
+	int i, j;
+	for( i = 0; i < 16; ++i )
+	{
+		for( j = 0; j < 4; ++j )
+		{
+			texels[i][j] = rgba[i*4 + j];
+		}
+	}
+	BC7_mode6_fit( texels, quality, &mode6 );
+	mode5.error = 0x7FFFFFFF;
+	mode5.rotation = 0;
+	if( (quality >= BC_QUALITY_SLOW) && (mode6.error > 0) )
+	{
+		/*	rotation r swaps alpha with channel r-1 (the decoder swaps it back)	*/
+		int rotation;
+		for( rotation = 0; rotation < 4; ++rotation )
+		{
+			float rotated[16][4];
+			memcpy( rotated, texels, sizeof(texels) );
+			if( rotation > 0 )
+			{
+				for( i = 0; i < 16; ++i )
+				{
+					float swap = rotated[i][rotation - 1];
+					rotated[i][rotation - 1] = rotated[i][3];
+					rotated[i][3] = swap;
+				}
+			}
+			BC7_mode5_fit( rotated, rotation, &mode5 );
+		}
+	}
+	memset( compressed, 0, 16 );
+	writer.data = compressed;
+	writer.position = 0;
+	if( mode5.error < mode6.error )
+	{
+		/*	the first index of each set has an implied 0 top bit	*/
+		if( mode5.indices[0] & 2 )
+		{
+			for( j = 0; j < 3; ++j )
+			{
+				int swap = mode5.q[0][j];
+				mode5.q[0][j] = mode5.q[1][j];
+				mode5.q[1][j] = swap;
+			}
+			for( i = 0; i < 16; ++i )
+			{
+				mode5.indices[i] = 3 - mode5.indices[i];
+			}
+		}
+		if( mode5.alpha_indices[0] & 2 )
+		{
+			int swap = mode5.q[0][3];
+			mode5.q[0][3] = mode5.q[1][3];
+			mode5.q[1][3] = swap;
+			for( i = 0; i < 16; ++i )
+			{
+				mode5.alpha_indices[i] = 3 - mode5.alpha_indices[i];
+			}
+		}
+		write_bits( &writer, 1 << 5, 6 );
+		write_bits( &writer, mode5.rotation, 2 );
+		for( j = 0; j < 3; ++j )
+		{
+			write_bits( &writer, mode5.q[0][j], 7 );
+			write_bits( &writer, mode5.q[1][j], 7 );
+		}
+		write_bits( &writer, mode5.q[0][3], 8 );
+		write_bits( &writer, mode5.q[1][3], 8 );
+		for( i = 0; i < 16; ++i )
+		{
+			write_bits( &writer, mode5.indices[i], (i == 0) ? 1 : 2 );
+		}
+		for( i = 0; i < 16; ++i )
+		{
+			write_bits( &writer, mode5.alpha_indices[i], (i == 0) ? 1 : 2 );
+		}
+		return;
+	}
+	if( mode6.indices[0] & 8 )
+	{
+		int swap;
+		for( j = 0; j < 4; ++j )
+		{
+			swap = mode6.q[0][j];
+			mode6.q[0][j] = mode6.q[1][j];
+			mode6.q[1][j] = swap;
+		}
+		swap = mode6.p[0];
+		mode6.p[0] = mode6.p[1];
+		mode6.p[1] = swap;
+		for( i = 0; i < 16; ++i )
+		{
+			mode6.indices[i] = 15 - mode6.indices[i];
+		}
+	}
+	write_bits( &writer, 1 << 6, 7 );
+	for( j = 0; j < 4; ++j )
+	{
+		write_bits( &writer, mode6.q[0][j], 7 );
+		write_bits( &writer, mode6.q[1][j], 7 );
+	}
+	write_bits( &writer, mode6.p[0], 1 );
+	write_bits( &writer, mode6.p[1], 1 );
+	for( i = 0; i < 16; ++i )
+	{
+		write_bits( &writer, mode6.indices[i], (i == 0) ? 3 : 4 );
+	}
+}
+
+/********* BC6H *********/
+
+/*	bits of the nearest half float, for values in [0, 65504]	*/
+static int BC6H_half_bits( float f )
+{
+	union { float f; unsigned int u; } v;
+	int exponent, half;
+	unsigned int mantissa;
+	if( !(f > 0.0f) )
+	{
+		/*	negatives and NaN	*/
+		return 0;
+	}
+	if( f >= 65504.0f )
+	{
+		return 0x7BFF;
+	}
+	v.f = f;
+	exponent = (int)((v.u >> 23) & 255) - 127 + 15;
+	mantissa = v.u & 0x7FFFFF;
+	if( exponent <= 0 )
+	{
+		/*	a half denormal	*/
+		int shift = 14 - exponent;
+		if( shift > 24 )
+		{
+			return 0;
+		}
+		mantissa |= 0x800000;
+		half = (int)(mantissa >> shift);
+		if( (mantissa >> (shift - 1)) & 1 )
+		{
+			++half;
+		}
+		return half;
+	}
+	half = (exponent << 10) | (int)(mantissa >> 13);
+	if( mantissa & 0x1000 )
+	{
+		/*	a carry into the exponent is still the right answer	*/
+		++half;
+	}
+	return (half > 0x7BFF) ? 0x7BFF : half;
+}
+
+/*	an endpoint of the given precision in the 16 bit interpolation space (unsigned)	*/
+static int BC6H_unquantize( int e, int bits )
+{
+	if( e == 0 )
+	{
+		return 0;
+	}
+	if( e == (1 << bits) - 1 )
+	{
+		return 0xFFFF;
+	}
+	return ((e << 16) + 0x8000) >> bits;
+}
+
+static int BC6H_quantize( float target, int bits )
+{
+	int e = clamp_int( (int)(target * (1 << bits) / 65536.0f), 0, (1 << bits) - 1 );
+	int best = e, best_distance = 0x7FFFFFFF, k;
+	for( k = e - 1; k <= e + 1; ++k )
+	{
+		int distance;
+		if( (k < 0) || (k >= (1 << bits)) )
+		{
+			continue;
+		}
+		distance = abs( BC6H_unquantize( k, bits ) - (int)target );
+		if( distance < best_distance )
+		{
+			best_distance = distance;
+			best = k;
+		}
+	}
+	return best;
+}
+
+typedef struct
+{
+	double error;
+	int bits;
+	int e[2][3];
+	unsigned char indices[16];
+}
+BC6H_fit;
+
+/*
+	Squared error, in half float bits, of the best index per texel for these
+	quantized endpoints.  halves are the texels' own half float bits
+*/
+static double
+	BC6H_select_indices
+	(
+		const int halves[16][3],
+		const int e0[3], const int e1[3], int bits,
+		unsigned char indices[16]
+	)
+{
+	int palette[16][3];
+	int i, j, k;
+	double error = 0.0;
+	for( j = 0; j < 3; ++j )
+	{
+		int u0 = BC6H_unquantize( e0[j], bits ), u1 = BC6H_unquantize( e1[j], bits );
+		for( k = 0; k < 16; ++k )
+		{
+			int interpolated = (u0 * (64 - BC_weights4[k]) + u1 * BC_weights4[k] + 32) >> 6;
+			palette[k][j] = (interpolated * 31) >> 6;
+		}
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		int best = 0;
+		double best_error = 1e30;
+		for( k = 0; k < 16; ++k )
+		{
+			double e = 0.0;
+			for( j = 0; j < 3; ++j )
+			{
+				double d = halves[i][j] - palette[k][j];
+				e += d * d;
+			}
+			if( e < best_error )
+			{
+				best_error = e;
+				best = k;
+			}
+		}
+		indices[i] = (unsigned char)best;
+		error += best_error;
+	}
+	return error;
+}
+
+static void
+	BC6H_try
+	(
+		const int halves[16][3],
+		const float e0[4], const float e1[4], int bits,
+		BC6H_fit *fit
+	)
+{
+	int q0[3], q1[3], j;
+	unsigned char indices[16];
+	double error;
+	for( j = 0; j < 3; ++j )
+	{
+		q0[j] = BC6H_quantize( e0[j], bits );
+		q1[j] = BC6H_quantize( e1[j], bits );
+	}
+	if( bits == 11 )
+	{
+		/*	mode 12 stores the second endpoint as a 9 bit signed delta	*/
+		for( j = 0; j < 3; ++j )
+		{
+			if( (q1[j] - q0[j] < -256) || (q1[j] - q0[j] > 255) ||
+				(q0[j] - q1[j] < -256) || (q0[j] - q1[j] > 255) )
+			{
+				return;
+			}
+		}
+	}
+	error = BC6H_select_indices( halves, q0, q1, bits, indices );
+	if( error < fit->error )
+	{
+		fit->error = error;
+		fit->bits = bits;
+		memcpy( fit->e[0], q0, sizeof(q0) );
+		memcpy( fit->e[1], q1, sizeof(q1) );
+		memcpy( fit->indices, indices, 16 );
+	}
+}
+
+void
+	compress_BC6H_block
+	(
+		const float *const rgb,
+		int quality,
+		unsigned char compressed[16]
+	)
+{
+	/*	texels live in the 16 bit interpolation space: half bits * 64/31	*/
+	float texels[16][4];
+	int halves[16][3];
+	float mean[4], axis[4], e0[4], e1[4];
+	BC6H_fit fit;
+	BC_bit_writer writer;
+	int i, j, bits, iteration;
+	int iterations = (quality == BC_QUALITY_SLOW) ? 3 : ((quality == BC_QUALITY_NORMAL) ? 1 : 0);
+	for( i = 0; i < 16; ++i )
+	{
+		for( j = 0; j < 3; ++j )
+		{
+			halves[i][j] = BC6H_half_bits( rgb[i*3 + j] );
+			texels[i][j] = halves[i][j] * (64.0f / 31.0f);
+		}
+		texels[i][3] = 0.0f;
+	}
+	fit.error = 1e30;
+	fit.bits = 10;
+	principal_axis( texels, 3, mean, axis );
+	for( bits = 10; bits <= ((quality == BC_QUALITY_SLOW) ? 11 : 10); ++bits )
+	{
+		axis_endpoints( texels, 3, mean, axis, 0.0f, 65535.0f, e0, e1 );
+		BC6H_try( halves, e0, e1, bits, &fit );
+		for( iteration = 0; (iteration < iterations) && (fit.error > 0); ++iteration )
+		{
+			if( !refit_endpoints( texels, 0, 3, fit.indices, BC_weights4, 0.0f, 65535.0f, e0, e1 ) )
+			{
+				break;
+			}
+			BC6H_try( halves, e0, e1, bits, &fit );
+		}
+	}
+	/*	the first index has an implied 0 top bit	*/
+	if( fit.indices[0] & 8 )
+	{
+		for( j = 0; j < 3; ++j )
+		{
+			int swap = fit.e[0][j];
+			fit.e[0][j] = fit.e[1][j];
+			fit.e[1][j] = swap;
+		}
+		for( i = 0; i < 16; ++i )
+		{
+			fit.indices[i] = 15 - fit.indices[i];
+		}
+	}
+	memset( compressed, 0, 16 );
+	writer.data = compressed;
+	writer.position = 0;
+	if( fit.bits == 10 )
+	{
+		/*	mode 11: two plain 10 bit endpoints	*/
+		write_bits( &writer, 0x03, 5 );
+		for( j = 0; j < 3; ++j )
+		{
+			write_bits( &writer, fit.e[0][j], 10 );
+		}
+		for( j = 0; j < 3; ++j )
+		{
+			write_bits( &writer, fit.e[1][j], 10 );
+		}
+	} else
+	{
+		/*	mode 12: an 11 bit endpoint and a 9 bit delta to the other	*/
+		write_bits( &writer, 0x07, 5 );
+		for( j = 0; j < 3; ++j )
+		{
+			write_bits( &writer, fit.e[0][j] & 0x3FF, 10 );
+		}
+		for( j = 0; j < 3; ++j )
+		{
+			write_bits( &writer, (fit.e[1][j] - fit.e[0][j]) & 0x1FF, 9 );
+			write_bits( &writer, fit.e[0][j] >> 10, 1 );
+		}
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		write_bits( &writer, fit.indices[i], (i == 0) ? 3 : 4 );
+	}
+}
+
+/********* BC7 decoding *********/
+
+static const int BC_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+/*	per mode: subsets, partition bits, rotation bits, index selection bit,
+	color bits, alpha bits, endpoint p-bits, shared p-bits, index bits,
+	second index bits	*/
+static const unsigned char BC7_modes[8][10] =
+{
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+/*	two subset partitions, bit i set = texel i is in subset 1	*/
+static const unsigned short BC7_partitions2[64] =
+{
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+/*	three subset partitions, two bits per texel	*/
+static const unsigned int BC7_partitions3[64] =
+{
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+/*	the texel whose index is one bit shorter, for the second / third subset	*/
+static const unsigned char BC7_anchor2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+static const unsigned char BC7_anchor3a[64] =
+{
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+static const unsigned char BC7_anchor3b[64] =
+{
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+/*	reads fields LSB first	*/
+static unsigned int read_bits( const unsigned char *data, int *position, int count )
+{
+	unsigned int value = 0;
+	int i;
+	for( i = 0; i < count; ++i, ++*position )
+	{
+		value |= ((data[*position >> 3] >> (*position & 7)) & 1u) << i;
+	}
+	return value;
+}
+
+static int BC7_subset( int subsets, int partition, int texel )
+{
+	if( subsets == 2 )
+	{
+		return (BC7_partitions2[partition] >> texel) & 1;
+	}
+	if( subsets == 3 )
+	{
+		return (BC7_partitions3[partition] >> (texel * 2)) & 3;
+	}
+	return 0;
+}
+
+static int BC7_is_anchor( int subsets, int partition, int texel )
+{
+	return (texel == 0) ||
+		((subsets == 2) && (texel == BC7_anchor2[partition])) ||
+		((subsets == 3) && ((texel == BC7_anchor3a[partition]) || (texel == BC7_anchor3b[partition])));
+}
+
+void
+	decode_BC7_block
+	(
+		const unsigned char *const compressed,
+		unsigned char rgba[64]
+	)
+{
+	const unsigned char *m;
+	int mode, subsets, partition, rotation, selection;
+	int endpoints[3][2][4], p_bits[3][2];
+	int indices[16], alpha_indices[16];
+	int position = 0;
+	int s, e, c, i;
+	for( mode = 0; mode < 8; ++mode )
+	{
+		if( compressed[0] & (1 << mode) )
+		{
+			break;
+		}
+	}
+	if( mode == 8 )
+	{
+		/*	reserved, decodes to transparent black	*/
+		memset( rgba, 0, 64 );
+		return;
+	}
+	m = BC7_modes[mode];
+	position = mode + 1;
+	subsets = m[0];
+	partition = read_bits( compressed, &position, m[1] );
+	rotation = read_bits( compressed, &position, m[2] );
+	selection = read_bits( compressed, &position, m[3] );
+	/*	all the reds, then greens, blues and alphas	*/
+	for( c = 0; c < 4; ++c )
+	{
+		int bits = (c < 3) ? m[4] : m[5];
+		for( s = 0; s < subsets; ++s )
+		{
+			for( e = 0; e < 2; ++e )
+			{
+				endpoints[s][e][c] = read_bits( compressed, &position, bits );
+			}
+		}
+	}
+	/*	p-bits, one per endpoint or one shared by both ends of a subset	*/
+	for( s = 0; s < subsets; ++s )
+	{
+		for( e = 0; e < 2; ++e )
+		{
+			if( m[6] || (m[7] && (e == 0)) )
+			{
+				p_bits[s][e] = read_bits( compressed, &position, 1 );
+			} else
+			{
+				p_bits[s][e] = m[7] ? p_bits[s][0] : 0;
+			}
+		}
+	}
+	/*	the p-bit becomes the low bit, then everything is stretched to 8 bits	*/
+	for( s = 0; s < subsets; ++s )
+	{
+		for( e = 0; e < 2; ++e )
+		{
+			for( c = 0; c < 4; ++c )
+			{
+				int bits = (c < 3) ? m[4] : m[5];
+				int v = endpoints[s][e][c];
+				if( bits == 0 )
+				{
+					continue;
+				}
+				if( m[6] || m[7] )
+				{
+					v = (v << 1) | p_bits[s][e];
+					++bits;
+				}
+				v <<= 8 - bits;
+				endpoints[s][e][c] = v | (v >> bits);
+			}
+		}
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		int bits = m[8] - (BC7_is_anchor( subsets, partition, i ) ? 1 : 0);
+		indices[i] = read_bits( compressed, &position, bits );
+	}
+	for( i = 0; i < 16 && m[9]; ++i )
+	{
+		alpha_indices[i] = read_bits( compressed, &position, m[9] - ((i == 0) ? 1 : 0) );
+	}
+	for( i = 0; i < 16; ++i )
+	{
+		int *e0 = endpoints[BC7_subset( subsets, partition, i )][0];
+		int *e1 = endpoints[BC7_subset( subsets, partition, i )][1];
+		int color_bits = m[8], alpha_bits = m[8];
+		int color_index = indices[i], alpha_index = indices[i];
+		const int *color_weights, *alpha_weights;
+		unsigned char *texel = rgba + i * 4;
+		if( m[9] )
+		{
+			alpha_bits = m[9];
+			alpha_index = alpha_indices[i];
+			if( selection )
+			{
+				int swap_bits = color_bits, swap_index = color_index;
+				color_bits = alpha_bits;
+				color_index = alpha_index;
+				alpha_bits = swap_bits;
+				alpha_index = swap_index;
+			}
+		}
+		color_weights = (color_bits == 2) ? BC_weights2 : ((color_bits == 3) ? BC_weights3 : BC_weights4);
+		alpha_weights = (alpha_bits == 2) ? BC_weights2 : ((alpha_bits == 3) ? BC_weights3 : BC_weights4);
+		for( c = 0; c < 3; ++c )
+		{
+			int w = color_weights[color_index];
+			texel[c] = (unsigned char)(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+		}
+		if( m[5] == 0 )
+		{
+			texel[3] = 255;
+		} else
+		{
+			int w = alpha_weights[alpha_index];
+			texel[3] = (unsigned char)(((64 - w) * e0[3] + w * e1[3] + 32) >> 6);
+		}
+		if( rotation )
+		{
+			unsigned char swap = texel[3];
+			texel[3] = texel[rotation - 1];
+			texel[rotation - 1] = swap;
+		}
+	}
+}
@@ -7,11 +7,29 @@
 	public domain
 */
 
+#define _CRT_SECURE_NO_WARNINGS
+
 #include <image_DXT.h>
+#include <image_BC.h>
+#include <stb_image_aug.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <image_threads.h>
+
+/*	The SSE2 block compressor is part of every x86-64 target, so no runtime check is needed	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define DXT_SSE2
+#include <emmintrin.h>
+#endif
+
+/*	see set_DXT_compression_options()	*/
+static int DXT_threads = 0;
+static int DXT_use_simd = 1;
+
+/*	images with fewer 4x4 blocks than this are not worth waking up threads for	*/
+#define DXT_MIN_BLOCKS_PER_THREAD	1024
 
 /*	set this =1 if you want to use the covarince matrix method...
 	which is better than my method of using standard deviations
@@ -37,6 +55,40 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+/*
+	Decodes an 8 byte DXT color block into 4x4 RGBA, rows
+	stride bytes apart.  With dxt1_alpha the c0 <= c1 blocks
+	have 3 colors and a transparent black, otherwise (DXT3/5)
+	every block has 4.  alpha (16 values) replaces the alpha
+	of every texel unless it is NULL.
+*/
+static void decode_DDS_color_block(
+				const unsigned char *const compressed,
+				int dxt1_alpha,
+				const unsigned char *const alpha,
+				unsigned char *rgba, int stride );
+/*
+	Decodes an 8 byte DXT5 alpha / BC4 block into 16 values.
+*/
+static void decode_DDS_alpha_block(
+				const unsigned char *const compressed,
+				unsigned char values[16] );
+
+static void
+	color_line_from_sums
+	(
+		float sum_r, float sum_g, float sum_b,
+		float sum_rr, float sum_gg, float sum_bb,
+		float sum_rg, float sum_rb, float sum_gb,
+		float point[3], float direction[3]
+	);
+static void
+	master_colors_from_line
+	(
+		const float sum_x[3], const float sum_x2[3], float vec_len2,
+		float dot_min, float dot_max,
+		int *cmax, int *cmin
+	);
 
 /********* Actual Exposed Functions *********/
 int
@@ -46,11 +98,25 @@ int
 		int width, int height, int channels,
 		const unsigned char *const data
 	)
+{
+	return save_image_as_DDS_format( filename, width, height, channels, data,
+			DDS_FORMAT_AUTO, BC_QUALITY_NORMAL );
+}
+
+int
+	save_image_as_DDS_format
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data,
+		int format, int quality
+	)
 {
 	/*	variables	*/
 	FILE *fout;
 	unsigned char *DDS_data;
 	DDS_header header;
+	DDS_header_DXT10 header10;
 	int DDS_size;
 	/*	error check	*/
 	if( (NULL == filename) ||
@@ -60,15 +126,17 @@ int
 	{
 		return 0;
 	}
-	/*	Convert the image	*/
-	if( (channels & 1) == 1 )
+	if( format == DDS_FORMAT_AUTO )
 	{
-		/*	no alpha, just use DXT1	*/
-		DDS_data = convert_image_to_DXT1( data, width, height, channels, &DDS_size );
-	} else
+		/*	no alpha, just use DXT1, otherwise DXT5	*/
+		format = ((channels & 1) == 1) ? DDS_FORMAT_DXT1 : DDS_FORMAT_DXT5;
+	}
+	/*	Convert the image	*/
+	DDS_data = convert_image_to_DDS_format( data, width, height, channels,
+			format, quality, &DDS_size );
+	if( NULL == DDS_data )
 	{
-		/*	has alpha, so use DXT5	*/
-		DDS_data = convert_image_to_DXT5( data, width, height, channels, &DDS_size );
+		return 0;
 	}
 	/*	save it	*/
 	memset( &header, 0, sizeof( DDS_header ) );
@@ -80,200 +148,597 @@ int
 	header.dwPitchOrLinearSize = DDS_size;
 	header.sPixelFormat.dwSize = 32;
 	header.sPixelFormat.dwFlags = DDPF_FOURCC;
-	if( (channels & 1) == 1 )
+	memset( &header10, 0, sizeof( DDS_header_DXT10 ) );
+	switch( format )
 	{
+	case DDS_FORMAT_DXT1:
 		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
-	} else
-	{
+		break;
+	case DDS_FORMAT_DXT5:
 		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+		break;
+	case DDS_FORMAT_BC4:
+		header10.dxgiFormat = DXGI_FORMAT_BC4_UNORM;
+		break;
+	case DDS_FORMAT_BC5:
+		header10.dxgiFormat = DXGI_FORMAT_BC5_UNORM;
+		break;
+	default:
+		header10.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+		break;
+	}
+	if( header10.dxgiFormat )
+	{
+		/*	the newer formats only have a name in the DX10 extension	*/
+		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('1' << 16) | ('0' << 24);
+		header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		header10.arraySize = 1;
 	}
 	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
 	/*	write it out	*/
-	fout = fopen_s(&fout, filename, "rb");
+	fout = fopen( filename, "wb" );
+	if( NULL == fout )
+	{
+		stbi_image_free( DDS_data );
+		return 0;
+	}
 	fwrite( &header, sizeof( DDS_header ), 1, fout );
+	if( header10.dxgiFormat )
+	{
+		fwrite( &header10, sizeof( DDS_header_DXT10 ), 1, fout );
+	}
 	fwrite( DDS_data, 1, DDS_size, fout );
 	fclose( fout );
 	/*	done	*/
-	free( DDS_data );
+	stbi_image_free( DDS_data );
 	return 1;
 }
 
-unsigned char* convert_image_to_DXT1(
+void set_DXT_compression_options( int threads, int use_simd )
+{
+	DXT_threads = (threads < 0) ? 0 : threads;
+	DXT_use_simd = use_simd;
+}
+
+/*
+	One band of block rows for a worker, every band writes
+	its own part of the output so they need no locking.
+*/
+typedef struct
+{
+	const unsigned char *uncompressed;
+	int width, height, channels;
+	unsigned char *compressed;
+	int first_block_row, end_block_row;
+	void (*compress_rows)( const void *job );
+	/*	only used by the BCn encoders, hdr replaces uncompressed for BC6H	*/
+	int quality;
+	const float *hdr;
+	/*	only used by the decoders, they read blocks and write decoded	*/
+	int format;
+	const unsigned char *blocks;
+	unsigned char *decoded;
+}
+DXT_job;
+
+/*
+	Copies the 4x4 block at (i,j) out of the image as RGBA,
+	repeating the first texel into the parts that hang off
+	the edge.  Missing alpha is 255.
+*/
+static void
+	gather_DXT_block
+	(
 		const unsigned char *const uncompressed,
 		int width, int height, int channels,
-		int *out_size )
+		int i, int j,
+		unsigned char ublock[16*4]
+	)
 {
-	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
-	/*	error check	*/
-	*out_size = 0;
-	if( (width < 1) || (height < 1) ||
-		(NULL == uncompressed) ||
-		(channels < 1) || (channels > 4) )
+	int x, y;
+	int idx = 0;
+	int mx = 4, my = 4;
+	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
+	int chan_step = (channels < 3) ? 0 : 1;
+	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
+	int has_alpha = 1 - (channels & 1);
+	if( j+4 >= height )
 	{
-		return NULL;
+		my = height - j;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
-	if( channels < 3 )
+	if( i+4 >= width )
+	{
+		mx = width - i;
+	}
+	for( y = 0; y < my; ++y )
+	{
+		const unsigned char *row = uncompressed + ((j+y)*width + i)*channels;
+		if( (channels == 4) && (mx == 4) )
+		{
+			memcpy( ublock + idx, row, 16 );
+			idx += 16;
+		} else
+		{
+			for( x = 0; x < mx; ++x )
+			{
+				ublock[idx++] = row[x*channels];
+				ublock[idx++] = row[x*channels+chan_step];
+				ublock[idx++] = row[x*channels+chan_step+chan_step];
+				ublock[idx++] =
+					has_alpha * row[x*channels+channels-1]
+					+ (1-has_alpha)*255;
+			}
+		}
+		for( x = mx; x < 4; ++x )
+		{
+			ublock[idx++] = ublock[0];
+			ublock[idx++] = ublock[1];
+			ublock[idx++] = ublock[2];
+			ublock[idx++] = ublock[3];
+		}
+	}
+	for( y = my; y < 4; ++y )
 	{
-		chan_step = 0;
+		for( x = 0; x < 4; ++x )
+		{
+			ublock[idx++] = ublock[0];
+			ublock[idx++] = ublock[1];
+			ublock[idx++] = ublock[2];
+			ublock[idx++] = ublock[3];
+		}
 	}
-	/*	get the RAM for the compressed image
-		(8 bytes per 4x4 pixel block)	*/
-	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
-	compressed = (unsigned char*)malloc( *out_size );
+}
+
+static void compress_DXT1_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j, x;
+	unsigned char ublock[16*4];
+	unsigned char cblock[8];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 8;
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
 	{
-		for( i = 0; i < width; i += 4 )
+		for( i = 0; i < job->width; i += 4 )
 		{
 			/*	copy this block into a new one	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
+			gather_DXT_block( job->uncompressed, job->width, job->height, job->channels, i, j, ublock );
+			/*	compress the block (the alpha byte is skipped)	*/
+			compress_DDS_color_block( 4, ublock, cblock );
+			/*	copy the data from the block into the main block	*/
+			for( x = 0; x < 8; ++x )
 			{
-				my = height - j;
+				job->compressed[index++] = cblock[x];
 			}
-			if( i+4 >= width )
+		}
+	}
+}
+
+static void compress_DXT5_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j, x;
+	unsigned char ublock[16*4];
+	unsigned char cblock[8];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 16;
+	/*	go through each block	*/
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4 )
+		{
+			gather_DXT_block( job->uncompressed, job->width, job->height, job->channels, i, j, ublock );
+			/*	now compress the alpha block	*/
+			compress_DDS_alpha_block( ublock, cblock );
+			/*	copy the data from the compressed alpha block into the main buffer	*/
+			for( x = 0; x < 8; ++x )
 			{
-				mx = width - i;
+				job->compressed[index++] = cblock[x];
 			}
-			for( y = 0; y < my; ++y )
+			/*	then compress the color block	*/
+			compress_DDS_color_block( 4, ublock, cblock );
+			/*	copy the data from the compressed color block into the main buffer	*/
+			for( x = 0; x < 8; ++x )
 			{
-				for( x = 0; x < mx; ++x )
+				job->compressed[index++] = cblock[x];
+			}
+		}
+	}
+}
+
+static void compress_BC4_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j;
+	unsigned char ublock[16*4];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 8;
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4 )
+		{
+			gather_DXT_block( job->uncompressed, job->width, job->height, job->channels, i, j, ublock );
+			/*	red only	*/
+			compress_BC4_block( ublock, 4, job->quality, job->compressed + index );
+			index += 8;
+		}
+	}
+}
+
+static void compress_BC5_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j;
+	unsigned char ublock[16*4];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 16;
+	/*	luminance/alpha keeps its alpha, otherwise it is red and green	*/
+	int second = (job->channels == 2) ? 3 : 1;
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4 )
+		{
+			gather_DXT_block( job->uncompressed, job->width, job->height, job->channels, i, j, ublock );
+			compress_BC4_block( ublock, 4, job->quality, job->compressed + index );
+			compress_BC4_block( ublock + second, 4, job->quality, job->compressed + index + 8 );
+			index += 16;
+		}
+	}
+}
+
+static void compress_BC7_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j;
+	unsigned char ublock[16*4];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 16;
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4 )
+		{
+			gather_DXT_block( job->uncompressed, job->width, job->height, job->channels, i, j, ublock );
+			compress_BC7_block( ublock, job->quality, job->compressed + index );
+			index += 16;
+		}
+	}
+}
+
+/*
+	Same as gather_DXT_block, for float images and RGB only.
+	Texels off the edge repeat the last row / column.
+*/
+static void
+	gather_BC6H_block
+	(
+		const float *const hdr,
+		int width, int height, int channels,
+		int i, int j,
+		float fblock[16*3]
+	)
+{
+	int x, y;
+	int chan_step = (channels < 3) ? 0 : 1;
+	for( y = 0; y < 4; ++y )
+	{
+		int sy = (j+y < height) ? j+y : height-1;
+		for( x = 0; x < 4; ++x )
+		{
+			int sx = (i+x < width) ? i+x : width-1;
+			const float *texel = hdr + ((size_t)sy*width + sx)*channels;
+			fblock[(y*4+x)*3+0] = texel[0];
+			fblock[(y*4+x)*3+1] = texel[chan_step];
+			fblock[(y*4+x)*3+2] = texel[chan_step+chan_step];
+		}
+	}
+}
+
+static void compress_BC6H_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j;
+	float fblock[16*3];
+	int index = job->first_block_row * ((job->width+3) >> 2) * 16;
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4 )
+		{
+			gather_BC6H_block( job->hdr, job->width, job->height, job->channels, i, j, fblock );
+			compress_BC6H_block( fblock, job->quality, job->compressed + index );
+			index += 16;
+		}
+	}
+}
+
+static void decode_DDS_rows( const void *job_ptr )
+{
+	const DXT_job *job = (const DXT_job*)job_ptr;
+	int i, j, x, y;
+	unsigned char block_rgba[16*4];
+	unsigned char values[16], values2[16];
+	int block_size = ((job->format == DDS_FORMAT_DXT1) || (job->format == DDS_FORMAT_BC4)) ? 8 : 16;
+	const unsigned char *block = job->blocks + job->first_block_row * ((job->width+3) >> 2) * block_size;
+	for( j = job->first_block_row*4; j < job->end_block_row*4 && j < job->height; j += 4 )
+	{
+		for( i = 0; i < job->width; i += 4, block += block_size )
+		{
+			int mx = (job->width - i < 4) ? job->width - i : 4;
+			int my = (job->height - j < 4) ? job->height - j : 4;
+			/*	whole blocks go straight to the image, the edges through block_rgba	*/
+			int whole = (mx == 4) && (my == 4);
+			unsigned char *rgba = whole ? job->decoded + ((size_t)j * job->width + i) * 4 : block_rgba;
+			int stride = whole ? job->width * 4 : 16;
+			switch( job->format )
+			{
+			case DDS_FORMAT_DXT1:
+				decode_DDS_color_block( block, 1, NULL, rgba, stride );
+				break;
+			case DDS_FORMAT_DXT3:
+				/*	explicit 4 bit alpha	*/
+				for( x = 0; x < 16; ++x )
 				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
+					values[x] = ((block[x >> 1] >> ((x & 1) * 4)) & 15) * 17;
 				}
-				for( x = mx; x < 4; ++x )
+				decode_DDS_color_block( block + 8, 0, values, rgba, stride );
+				break;
+			case DDS_FORMAT_DXT5:
+				decode_DDS_alpha_block( block, values );
+				decode_DDS_color_block( block + 8, 0, values, rgba, stride );
+				break;
+			case DDS_FORMAT_BC4:
+			case DDS_FORMAT_BC5:
+				/*	as OpenGL reads RED and RG textures	*/
+				decode_DDS_alpha_block( block, values );
+				memset( values2, 0, 16 );
+				if( job->format == DDS_FORMAT_BC5 )
 				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
+					decode_DDS_alpha_block( block + 8, values2 );
 				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
+				for( x = 0; x < 16; ++x )
 				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
+					unsigned char *texel = rgba + (x >> 2) * stride + (x & 3) * 4;
+					texel[0] = values[x];
+					texel[1] = values2[x];
+					texel[2] = 0;
+					texel[3] = 255;
 				}
+				break;
+			default:
+				decode_BC7_block( block, block_rgba );
+				if( whole )
+				{
+					for( y = 0; y < 4; ++y )
+					{
+						memcpy( rgba + y * stride, block_rgba + y*16, 16 );
+					}
+				}
+				break;
 			}
-			/*	compress the block	*/
-			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
-			/*	copy the data from the block into the main block	*/
-			for( x = 0; x < 8; ++x )
+			if( !whole )
 			{
-				compressed[index++] = cblock[x];
+				/*	only the part of the block inside the image	*/
+				for( y = 0; y < my; ++y )
+				{
+					memcpy( job->decoded + ((size_t)(j+y) * job->width + i) * 4, block_rgba + y*16, mx * 4 );
+				}
 			}
 		}
 	}
+}
+
+static void DXT_band( void *job )
+{
+	((DXT_job*)job)->compress_rows( job );
+}
+
+/*
+	Splits the block rows into one band per thread, see
+	image_threads_run().  Every band is a copy of prototype
+	with its own rows filled in.
+*/
+static void
+	run_DXT_job
+	(
+		const DXT_job *prototype
+	)
+{
+	DXT_job jobs[IMAGE_THREADS_MAX];
+	int block_rows = (prototype->height+3) >> 2;
+	int blocks = block_rows * ((prototype->width+3) >> 2);
+	int thread_count = image_threads_count( DXT_threads, blocks,
+			DXT_MIN_BLOCKS_PER_THREAD, block_rows );
+	int t;
+	for( t = 0; t < thread_count; ++t )
+	{
+		jobs[t] = *prototype;
+		jobs[t].first_block_row = block_rows * t / thread_count;
+		jobs[t].end_block_row = block_rows * (t+1) / thread_count;
+	}
+	image_threads_run( DXT_band, jobs, sizeof(jobs[0]), thread_count );
+}
+
+/*
+	Shared front end of the 8 bit converters, block_size
+	is the number of bytes each 4x4 block compresses to.
+*/
+static unsigned char*
+	convert_image_with
+	(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int quality, int block_size,
+		void (*compress_rows)( const void *job ),
+		int *out_size
+	)
+{
+	DXT_job job;
+	unsigned char *compressed;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * block_size;
+	compressed = (unsigned char*)stbi_image_alloc( *out_size );
+	if( NULL == compressed )
+	{
+		*out_size = 0;
+		return NULL;
+	}
+	memset( &job, 0, sizeof( DXT_job ) );
+	job.uncompressed = uncompressed;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.compressed = compressed;
+	job.compress_rows = compress_rows;
+	job.quality = quality;
+	run_DXT_job( &job );
 	return compressed;
 }
 
+unsigned char* convert_image_to_DXT1(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	/*	8 bytes per 4x4 pixel block	*/
+	return convert_image_with( uncompressed, width, height, channels,
+			0, 8, compress_DXT1_rows, out_size );
+}
+
 unsigned char* convert_image_to_DXT5(
 		const unsigned char *const uncompressed,
 		int width, int height, int channels,
 		int *out_size )
 {
+	/*	16 bytes per 4x4 pixel block	*/
+	return convert_image_with( uncompressed, width, height, channels,
+			0, 16, compress_DXT5_rows, out_size );
+}
+
+unsigned char* convert_image_to_BC4(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int quality,
+		int *out_size )
+{
+	return convert_image_with( uncompressed, width, height, channels,
+			quality, 8, compress_BC4_rows, out_size );
+}
+
+unsigned char* convert_image_to_BC5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int quality,
+		int *out_size )
+{
+	return convert_image_with( uncompressed, width, height, channels,
+			quality, 16, compress_BC5_rows, out_size );
+}
+
+unsigned char* convert_image_to_BC7(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int quality,
+		int *out_size )
+{
+	return convert_image_with( uncompressed, width, height, channels,
+			quality, 16, compress_BC7_rows, out_size );
+}
+
+unsigned char* convert_image_to_BC6H(
+		const float *const uncompressed,
+		int width, int height, int channels,
+		int quality,
+		int *out_size )
+{
+	DXT_job job;
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*4];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0, has_alpha;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
 		(NULL == uncompressed) ||
-		(channels < 1) || ( channels > 4) )
+		(channels < 1) || (channels > 4) )
 	{
 		return NULL;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
-	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
-	has_alpha = 1 - (channels & 1);
-	/*	get the RAM for the compressed image
-		(16 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
-	compressed = (unsigned char*)malloc( *out_size );
-	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	compressed = (unsigned char*)stbi_image_alloc( *out_size );
+	if( NULL == compressed )
 	{
-		for( i = 0; i < width; i += 4 )
-		{
-			/*	local variables, and my block counter	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-					ublock[idx++] =
-						has_alpha * uncompressed[(j+y)*width*channels+(i+x)*channels+channels-1]
-						+ (1-has_alpha)*255;
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
-			/*	copy the data from the compressed alpha block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-			/*	then compress the color block	*/
-			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
-			/*	copy the data from the compressed color block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-		}
+		*out_size = 0;
+		return NULL;
 	}
+	memset( &job, 0, sizeof( DXT_job ) );
+	job.hdr = uncompressed;
+	job.width = width;
+	job.height = height;
+	job.channels = channels;
+	job.compressed = compressed;
+	job.compress_rows = compress_BC6H_rows;
+	job.quality = quality;
+	run_DXT_job( &job );
 	return compressed;
 }
 
+unsigned char* convert_image_to_DDS_format(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int format, int quality,
+		int *out_size )
+{
+	if( format == DDS_FORMAT_AUTO )
+	{
+		/*	alpha or not	*/
+		format = ((channels & 1) == 1) ? DDS_FORMAT_DXT1 : DDS_FORMAT_DXT5;
+	}
+	switch( format )
+	{
+	case DDS_FORMAT_DXT1:
+		return convert_image_to_DXT1( uncompressed, width, height, channels, out_size );
+	case DDS_FORMAT_DXT5:
+		return convert_image_to_DXT5( uncompressed, width, height, channels, out_size );
+	case DDS_FORMAT_BC4:
+		return convert_image_to_BC4( uncompressed, width, height, channels, quality, out_size );
+	case DDS_FORMAT_BC5:
+		return convert_image_to_BC5( uncompressed, width, height, channels, quality, out_size );
+	case DDS_FORMAT_BC7:
+		return convert_image_to_BC7( uncompressed, width, height, channels, quality, out_size );
+	}
+	*out_size = 0;
+	return NULL;
+}
+
+unsigned char* convert_DDS_format_to_image(
+		const unsigned char *const compressed,
+		int width, int height,
+		int format )
+{
+	DXT_job job;
+	unsigned char *decoded;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == compressed) ||
+		(format < DDS_FORMAT_DXT1) || (format > DDS_FORMAT_DXT3) )
+	{
+		return NULL;
+	}
+	decoded = (unsigned char*)stbi_image_alloc( (size_t)width * height * 4 );
+	if( NULL == decoded )
+	{
+		return NULL;
+	}
+	memset( &job, 0, sizeof( DXT_job ) );
+	job.width = width;
+	job.height = height;
+	job.blocks = compressed;
+	job.decoded = decoded;
+	job.format = format;
+	job.compress_rows = decode_DDS_rows;
+	run_DXT_job( &job );
+	return decoded;
+}
+
 /********* Helper Functions *********/
 int convert_bit_range( int c, int from_bits, int to_bits )
 {
@@ -301,7 +766,6 @@ void compute_color_line_STDEV(
 		int channels,
 		float point[3], float direction[3] )
 {
-	const float inv_16 = 1.0f / 16.0f;
 	int i;
 	float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f;
 	float sum_rr = 0.0f, sum_gg = 0.0f, sum_bb = 0.0f;
@@ -320,6 +784,27 @@ void compute_color_line_STDEV(
 		sum_rb += uncompressed[i+0] * uncompressed[i+2];
 		sum_gb += uncompressed[i+1] * uncompressed[i+2];
 	}
+	color_line_from_sums(
+			sum_r, sum_g, sum_b,
+			sum_rr, sum_gg, sum_bb,
+			sum_rg, sum_rb, sum_gb,
+			point, direction );
+}
+
+/*
+	The rest of compute_color_line_STDEV, once the sums of the 16 texels
+	and their products are known (the SSE2 compressor gets them on its own)
+*/
+static void
+	color_line_from_sums
+	(
+		float sum_r, float sum_g, float sum_b,
+		float sum_rr, float sum_gg, float sum_bb,
+		float sum_rg, float sum_rb, float sum_gb,
+		float point[3], float direction[3]
+	)
+{
+	const float inv_16 = 1.0f / 16.0f;
 	/*	convert the sums to averages	*/
 	sum_r *= inv_16;
 	sum_g *= inv_16;
@@ -413,9 +898,7 @@ void LSE_master_colors_max_min(
 		int channels,
 		const unsigned char *const uncompressed )
 {
-	int i, j;
-	/*	the master colors	*/
-	int c0[3], c1[3];
+	int i;
 	/*	used for fitting the line	*/
 	float sum_x[] = { 0.0f, 0.0f, 0.0f };
 	float sum_x2[] = { 0.0f, 0.0f, 0.0f };
@@ -454,6 +937,25 @@ void LSE_master_colors_max_min(
 			dot_max = dot;
 		}
 	}
+	master_colors_from_line( sum_x, sum_x2, vec_len2, dot_min, dot_max, cmax, cmin );
+}
+
+/*
+	The rest of LSE_master_colors_max_min: turns the extent of the
+	block along its color line into the two 565 master colors
+*/
+static void
+	master_colors_from_line
+	(
+		const float sum_x[3], const float sum_x2[3], float vec_len2,
+		float dot_min, float dot_max,
+		int *cmax, int *cmin
+	)
+{
+	int i, j;
+	/*	the master colors	*/
+	int c0[3], c1[3];
+	float dot;
 	/*	and the offset (from the average location)	*/
 	dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
 	dot_min -= dot;
@@ -497,25 +999,22 @@ void LSE_master_colors_max_min(
 	}
 }
 
-void
-	compress_DDS_color_block
+/*
+	Stores the two 565 master colors, clears the indices and sets up
+	the projection of a texel onto the line between the two colors
+	(0 at color 0, 1 at color 1)
+*/
+static void
+	start_DDS_color_block
 	(
-		int channels,
-		const unsigned char *const uncompressed,
-		unsigned char compressed[8]
+		int enc_c0, int enc_c1,
+		unsigned char compressed[8],
+		float color_line[3], float *dot_offset
 	)
 {
-	/*	variables	*/
 	int i;
-	int next_bit;
-	int enc_c0, enc_c1;
 	int c0[4], c1[4];
-	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	float vec_len2 = 0.0f, dot_offset = 0.0f;
-	/*	stupid order	*/
-	int swizzle4[] = { 0, 2, 3, 1 };
-	/*	get the master colors	*/
-	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
+	float vec_len2 = 0.0f;
 	/*	store the 565 color 0 and color 1	*/
 	compressed[0] = (enc_c0 >> 0) & 255;
 	compressed[1] = (enc_c0 >> 8) & 255;
@@ -545,7 +1044,218 @@ void
 	color_line[1] *= vec_len2;
 	color_line[2] *= vec_len2;
 	/*	compute the offset (constant) portion of the dot product	*/
-	dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+	*dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+}
+
+#ifdef DXT_SSE2
+/*
+	compress_DDS_color_block for RGBA blocks, 4 texels at a time.
+	Every sum and product is formed in the same order as the plain
+	C version, so the output is bit for bit the same.
+*/
+static void
+	compress_DDS_color_block_SSE2
+	(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	const __m128i byte_mask = _mm_set1_epi32( 255 );
+	__m128i r[4], g[4], b[4];
+	__m128i sum_r, sum_g, sum_b, sum_rr, sum_gg, sum_bb, sum_rg, sum_rb, sum_gb;
+	__m128 rf[4], gf[4], bf[4];
+	__m128 dir0, dir1, dir2, dot_lo, dot_hi;
+	__m128i indices[2];
+	float point[3], direction[3], color_line[3];
+	float vec_len2, dot_min, dot_max, dot_offset;
+	int sums[9][4];
+	short index[16];
+	unsigned int bits = 0;
+	int enc_c0, enc_c1;
+	int i, k;
+	/*	stupid order	*/
+	static const int swizzle4[] = { 0, 2, 3, 1 };
+	/*	one 32 bit lane per texel and channel	*/
+	for( i = 0; i < 4; ++i )
+	{
+		__m128i texels = _mm_loadu_si128( (const __m128i*)(uncompressed + i*16) );
+		r[i] = _mm_and_si128( texels, byte_mask );
+		g[i] = _mm_and_si128( _mm_srli_epi32( texels, 8 ), byte_mask );
+		b[i] = _mm_and_si128( _mm_srli_epi32( texels, 16 ), byte_mask );
+		rf[i] = _mm_cvtepi32_ps( r[i] );
+		gf[i] = _mm_cvtepi32_ps( g[i] );
+		bf[i] = _mm_cvtepi32_ps( b[i] );
+	}
+	/*	the sums are integers well below 2^24, exact in either order.
+		the high halves of the lanes are 0, so madd is a 32 bit multiply	*/
+	sum_r = sum_g = sum_b = sum_rr = sum_gg = sum_bb = sum_rg = sum_rb = sum_gb = _mm_setzero_si128();
+	for( i = 0; i < 4; ++i )
+	{
+		sum_r = _mm_add_epi32( sum_r, r[i] );
+		sum_g = _mm_add_epi32( sum_g, g[i] );
+		sum_b = _mm_add_epi32( sum_b, b[i] );
+		sum_rr = _mm_add_epi32( sum_rr, _mm_madd_epi16( r[i], r[i] ) );
+		sum_gg = _mm_add_epi32( sum_gg, _mm_madd_epi16( g[i], g[i] ) );
+		sum_bb = _mm_add_epi32( sum_bb, _mm_madd_epi16( b[i], b[i] ) );
+		sum_rg = _mm_add_epi32( sum_rg, _mm_madd_epi16( r[i], g[i] ) );
+		sum_rb = _mm_add_epi32( sum_rb, _mm_madd_epi16( r[i], b[i] ) );
+		sum_gb = _mm_add_epi32( sum_gb, _mm_madd_epi16( g[i], b[i] ) );
+	}
+	_mm_storeu_si128( (__m128i*)sums[0], sum_r );
+	_mm_storeu_si128( (__m128i*)sums[1], sum_g );
+	_mm_storeu_si128( (__m128i*)sums[2], sum_b );
+	_mm_storeu_si128( (__m128i*)sums[3], sum_rr );
+	_mm_storeu_si128( (__m128i*)sums[4], sum_gg );
+	_mm_storeu_si128( (__m128i*)sums[5], sum_bb );
+	_mm_storeu_si128( (__m128i*)sums[6], sum_rg );
+	_mm_storeu_si128( (__m128i*)sums[7], sum_rb );
+	_mm_storeu_si128( (__m128i*)sums[8], sum_gb );
+	for( k = 0; k < 9; ++k )
+	{
+		sums[k][0] += sums[k][1] + sums[k][2] + sums[k][3];
+	}
+	color_line_from_sums(
+			(float)sums[0][0], (float)sums[1][0], (float)sums[2][0],
+			(float)sums[3][0], (float)sums[4][0], (float)sums[5][0],
+			(float)sums[6][0], (float)sums[7][0], (float)sums[8][0],
+			point, direction );
+	vec_len2 = 1.0f / ( 0.00001f +
+			direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2] );
+	/*	finding the max and min vector values	*/
+	dir0 = _mm_set1_ps( direction[0] );
+	dir1 = _mm_set1_ps( direction[1] );
+	dir2 = _mm_set1_ps( direction[2] );
+	dot_lo = dot_hi = _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( dir0, rf[0] ), _mm_mul_ps( dir1, gf[0] ) ), _mm_mul_ps( dir2, bf[0] ) );
+	for( i = 1; i < 4; ++i )
+	{
+		__m128 dot = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( dir0, rf[i] ), _mm_mul_ps( dir1, gf[i] ) ), _mm_mul_ps( dir2, bf[i] ) );
+		dot_lo = _mm_min_ps( dot_lo, dot );
+		dot_hi = _mm_max_ps( dot_hi, dot );
+	}
+	dot_lo = _mm_min_ps( dot_lo, _mm_shuffle_ps( dot_lo, dot_lo, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	dot_lo = _mm_min_ps( dot_lo, _mm_shuffle_ps( dot_lo, dot_lo, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	dot_hi = _mm_max_ps( dot_hi, _mm_shuffle_ps( dot_hi, dot_hi, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	dot_hi = _mm_max_ps( dot_hi, _mm_shuffle_ps( dot_hi, dot_hi, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	dot_min = _mm_cvtss_f32( dot_lo );
+	dot_max = _mm_cvtss_f32( dot_hi );
+	master_colors_from_line( point, direction, vec_len2, dot_min, dot_max, &enc_c0, &enc_c1 );
+	start_DDS_color_block( enc_c0, enc_c1, compressed, color_line, &dot_offset );
+	/*	place every texel on the line, mapped to [0,3]	*/
+	dir0 = _mm_set1_ps( color_line[0] );
+	dir1 = _mm_set1_ps( color_line[1] );
+	dir2 = _mm_set1_ps( color_line[2] );
+	for( i = 0; i < 4; i += 2 )
+	{
+		__m128 dot_a = _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( dir0, rf[i] ), _mm_mul_ps( dir1, gf[i] ) ), _mm_mul_ps( dir2, bf[i] ) ),
+				_mm_set1_ps( dot_offset ) );
+		__m128 dot_b = _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( dir0, rf[i+1] ), _mm_mul_ps( dir1, gf[i+1] ) ), _mm_mul_ps( dir2, bf[i+1] ) ),
+				_mm_set1_ps( dot_offset ) );
+		__m128i value_a = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( dot_a, _mm_set1_ps( 3.0f ) ), _mm_set1_ps( 0.5f ) ) );
+		__m128i value_b = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( dot_b, _mm_set1_ps( 3.0f ) ), _mm_set1_ps( 0.5f ) ) );
+		indices[i >> 1] = _mm_min_epi16( _mm_max_epi16(
+				_mm_packs_epi32( value_a, value_b ), _mm_setzero_si128() ), _mm_set1_epi16( 3 ) );
+	}
+	_mm_storeu_si128( (__m128i*)index, indices[0] );
+	_mm_storeu_si128( (__m128i*)(index + 8), indices[1] );
+	for( i = 0; i < 16; ++i )
+	{
+		bits |= (unsigned int)swizzle4[ index[i] ] << (2*i);
+	}
+	compressed[4] = (unsigned char)(bits >> 0);
+	compressed[5] = (unsigned char)(bits >> 8);
+	compressed[6] = (unsigned char)(bits >> 16);
+	compressed[7] = (unsigned char)(bits >> 24);
+}
+
+/*
+	compress_DDS_alpha_block with the limits and the 3 bit
+	indices found 8 texels at a time, same output
+*/
+static void
+	compress_DDS_alpha_block_SSE2
+	(
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	__m128i alpha[4], a16[2], lo, hi;
+	__m128 scale;
+	int value[16];
+	int i, a0, a1;
+	unsigned int bits_lo = 0, bits_hi = 0;
+	/*	stupid order	*/
+	static const int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+	for( i = 0; i < 4; ++i )
+	{
+		alpha[i] = _mm_srli_epi32( _mm_loadu_si128( (const __m128i*)(uncompressed + i*16) ), 24 );
+	}
+	/*	get the alpha limits (a0 > a1)	*/
+	a16[0] = _mm_packs_epi32( alpha[0], alpha[1] );
+	a16[1] = _mm_packs_epi32( alpha[2], alpha[3] );
+	lo = _mm_min_epi16( a16[0], a16[1] );
+	hi = _mm_max_epi16( a16[0], a16[1] );
+	lo = _mm_min_epi16( lo, _mm_shuffle_epi32( lo, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	hi = _mm_max_epi16( hi, _mm_shuffle_epi32( hi, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	lo = _mm_min_epi16( lo, _mm_shuffle_epi32( lo, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	hi = _mm_max_epi16( hi, _mm_shuffle_epi32( hi, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	lo = _mm_min_epi16( lo, _mm_srli_epi32( lo, 16 ) );
+	hi = _mm_max_epi16( hi, _mm_srli_epi32( hi, 16 ) );
+	a1 = _mm_cvtsi128_si32( lo ) & 0xFFFF;
+	a0 = _mm_cvtsi128_si32( hi ) & 0xFFFF;
+	compressed[0] = a0;
+	compressed[1] = a1;
+	/*	convert the alpha values to 3 bit numbers	*/
+	scale = _mm_set1_ps( 7.9999f / (a0 - a1) );
+	for( i = 0; i < 4; ++i )
+	{
+		__m128 offset = _mm_cvtepi32_ps( _mm_sub_epi32( alpha[i], _mm_set1_epi32( a1 ) ) );
+		_mm_storeu_si128( (__m128i*)(value + i*4), _mm_cvttps_epi32( _mm_mul_ps( offset, scale ) ) );
+	}
+	/*	and pack them, 24 bits per 8 texels	*/
+	for( i = 0; i < 8; ++i )
+	{
+		bits_lo |= (unsigned int)swizzle8[ value[i] & 7 ] << (3*i);
+		bits_hi |= (unsigned int)swizzle8[ value[i+8] & 7 ] << (3*i);
+	}
+	compressed[2] = (unsigned char)(bits_lo >> 0);
+	compressed[3] = (unsigned char)(bits_lo >> 8);
+	compressed[4] = (unsigned char)(bits_lo >> 16);
+	compressed[5] = (unsigned char)(bits_hi >> 0);
+	compressed[6] = (unsigned char)(bits_hi >> 8);
+	compressed[7] = (unsigned char)(bits_hi >> 16);
+}
+#endif
+
+void
+	compress_DDS_color_block
+	(
+		int channels,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i;
+	int next_bit;
+	int enc_c0, enc_c1;
+	float color_line[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float dot_offset = 0.0f;
+	/*	stupid order	*/
+	int swizzle4[] = { 0, 2, 3, 1 };
+#ifdef DXT_SSE2
+	if( DXT_use_simd && (channels == 4) )
+	{
+		compress_DDS_color_block_SSE2( uncompressed, compressed );
+		return;
+	}
+#endif
+	/*	get the master colors	*/
+	LSE_master_colors_max_min( &enc_c0, &enc_c1, channels, uncompressed );
+	start_DDS_color_block( enc_c0, enc_c1, compressed, color_line, &dot_offset );
 	/*	store the rest of the bits	*/
 	next_bit = 8*4;
 	for( i = 0; i < 16; ++i )
@@ -588,6 +1298,13 @@ void
 	float scale_me;
 	/*	stupid order	*/
 	int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+#ifdef DXT_SSE2
+	if( DXT_use_simd )
+	{
+		compress_DDS_alpha_block_SSE2( uncompressed, compressed );
+		return;
+	}
+#endif
 	/*	get the alpha limits (a0 > a1)	*/
 	a0 = a1 = uncompressed[3];
 	for( i = 4+3; i < 16*4; i += 4 )
@@ -630,3 +1347,128 @@ void
 	}
 	/*	done compressing to DXT1	*/
 }
+
+static void decode_DDS_color_block(
+				const unsigned char *const compressed,
+				int dxt1_alpha,
+				const unsigned char *const alpha,
+				unsigned char *rgba, int stride )
+{
+	unsigned int palette[4];
+	int colors[4][3];
+	unsigned int c0 = compressed[0] | (compressed[1] << 8);
+	unsigned int c1 = compressed[2] | (compressed[3] << 8);
+	unsigned int indices = compressed[4] | (compressed[5] << 8) |
+		(compressed[6] << 16) | ((unsigned int)compressed[7] << 24);
+	int three_colors = dxt1_alpha && (c0 <= c1);
+	int i;
+	/*	565 to 888 by repeating the top bits	*/
+	colors[0][0] = ((c0 >> 8) & 0xF8) | (c0 >> 13);
+	colors[0][1] = ((c0 >> 3) & 0xFC) | ((c0 >> 9) & 3);
+	colors[0][2] = ((c0 << 3) & 0xF8) | ((c0 >> 2) & 7);
+	colors[1][0] = ((c1 >> 8) & 0xF8) | (c1 >> 13);
+	colors[1][1] = ((c1 >> 3) & 0xFC) | ((c1 >> 9) & 3);
+	colors[1][2] = ((c1 << 3) & 0xF8) | ((c1 >> 2) & 7);
+	for( i = 0; i < 3; ++i )
+	{
+		if( three_colors )
+		{
+			colors[2][i] = (colors[0][i] + colors[1][i]) / 2;
+			colors[3][i] = 0;
+		} else
+		{
+			colors[2][i] = (2 * colors[0][i] + colors[1][i]) / 3;
+			colors[3][i] = (colors[0][i] + 2 * colors[1][i]) / 3;
+		}
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		palette[i] = colors[i][0] | (colors[i][1] << 8) | (colors[i][2] << 16) | (255u << 24);
+	}
+	if( three_colors )
+	{
+		palette[3] = 0;
+	}
+#ifdef DXT_SSE2
+	if( DXT_use_simd )
+	{
+		/*	each texel's two index bits become lane masks, which pick
+			between the palette entries without any lookups	*/
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i low_bits = _mm_setr_epi32( 1 << 0, 1 << 2, 1 << 4, 1 << 6 );
+		const __m128i high_bits = _mm_setr_epi32( 1 << 1, 1 << 3, 1 << 5, 1 << 7 );
+		__m128i p0 = _mm_set1_epi32( (int)palette[0] );
+		__m128i p01 = _mm_xor_si128( p0, _mm_set1_epi32( (int)palette[1] ) );
+		__m128i p2 = _mm_set1_epi32( (int)palette[2] );
+		__m128i p23 = _mm_xor_si128( p2, _mm_set1_epi32( (int)palette[3] ) );
+		__m128i alpha_bytes = zero;
+		if( alpha )
+		{
+			alpha_bytes = _mm_loadu_si128( (const __m128i*)alpha );
+		}
+		for( i = 0; i < 4; ++i )
+		{
+			__m128i row = _mm_set1_epi32( (int)(indices >> (i * 8)) );
+			__m128i bit0 = _mm_cmpeq_epi32( _mm_and_si128( row, low_bits ), low_bits );
+			__m128i bit1 = _mm_cmpeq_epi32( _mm_and_si128( row, high_bits ), high_bits );
+			__m128i lo = _mm_xor_si128( p0, _mm_and_si128( bit0, p01 ) );
+			__m128i hi = _mm_xor_si128( p2, _mm_and_si128( bit0, p23 ) );
+			__m128i color = _mm_xor_si128( lo, _mm_and_si128( bit1, _mm_xor_si128( lo, hi ) ) );
+			if( alpha )
+			{
+				/*	this row's 4 alpha bytes into the top byte of each lane	*/
+				__m128i a = _mm_unpacklo_epi16( zero, _mm_unpacklo_epi8( zero, alpha_bytes ) );
+				color = _mm_or_si128( _mm_and_si128( color, _mm_set1_epi32( 0x00FFFFFF ) ), a );
+				alpha_bytes = _mm_srli_si128( alpha_bytes, 4 );
+			}
+			_mm_storeu_si128( (__m128i*)(rgba + i * stride), color );
+		}
+		return;
+	}
+#endif
+	for( i = 0; i < 16; ++i )
+	{
+		unsigned int color = palette[(indices >> (i * 2)) & 3];
+		unsigned char *texel = rgba + (i >> 2) * stride + (i & 3) * 4;
+		texel[0] = (unsigned char)(color);
+		texel[1] = (unsigned char)(color >> 8);
+		texel[2] = (unsigned char)(color >> 16);
+		texel[3] = alpha ? alpha[i] : (unsigned char)(color >> 24);
+	}
+}
+
+static void decode_DDS_alpha_block(
+				const unsigned char *const compressed,
+				unsigned char values[16] )
+{
+	unsigned char palette[8];
+	int a0 = compressed[0], a1 = compressed[1];
+	int i;
+	palette[0] = (unsigned char)a0;
+	palette[1] = (unsigned char)a1;
+	if( a0 > a1 )
+	{
+		for( i = 1; i < 7; ++i )
+		{
+			palette[i+1] = (unsigned char)(((7 - i) * a0 + i * a1 + 3) / 7);
+		}
+	} else
+	{
+		for( i = 1; i < 5; ++i )
+		{
+			palette[i+1] = (unsigned char)(((5 - i) * a0 + i * a1 + 2) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	/*	16 3 bit indices, in the last 6 bytes	*/
+	for( i = 0; i < 2; ++i )
+	{
+		unsigned int bits = compressed[2+i*3] | (compressed[3+i*3] << 8) | (compressed[4+i*3] << 16);
+		int k;
+		for( k = 0; k < 8; ++k )
+		{
+			values[i*8+k] = palette[(bits >> (k * 3)) & 7];
+		}
+	}
+}
@@ -0,0 +1,573 @@
+/*
+	on-disk cache of finished textures
+
+	An entry file is a header, a table of levels and then the
+	level data, every level starting on a 16 byte boundary.
+	Entries are written to a temporary name of their own and
+	renamed into place, so a reader never maps half a file and
+	two writers of the same key never share a file.  Temporary
+	files a crash left behind are evicted like entries.  Each load bumps
+	the file's modification time, which is what the eviction
+	sorts on.
+
+	public domain
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <image_cache.h>
+#define IMAGE_THREADS_NO_RUNNER
+#include <image_threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+/*	'STC1' on this machine's byte order, entries are never shared between machines	*/
+#define IMAGE_CACHE_MAGIC	(('S'<<0)|('T'<<8)|('C'<<16)|('1'<<24))
+/*	bump whenever what SOIL uploads for the same key changes	*/
+#define IMAGE_CACHE_VERSION	1
+#define IMAGE_CACHE_ALIGN(x)	(((x) + 15) & ~15ull)
+/*	leaves room for the file name after the directory	*/
+#define IMAGE_CACHE_MAX_PATH	1024
+#define IMAGE_CACHE_MAX_NAME	48
+/*	how many temporary names image_cache_save tries	*/
+#define IMAGE_CACHE_TEMP_TRIES	16
+
+typedef struct
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long key;
+	unsigned long long file_size;
+	unsigned int texture_type;
+	unsigned int flags;
+	int swizzle;
+	int num_levels;
+} image_cache_header;
+
+typedef struct
+{
+	unsigned int internal_format;
+	unsigned int format;
+	int width, height;
+	int size;
+	unsigned int offset;
+} image_cache_level_header;
+
+/*	what the eviction needs to know about each entry	*/
+typedef struct
+{
+	char name[IMAGE_CACHE_MAX_NAME];
+	unsigned long long size;
+	unsigned long long stamp;
+} image_cache_file;
+
+/********* xxHash64 *********/
+#define HASH_PRIME1	0x9E3779B185EBCA87ull
+#define HASH_PRIME2	0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME3	0x165667B19E3779F9ull
+#define HASH_PRIME4	0x85EBCA77C2B2AE63ull
+#define HASH_PRIME5	0x27D4EB2F165667C5ull
+
+static unsigned long long hash_rotate( unsigned long long x, int bits )
+{
+	return (x << bits) | (x >> (64 - bits));
+}
+
+static unsigned long long hash_read64( const unsigned char *p )
+{
+	unsigned long long x;
+	memcpy( &x, p, 8 );
+	return x;
+}
+
+static unsigned long long hash_round( unsigned long long acc, unsigned long long input )
+{
+	acc += input * HASH_PRIME2;
+	return hash_rotate( acc, 31 ) * HASH_PRIME1;
+}
+
+static unsigned long long hash_merge( unsigned long long acc, unsigned long long value )
+{
+	acc ^= hash_round( 0, value );
+	return acc * HASH_PRIME1 + HASH_PRIME4;
+}
+
+unsigned long long
+image_cache_hash
+(
+    const void *data, int length,
+    unsigned long long seed
+)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + length;
+	unsigned long long h;
+	if( length >= 32 )
+	{
+		/*	4 independent lanes, 32 bytes a step	*/
+		unsigned long long v1 = seed + HASH_PRIME1 + HASH_PRIME2;
+		unsigned long long v2 = seed + HASH_PRIME2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - HASH_PRIME1;
+		const unsigned char *limit = end - 32;
+		do
+		{
+			v1 = hash_round( v1, hash_read64( p ) );
+			v2 = hash_round( v2, hash_read64( p + 8 ) );
+			v3 = hash_round( v3, hash_read64( p + 16 ) );
+			v4 = hash_round( v4, hash_read64( p + 24 ) );
+			p += 32;
+		} while( p <= limit );
+		h = hash_rotate( v1, 1 ) + hash_rotate( v2, 7 ) + hash_rotate( v3, 12 ) + hash_rotate( v4, 18 );
+		h = hash_merge( h, v1 );
+		h = hash_merge( h, v2 );
+		h = hash_merge( h, v3 );
+		h = hash_merge( h, v4 );
+	} else
+	{
+		h = seed + HASH_PRIME5;
+	}
+	h += (unsigned long long)length;
+	for( ; p + 8 <= end; p += 8 )
+	{
+		h ^= hash_round( 0, hash_read64( p ) );
+		h = hash_rotate( h, 27 ) * HASH_PRIME1 + HASH_PRIME4;
+	}
+	if( p + 4 <= end )
+	{
+		unsigned int x;
+		memcpy( &x, p, 4 );
+		h ^= x * HASH_PRIME1;
+		h = hash_rotate( h, 23 ) * HASH_PRIME2 + HASH_PRIME3;
+		p += 4;
+	}
+	for( ; p < end; ++p )
+	{
+		h ^= *p * HASH_PRIME5;
+		h = hash_rotate( h, 11 ) * HASH_PRIME1;
+	}
+	h ^= h >> 33;
+	h *= HASH_PRIME2;
+	h ^= h >> 29;
+	h *= HASH_PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+/********* entries *********/
+void
+image_cache_init_entry
+(
+    image_cache_entry *entry
+)
+{
+	memset( entry, 0, sizeof( image_cache_entry ) );
+}
+
+int
+image_cache_add_level
+(
+    image_cache_entry *entry,
+    unsigned int internal_format, unsigned int format,
+    int width, int height,
+    int size, const unsigned char *const data
+)
+{
+	image_cache_level *level;
+	unsigned char *copy;
+	if( (entry->num_levels >= IMAGE_CACHE_MAX_LEVELS) || (size <= 0) )
+	{
+		entry->incomplete = 1;
+		return 0;
+	}
+	copy = (unsigned char*)malloc( size );
+	if( NULL == copy )
+	{
+		entry->incomplete = 1;
+		return 0;
+	}
+	memcpy( copy, data, size );
+	level = &entry->levels[entry->num_levels++];
+	level->internal_format = internal_format;
+	level->format = format;
+	level->width = width;
+	level->height = height;
+	level->size = size;
+	level->data = copy;
+	return 1;
+}
+
+void
+image_cache_free_entry
+(
+    image_cache_entry *entry
+)
+{
+	int i;
+	if( entry->map.data )
+	{
+		stbi_unmap_file( &entry->map );
+	} else
+	{
+		for( i = 0; i < entry->num_levels; ++i )
+		{
+			free( (void*)entry->levels[i].data );
+		}
+	}
+	image_cache_init_entry( entry );
+}
+
+/********* files *********/
+static int image_cache_path( char *path, const char *directory, unsigned long long key, const char *extension )
+{
+	if( strlen( directory ) + IMAGE_CACHE_MAX_NAME > IMAGE_CACHE_MAX_PATH )
+	{
+		return 0;
+	}
+	sprintf( path, "%s/%08x%08x.%s", directory,
+		(unsigned int)(key >> 32), (unsigned int)key, extension );
+	return 1;
+}
+
+/*
+	Creates a temporary file for key that no other thread or
+	process is writing.  The process id and a per-thread counter
+	make the name, and O_EXCL makes sure it really is new (threads
+	whose counters meet just move on to the next number).
+*/
+static FILE *image_cache_create_temp( char *path, const char *directory, unsigned long long key )
+{
+	static IMAGE_THREAD_LOCAL unsigned int counter = 0;
+	int tries, fd;
+	if( strlen( directory ) + IMAGE_CACHE_MAX_NAME > IMAGE_CACHE_MAX_PATH )
+	{
+		return NULL;
+	}
+	for( tries = 0; tries < IMAGE_CACHE_TEMP_TRIES; ++tries )
+	{
+		FILE *f;
+#ifdef _WIN32
+		unsigned int pid = (unsigned int)_getpid();
+#else
+		unsigned int pid = (unsigned int)getpid();
+#endif
+		sprintf( path, "%s/%08x%08x.%x.%x.tmp", directory,
+			(unsigned int)(key >> 32), (unsigned int)key, pid, counter++ );
+#ifdef _WIN32
+		fd = _open( path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE );
+		f = (fd >= 0) ? _fdopen( fd, "wb" ) : NULL;
+		if( (fd >= 0) && (NULL == f) )
+		{
+			_close( fd );
+		}
+#else
+		fd = open( path, O_WRONLY | O_CREAT | O_EXCL, 0666 );
+		f = (fd >= 0) ? fdopen( fd, "wb" ) : NULL;
+		if( (fd >= 0) && (NULL == f) )
+		{
+			close( fd );
+		}
+#endif
+		if( fd >= 0 )
+		{
+			if( NULL == f )
+			{
+				remove( path );
+			}
+			return f;
+		}
+		if( errno != EEXIST )
+		{
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int image_cache_compare_stamps( const void *a, const void *b )
+{
+	unsigned long long stamp_a = ((const image_cache_file*)a)->stamp;
+	unsigned long long stamp_b = ((const image_cache_file*)b)->stamp;
+	return (stamp_a < stamp_b) ? -1 : (stamp_a > stamp_b);
+}
+
+/*	is name an entry, or a temporary file one was written to?	*/
+static int image_cache_is_cache_file( const char *name )
+{
+	size_t length = strlen( name );
+	return (length >= 4) && (length < IMAGE_CACHE_MAX_NAME) &&
+		(!strcmp( name + length - 4, ".stc" ) || !strcmp( name + length - 4, ".tmp" ));
+}
+
+/*	collects the entries (and temporary files) in directory, the caller frees the list	*/
+static image_cache_file *image_cache_list( const char *directory, int *count )
+{
+	image_cache_file *files = NULL;
+	int capacity = 0;
+	char path[IMAGE_CACHE_MAX_PATH];
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search;
+	*count = 0;
+	sprintf( path, "%s/*.*", directory );
+	search = FindFirstFileA( path, &found );
+	if( search == INVALID_HANDLE_VALUE )
+	{
+		return NULL;
+	}
+	do
+	{
+		image_cache_file *file;
+		if( !image_cache_is_cache_file( found.cFileName ) )
+		{
+			continue;
+		}
+#else
+	DIR *dir = opendir( directory );
+	struct dirent *found;
+	*count = 0;
+	if( NULL == dir )
+	{
+		return NULL;
+	}
+	while( (found = readdir( dir )) != NULL )
+	{
+		image_cache_file *file;
+		struct stat info;
+		if( !image_cache_is_cache_file( found->d_name ) )
+		{
+			continue;
+		}
+		sprintf( path, "%s/%s", directory, found->d_name );
+		if( stat( path, &info ) != 0 )
+		{
+			continue;
+		}
+#endif
+		if( *count == capacity )
+		{
+			image_cache_file *grown;
+			capacity = capacity ? capacity * 2 : 64;
+			grown = (image_cache_file*)realloc( files, capacity * sizeof( image_cache_file ) );
+			if( NULL == grown )
+			{
+				break;
+			}
+			files = grown;
+		}
+		file = &files[(*count)++];
+#ifdef _WIN32
+		strcpy( file->name, found.cFileName );
+		file->size = ((unsigned long long)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+		file->stamp = ((unsigned long long)found.ftLastWriteTime.dwHighDateTime << 32) |
+			found.ftLastWriteTime.dwLowDateTime;
+	} while( FindNextFileA( search, &found ) );
+	FindClose( search );
+#else
+		strcpy( file->name, found->d_name );
+		file->size = (unsigned long long)info.st_size;
+		file->stamp = (unsigned long long)info.st_mtime;
+	}
+	closedir( dir );
+#endif
+	return files;
+}
+
+/*	deletes the least recently used entries until the rest fit in max_bytes	*/
+static void image_cache_evict( const char *directory, unsigned long long max_bytes )
+{
+	char path[IMAGE_CACHE_MAX_PATH];
+	unsigned long long total = 0;
+	int count, i;
+	image_cache_file *files = image_cache_list( directory, &count );
+	for( i = 0; i < count; ++i )
+	{
+		total += files[i].size;
+	}
+	if( total > max_bytes )
+	{
+		qsort( files, count, sizeof( image_cache_file ), image_cache_compare_stamps );
+		for( i = 0; (i < count) && (total > max_bytes); ++i )
+		{
+			sprintf( path, "%s/%s", directory, files[i].name );
+			if( remove( path ) == 0 )
+			{
+				total -= files[i].size;
+			}
+		}
+	}
+	free( files );
+}
+
+int
+image_cache_save
+(
+    const char *directory,
+    unsigned long long key,
+    const image_cache_entry *entry,
+    unsigned long long max_bytes
+)
+{
+	image_cache_header header;
+	image_cache_level_header levels[IMAGE_CACHE_MAX_LEVELS];
+	char temp_path[IMAGE_CACHE_MAX_PATH], path[IMAGE_CACHE_MAX_PATH];
+	static const unsigned char padding[16] = { 0 };
+	unsigned long long offset;
+	FILE *f;
+	int i, ok;
+	if( (entry->num_levels <= 0) || entry->incomplete ||
+		!image_cache_path( path, directory, key, "stc" ) )
+	{
+		return 0;
+	}
+	/*	lay the levels out	*/
+	memset( &header, 0, sizeof( header ) );
+	memset( levels, 0, sizeof( levels ) );
+	offset = IMAGE_CACHE_ALIGN( sizeof( header ) + entry->num_levels * sizeof( image_cache_level_header ) );
+	for( i = 0; i < entry->num_levels; ++i )
+	{
+		levels[i].internal_format = entry->levels[i].internal_format;
+		levels[i].format = entry->levels[i].format;
+		levels[i].width = entry->levels[i].width;
+		levels[i].height = entry->levels[i].height;
+		levels[i].size = entry->levels[i].size;
+		levels[i].offset = (unsigned int)offset;
+		offset = IMAGE_CACHE_ALIGN( offset + entry->levels[i].size );
+	}
+	if( (offset > max_bytes) || (offset >= 0x7fffffff) )
+	{
+		/*	it would only push everything else out	*/
+		return 0;
+	}
+	header.magic = IMAGE_CACHE_MAGIC;
+	header.version = IMAGE_CACHE_VERSION;
+	header.key = key;
+	header.file_size = offset;
+	header.texture_type = entry->texture_type;
+	header.flags = entry->flags;
+	header.swizzle = entry->swizzle;
+	header.num_levels = entry->num_levels;
+	/*	the directory may not be there yet	*/
+#ifdef _WIN32
+	_mkdir( directory );
+#else
+	mkdir( directory, 0777 );
+#endif
+	f = image_cache_create_temp( temp_path, directory, key );
+	if( NULL == f )
+	{
+		return 0;
+	}
+	ok = (fwrite( &header, sizeof( header ), 1, f ) == 1) &&
+		(fwrite( levels, sizeof( image_cache_level_header ), entry->num_levels, f ) == (size_t)entry->num_levels);
+	offset = sizeof( header ) + entry->num_levels * sizeof( image_cache_level_header );
+	for( i = 0; ok && (i < entry->num_levels); ++i )
+	{
+		int pad = (int)(levels[i].offset - offset);
+		ok = (fwrite( padding, 1, pad, f ) == (size_t)pad) &&
+			(fwrite( entry->levels[i].data, 1, entry->levels[i].size, f ) == (size_t)entry->levels[i].size);
+		offset = levels[i].offset + entry->levels[i].size;
+	}
+	/*	and the tail padding, so the size matches the header	*/
+	if( ok && (offset < header.file_size) )
+	{
+		int pad = (int)(header.file_size - offset);
+		ok = (fwrite( padding, 1, pad, f ) == (size_t)pad);
+	}
+	ok = (fclose( f ) == 0) && ok;
+	if( ok )
+	{
+#ifdef _WIN32
+		ok = MoveFileExA( temp_path, path, MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+		ok = rename( temp_path, path ) == 0;
+#endif
+	}
+	if( !ok )
+	{
+		remove( temp_path );
+		return 0;
+	}
+	image_cache_evict( directory, max_bytes );
+	return 1;
+}
+
+int
+image_cache_load
+(
+    const char *directory,
+    unsigned long long key,
+    image_cache_entry *entry
+)
+{
+	char path[IMAGE_CACHE_MAX_PATH];
+	image_cache_header header;
+	const image_cache_level_header *levels;
+	int i;
+	image_cache_init_entry( entry );
+	if( !image_cache_path( path, directory, key, "stc" ) ||
+		!stbi_map_file( path, &entry->map ) )
+	{
+		return 0;
+	}
+	/*	anything that doesn't add up is a miss (and gets overwritten)	*/
+	if( entry->map.len < (int)sizeof( header ) )
+	{
+		image_cache_free_entry( entry );
+		return 0;
+	}
+	memcpy( &header, entry->map.data, sizeof( header ) );
+	if( (header.magic != IMAGE_CACHE_MAGIC) || (header.version != IMAGE_CACHE_VERSION) ||
+		(header.key != key) || (header.file_size != (unsigned long long)entry->map.len) ||
+		(header.num_levels <= 0) || (header.num_levels > IMAGE_CACHE_MAX_LEVELS) ||
+		(sizeof( header ) + header.num_levels * sizeof( image_cache_level_header ) > (size_t)entry->map.len) )
+	{
+		image_cache_free_entry( entry );
+		return 0;
+	}
+	levels = (const image_cache_level_header*)(entry->map.data + sizeof( header ));
+	for( i = 0; i < header.num_levels; ++i )
+	{
+		if( (levels[i].size <= 0) ||
+			((unsigned long long)levels[i].offset + levels[i].size > header.file_size) )
+		{
+			image_cache_free_entry( entry );
+			return 0;
+		}
+		entry->levels[i].internal_format = levels[i].internal_format;
+		entry->levels[i].format = levels[i].format;
+		entry->levels[i].width = levels[i].width;
+		entry->levels[i].height = levels[i].height;
+		entry->levels[i].size = levels[i].size;
+		entry->levels[i].data = entry->map.data + levels[i].offset;
+	}
+	entry->texture_type = header.texture_type;
+	entry->flags = header.flags;
+	entry->swizzle = header.swizzle;
+	entry->num_levels = header.num_levels;
+	/*	just used, so it is the last to be evicted	*/
+#ifdef _WIN32
+	_utime( path, NULL );
+#else
+	utime( path, NULL );
+#endif
+	return 1;
+}
@@ -8,7 +8,9 @@
 
 #include "image_helper.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "image_threads.h"
 
 /*	Upscaling the image uses simple bilinear interpolation	*/
 int
@@ -151,44 +153,674 @@ int
 	return 1;
 }
 
+unsigned char clamp_byte( int x ) { return ( (x) < 0 ? (0) : ( (x) > 255 ? 255 : (x) ) ); }
+
+/*	The SSE2 path is part of every x86-64 target, so no runtime check is needed	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMAGE_HELPER_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+	Box filters one output row from a pair of input rows,
+	(a+b+c+d+2)/4 for every channel, exactly like mipmap_image
+	with a 2x2 block.  The SSE2 loop handles 1, 2 and 4 channels,
+	8 output bytes per step, and the scalar loop finishes the row.
+*/
+static void
+	mipmap_box_row
+	(
+		const unsigned char* row0, const unsigned char* row1,
+		int width, int channels,
+		unsigned char* out, int out_width
+	)
+{
+	int i = 0, c;
+	/*	a 1 pixel wide level only has vertical neighbours	*/
+	const int step = (width > 1) ? channels : 0;
+#ifdef IMAGE_HELPER_SSE2
+	if( (step != 0) && ((channels == 1) || (channels == 2) || (channels == 4)) )
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16( 1 );
+		const __m128i rounding = _mm_set1_epi16( 2 );
+		const int out_bytes = out_width * channels;
+		for( ; i + 8 <= out_bytes; i += 8 )
+		{
+			__m128i a = _mm_loadu_si128( (const __m128i*)(row0 + 2*i) );
+			__m128i b = _mm_loadu_si128( (const __m128i*)(row1 + 2*i) );
+			/*	vertical sums, 16 bits each	*/
+			__m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) );
+			__m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) );
+			__m128i sum;
+			/*	then add each pixel to its right hand neighbour	*/
+			if( channels == 4 )
+			{
+				sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+			} else if( channels == 2 )
+			{
+				__m128 lo_f = _mm_castsi128_ps( lo ), hi_f = _mm_castsi128_ps( hi );
+				sum = _mm_add_epi16(
+						_mm_castps_si128( _mm_shuffle_ps( lo_f, hi_f, _MM_SHUFFLE( 2, 0, 2, 0 ) ) ),
+						_mm_castps_si128( _mm_shuffle_ps( lo_f, hi_f, _MM_SHUFFLE( 3, 1, 3, 1 ) ) ) );
+			} else
+			{
+				/*	at most 4*255, the signed pack can't saturate	*/
+				sum = _mm_packs_epi32( _mm_madd_epi16( lo, ones ), _mm_madd_epi16( hi, ones ) );
+			}
+			sum = _mm_srli_epi16( _mm_add_epi16( sum, rounding ), 2 );
+			_mm_storel_epi64( (__m128i*)(out + i), _mm_packus_epi16( sum, sum ) );
+		}
+		/*	i is a whole number of pixels, channels divides 8	*/
+		i /= channels;
+	}
+#endif
+	for( ; i < out_width; ++i )
+	{
+		const int index = 2*i*channels;
+		for( c = 0; c < channels; ++c )
+		{
+			out[i*channels + c] = (unsigned char)((
+					row0[index + c] + row0[index + step + c] +
+					row1[index + c] + row1[index + step + c] + 2) >> 2);
+		}
+	}
+}
+
+/*	modified Bessel function of the first kind, order 0	*/
+static float bessel_i0( float x )
+{
+	float sum = 1.0f, term = 1.0f;
+	int k;
+	for( k = 1; k < 20; ++k )
+	{
+		term *= (x * 0.5f / k) * (x * 0.5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float sinc( float x )
+{
+	const float pi = 3.14159265358979f;
+	if( fabsf( x ) < 1e-6f )
+	{
+		return 1.0f;
+	}
+	return sinf( pi * x ) / (pi * x);
+}
+
+/*
+	Fills in the weights of the 8 taps around each output pixel,
+	for source texels 0.5, 1.5, 2.5 and 3.5 texels from its center
+	(each used on both sides), normalized to sum to 1.
+	Returns how many taps per side are non-zero.
+*/
+static int
+	mipmap_filter_weights
+	(
+		int filter, float weights[4]
+	)
+{
+	float sum = 0.0f;
+	int i;
+	if( filter == MIPMAP_FILTER_BOX )
+	{
+		weights[0] = 0.5f;
+		weights[1] = weights[2] = weights[3] = 0.0f;
+		return 1;
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		/*	distance in output texels, the kernels span 2 of them either way	*/
+		float t = (i + 0.5f) * 0.5f;
+		if( filter == MIPMAP_FILTER_KAISER )
+		{
+			const float alpha = 4.0f;
+			float r = t * 0.5f;
+			weights[i] = sinc( t ) * bessel_i0( alpha * sqrtf( 1.0f - r*r ) ) / bessel_i0( alpha );
+		} else
+		{
+			/*	Lanczos 2	*/
+			weights[i] = sinc( t ) * sinc( t * 0.5f );
+		}
+		sum += 2.0f * weights[i];
+	}
+	for( i = 0; i < 4; ++i )
+	{
+		weights[i] /= sum;
+	}
+	return 4;
+}
+
+/*
+	The separable float path, for the windowed sinc filters and
+	for gamma correct averaging.  Each input row is converted to
+	[0,1] floats once (linear light for the color channels when
+	asked) with its edge texels repeated, filtered horizontally
+	into a ring of 8 rows, and each output row is then the
+	weighted sum of the ring rows it covers.
+*/
+static int
+	mipmap_filtered
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int mip_width, int mip_height,
+		int filter, int gamma_correct
+	)
+{
+	/*	linear [0,1] to an sRGB code, fine enough to round correctly near black	*/
+	enum { TO_SRGB_SIZE = 16384 };
+	float weights[4], taps_weight[8];
+	float to_float[2][256];
+	unsigned char *to_srgb;
+	int ring_row[8];
+	float *ring, *accum, *padded;
+	const int row_floats = mip_width * channels;
+	/*	for channels = 2 or 4, the last one is alpha, and stays linear	*/
+	const int color_channels = channels - (1 - (channels & 1));
+	int taps, pad, i, j, c, k;
+
+	taps = mipmap_filter_weights( filter, weights );
+	pad = taps;
+	for( k = 1 - taps; k <= taps; ++k )
+	{
+		taps_weight[k + taps - 1] = weights[(k > 0) ? (k - 1) : -k];
+	}
+	for( i = 0; i < 256; ++i )
+	{
+		float v = i / 255.0f;
+		to_float[1][i] = v;
+		if( gamma_correct )
+		{
+			v = (v <= 0.04045f) ? v / 12.92f : powf( (v + 0.055f) / 1.055f, 2.4f );
+		}
+		to_float[0][i] = v;
+	}
+	ring = (float*)malloc( 8 * row_floats * sizeof(float) );
+	accum = (float*)malloc( row_floats * sizeof(float) );
+	padded = (float*)malloc( (width + 2*pad) * channels * sizeof(float) );
+	to_srgb = (unsigned char*)malloc( TO_SRGB_SIZE + 1 );
+	if( (ring == NULL) || (accum == NULL) || (padded == NULL) || (to_srgb == NULL) )
+	{
+		free( ring );
+		free( accum );
+		free( padded );
+		free( to_srgb );
+		return 0;
+	}
+	/*	the nearest code for each step, the codes only ever go up	*/
+	for( i = 0, k = 0; i <= TO_SRGB_SIZE; ++i )
+	{
+		float v = (float)i / TO_SRGB_SIZE;
+		while( (k < 255) && (v > 0.5f * (to_float[0][k] + to_float[0][k+1])) )
+		{
+			++k;
+		}
+		to_srgb[i] = (unsigned char)k;
+	}
+	for( k = 0; k < 8; ++k )
+	{
+		ring_row[k] = -1;
+	}
+	for( j = 0; j < mip_height; ++j )
+	{
+		for( i = 0; i < row_floats; ++i )
+		{
+			accum[i] = 0.0f;
+		}
+		/*	source rows 2j-taps+1 .. 2j+taps, clamped to the edge	*/
+		for( k = 1 - taps; k <= taps; ++k )
+		{
+			int y = 2*j + k;
+			const float wy = taps_weight[k + taps - 1];
+			float *row;
+			if( y < 0 ) { y = 0; }
+			if( y > height - 1 ) { y = height - 1; }
+			row = ring + (y & 7) * row_floats;
+			if( ring_row[y & 7] != y )
+			{
+				const unsigned char *src = orig + y * width * channels;
+				int x;
+				ring_row[y & 7] = y;
+				for( x = 0; x < width; ++x )
+				{
+					for( c = 0; c < color_channels; ++c )
+					{
+						padded[(x + pad) * channels + c] = to_float[0][src[x*channels + c]];
+					}
+					for( ; c < channels; ++c )
+					{
+						padded[(x + pad) * channels + c] = to_float[1][src[x*channels + c]];
+					}
+				}
+				for( x = 0; x < pad; ++x )
+				{
+					memcpy( padded + x * channels, padded + pad * channels, channels * sizeof(float) );
+					memcpy( padded + (width + pad + x) * channels,
+							padded + (width + pad - 1) * channels, channels * sizeof(float) );
+				}
+				/*	filter this input row horizontally	*/
+#ifdef IMAGE_HELPER_SSE2
+				if( channels == 4 )
+				{
+					for( i = 0; i < mip_width; ++i )
+					{
+						const float *in = padded + (pad + 1 - taps + 2*i) * 4;
+						__m128 sum = _mm_setzero_ps();
+						for( x = 0; x < 2*taps; ++x )
+						{
+							sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( taps_weight[x] ), _mm_loadu_ps( in + x*4 ) ) );
+						}
+						_mm_storeu_ps( row + i*4, sum );
+					}
+				} else
+#endif
+				{
+					for( i = 0; i < row_floats; ++i )
+					{
+						row[i] = 0.0f;
+					}
+					for( x = 0; x < 2*taps; ++x )
+					{
+						const float wx = taps_weight[x];
+						const float *in = padded + (pad + 1 - taps + x) * channels;
+						for( i = 0; i < mip_width; ++i )
+						{
+							for( c = 0; c < channels; ++c )
+							{
+								row[i*channels + c] += wx * in[2*i*channels + c];
+							}
+						}
+					}
+				}
+			}
+			i = 0;
+#ifdef IMAGE_HELPER_SSE2
+			for( ; i + 4 <= row_floats; i += 4 )
+			{
+				_mm_storeu_ps( accum + i, _mm_add_ps( _mm_loadu_ps( accum + i ),
+						_mm_mul_ps( _mm_set1_ps( wy ), _mm_loadu_ps( row + i ) ) ) );
+			}
+#endif
+			for( ; i < row_floats; ++i )
+			{
+				accum[i] += wy * row[i];
+			}
+		}
+		/*	and back to bytes	*/
+		for( i = 0; i < row_floats; i += channels )
+		{
+			for( c = 0; c < channels; ++c )
+			{
+				float v = accum[i + c];
+				if( v < 0.0f ) { v = 0.0f; }
+				if( v > 1.0f ) { v = 1.0f; }
+				resampled[j*row_floats + i + c] = (c < color_channels) ?
+						to_srgb[(int)(v * TO_SRGB_SIZE + 0.5f)] :
+						(unsigned char)(v * 255.0f + 0.5f);
+			}
+		}
+	}
+	free( ring );
+	free( accum );
+	free( padded );
+	free( to_srgb );
+	return 1;
+}
+
 int
-	scale_image_RGB_to_NTSC_safe
+	mipmap_image_next_level
 	(
-		unsigned char* orig,
-		int width, int height, int channels
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int filter, int gamma_correct
 	)
 {
-	const float scale_lo = 16.0f - 0.499f;
-	const float scale_hi = 235.0f + 0.499f;
-	int i, j;
-	int nc = channels;
-	unsigned char scale_LUT[256];
+	int mip_width, mip_height, j;
+
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
-		(channels < 1) || (orig == NULL) )
+		(channels < 1) || (orig == NULL) ||
+		(resampled == NULL) ||
+		(filter < MIPMAP_FILTER_BOX) || (filter > MIPMAP_FILTER_LANCZOS) )
 	{
 		/*	nothing to do	*/
 		return 0;
 	}
-	/*	set up the scaling Look Up Table	*/
-	for( i = 0; i < 256; ++i )
+	mip_width = (width > 1) ? width / 2 : 1;
+	mip_height = (height > 1) ? height / 2 : 1;
+	if( (filter != MIPMAP_FILTER_BOX) || gamma_correct )
 	{
-		scale_LUT[i] = (unsigned char)((scale_hi - scale_lo) * i / 255.0f + scale_lo);
+		return mipmap_filtered( orig, width, height, channels,
+				resampled, mip_width, mip_height, filter, gamma_correct );
 	}
-	/*	for channels = 2 or 4, ignore the alpha component	*/
-	nc -= 1 - (channels & 1);
-	/*	OK, go through the image and scale any non-alpha components	*/
-	for( i = 0; i < width*height*channels; i += channels )
+	for( j = 0; j < mip_height; ++j )
 	{
-		for( j = 0; j < nc; ++j )
+		const unsigned char *row0 = orig + 2*j*width*channels;
+		/*	a 1 pixel high level only has horizontal neighbours	*/
+		const unsigned char *row1 = (height > 1) ? row0 + width*channels : row0;
+		mipmap_box_row( row0, row1, width, channels,
+				resampled + j*mip_width*channels, mip_width );
+	}
+	return 1;
+}
+
+/*	see set_image_transform_options()	*/
+static int transform_threads = 0;
+static int transform_use_simd = 1;
+
+/*	images with fewer pixels than this are not worth waking up threads for	*/
+#define TRANSFORM_MIN_PIXELS_PER_THREAD	(1 << 16)
+
+/*
+	One band of a transform_image() call.  Bands are ranges of
+	result rows, or when flipping in place, of the row pairs
+	that swap places (the first half of the image).
+*/
+typedef struct
+{
+	const unsigned char *orig;
+	unsigned char *result;
+	int width, height, channels;
+	unsigned int transforms;
+	const unsigned char *NTSC_LUT;
+	int first_row, end_row;
+} transform_job;
+
+/*	(c*a+128)>>8 on the color channels of a row	*/
+static void
+	multiply_alpha_row
+	(
+		unsigned char *row,
+		int width, int channels
+	)
+{
+	int i = 0;
+	if( channels == 2 )
+	{
+		for( ; i < 2*width; i += 2 )
+		{
+			row[i] = (row[i] * row[i+1] + 128) >> 8;
+		}
+		return;
+	}
+#ifdef IMAGE_HELPER_SSE2
+	if( transform_use_simd )
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16( 128 );
+		const __m128i alpha_mask = _mm_set_epi16( -1, 0, 0, 0, -1, 0, 0, 0 );
+		for( ; i + 16 <= 4*width; i += 16 )
+		{
+			__m128i p = _mm_loadu_si128( (const __m128i*)(row + i) );
+			__m128i lo = _mm_unpacklo_epi8( p, zero );
+			__m128i hi = _mm_unpackhi_epi8( p, zero );
+			/*	each pixel's alpha in all 4 of its lanes	*/
+			__m128i alpha_lo = _mm_shufflehi_epi16( _mm_shufflelo_epi16( lo, 0xFF ), 0xFF );
+			__m128i alpha_hi = _mm_shufflehi_epi16( _mm_shufflelo_epi16( hi, 0xFF ), 0xFF );
+			/*	at most 255*255+128, the logical shift keeps it unsigned	*/
+			__m128i mul_lo = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( lo, alpha_lo ), rounding ), 8 );
+			__m128i mul_hi = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( hi, alpha_hi ), rounding ), 8 );
+			lo = _mm_or_si128( _mm_andnot_si128( alpha_mask, mul_lo ), _mm_and_si128( alpha_mask, lo ) );
+			hi = _mm_or_si128( _mm_andnot_si128( alpha_mask, mul_hi ), _mm_and_si128( alpha_mask, hi ) );
+			_mm_storeu_si128( (__m128i*)(row + i), _mm_packus_epi16( lo, hi ) );
+		}
+	}
+#endif
+	for( ; i < 4*width; i += 4 )
+	{
+		row[i+0] = (row[i+0] * row[i+3] + 128) >> 8;
+		row[i+1] = (row[i+1] * row[i+3] + 128) >> 8;
+		row[i+2] = (row[i+2] * row[i+3] + 128) >> 8;
+	}
+}
+
+/*	RGB(A) to CoYCg or CoCgAY, see convert_RGB_to_YCoCg()	*/
+static void
+	YCoCg_row
+	(
+		unsigned char *row,
+		int width, int channels
+	)
+{
+	int i = 0;
+	if( channels == 3 )
+	{
+		for( ; i < 3*width; i += 3 )
+		{
+			int r = row[i+0];
+			int g = (row[i+1] + 1) >> 1;
+			int b = row[i+2];
+			int tmp = (2 + r + b) >> 2;
+			/*	Co	*/
+			row[i+0] = clamp_byte( 128 + ((r - b + 1) >> 1) );
+			/*	Y	*/
+			row[i+1] = clamp_byte( g + tmp );
+			/*	Cg	*/
+			row[i+2] = clamp_byte( 128 + g - tmp );
+		}
+		return;
+	}
+#ifdef IMAGE_HELPER_SSE2
+	if( transform_use_simd )
+	{
+		/*	one pixel per 32 bit lane	*/
+		const __m128i byte_mask = _mm_set1_epi32( 0xFF );
+		const __m128i one = _mm_set1_epi32( 1 );
+		const __m128i two = _mm_set1_epi32( 2 );
+		const __m128i half = _mm_set1_epi32( 128 );
+		for( ; i + 16 <= 4*width; i += 16 )
+		{
+			__m128i p = _mm_loadu_si128( (const __m128i*)(row + i) );
+			__m128i r = _mm_and_si128( p, byte_mask );
+			__m128i g = _mm_and_si128( _mm_srli_epi32( p, 8 ), byte_mask );
+			__m128i b = _mm_and_si128( _mm_srli_epi32( p, 16 ), byte_mask );
+			__m128i a = _mm_srli_epi32( p, 24 );
+			__m128i tmp = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( r, b ), two ), 2 );
+			__m128i co, cg, y;
+			g = _mm_srli_epi32( _mm_add_epi32( g, one ), 1 );
+			co = _mm_add_epi32( half, _mm_srai_epi32( _mm_add_epi32( _mm_sub_epi32( r, b ), one ), 1 ) );
+			cg = _mm_sub_epi32( _mm_add_epi32( half, g ), tmp );
+			y = _mm_add_epi32( g, tmp );
+			/*	all three are in [0,256], and the high 16 bits of
+				each lane are 0, so a 16 bit min is the clamp	*/
+			co = _mm_min_epi16( co, byte_mask );
+			cg = _mm_min_epi16( cg, byte_mask );
+			y = _mm_min_epi16( y, byte_mask );
+			p = _mm_or_si128(
+					_mm_or_si128( co, _mm_slli_epi32( cg, 8 ) ),
+					_mm_or_si128( _mm_slli_epi32( a, 16 ), _mm_slli_epi32( y, 24 ) ) );
+			_mm_storeu_si128( (__m128i*)(row + i), p );
+		}
+	}
+#endif
+	for( ; i < 4*width; i += 4 )
+	{
+		int r = row[i+0];
+		int g = (row[i+1] + 1) >> 1;
+		int b = row[i+2];
+		unsigned char a = row[i+3];
+		int tmp = (2 + r + b) >> 2;
+		/*	Co	*/
+		row[i+0] = clamp_byte( 128 + ((r - b + 1) >> 1) );
+		/*	Cg	*/
+		row[i+1] = clamp_byte( 128 + g - tmp );
+		/*	Alpha	*/
+		row[i+2] = a;
+		/*	Y	*/
+		row[i+3] = clamp_byte( g + tmp );
+	}
+}
+
+/*
+	Every transform but the flip, one after the other along
+	a row that is still in the cache from being copied
+*/
+static void
+	transform_row
+	(
+		const transform_job *job,
+		unsigned char *row
+	)
+{
+	const int channels = job->channels;
+	if( job->transforms & IMAGE_TRANSFORM_NTSC_SAFE_RGB )
+	{
+		/*	for channels = 2 or 4, ignore the alpha component	*/
+		const int nc = channels - (1 - (channels & 1));
+		int i, c;
+		for( i = 0; i < job->width*channels; i += channels )
+		{
+			for( c = 0; c < nc; ++c )
+			{
+				row[i+c] = job->NTSC_LUT[row[i+c]];
+			}
+		}
+	}
+	if( (job->transforms & IMAGE_TRANSFORM_MULTIPLY_ALPHA) &&
+		((channels == 2) || (channels == 4)) )
+	{
+		multiply_alpha_row( row, job->width, channels );
+	}
+	if( (job->transforms & IMAGE_TRANSFORM_YCoCg) &&
+		((channels == 3) || (channels == 4)) )
+	{
+		YCoCg_row( row, job->width, channels );
+	}
+}
+
+static void
+	transform_rows
+	(
+		const transform_job *job
+	)
+{
+	const int row_bytes = job->width * job->channels;
+	const int flip = (job->transforms & IMAGE_TRANSFORM_FLIP_Y) != 0;
+	int j;
+	if( flip && (job->orig == job->result) )
+	{
+		/*	swap each pair of rows, a piece at a time, then finish both	*/
+		unsigned char temp[1024];
+		for( j = job->first_row; j < job->end_row; ++j )
+		{
+			unsigned char *row1 = job->result + (size_t)j * row_bytes;
+			unsigned char *row2 = job->result + (size_t)(job->height - 1 - j) * row_bytes;
+			int i, n;
+			if( row1 != row2 )
+			{
+				for( i = 0; i < row_bytes; i += n )
+				{
+					n = (row_bytes - i < (int)sizeof( temp )) ? row_bytes - i : (int)sizeof( temp );
+					memcpy( temp, row1 + i, n );
+					memcpy( row1 + i, row2 + i, n );
+					memcpy( row2 + i, temp, n );
+				}
+				transform_row( job, row2 );
+			}
+			transform_row( job, row1 );
+		}
+		return;
+	}
+	for( j = job->first_row; j < job->end_row; ++j )
+	{
+		unsigned char *row = job->result + (size_t)j * row_bytes;
+		const unsigned char *from = job->orig +
+				(size_t)(flip ? job->height - 1 - j : j) * row_bytes;
+		if( from != row )
+		{
+			memcpy( row, from, row_bytes );
+		}
+		transform_row( job, row );
+	}
+}
+
+static void transform_band( void *job )
+{
+	transform_rows( (const transform_job*)job );
+}
+
+void
+	set_image_transform_options
+	(
+		int threads, int use_simd
+	)
+{
+	transform_threads = (threads < 0) ? 0 : threads;
+	transform_use_simd = use_simd;
+}
+
+int
+	transform_image
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* result,
+		unsigned int transforms
+	)
+{
+	const float scale_lo = 16.0f - 0.499f;
+	const float scale_hi = 235.0f + 0.499f;
+	unsigned char NTSC_LUT[256];
+	transform_job jobs[IMAGE_THREADS_MAX];
+	int rows, thread_count, t, i;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(orig == NULL) || (result == NULL) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	if( transforms & IMAGE_TRANSFORM_NTSC_SAFE_RGB )
+	{
+		/*	set up the scaling Look Up Table	*/
+		for( i = 0; i < 256; ++i )
 		{
-			orig[i+j] = scale_LUT[orig[i+j]];
+			NTSC_LUT[i] = (unsigned char)((scale_hi - scale_lo) * i / 255.0f + scale_lo);
 		}
 	}
+	/*	flipping in place works on pairs of rows	*/
+	rows = ((transforms & IMAGE_TRANSFORM_FLIP_Y) && (orig == result)) ? (height + 1) / 2 : height;
+	thread_count = image_threads_count( transform_threads, width * height,
+			TRANSFORM_MIN_PIXELS_PER_THREAD, rows );
+	for( t = 0; t < thread_count; ++t )
+	{
+		jobs[t].orig = orig;
+		jobs[t].result = result;
+		jobs[t].width = width;
+		jobs[t].height = height;
+		jobs[t].channels = channels;
+		jobs[t].transforms = transforms;
+		jobs[t].NTSC_LUT = NTSC_LUT;
+		jobs[t].first_row = rows * t / thread_count;
+		jobs[t].end_row = rows * (t+1) / thread_count;
+	}
+	image_threads_run( transform_band, jobs, sizeof(jobs[0]), thread_count );
 	return 1;
 }
 
-unsigned char clamp_byte( int x ) { return ( (x) < 0 ? (0) : ( (x) > 255 ? 255 : (x) ) ); }
+int
+	scale_image_RGB_to_NTSC_safe
+	(
+		unsigned char* orig,
+		int width, int height, int channels
+	)
+{
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (orig == NULL) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	return transform_image( orig, width, height, channels,
+			orig, IMAGE_TRANSFORM_NTSC_SAFE_RGB );
+}
 
 /*
 	This function takes the RGB components of the image
@@ -204,7 +836,6 @@ int
 		int width, int height, int channels
 	)
 {
-	int i;
 	/*	error check	*/
 	if( (width < 1) || (height < 1) ||
 		(channels < 3) || (channels > 4) ||
@@ -214,40 +845,8 @@ int
 		return -1;
 	}
 	/*	do the conversion	*/
-	if( channels == 3 )
-	{
-		for( i = 0; i < width*height*3; i += 3 )
-		{
-			int r = orig[i+0];
-			int g = (orig[i+1] + 1) >> 1;
-			int b = orig[i+2];
-			int tmp = (2 + r + b) >> 2;
-			/*	Co	*/
-			orig[i+0] = clamp_byte( 128 + ((r - b + 1) >> 1) );
-			/*	Y	*/
-			orig[i+1] = clamp_byte( g + tmp );
-			/*	Cg	*/
-			orig[i+2] = clamp_byte( 128 + g - tmp );
-		}
-	} else
-	{
-		for( i = 0; i < width*height*4; i += 4 )
-		{
-			int r = orig[i+0];
-			int g = (orig[i+1] + 1) >> 1;
-			int b = orig[i+2];
-			unsigned char a = orig[i+3];
-			int tmp = (2 + r + b) >> 2;
-			/*	Co	*/
-			orig[i+0] = clamp_byte( 128 + ((r - b + 1) >> 1) );
-			/*	Cg	*/
-			orig[i+1] = clamp_byte( 128 + g - tmp );
-			/*	Alpha	*/
-			orig[i+2] = a;
-			/*	Y	*/
-			orig[i+3] = clamp_byte( g + tmp );
-		}
-	}
+	transform_image( orig, width, height, channels,
+			orig, IMAGE_TRANSFORM_YCoCg );
 	/*	done	*/
 	return 0;
 }
@@ -9,7 +9,11 @@
       HDR (radiance rgbE format)
       writes BMP,TGA (define STBI_NO_WRITE to remove code)
       decoded from memory or through stdio FILE (define STBI_NO_STDIO to remove code)
-      supports installable dequantizing-IDCT, YCbCr-to-RGB conversion (define STBI_SIMD)
+      loading by filename decodes straight out of a read-only mapping of the file
+      SSE2 dequantizing-IDCT, YCbCr-to-RGB and 4:2:0 upsampling, picked at runtime;
+         installable replacements for the first two (stbi_install_idct etc)
+      JPEG restart intervals decoded, and colour converted, on one thread per core
+         (stbi_set_jpeg_threads; define STBI_NO_THREADS to remove code)
 */
 
 #include "stb_image_aug.h"
@@ -21,12 +25,40 @@
 
 #ifndef STBI_NO_STDIO
 #include <stdio.h>
+#if defined(_WIN32)
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define STBI_MMAP
+#endif
 #endif
 #include <stdlib.h>
 #include <memory.h>
 #include <assert.h>
 #include <stdarg.h>
 
+// SSE2 JPEG and PNG kernels: always there on x64 and SSE2 builds, 32-bit MSVC
+// builds that don't assume it ask the CPU before using them
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+  #define STBI_SSE2
+#elif defined(_MSC_VER) && defined(_M_IX86)
+  #define STBI_SSE2
+  #define STBI_SSE2_CPUID
+  #include <intrin.h>
+#endif
+#ifdef STBI_SSE2
+  #include <emmintrin.h>
+#endif
+
+#ifdef STBI_NO_THREADS
+#define IMAGE_THREADS_NO_RUNNER
+#endif
+#include "image_threads.h"
+
 #ifndef _MSC_VER
   #ifdef __cplusplus
   #define __forceinline inline
@@ -43,6 +75,7 @@ typedef   signed short  int16;
 typedef unsigned int   uint32;
 typedef   signed int    int32;
 typedef unsigned int   uint;
+typedef unsigned long long uint64;
 
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(uint32)==4];
@@ -63,17 +96,92 @@ typedef unsigned char validate_uint32[sizeof(uint32)==4];
 // Generic API that works on all image types
 //
 
-// this is not threadsafe
-static char *failure_reason;
+// the default context: what threads without one of their own read their
+// settings and loaders from. it holds no failure reason, each such thread
+// keeps its own
+static stbi_context default_context = {
+   NULL,
+   2.2f, 1.0f,
+   2.2f, 1.0f,
+   NULL, NULL,
+   0,
+   { NULL },
+   0,
+   NULL, NULL, NULL, NULL,
+};
+
+static IMAGE_THREAD_LOCAL stbi_context *current_context;
+static IMAGE_THREAD_LOCAL char *thread_failure_reason;
+
+static stbi_context *context(void)
+{
+   return current_context ? current_context : &default_context;
+}
+
+// every buffer goes through the current context's allocator
+static void *stbi_malloc(size_t size)
+{
+   stbi_context *ctx = context();
+   return ctx->malloc_fn ? ctx->malloc_fn(ctx->alloc_user, size) : malloc(size);
+}
+
+static void *stbi_realloc(void *p, size_t size)
+{
+   stbi_context *ctx = context();
+   return ctx->realloc_fn ? ctx->realloc_fn(ctx->alloc_user, p, size) : realloc(p, size);
+}
+
+static void stbi_free(void *p)
+{
+   stbi_context *ctx = context();
+   if (ctx->free_fn) ctx->free_fn(ctx->alloc_user, p); else free(p);
+}
+
+void stbi_set_allocator(void *(*malloc_fn)(void *user, size_t size),
+                        void *(*realloc_fn)(void *user, void *p, size_t size),
+                        void (*free_fn)(void *user, void *p), void *user)
+{
+   stbi_context *ctx = context();
+   ctx->malloc_fn = malloc_fn;
+   ctx->realloc_fn = realloc_fn;
+   ctx->free_fn = free_fn;
+   ctx->alloc_user = user;
+}
+
+void *stbi_image_alloc(size_t size)
+{
+   return stbi_malloc(size);
+}
+
+void stbi_context_init(stbi_context *ctx)
+{
+   *ctx = default_context;
+   ctx->failure_reason = NULL;
+}
+
+stbi_context *stbi_use_context(stbi_context *ctx)
+{
+   stbi_context *previous = current_context;
+   current_context = ctx;
+   return previous;
+}
 
 char *stbi_failure_reason(void)
 {
-   return failure_reason;
+   return current_context ? current_context->failure_reason : thread_failure_reason;
+}
+
+static void set_failure_reason(char *str)
+{
+   if (current_context)
+      current_context->failure_reason = str;
+   else
+      thread_failure_reason = str;
 }
 
 static int e(char *str)
 {
-   failure_reason = str;
+   set_failure_reason(str);
    return 0;
 }
 
@@ -90,24 +198,21 @@ static int e(char *str)
 
 void stbi_image_free(void *retval_from_stbi_load)
 {
-   free(retval_from_stbi_load);
+   stbi_free(retval_from_stbi_load);
 }
 
-#define MAX_LOADERS  32
-stbi_loader *loaders[MAX_LOADERS];
-static int max_loaders = 0;
-
 int stbi_register_loader(stbi_loader *loader)
 {
+   stbi_context *ctx = context();
    int i;
-   for (i=0; i < MAX_LOADERS; ++i) {
+   for (i=0; i < STBI_MAX_LOADERS; ++i) {
       // already present?
-      if (loaders[i] == loader)
+      if (ctx->loaders[i] == loader)
          return 1;
       // end of the list?
-      if (loaders[i] == NULL) {
-         loaders[i] = loader;
-         max_loaders = i+1;
+      if (ctx->loaders[i] == NULL) {
+         ctx->loaders[i] = loader;
+         ctx->num_loaders = i+1;
          return 1;
       }
    }
@@ -121,13 +226,110 @@ static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
 #ifndef STBI_NO_STDIO
+// the FILE path pulls every byte through fgetc, so whole files are mapped
+// instead (or, where that fails, read with a single fread) and decoded from memory
+int stbi_map_file(char const *filename, stbi_file_map *map)
+{
+   FILE *f;
+   long len;
+   stbi_uc *buffer;
+   map->data = NULL;
+   map->len = 0;
+   map->mapped = 0;
+#if defined(_WIN32)
+   {
+      HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+      if (file != INVALID_HANDLE_VALUE) {
+         LARGE_INTEGER size;
+         if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < 0x7fffffff) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+               // the view keeps the mapping alive by itself
+               map->data = (stbi_uc const *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+               CloseHandle(mapping);
+            }
+         }
+         CloseHandle(file);
+         if (map->data) {
+            map->len = (int) size.QuadPart;
+            map->mapped = 1;
+            return 1;
+         }
+      }
+   }
+#elif defined(STBI_MMAP)
+   {
+      int fd = open(filename, O_RDONLY);
+      if (fd >= 0) {
+         struct stat st;
+         if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < 0x7fffffff) {
+            int flags = MAP_PRIVATE;
+            void *data;
+            #ifdef MAP_POPULATE
+            // every loader reads the whole file, so fault it all in with one call
+            // rather than a page at a time
+            flags |= MAP_POPULATE;
+            #endif
+            data = mmap(NULL, (size_t) st.st_size, PROT_READ, flags, fd, 0);
+            if (data != MAP_FAILED) {
+               #ifdef POSIX_MADV_WILLNEED
+               // and ask for readahead where it can't be populated up front
+               posix_madvise(data, (size_t) st.st_size, POSIX_MADV_WILLNEED);
+               #endif
+               map->data = (stbi_uc const *) data;
+               map->len = (int) st.st_size;
+               map->mapped = 1;
+            }
+         }
+         close(fd);
+         if (map->mapped)
+            return 1;
+      }
+   }
+#endif
+   f = fopen(filename, "rb");
+   if (!f) return e("can't fopen", "Unable to open file");
+   fseek(f, 0, SEEK_END);
+   len = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   if (len < 0 || len >= 0x7fffffff) {
+      fclose(f);
+      return e("too large", "File too large to load");
+   }
+   buffer = (stbi_uc *) stbi_malloc(len ? len : 1);
+   if (!buffer) {
+      fclose(f);
+      return e("outofmem", "Out of memory");
+   }
+   map->data = buffer;
+   map->len = (int) fread(buffer, 1, len, f);
+   fclose(f);
+   return 1;
+}
+
+void stbi_unmap_file(stbi_file_map *map)
+{
+   if (map->mapped) {
+#if defined(_WIN32)
+      UnmapViewOfFile(map->data);
+#elif defined(STBI_MMAP)
+      munmap((void *) map->data, map->len);
+#endif
+   } else {
+      stbi_free((void *) map->data);
+   }
+   map->data = NULL;
+   map->len = 0;
+   map->mapped = 0;
+}
+
 unsigned char *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_map map;
    unsigned char *result;
-   if (!f) return epuc("can't fopen", "Unable to open file");
-   result = stbi_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!stbi_map_file(filename, &map)) return NULL;
+   result = stbi_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return result;
 }
 
@@ -152,9 +354,9 @@ unsigned char *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_c
       return hdr_to_ldr(hdr, *x, *y, req_comp ? req_comp : *comp);
    }
    #endif
-   for (i=0; i < max_loaders; ++i)
-      if (loaders[i]->test_file(f))
-         return loaders[i]->load_from_file(f,x,y,comp,req_comp);
+   for (i=0; i < context()->num_loaders; ++i)
+      if (context()->loaders[i]->test_file(f))
+         return context()->loaders[i]->load_from_file(f,x,y,comp,req_comp);
    // test tga last because it's a crappy test!
    if (stbi_tga_test_file(f))
       return stbi_tga_load_from_file(f,x,y,comp,req_comp);
@@ -183,9 +385,9 @@ unsigned char *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int
       return hdr_to_ldr(hdr, *x, *y, req_comp ? req_comp : *comp);
    }
    #endif
-   for (i=0; i < max_loaders; ++i)
-      if (loaders[i]->test_memory(buffer,len))
-         return loaders[i]->load_from_memory(buffer,len,x,y,comp,req_comp);
+   for (i=0; i < context()->num_loaders; ++i)
+      if (context()->loaders[i]->test_memory(buffer,len))
+         return context()->loaders[i]->load_from_memory(buffer,len,x,y,comp,req_comp);
    // test tga last because it's a crappy test!
    if (stbi_tga_test_memory(buffer,len))
       return stbi_tga_load_from_memory(buffer,len,x,y,comp,req_comp);
@@ -197,11 +399,11 @@ unsigned char *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int
 #ifndef STBI_NO_STDIO
 float *stbi_loadf(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_map map;
    float *result;
-   if (!f) return epf("can't fopen", "Unable to open file");
-   result = stbi_loadf_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!stbi_map_file(filename, &map)) return NULL;
+   result = stbi_loadf_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return result;
 }
 
@@ -249,11 +451,11 @@ int stbi_is_hdr_from_memory(stbi_uc const *buffer, int len)
 #ifndef STBI_NO_STDIO
 extern int      stbi_is_hdr          (char const *filename)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_map map;
    int result=0;
-   if (f) {
-      result = stbi_is_hdr_from_file(f);
-      fclose(f);
+   if (stbi_map_file(filename, &map)) {
+      result = stbi_is_hdr_from_memory(map.data,map.len);
+      stbi_unmap_file(&map);
    }
    return result;
 }
@@ -277,14 +479,11 @@ extern int      stbi_info_from_file  (FILE *f,                  int *x, int *y,
 extern int      stbi_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp);
 
 #ifndef STBI_NO_HDR
-static float h2l_gamma_i=1.0f/2.2f, h2l_scale_i=1.0f;
-static float l2h_gamma=2.2f, l2h_scale=1.0f;
+void   stbi_hdr_to_ldr_gamma(float gamma) { context()->hdr_to_ldr_gamma = gamma; }
+void   stbi_hdr_to_ldr_scale(float scale) { context()->hdr_to_ldr_scale = scale; }
 
-void   stbi_hdr_to_ldr_gamma(float gamma) { h2l_gamma_i = 1/gamma; }
-void   stbi_hdr_to_ldr_scale(float scale) { h2l_scale_i = 1/scale; }
-
-void   stbi_ldr_to_hdr_gamma(float gamma) { l2h_gamma = gamma; }
-void   stbi_ldr_to_hdr_scale(float scale) { l2h_scale = scale; }
+void   stbi_ldr_to_hdr_gamma(float gamma) { context()->ldr_to_hdr_gamma = gamma; }
+void   stbi_ldr_to_hdr_scale(float scale) { context()->ldr_to_hdr_scale = scale; }
 #endif
 
 
@@ -300,6 +499,21 @@ enum
    SCAN_header,
 };
 
+#define STREAM_BUFFER  16384
+
+// a streaming load (stbi_load_rows_from_callbacks): the file comes in
+// through io a buffer at a time, and the image goes out through rows
+typedef struct
+{
+   stbi_io_callbacks const *io;
+   stbi_rows_callback rows;
+   void *user;
+   int *x, *y, *comp;
+   uint8 *scratch;      // rows converted to req_comp
+   int scratch_len;
+   uint8 buffer[STREAM_BUFFER];
+} stream;
+
 typedef struct
 {
    uint32 img_x, img_y;
@@ -308,13 +522,16 @@ typedef struct
    #ifndef STBI_NO_STDIO
    FILE  *img_file;
    #endif
+   // for a stream, img_buffer is the part of its buffer not read yet
    uint8 *img_buffer, *img_buffer_end;
+   stream *stream;
 } stbi;
 
 #ifndef STBI_NO_STDIO
 static void start_file(stbi *s, FILE *f)
 {
    s->img_file = f;
+   s->stream = NULL;
 }
 #endif
 
@@ -325,6 +542,24 @@ static void start_mem(stbi *s, uint8 const *buffer, int len)
 #endif
    s->img_buffer = (uint8 *) buffer;
    s->img_buffer_end = (uint8 *) buffer+len;
+   s->stream = NULL;
+}
+
+// start reading a stream, from what's already in its buffer
+static void start_stream(stbi *s, stream *st, int len)
+{
+   start_mem(s, st->buffer, len);
+   s->stream = st;
+}
+
+// read the next piece of a stream once the last is used up
+static int refill(stbi *s)
+{
+   int n = s->stream->io->read(s->stream->user, (char *) s->stream->buffer, STREAM_BUFFER);
+   if (n <= 0) return 0;
+   s->img_buffer = s->stream->buffer;
+   s->img_buffer_end = s->stream->buffer + n;
+   return 1;
 }
 
 __forceinline static int get8(stbi *s)
@@ -337,6 +572,8 @@ __forceinline static int get8(stbi *s)
 #endif
    if (s->img_buffer < s->img_buffer_end)
       return *s->img_buffer++;
+   if (s->stream && refill(s))
+      return *s->img_buffer++;
    return 0;
 }
 
@@ -346,6 +583,8 @@ __forceinline static int at_eof(stbi *s)
    if (s->img_file)
       return feof(s->img_file);
 #endif
+   if (s->stream && s->img_buffer >= s->img_buffer_end)
+      return !refill(s);
    return s->img_buffer >= s->img_buffer_end;
 }
 
@@ -361,6 +600,20 @@ static void skip(stbi *s, int n)
       fseek(s->img_file, n, SEEK_CUR);
    else
 #endif
+   if (s->stream && n > s->img_buffer_end - s->img_buffer) {
+      stream *st = s->stream;
+      n -= (int) (s->img_buffer_end - s->img_buffer);
+      s->img_buffer = s->img_buffer_end;
+      if (st->io->skip)
+         st->io->skip(st->user, n);
+      else
+         while (n > 0 && refill(s)) {
+            int k = (int) (s->img_buffer_end - s->img_buffer);
+            if (k > n) k = n;
+            s->img_buffer += k;
+            n -= k;
+         }
+   } else
       s->img_buffer += n;
 }
 
@@ -396,6 +649,20 @@ static void getn(stbi *s, stbi_uc *buffer, int n)
       return;
    }
 #endif
+   if (s->stream) {
+      // what's buffered, then straight from the callback
+      int k = (int) (s->img_buffer_end - s->img_buffer);
+      if (k > n) k = n;
+      memcpy(buffer, s->img_buffer, k);
+      s->img_buffer += k;
+      while (k < n) {
+         int r = s->stream->io->read(s->stream->user, (char *) buffer + k, n - k);
+         if (r <= 0) break;
+         k += r;
+      }
+      memset(buffer + k, 0, n - k);
+      return;
+   }
    memcpy(buffer, s->img_buffer, n);
    s->img_buffer += n;
 }
@@ -416,56 +683,90 @@ static uint8 compute_y(int r, int g, int b)
    return (uint8) (((r*77) + (g*150) +  (29*b)) >> 8);
 }
 
+// one row of x pixels
+static void convert_row(unsigned char *dest, unsigned char const *src, int img_n, int req_comp, uint x)
+{
+   int i;
+   #define COMBO(a,b)  ((a)*8+(b))
+   #define CASE(a,b)   case COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch(COMBO(img_n, req_comp)) {
+      CASE(1,2) dest[0]=src[0], dest[1]=255; break;
+      CASE(1,3) dest[0]=dest[1]=dest[2]=src[0]; break;
+      CASE(1,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=255; break;
+      CASE(2,1) dest[0]=src[0]; break;
+      CASE(2,3) dest[0]=dest[1]=dest[2]=src[0]; break;
+      CASE(2,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=src[1]; break;
+      CASE(3,4) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2],dest[3]=255; break;
+      CASE(3,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
+      CASE(3,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = 255; break;
+      CASE(4,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
+      CASE(4,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = src[3]; break;
+      CASE(4,3) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2]; break;
+      default: assert(0);
+   }
+   #undef CASE
+}
+
 static unsigned char *convert_format(unsigned char *data, int img_n, int req_comp, uint x, uint y)
 {
-   int i,j;
+   int j;
    unsigned char *good;
 
    if (req_comp == img_n) return data;
    assert(req_comp >= 1 && req_comp <= 4);
 
-   good = (unsigned char *) malloc(req_comp * x * y);
+   good = (unsigned char *) stbi_malloc(req_comp * x * y);
    if (good == NULL) {
-      free(data);
+      stbi_free(data);
       return epuc("outofmem", "Out of memory");
    }
 
-   for (j=0; j < (int) y; ++j) {
-      unsigned char *src  = data + j * x * img_n   ;
-      unsigned char *dest = good + j * x * req_comp;
-
-      #define COMBO(a,b)  ((a)*8+(b))
-      #define CASE(a,b)   case COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch(COMBO(img_n, req_comp)) {
-         CASE(1,2) dest[0]=src[0], dest[1]=255; break;
-         CASE(1,3) dest[0]=dest[1]=dest[2]=src[0]; break;
-         CASE(1,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=255; break;
-         CASE(2,1) dest[0]=src[0]; break;
-         CASE(2,3) dest[0]=dest[1]=dest[2]=src[0]; break;
-         CASE(2,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=src[1]; break;
-         CASE(3,4) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2],dest[3]=255; break;
-         CASE(3,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
-         CASE(3,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = 255; break;
-         CASE(4,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
-         CASE(4,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = src[3]; break;
-         CASE(4,3) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2]; break;
-         default: assert(0);
-      }
-      #undef CASE
-   }
+   for (j=0; j < (int) y; ++j)
+      convert_row(good + j * x * req_comp, data + j * x * img_n, img_n, req_comp, x);
 
-   free(data);
+   stbi_free(data);
    return good;
 }
 
+// a streaming load knows the image's size: tell the caller, before any rows
+static void stream_begin(stbi *s, int comp)
+{
+   stream *st = s->stream;
+   *st->x = s->img_x;
+   *st->y = s->img_y;
+   if (st->comp) *st->comp = comp;
+}
+
+// hand count finished rows of img_n components, starting at row y, to a
+// streaming load's callback as req_comp components
+static int stream_rows(stbi *s, uint8 *rows, int img_n, int req_comp, int y, int count)
+{
+   stream *st = s->stream;
+   if (req_comp && req_comp != img_n) {
+      int i, row = s->img_x * req_comp;
+      if (row * count > st->scratch_len) {
+         uint8 *p = (uint8 *) stbi_realloc(st->scratch, row * count);
+         if (!p) return e("outofmem", "Out of memory");
+         st->scratch = p;
+         st->scratch_len = row * count;
+      }
+      for (i=0; i < count; ++i)
+         convert_row(st->scratch + row * i, rows + s->img_x * img_n * i, img_n, req_comp, s->img_x);
+      rows = st->scratch;
+   }
+   st->rows(st->user, rows, y, count);
+   return 1;
+}
+
 #ifndef STBI_NO_HDR
 static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
 {
    int i,k,n;
-   float *output = (float *) malloc(x * y * comp * sizeof(float));
-   if (output == NULL) { free(data); return epf("outofmem", "Out of memory"); }
+   float l2h_gamma = context()->ldr_to_hdr_gamma, l2h_scale = context()->ldr_to_hdr_scale;
+   float *output = (float *) stbi_malloc(x * y * comp * sizeof(float));
+   if (output == NULL) { stbi_free(data); return epf("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -474,7 +775,7 @@ static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
       }
       if (k < comp) output[i*comp + k] = data[i*comp+k]/255.0f;
    }
-   free(data);
+   stbi_free(data);
    return output;
 }
 
@@ -482,8 +783,9 @@ static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
 static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp)
 {
    int i,k,n;
-   stbi_uc *output = (stbi_uc *) malloc(x * y * comp);
-   if (output == NULL) { free(data); return epuc("outofmem", "Out of memory"); }
+   float h2l_gamma_i = 1/context()->hdr_to_ldr_gamma, h2l_scale_i = 1/context()->hdr_to_ldr_scale;
+   stbi_uc *output = (stbi_uc *) stbi_malloc(x * y * comp);
+   if (output == NULL) { stbi_free(data); return epuc("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -500,7 +802,7 @@ static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp)
          output[i*comp + k] = float2int(z);
       }
    }
-   free(data);
+   stbi_free(data);
    return output;
 }
 #endif
@@ -548,13 +850,10 @@ typedef struct
 
 typedef struct
 {
-   #if STBI_SIMD
-   unsigned short dequant2[4][64];
-   #endif
    stbi s;
    huffman huff_dc[4];
    huffman huff_ac[4];
-   uint8 dequant[4][64];
+   uint16 dequant[4][64];
 
 // sizes for components, interleaved MCUs
    int img_h_max, img_v_max;
@@ -571,9 +870,9 @@ typedef struct
       int dc_pred;
 
       int x,y,w2,h2;
+      int lines;   // h2, or when streaming 3 MCU rows' worth used round and round
       uint8 *data;
       void *raw_data;
-      uint8 *linebuf;
    } img_comp[4];
 
    uint32         code_buffer; // jpeg entropy-coded buffer
@@ -583,6 +882,11 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+
+// streaming: rows are converted and handed out as soon as the MCU rows
+// they need are decoded
+   struct jpeg_rows_job *stream_job; // NULL until the first scan starts
+   uint stream_y;                    // next output row to hand out
 } jpeg;
 
 static int build_huffman(huffman *h, int *count)
@@ -633,9 +937,11 @@ static void grow_buffer_unsafe(jpeg *j)
       if (b == 0xff) {
          int c = get8(&j->s);
          if (c != 0) {
+            // the marker ends the data; pad with zeros like after it, so a
+            // code in the last few bits still has FAST_BITS to look at
             j->marker = (unsigned char) c;
             j->nomore = 1;
-            return;
+            b = 0;
          }
       }
       j->code_buffer = (j->code_buffer << 8) | b;
@@ -819,12 +1125,12 @@ __forceinline static uint8 clamp(int x)
    t1 += p2+p4;                                \
    t0 += p1+p3;
 
-#if !STBI_SIMD
 // .344 seconds on 3*anemones.jpg
-static void idct_block(uint8 *out, int out_stride, short data[64], uint8 *dequantize)
+static void idct_block(uint8 *out, int out_stride, short data[64], unsigned short *dequantize)
 {
    int i,val[64],*v=val;
-   uint8 *o,*dq = dequantize;
+   uint8 *o;
+   unsigned short *dq = dequantize;
    short *d = data;
 
    // columns
@@ -872,66 +1178,202 @@ static void idct_block(uint8 *out, int out_stride, short data[64], uint8 *dequan
       o[4] = clamp((x3-t0) >> 17);
    }
 }
-#else
-static void idct_block(uint8 *out, int out_stride, short data[64], unsigned short *dequantize)
-{
-   int i,val[64],*v=val;
-   uint8 *o;
-   unsigned short *dq = dequantize;
-   short *d = data;
 
-   // columns
-   for (i=0; i < 8; ++i,++d,++dq, ++v) {
-      // if all zeroes, shortcut -- this avoids dequantizing 0s and IDCTing
-      if (d[ 8]==0 && d[16]==0 && d[24]==0 && d[32]==0
-           && d[40]==0 && d[48]==0 && d[56]==0) {
-         //    no shortcut                 0     seconds
-         //    (1|2|3|4|5|6|7)==0          0     seconds
-         //    all separate               -0.047 seconds
-         //    1 && 2|3 && 4|5 && 6|7:    -0.047 seconds
-         int dcterm = d[0] * dq[0] << 2;
-         v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dcterm;
-      } else {
-         IDCT_1D(d[ 0]*dq[ 0],d[ 8]*dq[ 8],d[16]*dq[16],d[24]*dq[24],
-                 d[32]*dq[32],d[40]*dq[40],d[48]*dq[48],d[56]*dq[56])
-         // constants scaled things up by 1<<12; let's bring them back
-         // down, but keep 2 extra bits of precision
-         x0 += 512; x1 += 512; x2 += 512; x3 += 512;
-         v[ 0] = (x0+t3) >> 10;
-         v[56] = (x0-t3) >> 10;
-         v[ 8] = (x1+t2) >> 10;
-         v[48] = (x1-t2) >> 10;
-         v[16] = (x2+t1) >> 10;
-         v[40] = (x2-t1) >> 10;
-         v[24] = (x3+t0) >> 10;
-         v[32] = (x3-t0) >> 10;
+#ifdef STBI_SSE2
+// same arithmetic as idct_block, eight columns (then rows) at a time in
+// 16-bit lanes, so the output is identical for any sane input (the
+// dequantized coefficients and the column pass results fit in 16 bits).
+// idct_block's DC-only column shortcut gives the same values the full
+// column IDCT does, so there's no need for it here.
+static void idct_block_sse2(uint8 *out, int out_stride, short data[64], unsigned short *dequantize)
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // pmaddwd constant: even lanes x, odd lanes y
+   #define dct_const(x,y)  _mm_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out0 = x*c0.x + y*c0.y, out1 = x*c1.x + y*c1.y, in 32 bits
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m128i c0##lo = _mm_unpacklo_epi16((x),(y)); \
+      __m128i c0##hi = _mm_unpackhi_epi16((x),(y)); \
+      __m128i out0##_l = _mm_madd_epi16(c0##lo, c0); \
+      __m128i out0##_h = _mm_madd_epi16(c0##hi, c0); \
+      __m128i out1##_l = _mm_madd_epi16(c0##lo, c1); \
+      __m128i out1##_h = _mm_madd_epi16(c0##hi, c1)
+
+   // out = in << 12, 16 to 32 bits
+   #define dct_widen(out, in) \
+      __m128i out##_l = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), (in)), 4); \
+      __m128i out##_h = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), (in)), 4)
+
+   #define dct_wadd(out, a, b) \
+      __m128i out##_l = _mm_add_epi32(a##_l, b##_l); \
+      __m128i out##_h = _mm_add_epi32(a##_h, b##_h)
+
+   #define dct_wsub(out, a, b) \
+      __m128i out##_l = _mm_sub_epi32(a##_l, b##_l); \
+      __m128i out##_h = _mm_sub_epi32(a##_h, b##_h)
+
+   // out0 = (a+b+bias) >> s, out1 = (a-b+bias) >> s, packed back to 16 bits
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m128i abiased_l = _mm_add_epi32(a##_l, bias); \
+         __m128i abiased_h = _mm_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm_packs_epi32(_mm_srai_epi32(sum_l, s), _mm_srai_epi32(sum_h, s)); \
+         out1 = _mm_packs_epi32(_mm_srai_epi32(dif_l, s), _mm_srai_epi32(dif_h, s)); \
       }
-   }
 
-   for (i=0, v=val, o=out; i < 8; ++i,v+=8,o+=out_stride) {
-      // no fast case since the first 1D IDCT spread components out
-      IDCT_1D(v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7])
-      // constants scaled things up by 1<<12, plus we had 1<<2 from first
-      // loop, plus horizontal and vertical each scale by sqrt(8) so together
-      // we've got an extra 1<<3, so 1<<17 total we need to remove.
-      x0 += 65536; x1 += 65536; x2 += 65536; x3 += 65536;
-      o[0] = clamp((x0+t3) >> 17);
-      o[7] = clamp((x0-t3) >> 17);
-      o[1] = clamp((x1+t2) >> 17);
-      o[6] = clamp((x1-t2) >> 17);
-      o[2] = clamp((x2+t1) >> 17);
-      o[5] = clamp((x2-t1) >> 17);
-      o[3] = clamp((x3+t0) >> 17);
-      o[4] = clamp((x3-t0) >> 17);
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   // IDCT_1D on eight lanes; the multiplies are regrouped into pairs
+   // so each pmaddwd does one p*c + q*c' term of the scalar version
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m128i rot0_0 = dct_const(f2f(0.5411961f), f2f(0.5411961f) + f2f(-1.847759065f));
+   __m128i rot0_1 = dct_const(f2f(0.5411961f) + f2f( 0.765366865f), f2f(0.5411961f));
+   __m128i rot1_0 = dct_const(f2f(1.175875602f) + f2f(-0.899976223f), f2f(1.175875602f));
+   __m128i rot1_1 = dct_const(f2f(1.175875602f), f2f(1.175875602f) + f2f(-2.562915447f));
+   __m128i rot2_0 = dct_const(f2f(-1.961570560f) + f2f( 0.298631336f), f2f(-1.961570560f));
+   __m128i rot2_1 = dct_const(f2f(-1.961570560f), f2f(-1.961570560f) + f2f( 3.072711026f));
+   __m128i rot3_0 = dct_const(f2f(-0.390180644f) + f2f( 2.053119869f), f2f(-0.390180644f));
+   __m128i rot3_1 = dct_const(f2f(-0.390180644f), f2f(-0.390180644f) + f2f( 1.501321110f));
+
+   // rounding as in idct_block; the +128 of clamp() is folded into the row bias
+   __m128i bias_0 = _mm_set1_epi32(512);
+   __m128i bias_1 = _mm_set1_epi32(65536 + (128<<17));
+
+   // load and dequantize (low 16 bits of the product, like the column pass keeps)
+   #define dct_load(r, k) \
+      r = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *) (data + k*8)), \
+                          _mm_loadu_si128((const __m128i *) (dequantize + k*8)))
+   dct_load(row0, 0); dct_load(row1, 1); dct_load(row2, 2); dct_load(row3, 3);
+   dct_load(row4, 4); dct_load(row5, 5); dct_load(row6, 6); dct_load(row7, 7);
+
+   // columns
+   dct_pass(bias_0, 10);
+
+   // 16-bit 8x8 transpose
+   dct_interleave16(row0, row4);
+   dct_interleave16(row1, row5);
+   dct_interleave16(row2, row6);
+   dct_interleave16(row3, row7);
+
+   dct_interleave16(row0, row2);
+   dct_interleave16(row1, row3);
+   dct_interleave16(row4, row6);
+   dct_interleave16(row5, row7);
+
+   dct_interleave16(row0, row1);
+   dct_interleave16(row2, row3);
+   dct_interleave16(row4, row5);
+   dct_interleave16(row6, row7);
+
+   // rows
+   dct_pass(bias_1, 17);
+
+   {
+      // clamp to 0..255 while packing, then 8-bit transpose back
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
    }
+
+   #undef dct_const
+   #undef dct_rot
+   #undef dct_widen
+   #undef dct_wadd
+   #undef dct_wsub
+   #undef dct_bfly32o
+   #undef dct_interleave8
+   #undef dct_interleave16
+   #undef dct_pass
+   #undef dct_load
+}
+
+// 1 if the SSE2 kernels can run: always, unless this is a 32-bit build
+// that doesn't assume SSE2, in which case ask the CPU
+static int sse2_available(void)
+{
+   #ifdef STBI_SSE2_CPUID
+   int info[4];
+   __cpuid(info, 1);
+   return (info[3] >> 26) & 1;
+   #else
+   return 1;
+   #endif
 }
-static stbi_idct_8x8 stbi_idct_installed = idct_block;
+#endif
 
 extern void stbi_install_idct(stbi_idct_8x8 func)
 {
-   stbi_idct_installed = func;
+   context()->idct = func;
+}
+
+// the IDCT this decode uses: the installed one, else the fastest built-in
+static stbi_idct_8x8 idct_kernel(void)
+{
+   if (context()->idct) return context()->idct;
+   #ifdef STBI_SSE2
+   if (sse2_available()) return idct_block_sse2;
+   #endif
+   return idct_block;
 }
-#endif
 
 #define MARKER_none  0xff
 // if there's a pending marker from the entropy stream, return that
@@ -966,78 +1408,236 @@ static void reset(jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
-static int parse_entropy_coded_data(jpeg *z)
+// how many MCUs (single blocks, for a non-interleaved scan) the scan codes
+static int scan_mcu_count(jpeg *z)
 {
-   reset(z);
    if (z->scan_n == 1) {
-      int i,j;
-      #if STBI_SIMD
-      __declspec(align(16))
-      #endif
-      short data[64];
+      int n = z->order[0];
+      return ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   }
+   return z->img_mcu_x * z->img_mcu_y;
+}
+
+// where a line of a component's samples is kept
+__forceinline static uint8 *comp_line(jpeg *z, int k, int line)
+{
+   return z->img_comp[k].data + z->img_comp[k].w2 * (line % z->img_comp[k].lines);
+}
+
+// decode MCUs first..end-1 of the scan from the current position of the
+// entropy decoder, without looking for restart markers
+static int decode_mcus(jpeg *z, stbi_idct_8x8 idct, int first, int end)
+{
+   int m;
+   short data[64];
+   if (z->scan_n == 1) {
       int n = z->order[0];
       // non-interleaved data, we just need to process one block at a time,
       // in trivial scanline order
       // number of blocks to do just depends on how many actual "pixels" this
       // component has, independent of interleaved MCU blocking and such
       int w = (z->img_comp[n].x+7) >> 3;
-      int h = (z->img_comp[n].y+7) >> 3;
-      for (j=0; j < h; ++j) {
-         for (i=0; i < w; ++i) {
-            if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-            #if STBI_SIMD
-            stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-            #else
-            idct_block(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-            #endif
-            // every data block is an MCU, so countdown the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
-         }
+      for (m=first; m < end; ++m) {
+         int i = m % w, j = m / w;
+         if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
+         idct(comp_line(z, n, j*8)+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
       }
    } else { // interleaved!
-      int i,j,k,x,y;
-      short data[64];
-      for (j=0; j < z->img_mcu_y; ++j) {
-         for (i=0; i < z->img_mcu_x; ++i) {
-            // scan an interleaved mcu... process scan_n components in order
-            for (k=0; k < z->scan_n; ++k) {
-               int n = z->order[k];
-               // scan out an mcu's worth of this component; that's just determined
-               // by the basic H and V specified for the component
-               for (y=0; y < z->img_comp[n].v; ++y) {
-                  for (x=0; x < z->img_comp[n].h; ++x) {
-                     int x2 = (i*z->img_comp[n].h + x)*8;
-                     int y2 = (j*z->img_comp[n].v + y)*8;
-                     if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-                     #if STBI_SIMD
-                     stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-                     #else
-                     idct_block(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-                     #endif
-                  }
+      int k,x,y;
+      for (m=first; m < end; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         // scan an interleaved mcu... process scan_n components in order
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            // scan out an mcu's worth of this component; that's just determined
+            // by the basic H and V specified for the component
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*8;
+                  int y2 = (j*z->img_comp[n].v + y)*8;
+                  if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
+                  idct(comp_line(z, n, y2)+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
                }
             }
-            // after all interleaved components, that's an interleaved MCU,
-            // so now count down the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
          }
       }
    }
    return 1;
 }
 
+void stbi_set_jpeg_threads(int threads)
+{
+   context()->jpeg_threads = threads < 0 ? 0 : threads;
+}
+
+#ifndef STBI_NO_THREADS
+#define JPEG_MAX_THREADS IMAGE_THREADS_MAX
+
+// how many threads to split 'work' units across, at least 'min_work' each
+static int jpeg_thread_count(int work, int min_work)
+{
+   return image_threads_count(context()->jpeg_threads, work, min_work, JPEG_MAX_THREADS);
+}
+
+typedef struct
+{
+   void (*run)(void *job);
+   void *job;
+   char *failure_reason;  // the worker's own, passed back to the caller
+} jpeg_thread;
+
+static void jpeg_thread_run(void *job)
+{
+   jpeg_thread *t = (jpeg_thread *) job;
+   t->run(t->job);
+   t->failure_reason = stbi_failure_reason();
+}
+
+// run(job) for each of the 'count' jobs (each 'job_size' bytes) with
+// image_threads_run, then pass any worker's failure reason back here
+static void run_jpeg_jobs(void (*run)(void *job), void *jobs, int job_size, int count)
+{
+   jpeg_thread t[JPEG_MAX_THREADS];
+   int i;
+   for (i=0; i < count; ++i) {
+      t[i].run = run;
+      t[i].job = (uint8 *) jobs + i*job_size;
+      t[i].failure_reason = NULL;
+   }
+   image_threads_run(jpeg_thread_run, t, sizeof(t[0]), count);
+   for (i=1; i < count; ++i)
+      if (t[i].failure_reason) set_failure_reason(t[i].failure_reason);
+}
+
+// scans with fewer MCUs per thread than this stay on one thread
+#define JPEG_MIN_MCUS_PER_THREAD  512
+
+typedef struct
+{
+   jpeg *z;
+   stbi_idct_8x8 idct;
+   uint8 **start, **stop;  // entropy-coded bytes of each restart interval
+   int first, end;         // restart intervals this thread decodes
+   int mcus;
+   int ok;
+} jpeg_interval_job;
+
+static void decode_intervals(void *job)
+{
+   jpeg_interval_job *q = (jpeg_interval_job *) job;
+   // every thread has its own entropy decoder and dc predictions; the
+   // tables are copied along, the component planes are shared, and the
+   // intervals write disjoint MCUs of them
+   jpeg w = *q->z;
+   int k, ri = w.restart_interval;
+   q->ok = 1;
+   for (k=q->first; k < q->end && q->ok; ++k) {
+      int end = q->mcus - k*ri > ri ? (k+1)*ri : q->mcus;
+      start_mem(&w.s, q->start[k], (int) (q->stop[k] - q->start[k]));
+      reset(&w);
+      q->ok = decode_mcus(&w, q->idct, k*ri, end);
+   }
+}
+
+// decode the restart intervals of the scan on several threads; returns -1
+// (having consumed nothing) when that isn't possible or worth it, so the
+// caller decodes the scan serially
+static int decode_intervals_threaded(jpeg *z, stbi_idct_8x8 idct, int mcus)
+{
+   jpeg_interval_job job[JPEG_MAX_THREADS];
+   int ri = z->restart_interval, intervals, found = 0, threads, t, ok = 1;
+   uint8 *p, *end = z->s.img_buffer_end, **start, **stop;
+
+   if (ri <= 0) return -1;
+   #ifndef STBI_NO_STDIO
+   if (z->s.img_file) return -1;
+   #endif
+   if (z->s.stream) return -1;
+   intervals = (mcus + ri-1) / ri;
+   threads = jpeg_thread_count(mcus, JPEG_MIN_MCUS_PER_THREAD);
+   if (threads > intervals) threads = intervals;
+   if (threads < 2) return -1;
+
+   // find where each interval's bytes start and stop: they are separated by
+   // RSTn markers, and the first other marker (FFxx, xx not 00) ends the scan
+   start = (uint8 **) stbi_malloc(2 * intervals * sizeof(*start));
+   if (!start) return -1;
+   stop = start + intervals;
+   p = start[0] = z->s.img_buffer;
+   for (;;) {
+      p = (uint8 *) memchr(p, 0xff, end - p);
+      if (!p || p+1 >= end) { p = end; break; }
+      if (p[1] == 0x00) { p += 2; continue; }
+      if (p[1] == 0xff) { p += 1; continue; }  // fill byte
+      if (!RESTART(p[1])) break;
+      if (found+1 == intervals) { found = -1; break; }
+      stop[found++] = p;
+      start[found] = p += 2;
+   }
+   if (found+1 != intervals) {
+      // a marker missing or one too many: leave it to the serial decoder,
+      // which makes what it can of the damage
+      stbi_free(start);
+      return -1;
+   }
+   stop[found] = p;
+
+   for (t=0; t < threads; ++t) {
+      job[t].z = z;
+      job[t].idct = idct;
+      job[t].start = start;
+      job[t].stop = stop;
+      job[t].first = intervals * t / threads;
+      job[t].end = intervals * (t+1) / threads;
+      job[t].mcus = mcus;
+   }
+   run_jpeg_jobs(decode_intervals, job, sizeof(job[0]), threads);
+   for (t=0; t < threads; ++t)
+      ok &= job[t].ok;
+   stbi_free(start);
+
+   // carry on from the marker that ends the scan
+   z->s.img_buffer = p;
+   z->marker = MARKER_none;
+   return ok;
+}
+#endif
+
+static int jpeg_stream_rows(jpeg *z, int mcus_done);
+
+static int parse_entropy_coded_data(jpeg *z)
+{
+   stbi_idct_8x8 idct = idct_kernel();
+   int mcus = scan_mcu_count(z), m = 0, row = mcus;
+   #ifndef STBI_NO_THREADS
+   int r = decode_intervals_threaded(z, idct, mcus);
+   if (r >= 0) return r;
+   #endif
+   // a streamed image is handed out a row of MCUs at a time
+   if (z->stream_job)
+      row = z->scan_n == 1 ? (z->img_comp[z->order[0]].x+7) >> 3 : z->img_mcu_x;
+   reset(z);
+   while (m < mcus) {
+      // up to the end of the restart interval, or of the row of MCUs
+      int end = mcus - m > z->todo ? m + z->todo : mcus;
+      if (end > (m / row + 1) * row) end = (m / row + 1) * row;
+      if (!decode_mcus(z, idct, m, end)) return 0;
+      z->todo -= end - m;
+      m = end;
+      if (z->stream_job && m % row == 0)
+         if (!jpeg_stream_rows(z, m)) return 0;
+      if (z->todo <= 0) {
+         if (z->code_bits < 24) grow_buffer_unsafe(z);
+         // if it's NOT a restart, then just bail, so we get corrupt data
+         // rather than no data
+         if (!RESTART(z->marker)) break;
+         reset(z);
+      }
+   }
+   if (z->stream_job) return jpeg_stream_rows(z, mcus);
+   return 1;
+}
+
 static int process_marker(jpeg *z, int m)
 {
    int L;
@@ -1063,10 +1663,6 @@ static int process_marker(jpeg *z, int m)
             if (t > 3) return e("bad DQT table","Corrupt JPEG");
             for (i=0; i < 64; ++i)
                z->dequant[t][dezigzag[i]] = get8u(&z->s);
-            #if STBI_SIMD
-            for (i=0; i < 64; ++i)
-               z->dequant2[t][i] = dequant[t][i];
-            #endif
             L -= 65;
          }
          return L==0;
@@ -1132,6 +1728,26 @@ static int process_scan_header(jpeg *z)
    return 1;
 }
 
+// room for mcu_rows rows of MCUs of each component
+static int alloc_components(jpeg *z, int mcu_rows)
+{
+   int i;
+   for (i=0; i < z->s.img_n; ++i) {
+      z->img_comp[i].lines = z->img_comp[i].v * 8 * (mcu_rows < z->img_mcu_y ? mcu_rows : z->img_mcu_y);
+      z->img_comp[i].raw_data = stbi_malloc(z->img_comp[i].w2 * z->img_comp[i].lines+15);
+      if (z->img_comp[i].raw_data == NULL) {
+         for(--i; i >= 0; --i) {
+            stbi_free(z->img_comp[i].raw_data);
+            z->img_comp[i].data = NULL;
+         }
+         return e("outofmem", "Out of memory");
+      }
+      // align blocks for installable-idct using mmx/sse
+      z->img_comp[i].data = (uint8*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
+   }
+   return 1;
+}
+
 static int process_frame_header(jpeg *z, int scan)
 {
    stbi *s = &z->s;
@@ -1143,10 +1759,8 @@ static int process_frame_header(jpeg *z, int scan)
    c = get8(s);
    if (c != 3 && c != 1) return e("bad component count","Corrupt JPEG");    // JFIF requires
    s->img_n = c;
-   for (i=0; i < c; ++i) {
+   for (i=0; i < c; ++i)
       z->img_comp[i].data = NULL;
-      z->img_comp[i].linebuf = NULL;
-   }
 
    if (Lf != 8+3*s->img_n) return e("bad SOF len","Corrupt JPEG");
 
@@ -1188,20 +1802,11 @@ static int process_frame_header(jpeg *z, int scan)
       // discard the extra data until colorspace conversion
       z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
       z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
-      z->img_comp[i].raw_data = malloc(z->img_comp[i].w2 * z->img_comp[i].h2+15);
-      if (z->img_comp[i].raw_data == NULL) {
-         for(--i; i >= 0; --i) {
-            free(z->img_comp[i].raw_data);
-            z->img_comp[i].data = NULL;
-         }
-         return e("outofmem", "Out of memory");
-      }
-      // align blocks for installable-idct using mmx/sse
-      z->img_comp[i].data = (uint8*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
-      z->img_comp[i].linebuf = NULL;
    }
 
-   return 1;
+   // a stream only keeps the rows of MCUs around the ones being converted,
+   // unless its first scan shows it needs all of them
+   return alloc_components(z, s->stream ? 3 : z->img_mcu_y);
 }
 
 // use comparisons since in some cases we handle more than one case (e.g. SOF)
@@ -1232,6 +1837,8 @@ static int decode_jpeg_header(jpeg *z, int scan)
    return 1;
 }
 
+static int jpeg_stream_start(jpeg *z);
+
 static int decode_jpeg_image(jpeg *j)
 {
    int m;
@@ -1241,6 +1848,18 @@ static int decode_jpeg_image(jpeg *j)
    while (!EOI(m)) {
       if (SOS(m)) {
          if (!process_scan_header(j)) return 0;
+         if (j->s.stream && !j->stream_job) {
+            // one scan with every component can go out as it's decoded;
+            // components in scans of their own have to be decoded whole first
+            if (j->scan_n == j->s.img_n) {
+               if (!jpeg_stream_start(j)) return 0;
+            } else if (j->img_comp[0].lines < j->img_comp[0].h2) {
+               int i;
+               for (i=0; i < j->s.img_n; ++i)
+                  stbi_free(j->img_comp[i].raw_data);
+               if (!alloc_components(j, j->img_mcu_y)) return 0;
+            }
+         }
          if (!parse_entropy_coded_data(j)) return 0;
       } else {
          if (!process_marker(j, m)) return 0;
@@ -1317,6 +1936,58 @@ static uint8 *resample_row_hv_2(uint8 *out, uint8 *in_near, uint8 *in_far, int w
    return out;
 }
 
+#ifdef STBI_SSE2
+// resample_row_hv_2 eight input pixels at a time, same results
+static uint8 *resample_row_hv_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+   __m128i zero = _mm_setzero_si128();
+   __m128i bias = _mm_set1_epi16(8);
+   if (w == 1) {
+      out[0] = out[1] = div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   // the last pixel needs the edge case below, so stop short of it
+   for (; i < ((w-1) & ~7); i += 8) {
+      // vertical pass: 3*near + far = 4*near + (far - near)
+      __m128i farw  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_far + i)), zero);
+      __m128i nearw = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_near + i)), zero);
+      __m128i curr  = _mm_add_epi16(_mm_slli_epi16(nearw, 2), _mm_sub_epi16(farw, nearw));
+
+      // neighbours: shifted copies of curr, with the pixels just
+      // outside these eight patched in
+      __m128i prev = _mm_insert_epi16(_mm_slli_si128(curr, 2), t1, 0);
+      __m128i next = _mm_insert_epi16(_mm_srli_si128(curr, 2), 3*in_near[i+8] + in_far[i+8], 7);
+
+      // horizontal pass: even = 3*cur + prev, odd = 3*cur + next
+      __m128i curb = _mm_add_epi16(_mm_slli_epi16(curr, 2), bias);
+      __m128i even = _mm_add_epi16(_mm_sub_epi16(prev, curr), curb);
+      __m128i odd  = _mm_add_epi16(_mm_sub_epi16(next, curr), curb);
+
+      __m128i de0 = _mm_srli_epi16(_mm_unpacklo_epi16(even, odd), 4);
+      __m128i de1 = _mm_srli_epi16(_mm_unpackhi_epi16(even, odd), 4);
+      _mm_storeu_si128((__m128i *) (out + i*2), _mm_packus_epi16(de0, de1));
+
+      t1 = 3*in_near[i+7] + in_far[i+7];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = div16(3*t0 + t1 + 8);
+      out[i*2  ] = div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = div4(t1+2);
+   return out;
+}
+#endif
+
 static uint8 *resample_row_generic(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -1331,7 +2002,7 @@ static uint8 *resample_row_generic(uint8 *out, uint8 *in_near, uint8 *in_far, in
 
 // 0.38 seconds on 3*anemones.jpg   (0.25 with processor = Pro)
 // VC6 without processor=Pro is generating multiple LEAs per multiply!
-static void YCbCr_to_RGB_row(uint8 *out, uint8 *y, uint8 *pcb, uint8 *pcr, int count, int step)
+static void YCbCr_to_RGB_row(uint8 *out, uint8 const *y, uint8 const *pcb, uint8 const *pcr, int count, int step)
 {
    int i;
    for (i=0; i < count; ++i) {
@@ -1351,19 +2022,90 @@ static void YCbCr_to_RGB_row(uint8 *out, uint8 *y, uint8 *pcb, uint8 *pcr, int c
       out[0] = (uint8)r;
       out[1] = (uint8)g;
       out[2] = (uint8)b;
-      out[3] = 255;
+      // only with 4 channels: a band of rows must not touch the next one
+      if (step == 4) out[3] = 255;
       out += step;
    }
 }
 
-#if STBI_SIMD
-static stbi_YCbCr_to_RGB_run stbi_YCbCr_installed = YCbCr_to_RGB_row;
+#ifdef STBI_SSE2
+// YCbCr_to_RGB_row eight pixels at a time, same results.  The constants
+// don't fit pmaddwd's 16 bits, so each is split into a multiple of 65536,
+// which lands in the integer part (added to y), and a 16-bit remainder:
+//    r = y +   cr + ((cr* 26345              + 32768) >> 16)
+//    g = y -   cr + ((cr* 18734 - cb*22554   + 32768) >> 16)
+//    b = y + 2*cb + ((           - cb*14942  + 32768) >> 16)
+static void YCbCr_to_RGB_row_sse2(uint8 *out, uint8 const *y, uint8 const *pcb, uint8 const *pcr, int count, int step)
+{
+   int i = 0;
+   // with 3-byte pixels each one is written as 4 bytes, the spare byte
+   // landing on the next pixel, so the last pixel is left to the scalar loop
+   int last = step == 4 ? count : count-1;
+   __m128i zero  = _mm_setzero_si128();
+   __m128i c128  = _mm_set1_epi16(128);
+   __m128i alpha = _mm_set1_epi16(255);
+   __m128i round = _mm_set1_epi32(32768);
+   __m128i kr = _mm_setr_epi16(float2fixed(1.40200f) - 65536, 0, float2fixed(1.40200f) - 65536, 0,
+                               float2fixed(1.40200f) - 65536, 0, float2fixed(1.40200f) - 65536, 0);
+   __m128i kg = _mm_setr_epi16(65536 - float2fixed(0.71414f), -float2fixed(0.34414f),
+                               65536 - float2fixed(0.71414f), -float2fixed(0.34414f),
+                               65536 - float2fixed(0.71414f), -float2fixed(0.34414f),
+                               65536 - float2fixed(0.71414f), -float2fixed(0.34414f));
+   __m128i kb = _mm_setr_epi16(0, float2fixed(1.77200f) - 131072, 0, float2fixed(1.77200f) - 131072,
+                               0, float2fixed(1.77200f) - 131072, 0, float2fixed(1.77200f) - 131072);
+
+   #define ycc_frac(k) \
+      _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(crcb_l, k), round), 16), \
+                      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(crcb_h, k), round), 16))
+
+   for (; i+8 <= last; i += 8) {
+      __m128i yw  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (y + i)), zero);
+      __m128i cbw = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (pcb + i)), zero), c128);
+      __m128i crw = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (pcr + i)), zero), c128);
+      __m128i crcb_l = _mm_unpacklo_epi16(crw, cbw);
+      __m128i crcb_h = _mm_unpackhi_epi16(crw, cbw);
+
+      __m128i r = _mm_add_epi16(_mm_add_epi16(yw, crw), ycc_frac(kr));
+      __m128i g = _mm_add_epi16(_mm_sub_epi16(yw, crw), ycc_frac(kg));
+      __m128i b = _mm_add_epi16(_mm_add_epi16(yw, _mm_add_epi16(cbw, cbw)), ycc_frac(kb));
+
+      // clamp to 0..255 while packing, then interleave to RGBA
+      __m128i rb = _mm_packus_epi16(r, b);
+      __m128i ga = _mm_packus_epi16(g, alpha);
+      __m128i rg = _mm_unpacklo_epi8(rb, ga);
+      __m128i ba = _mm_unpackhi_epi8(rb, ga);
+      __m128i o0 = _mm_unpacklo_epi16(rg, ba);
+      __m128i o1 = _mm_unpackhi_epi16(rg, ba);
+
+      if (step == 4) {
+         _mm_storeu_si128((__m128i *) (out +  0), o0);
+         _mm_storeu_si128((__m128i *) (out + 16), o1);
+      } else {
+         // in order, so each spare byte is overwritten by the next pixel
+         int k, p;
+         for (k=0; k < 4; ++k) {
+            p = _mm_cvtsi128_si32(o0);
+            memcpy(out + k*3, &p, 4);
+            o0 = _mm_srli_si128(o0, 4);
+         }
+         for (k=0; k < 4; ++k) {
+            p = _mm_cvtsi128_si32(o1);
+            memcpy(out + 12 + k*3, &p, 4);
+            o1 = _mm_srli_si128(o1, 4);
+         }
+      }
+      out += 8*step;
+   }
+   #undef ycc_frac
+
+   YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
 
 void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func)
 {
-   stbi_YCbCr_installed = func;
+   context()->YCbCr_to_RGB = func;
 }
-#endif
 
 
 // clean up the temporary component buffers
@@ -1372,14 +2114,12 @@ static void cleanup_jpeg(jpeg *j)
    int i;
    for (i=0; i < j->s.img_n; ++i) {
       if (j->img_comp[i].data) {
-         free(j->img_comp[i].raw_data);
+         stbi_free(j->img_comp[i].raw_data);
          j->img_comp[i].data = NULL;
       }
-      if (j->img_comp[i].linebuf) {
-         free(j->img_comp[i].linebuf);
-         j->img_comp[i].linebuf = NULL;
-      }
    }
+   stbi_free(j->stream_job);
+   j->stream_job = NULL;
 }
 
 typedef struct
@@ -1392,12 +2132,175 @@ typedef struct
    int ypos;    // which pre-expansion row we're on
 } stbi_resample;
 
-static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+typedef struct jpeg_rows_job
 {
+   jpeg *z;
+   stbi_resample res_comp[4];  // resampler state at output row 0
+   stbi_YCbCr_to_RGB_run YCbCr_to_RGB;
+   uint8 *output;              // where row first goes
+   uint8 *linebuf;             // decode_n line buffers of img_x+3 bytes
    int n, decode_n;
+   uint first, end;            // output rows of this band
+} jpeg_rows_job;
+
+// resample and color-convert output rows first..end-1
+static void convert_rows(void *job)
+{
+   jpeg_rows_job *q = (jpeg_rows_job *) job;
+   jpeg *z = q->z;
+   int k, n = q->n;
+   uint i,j;
+   uint8 *coutput[4];
+   stbi_resample res_comp[4];
+
+   // move each resampler on to the band's first row
+   for (k=0; k < q->decode_n; ++k) {
+      stbi_resample *r = &res_comp[k];
+      int a, last = z->img_comp[k].y - 1;
+      *r = q->res_comp[k];
+      a = (r->ystep + q->first) / r->vs;  // times it has stepped down a row
+      r->ystep = (r->ystep + q->first) % r->vs;
+      r->ypos  = a;
+      r->line1 = comp_line(z, k, a < last ? a : last);
+      if (a > 0)
+         r->line0 = comp_line(z, k, a-1 < last ? a-1 : last);
+   }
+
+   for (j=q->first; j < q->end; ++j) {
+      uint8 *out = q->output + n * z->s.img_x * (j - q->first);
+      for (k=0; k < q->decode_n; ++k) {
+         stbi_resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(q->linebuf + k * (z->s.img_x + 3),
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 = comp_line(z, k, r->ypos);
+         }
+      }
+      if (n >= 3) {
+         uint8 *y = coutput[0];
+         if (z->s.img_n == 3) {
+            q->YCbCr_to_RGB(out, y, coutput[1], coutput[2], z->s.img_x, n);
+         } else
+            for (i=0; i < z->s.img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               if (n == 4) out[3] = 255;
+               out += n;
+            }
+      } else {
+         uint8 *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < z->s.img_x; ++i) out[i] = y[i];
+         else
+            for (i=0; i < z->s.img_x; ++i) *out++ = y[i], *out++ = 255;
+      }
+   }
+}
+
+#ifndef STBI_NO_THREADS
+// images with fewer pixels per thread than this are converted on one thread
+#define JPEG_MIN_PIXELS_PER_THREAD  (1 << 17)
+#endif
+
+// set up job to resample and color-convert the whole image to n components
+static void setup_rows_job(jpeg *z, jpeg_rows_job *job, int n)
+{
+   int k;
+   resample_row_func resample_hv_2 = resample_row_hv_2;
+
+   job->z = z;
+   job->n = n;
+   // a grey result only needs Y
+   job->decode_n = z->s.img_n == 3 && n < 3 ? 1 : z->s.img_n;
+   job->YCbCr_to_RGB = YCbCr_to_RGB_row;
+   #ifdef STBI_SSE2
+   if (sse2_available()) {
+      job->YCbCr_to_RGB = YCbCr_to_RGB_row_sse2;
+      resample_hv_2 = resample_row_hv_2_sse2;
+   }
+   #endif
+   if (context()->YCbCr_to_RGB) job->YCbCr_to_RGB = context()->YCbCr_to_RGB;
+
+   for (k=0; k < job->decode_n; ++k) {
+      stbi_resample *r = &job->res_comp[k];
+
+      r->hs      = z->img_h_max / z->img_comp[k].h;
+      r->vs      = z->img_v_max / z->img_comp[k].v;
+      r->ystep   = r->vs >> 1;
+      r->w_lores = (z->s.img_x + r->hs-1) / r->hs;
+      r->ypos    = 0;
+      r->line0   = r->line1 = z->img_comp[k].data;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = resample_row_v_2;
+      else if (r->hs == 2 && r->vs == 1) r->resample = resample_row_h_2;
+      else if (r->hs == 2 && r->vs == 2) r->resample = resample_hv_2;
+      else                               r->resample = resample_row_generic;
+   }
+}
+
+// a streaming load converts a row of MCUs' height at a time, through
+// buffers allocated along with its job
+static int jpeg_stream_start(jpeg *z)
+{
+   jpeg_rows_job *q;
+   int n = z->s.img_out_n ? z->s.img_out_n : z->s.img_n;
+   q = (jpeg_rows_job *) stbi_malloc(sizeof(*q) + z->s.img_n * (z->s.img_x + 3) + n * z->s.img_x * z->img_mcu_h);
+   if (!q) return e("outofmem", "Out of memory");
+   setup_rows_job(z, q, n);
+   q->linebuf = (uint8 *) (q+1);
+   q->output = q->linebuf + q->decode_n * (z->s.img_x + 3);
+   z->stream_job = q;
+   z->stream_y = 0;
+   stream_begin(&z->s, z->s.img_n);
+   return 1;
+}
+
+// hand out every output row not handed out yet whose samples are all
+// decoded, mcus_done MCUs into the scan (-1 for all of it)
+static int jpeg_stream_rows(jpeg *z, int mcus_done)
+{
+   jpeg_rows_job *q = z->stream_job;
+   uint end = z->s.img_y;
+   int k;
+   if (mcus_done >= 0) {
+      // decoded lines of each component, and the last output row that
+      // doesn't need the ones after them
+      int row = z->scan_n == 1 ? (z->img_comp[z->order[0]].x+7) >> 3 : z->img_mcu_x;
+      for (k=0; k < q->decode_n; ++k) {
+         stbi_resample *r = &q->res_comp[k];
+         int lines = mcus_done / row * (z->scan_n == 1 ? 8 : z->img_comp[k].v * 8);
+         if (lines < z->img_comp[k].y) {
+            // row j needs line (ystep + j) / vs
+            uint rows = lines * r->vs - r->ystep;
+            if (lines * r->vs < r->ystep) rows = 0;
+            if (rows < end) end = rows;
+         }
+      }
+   }
+   while (z->stream_y < end) {
+      q->first = z->stream_y;
+      q->end = end - q->first > (uint) z->img_mcu_h ? q->first + z->img_mcu_h : end;
+      convert_rows(q);
+      if (!stream_rows(&z->s, q->output, q->n, q->n, q->first, q->end - q->first)) return 0;
+      z->stream_y = q->end;
+   }
+   return 1;
+}
+
+static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+{
+   int n;
    // validate req_comp
    if (req_comp < 0 || req_comp > 4) return epuc("bad req_comp", "Internal error");
    z->s.img_n = 0;
+   z->s.img_out_n = req_comp;
+   z->stream_job = NULL;
 
    // load a jpeg image from whichever source
    if (!decode_jpeg_image(z)) { cleanup_jpeg(z); return NULL; }
@@ -1405,85 +2308,58 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s.img_n;
 
-   if (z->s.img_n == 3 && n < 3)
-      decode_n = 1;
-   else
-      decode_n = z->s.img_n;
-
-   // resample and color-convert
-   {
-      int k;
-      uint i,j;
+   if (z->s.stream) {
+      // the rest of the rows (all of them, if they had to be decoded
+      // whole), then give back the last band's buffer
       uint8 *output;
-      uint8 *coutput[4];
+      if (!z->stream_job && !jpeg_stream_start(z)) { cleanup_jpeg(z); return NULL; }
+      if (!jpeg_stream_rows(z, -1)) { cleanup_jpeg(z); return NULL; }
+      output = (uint8 *) stbi_malloc(1);
+      cleanup_jpeg(z);
+      if (!output) return epuc("outofmem", "Out of memory");
+      *out_x = z->s.img_x;
+      *out_y = z->s.img_y;
+      if (comp) *comp  = z->s.img_n;
+      return output;
+   }
 
-      stbi_resample res_comp[4];
+   // resample and color-convert, in bands of rows on as many threads
+   {
+      int t;
+      uint8 *output, *linebuf;
+      #ifndef STBI_NO_THREADS
+      jpeg_rows_job job[JPEG_MAX_THREADS];
+      int bands = jpeg_thread_count((int) (z->s.img_x * z->s.img_y), JPEG_MIN_PIXELS_PER_THREAD);
+      #else
+      jpeg_rows_job job[1];
+      int bands = 1;
+      #endif
 
-      for (k=0; k < decode_n; ++k) {
-         stbi_resample *r = &res_comp[k];
+      setup_rows_job(z, &job[0], n);
 
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (uint8 *) malloc(z->s.img_x + 3);
-         if (!z->img_comp[k].linebuf) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
-
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s.img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = resample_row_hv_2;
-         else                               r->resample = resample_row_generic;
-      }
+      // line buffers big enough for upsampling off the edges with upsample
+      // factor of 4, one set per band
+      linebuf = (uint8 *) stbi_malloc(bands * job[0].decode_n * (z->s.img_x + 3));
+      if (!linebuf) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
 
       // can't error after this so, this is safe
-      output = (uint8 *) malloc(n * z->s.img_x * z->s.img_y + 1);
-      if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s.img_y; ++j) {
-         uint8 *out = output + n * z->s.img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi_resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            uint8 *y = coutput[0];
-            if (z->s.img_n == 3) {
-               #if STBI_SIMD
-               stbi_YCbCr_installed(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #else
-               YCbCr_to_RGB_row(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #endif
-            } else
-               for (i=0; i < z->s.img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            uint8 *y = coutput[0];
-            if (n == 1)
-               for (i=0; i < z->s.img_x; ++i) out[i] = y[i];
-            else
-               for (i=0; i < z->s.img_x; ++i) *out++ = y[i], *out++ = 255;
-         }
+      output = (uint8 *) stbi_malloc(n * z->s.img_x * z->s.img_y + 1);
+      if (!output) { stbi_free(linebuf); cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
+
+      for (t=0; t < bands; ++t) {
+         job[t] = job[0];
+         job[t].linebuf = linebuf + t * job[0].decode_n * (z->s.img_x + 3);
+         job[t].first   = z->s.img_y * t / bands;
+         job[t].end     = z->s.img_y * (t+1) / bands;
+         job[t].output  = output + n * z->s.img_x * job[t].first;
       }
+      #ifndef STBI_NO_THREADS
+      run_jpeg_jobs(convert_rows, job, sizeof(job[0]), bands);
+      #else
+      convert_rows(&job[0]);
+      #endif
+
+      stbi_free(linebuf);
       cleanup_jpeg(z);
       *out_x = z->s.img_x;
       *out_y = z->s.img_y;
@@ -1503,10 +2379,10 @@ unsigned char *stbi_jpeg_load_from_file(FILE *f, int *x, int *y, int *comp, int
 unsigned char *stbi_jpeg_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_jpeg_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_jpeg_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 #endif
@@ -1550,22 +2426,35 @@ extern int      stbi_jpeg_info_from_memory(stbi_uc const *buffer, int len, int *
 //      - all input must be provided in an upfront buffer
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
-//      - fast huffman
+//      - fast huffman, resolving length/distance bases and extra bits too
+//      - 64-bit bit buffer, refilled a word at a time
+//      - matches copied a word at a time
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define ZFAST_BITS  9 // accelerate all cases in default tables
+#define ZFAST_BITS  11 // accelerate all cases in default tables, nearly all in others
 #define ZFAST_MASK  ((1 << ZFAST_BITS) - 1)
 
+// a decoded symbol, as the tables hold it and zhuffman_decode returns it
+// (0 is never a valid one):
+//    bits  0-3   length of its code
+//    bits  4-7   number of extra bits that follow the code
+//    bit   8     set if the value is a length or distance base
+//    bits 16-31  the symbol, or its length/distance base
+#define ZSYM(value,base,extra,size)  (((uint32) (value) << 16) | ((base) << 8) | ((extra) << 4) | (size))
+#define ZSYM_SIZE(z)   ((z) & 15)
+#define ZSYM_EXTRA(z)  (((z) >> 4) & 15)
+#define ZSYM_BASE(z)   ((z) & 0x100)
+#define ZSYM_VALUE(z)  ((int) ((z) >> 16))
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
 {
-   uint16 fast[1 << ZFAST_BITS];
+   uint32 fast[1 << ZFAST_BITS];
    uint16 firstcode[16];
    int maxcode[17];
    uint16 firstsymbol[16];
-   uint8  size[288];
-   uint16 value[288];
+   uint32 symbol[288];
 } zhuffman;
 
 __forceinline static int bitreverse16(int n)
@@ -1585,14 +2474,15 @@ __forceinline static int bit_reverse(int v, int bits)
    return bitreverse16(v) >> (16-bits);
 }
 
-static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
+// symbols from first_base on stand for base[i-first_base] plus extra[i-first_base] bits
+static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num, int *base, int *extra, int first_base)
 {
    int i,k=0;
    int code, next_code[16], sizes[17];
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
-   memset(z->fast, 255, sizeof(z->fast));
+   memset(z->fast, 0, sizeof(z->fast));
    for (i=0; i < num; ++i)
       ++sizes[sizelist[i]];
    sizes[0] = 0;
@@ -1615,12 +2505,14 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
       int s = sizelist[i];
       if (s) {
          int c = next_code[s] - z->firstcode[s] + z->firstsymbol[s];
-         z->size[c] = (uint8)s;
-         z->value[c] = (uint16)i;
+         if (i < first_base)
+            z->symbol[c] = ZSYM(i, 0, 0, s);
+         else
+            z->symbol[c] = ZSYM(base[i-first_base], 1, extra[i-first_base], s);
          if (s <= ZFAST_BITS) {
             int k = bit_reverse(next_code[s],s);
             while (k < (1 << ZFAST_BITS)) {
-               z->fast[k] = (uint16) c;
+               z->fast[k] = z->symbol[c];
                k += (1 << s);
             }
          }
@@ -1640,78 +2532,141 @@ typedef struct
 {
    uint8 *zbuffer, *zbuffer_end;
    int num_bits;
-   uint32 code_buffer;
+   uint64 code_buffer;
 
    char *zout;
    char *zout_start;
    char *zout_end;
    int   z_expandable;
 
+   // streaming output: instead of growing, a full buffer is handed to
+   // z_sink, which returns how many bytes it took (or -1 to stop), and
+   // then slid down to what's left plus the last 32K matches can reach
+   int  (*z_sink)(void *user, uint8 *data, int len);
+   void  *z_sink_user;
+   char  *z_unsunk;
+
+   // streaming input: once zbuffer runs out, z_refill points it at the
+   // next piece, or returns 0 at the end
+   int  (*z_refill)(void *user, uint8 **start, uint8 **end);
+   void  *z_refill_user;
+
    zhuffman z_length, z_distance;
 } zbuf;
 
 __forceinline static int zget8(zbuf *z)
 {
-   if (z->zbuffer >= z->zbuffer_end) return 0;
+   if (z->zbuffer >= z->zbuffer_end)
+      if (!z->z_refill || !z->z_refill(z->z_refill_user, &z->zbuffer, &z->zbuffer_end))
+         return 0;
    return *z->zbuffer++;
 }
 
+__forceinline static uint64 zget64(uint8 const *p)
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+   uint64 v;
+   memcpy(&v, p, 8);
+   return v;
+#else
+   return (uint64) p[0]       | (uint64) p[1] <<  8 | (uint64) p[2] << 16 | (uint64) p[3] << 24 |
+          (uint64) p[4] << 32 | (uint64) p[5] << 40 | (uint64) p[6] << 48 | (uint64) p[7] << 56;
+#endif
+}
+
+// top up to at least 56 bits
 static void fill_bits(zbuf *z)
 {
+   assert(z->code_buffer < ((uint64) 1 << z->num_bits));
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      // take as many whole bytes of the next eight as fit, and drop the
+      // part of the next byte that came along
+      int n = (63 - z->num_bits) >> 3;
+      z->code_buffer |= zget64(z->zbuffer) << z->num_bits;
+      z->zbuffer  += n;
+      z->num_bits += n*8;
+      z->code_buffer &= ((uint64) 1 << z->num_bits) - 1;
+      return;
+   }
    do {
-      assert(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= zget8(z) << z->num_bits;
+      z->code_buffer |= (uint64) zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 56);
 }
 
 __forceinline static unsigned int zreceive(zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) z->code_buffer & ((1 << n) - 1);
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
 }
 
-__forceinline static int zhuffman_decode(zbuf *a, zhuffman *z)
+// returns the symbol in the ZSYM form, 0 for an invalid code
+__forceinline static uint32 zhuffman_decode(zbuf *a, zhuffman *z)
 {
-   int b,s,k;
+   uint32 b;
+   int s,k;
    if (a->num_bits < 16) fill_bits(a);
    b = z->fast[a->code_buffer & ZFAST_MASK];
-   if (b < 0xffff) {
-      s = z->size[b];
+   if (b) {
+      s = ZSYM_SIZE(b);
       a->code_buffer >>= s;
       a->num_bits -= s;
-      return z->value[b];
+      return b;
    }
 
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = bit_reverse(a->code_buffer, 16);
+   k = bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
-   if (s == 16) return -1; // invalid code!
+   if (s == 16) return 0; // invalid code!
    // code size is s, so:
-   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
-   assert(z->size[b] == s);
+   k = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   assert(ZSYM_SIZE(z->symbol[k]) == s);
    a->code_buffer >>= s;
    a->num_bits -= s;
-   return z->value[b];
+   return z->symbol[k];
+}
+
+#define ZWINDOW  32768
+
+// pass everything since the last call to the sink
+static int zsink(zbuf *z)
+{
+   int took = z->z_sink(z->z_sink_user, (uint8 *) z->z_unsunk, (int) (z->zout - z->z_unsunk));
+   if (took < 0) return 0;
+   z->z_unsunk += took;
+   return 1;
 }
 
 static int expand(zbuf *z, int n)  // need to make room for n bytes
 {
    char *q;
    int cur, limit;
+   if (z->z_sink) {
+      int keep;
+      if (!zsink(z)) return 0;
+      cur  = (int) (z->zout     - z->zout_start);
+      keep = (int) (z->zout     - z->z_unsunk);
+      if (keep < ZWINDOW) keep = cur < ZWINDOW ? cur : ZWINDOW;
+      memmove(z->zout_start, z->zout - keep, keep);
+      z->z_unsunk -= cur - keep;
+      z->zout      = z->zout_start + keep;
+      if (z->zout + n > z->zout_end) return e("output buffer limit","Corrupt PNG");
+      return 1;
+   }
    if (!z->z_expandable) return e("output buffer limit","Corrupt PNG");
    cur   = (int) (z->zout     - z->zout_start);
    limit = (int) (z->zout_end - z->zout_start);
    while (cur + n > limit)
       limit *= 2;
-   q = (char *) realloc(z->zout_start, limit);
+   q = (char *) stbi_realloc(z->zout_start, limit);
    if (q == NULL) return e("outofmem", "Out of memory");
    z->zout_start = q;
    z->zout       = q + cur;
@@ -1736,27 +2691,43 @@ static int dist_extra[32] =
 static int parse_huffman_block(zbuf *a)
 {
    for(;;) {
-      int z = zhuffman_decode(a, &a->z_length);
-      if (z < 256) {
-         if (z < 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
+      uint32 z = zhuffman_decode(a, &a->z_length);
+      if (!ZSYM_BASE(z)) {
+         if (z == 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
+         if (ZSYM_VALUE(z) == 256) return 1;
          if (a->zout >= a->zout_end) if (!expand(a, 1)) return 0;
-         *a->zout++ = (char) z;
+         *a->zout++ = (char) ZSYM_VALUE(z);
       } else {
-         uint8 *p;
+         char *p;
          int len,dist;
-         if (z == 256) return 1;
-         z -= 257;
-         len = length_base[z];
-         if (length_extra[z]) len += zreceive(a, length_extra[z]);
+         len = ZSYM_VALUE(z);
+         if (ZSYM_EXTRA(z)) len += zreceive(a, ZSYM_EXTRA(z));
          z = zhuffman_decode(a, &a->z_distance);
-         if (z < 0) return e("bad huffman code","Corrupt PNG");
-         dist = dist_base[z];
-         if (dist_extra[z]) dist += zreceive(a, dist_extra[z]);
+         dist = ZSYM_VALUE(z);
+         if (ZSYM_EXTRA(z)) dist += zreceive(a, ZSYM_EXTRA(z));
+         // codes 286, 287 and 30, 31 have no base (and 0 isn't a code at all)
+         if (len == 0 || dist == 0) return e("bad huffman code","Corrupt PNG");
          if (a->zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
          if (a->zout + len > a->zout_end) if (!expand(a, len)) return 0;
-         p = (uint8 *) (a->zout - dist);
-         while (len--)
-            *a->zout++ = *p++;
+         p = a->zout - dist;
+         if (dist >= 8 && a->zout_end - a->zout >= len + 8) {
+            // eight bytes at a time: the source is at least that far back, so
+            // it's always already written; the last copy may run up to 7
+            // bytes past the match, which the buffer has room for
+            char *q = a->zout, *end = a->zout + len;
+            do {
+               memcpy(q, p, 8);
+               q += 8;
+               p += 8;
+            } while (q < end);
+            a->zout = end;
+         } else if (dist == 1) {
+            memset(a->zout, *p, len);
+            a->zout += len;
+         } else {
+            while (len--)
+               *a->zout++ = *p++;
+         }
       }
    }
 }
@@ -1764,7 +2735,7 @@ static int parse_huffman_block(zbuf *a)
 static int compute_huffman_codes(zbuf *a)
 {
    static uint8 length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
-   static zhuffman z_codelength; // static just to save stack space
+   zhuffman z_codelength;
    uint8 lencodes[286+32+137];//padding for maximum single op
    uint8 codelength_sizes[19];
    int i,n;
@@ -1778,15 +2749,17 @@ static int compute_huffman_codes(zbuf *a)
       int s = zreceive(a,3);
       codelength_sizes[length_dezigzag[i]] = (uint8) s;
    }
-   if (!zbuild_huffman(&z_codelength, codelength_sizes, 19)) return 0;
+   if (!zbuild_huffman(&z_codelength, codelength_sizes, 19, NULL, NULL, 19)) return 0;
 
    n = 0;
    while (n < hlit + hdist) {
-      int c = zhuffman_decode(a, &z_codelength);
-      assert(c >= 0 && c < 19);
+      uint32 z = zhuffman_decode(a, &z_codelength);
+      int c = ZSYM_VALUE(z);
+      if (z == 0) return e("bad codelengths","Corrupt PNG");
       if (c < 16)
          lencodes[n++] = (uint8) c;
       else if (c == 16) {
+         if (n == 0) return e("bad codelengths","Corrupt PNG");
          c = zreceive(a,2)+3;
          memset(lencodes+n, lencodes[n-1], c);
          n += c;
@@ -1802,8 +2775,8 @@ static int compute_huffman_codes(zbuf *a)
       }
    }
    if (n != hlit+hdist) return e("bad codelengths","Corrupt PNG");
-   if (!zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
-   if (!zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   if (!zbuild_huffman(&a->z_length, lencodes, hlit, length_base, length_extra, 257)) return 0;
+   if (!zbuild_huffman(&a->z_distance, lencodes+hlit, hdist, dist_base, dist_extra, 0)) return 0;
    return 1;
 }
 
@@ -1815,21 +2788,36 @@ static int parse_uncompressed_block(zbuf *a)
       zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (uint8) (a->code_buffer & 255); // wtf this warns?
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
-   assert(a->num_bits == 0);
    // now fill header the normal way
    while (k < 4)
       header[k++] = (uint8) zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return e("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return e("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
       if (!expand(a, len)) return 0;
+   // the bit buffer can still hold the first few bytes (or, for a short
+   // block, the start of the next one, which stays there)
+   while (len > 0 && a->num_bits > 0) {
+      *a->zout++ = (char) (a->code_buffer & 255);
+      a->code_buffer >>= 8;
+      a->num_bits -= 8;
+      --len;
+   }
+   while (a->zbuffer + len > a->zbuffer_end) {
+      // the block carries on in the next piece of input
+      int k = (int) (a->zbuffer_end - a->zbuffer);
+      memcpy(a->zout, a->zbuffer, k);
+      a->zout += k;
+      len -= k;
+      if (!a->z_refill || !a->z_refill(a->z_refill_user, &a->zbuffer, &a->zbuffer_end))
+         return e("read past buffer","Corrupt PNG");
+   }
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -1849,9 +2837,9 @@ static int parse_zlib_header(zbuf *a)
    return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
-static uint8 default_length[288], default_distance[32];
-static void init_defaults(void)
+// filled in per block rather than once into shared tables, so that
+// inflating on several threads at once needs no locking
+static void init_defaults(uint8 default_length[288], uint8 default_distance[32])
 {
    int i;   // use <= to match clearly with spec
    for (i=0; i <= 143; ++i)     default_length[i]   = 8;
@@ -1879,9 +2867,10 @@ static int parse_zlib(zbuf *a, int parse_header)
       } else {
          if (type == 1) {
             // use fixed code lengths
-            if (!default_distance[31]) init_defaults();
-            if (!zbuild_huffman(&a->z_length  , default_length  , 288)) return 0;
-            if (!zbuild_huffman(&a->z_distance, default_distance,  32)) return 0;
+            uint8 default_length[288], default_distance[32];
+            init_defaults(default_length, default_distance);
+            if (!zbuild_huffman(&a->z_length  , default_length  , 288, length_base, length_extra, 257)) return 0;
+            if (!zbuild_huffman(&a->z_distance, default_distance,  32, dist_base, dist_extra, 0)) return 0;
          } else {
             if (!compute_huffman_codes(a)) return 0;
          }
@@ -1897,14 +2886,32 @@ static int do_zlib(zbuf *a, char *obuf, int olen, int exp, int parse_header)
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->z_sink = NULL;
+   a->z_refill = NULL;
 
    return parse_zlib(a, parse_header);
 }
 
+// inflate into a window of olen bytes (at least ZWINDOW plus 64K, plus
+// the most sink may leave behind), passing the output to sink as it goes
+static int do_zlib_sink(zbuf *a, char *obuf, int olen, int (*sink)(void *, uint8 *, int), void *user)
+{
+   a->zout_start = obuf;
+   a->zout       = obuf;
+   a->zout_end   = obuf + olen;
+   a->z_expandable = 0;
+   a->z_sink = sink;
+   a->z_sink_user = user;
+   a->z_unsunk = obuf;
+
+   if (!parse_zlib(a, 1)) return 0;
+   return zsink(a);
+}
+
 char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
    zbuf a;
-   char *p = (char *) malloc(initial_size);
+   char *p = (char *) stbi_malloc(initial_size);
    if (p == NULL) return NULL;
    a.zbuffer = (uint8 *) buffer;
    a.zbuffer_end = (uint8 *) buffer + len;
@@ -1912,7 +2919,7 @@ char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      free(a.zout_start);
+      stbi_free(a.zout_start);
       return NULL;
    }
 }
@@ -1936,7 +2943,7 @@ int stbi_zlib_decode_buffer(char *obuffer, int olen, char const *ibuffer, int il
 char *stbi_zlib_decode_noheader_malloc(char const *buffer, int len, int *outlen)
 {
    zbuf a;
-   char *p = (char *) malloc(16384);
+   char *p = (char *) stbi_malloc(16384);
    if (p == NULL) return NULL;
    a.zbuffer = (uint8 *) buffer;
    a.zbuffer_end = (uint8 *) buffer+len;
@@ -1944,7 +2951,7 @@ char *stbi_zlib_decode_noheader_malloc(char const *buffer, int len, int *outlen)
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      free(a.zout_start);
+      stbi_free(a.zout_start);
       return NULL;
    }
 }
@@ -1964,11 +2971,11 @@ int stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char *ibuffe
 //    simple implementation
 //      - only 8-bit samples
 //      - no CRC checking
-//      - allocates lots of intermediate memory
-//        - avoids problem of streaming data between subsystems
-//        - avoids explicit window management
+//      - rows are unfiltered as they're inflated, through a 32K+ window
+//        rather than a buffer for the whole inflated image
 //    performance
 //      - uses stb_zlib, a PD zlib implementation with fast huffman decoding
+//      - SSE2 unfiltering
 
 
 typedef struct
@@ -1999,18 +3006,21 @@ static int check_png_header(stbi *s)
 typedef struct
 {
    stbi s;
-   uint8 *idata, *expanded, *out;
+   uint8 *idata, *window, *rows, *out;
+   uint32 row; // next row to unfilter
+
+   // a streamed load inflates straight from the IDAT chunks, and
+   // finishes each row as it's unfiltered
+   uint32 idat_left;  // of the IDAT chunk being inflated
+   chunk next;        // read by png_refill once the IDATs ran out
+   int have_next;
+   uint8 *palette, tc[3];
+   int has_trans, pal_out_n, req_comp;
 } png;
 
 
 enum {
-   F_none=0, F_sub=1, F_up=2, F_avg=3, F_paeth=4,
-   F_avg_first, F_paeth_first,
-};
-
-static uint8 first_row_filter[5] =
-{
-   F_none, F_sub, F_none, F_avg_first, F_paeth_first
+   F_none=0, F_sub=1, F_up=2, F_avg=3, F_paeth=4
 };
 
 static int paeth(int a, int b, int c)
@@ -2024,82 +3034,272 @@ static int paeth(int a, int b, int c)
    return c;
 }
 
-// create the png data from post-deflated data
-static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n)
+// undo one row's filter: n bytes a pixel, len bytes in all; the row
+// above the first is all zeroes, which makes the first row's filters the
+// general ones (avg halves the left pixel, paeth picks it)
+static void unfilter_row(uint8 *cur, uint8 const *prior, uint8 const *raw, int filter, int n, int len)
 {
-   stbi *s = &a->s;
-   uint32 i,j,stride = s->img_x*out_n;
    int k;
-   int img_n = s->img_n; // copy it into a local for later
-   assert(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (uint8 *) malloc(s->img_x * s->img_y * out_n);
-   if (!a->out) return e("outofmem", "Out of memory");
-   if (raw_len != (img_n * s->img_x + 1) * s->img_y) return e("not enough pixels","Corrupt PNG");
-   for (j=0; j < s->img_y; ++j) {
-      uint8 *cur = a->out + stride*j;
-      uint8 *prior = cur - stride;
-      int filter = *raw++;
-      if (filter > 4) return e("invalid filter","Corrupt PNG");
-      // if first row, use special filter that doesn't sample previous row
-      if (j == 0) filter = first_row_filter[filter];
-      // handle first pixel explicitly
-      for (k=0; k < img_n; ++k) {
-         switch(filter) {
-            case F_none       : cur[k] = raw[k]; break;
-            case F_sub        : cur[k] = raw[k]; break;
-            case F_up         : cur[k] = raw[k] + prior[k]; break;
-            case F_avg        : cur[k] = raw[k] + (prior[k]>>1); break;
-            case F_paeth      : cur[k] = (uint8) (raw[k] + paeth(0,prior[k],0)); break;
-            case F_avg_first  : cur[k] = raw[k]; break;
-            case F_paeth_first: cur[k] = raw[k]; break;
+   switch (filter) {
+      case F_none:
+         memcpy(cur, raw, len);
+         break;
+      case F_sub:
+         for (k=0; k < n; ++k)   cur[k] = raw[k];
+         for (   ; k < len; ++k) cur[k] = raw[k] + cur[k-n];
+         break;
+      case F_up:
+         for (k=0; k < len; ++k) cur[k] = raw[k] + prior[k];
+         break;
+      case F_avg:
+         for (k=0; k < n; ++k)   cur[k] = raw[k] + (prior[k]>>1);
+         for (   ; k < len; ++k) cur[k] = raw[k] + ((prior[k] + cur[k-n])>>1);
+         break;
+      case F_paeth:
+         for (k=0; k < n; ++k)   cur[k] = raw[k] + prior[k]; // paeth(0,b,0) is b
+         for (   ; k < len; ++k) cur[k] = (uint8) (raw[k] + paeth(cur[k-n],prior[k],prior[k-n]));
+         break;
+   }
+}
+
+#ifdef STBI_SSE2
+// unfilter_row with SSE2, same results.  Up is 16 bytes at a time; the
+// others depend on the pixel to the left, so for 3 and 4 byte pixels they
+// run a pixel at a time with the channels side by side (paeth in 16 bits
+// so its sums can't wrap); other pixel sizes take the scalar path
+// n is 4, or 3 for the last pixel of a 3 byte row: the others move a
+// whole word, the stray byte is rewritten by the next pixel
+__forceinline static __m128i png_load_pixel(uint8 const *p, int n)
+{
+   int v;
+   if (n == 4) memcpy(&v, p, 4);
+   else        v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return _mm_cvtsi32_si128(v);
+}
+
+__forceinline static void png_store_pixel(uint8 *p, __m128i x, int n)
+{
+   int v = _mm_cvtsi128_si32(x);
+   if (n == 4) memcpy(p, &v, 4);
+   else {
+      p[0] = (uint8) v;
+      p[1] = (uint8) (v >> 8);
+      p[2] = (uint8) (v >> 16);
+   }
+}
+
+// sub, avg and paeth; always inlined with n a constant, so the pixel
+// loads and stores are plain moves
+__forceinline static void unfilter_pixels_sse2(uint8 *cur, uint8 const *prior, uint8 const *raw, int filter, int n, int len)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a, b, c, x;
+   int k = 0;
+
+   // a is the pixel to the left, b the one above, c above and to the left
+   a = zero;
+   c = zero;
+   switch (filter) {
+      case F_sub:
+         for (; k < len; k += n) {
+            int w = k+4 <= len ? 4 : n;
+            a = _mm_add_epi8(a, png_load_pixel(raw+k, w));
+            png_store_pixel(cur+k, a, w);
          }
-      }
-      if (img_n != out_n) cur[img_n] = 255;
-      raw += img_n;
-      cur += out_n;
-      prior += out_n;
-      // this is a little gross, so that we don't switch per-pixel or per-component
-      if (img_n == out_n) {
-         #define CASE(f) \
-             case f:     \
-                for (i=s->img_x-1; i >= 1; --i, raw+=img_n,cur+=img_n,prior+=img_n) \
-                   for (k=0; k < img_n; ++k)
-         switch(filter) {
-            CASE(F_none)  cur[k] = raw[k]; break;
-            CASE(F_sub)   cur[k] = raw[k] + cur[k-img_n]; break;
-            CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-            CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-img_n])>>1); break;
-            CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],prior[k],prior[k-img_n])); break;
-            CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-img_n] >> 1); break;
-            CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],0,0)); break;
+         break;
+      case F_avg:
+         for (; k < len; k += n) {
+            int w = k+4 <= len ? 4 : n;
+            // pavgb rounds up; take back the 1 where a+b is odd
+            b = png_load_pixel(prior+k, w);
+            x = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            a = _mm_add_epi8(x, png_load_pixel(raw+k, w));
+            png_store_pixel(cur+k, a, w);
          }
-         #undef CASE
+         break;
+      case F_paeth:
+         for (; k < len; k += n) {
+            __m128i pa, pb, pc, smallest, pick_a, pick_b, nearest;
+            int w = k+4 <= len ? 4 : n;
+            b = _mm_unpacklo_epi8(png_load_pixel(prior+k, w), zero);
+            // pa = |b-c|, pb = |a-c|, pc = |a+b-2c|
+            pa = _mm_sub_epi16(b, c);
+            pb = _mm_sub_epi16(a, c);
+            pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            // ties go to a, then b
+            pick_a = _mm_cmpeq_epi16(smallest, pa);
+            pick_b = _mm_andnot_si128(pick_a, _mm_cmpeq_epi16(smallest, pb));
+            nearest = _mm_or_si128(_mm_or_si128(_mm_and_si128(pick_a, a), _mm_and_si128(pick_b, b)),
+                                   _mm_andnot_si128(_mm_or_si128(pick_a, pick_b), c));
+            x = _mm_add_epi8(_mm_packus_epi16(nearest, zero), png_load_pixel(raw+k, w));
+            png_store_pixel(cur+k, x, w);
+            a = _mm_unpacklo_epi8(x, zero);
+            c = b;
+         }
+         break;
+   }
+}
+
+static void unfilter_row_sse2(uint8 *cur, uint8 const *prior, uint8 const *raw, int filter, int n, int len)
+{
+   int k = 0;
+   if (filter == F_up) {
+      for (; k+16 <= len; k += 16)
+         _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((__m128i const *) (raw+k)),
+                                                            _mm_loadu_si128((__m128i const *) (prior+k))));
+      for (; k < len; ++k)
+         cur[k] = raw[k] + prior[k];
+   } else if (filter != F_none && n == 4) {
+      unfilter_pixels_sse2(cur, prior, raw, filter, 4, len);
+   } else if (filter != F_none && n == 3) {
+      unfilter_pixels_sse2(cur, prior, raw, filter, 3, len);
+   } else {
+      unfilter_row(cur, prior, raw, filter, n, len);
+   }
+}
+#endif
+
+static void add_alpha(uint8 *out, uint8 const *cur, int img_n, uint32 pixel_count)
+{
+   uint32 i;
+   int k;
+   for (i=0; i < pixel_count; ++i, out += img_n+1, cur += img_n) {
+      for (k=0; k < img_n; ++k)
+         out[k] = cur[k];
+      out[img_n] = 255;
+   }
+}
+
+static int compute_transparency(uint8 *p, uint32 pixel_count, uint8 tc[3], int out_n);
+static void expand_palette_pixels(uint8 *p, uint8 const *orig, uint32 pixel_count, uint8 const *palette, int pal_img_n);
+
+// finish a streamed row the way parse_png_file finishes a whole image,
+// in the spare half of a->out, and hand it out
+static int stream_png_row(png *a, uint8 *cur)
+{
+   stbi *s = &a->s;
+   int n = s->img_n;
+   if (s->img_out_n != n) {
+      add_alpha(a->out, cur, n, s->img_x);
+      cur = a->out;
+      n = s->img_out_n;
+   }
+   if (a->has_trans)
+      compute_transparency(cur, s->img_x, a->tc, n);
+   if (a->pal_out_n) {
+      expand_palette_pixels(a->out + s->img_x * 4, cur, s->img_x, a->palette, a->pal_out_n);
+      cur = a->out + s->img_x * 4;
+      n = a->pal_out_n;
+   }
+   return stream_rows(s, cur, n, a->req_comp, a->row, 1);
+}
+
+// z_sink for the PNG inflater: unfilter every whole row in data, straight
+// into the output when it has the same layout, otherwise into the two row
+// buffers and then out with an opaque alpha added (or on to the caller,
+// when streaming)
+static int unfilter_rows(void *user, uint8 *data, int len)
+{
+   png *a = (png *) user;
+   stbi *s = &a->s;
+   int img_n = s->img_n, out_n = s->img_out_n;
+   int width = s->img_x * img_n, stride = s->img_x * out_n;
+   void (*unfilter)(uint8 *, uint8 const *, uint8 const *, int, int, int) = unfilter_row;
+   int used = 0;
+
+   #ifdef STBI_SSE2
+   if (sse2_available()) unfilter = unfilter_row_sse2;
+   #endif
+
+   for (; len - used >= width + 1; used += width + 1, ++a->row) {
+      uint8 *raw = data + used + 1;
+      uint8 *cur, *prior;
+      int filter = data[used];
+      if (a->row >= s->img_y) { e("not enough pixels","Corrupt PNG"); return -1; }
+      if (filter > 4) { e("invalid filter","Corrupt PNG"); return -1; }
+      if (img_n == out_n && !s->stream) {
+         cur = a->out + stride * a->row;
+         prior = a->row ? cur - stride : a->rows;
       } else {
+         cur = a->rows + width * (1 + (a->row & 1));
+         prior = a->row ? a->rows + width * (1 + ((a->row-1) & 1)) : a->rows;
+      }
+      unfilter(cur, prior, raw, filter, img_n, width);
+      if (s->stream) {
+         if (!stream_png_row(a, cur)) return -1;
+      } else if (img_n != out_n) {
          assert(img_n+1 == out_n);
-         #define CASE(f) \
-             case f:     \
-                for (i=s->img_x-1; i >= 1; --i, cur[img_n]=255,raw+=img_n,cur+=out_n,prior+=out_n) \
-                   for (k=0; k < img_n; ++k)
-         switch(filter) {
-            CASE(F_none)  cur[k] = raw[k]; break;
-            CASE(F_sub)   cur[k] = raw[k] + cur[k-out_n]; break;
-            CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-            CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-out_n])>>1); break;
-            CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],prior[k],prior[k-out_n])); break;
-            CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-out_n] >> 1); break;
-            CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],0,0)); break;
-         }
-         #undef CASE
+         add_alpha(a->out + stride * a->row, cur, img_n, s->img_x);
       }
    }
+   return used;
+}
+
+// z_refill for a streamed PNG: the part of the current IDAT chunk that's
+// been read in, then the chunks after it for as long as they're IDATs
+static int png_refill(void *user, uint8 **start, uint8 **end)
+{
+   png *a = (png *) user;
+   stbi *s = &a->s;
+   while (!a->have_next) {
+      if (a->idat_left) {
+         uint32 k;
+         if (s->img_buffer >= s->img_buffer_end && !refill(s)) return 0;
+         k = (uint32) (s->img_buffer_end - s->img_buffer);
+         if (k > a->idat_left) k = a->idat_left;
+         *start = s->img_buffer;
+         *end = s->img_buffer + k;
+         s->img_buffer += k;
+         a->idat_left -= k;
+         return 1;
+      }
+      get32(s); // CRC
+      a->next = get_chunk_header(s);
+      if (a->next.type == PNG_TYPE('I','D','A','T'))
+         a->idat_left = a->next.length;
+      else
+         a->have_next = 1;
+   }
+   return 0;
+}
+
+// create the png data by inflating and unfiltering a window's worth of
+// rows at a time; a streamed image inflates straight from the file
+// instead of from idata, one row of out at a time
+static int create_png_image(png *a, uint8 *idata, int ilen, int out_n)
+{
+   stbi *s = &a->s;
+   zbuf z;
+   int width = s->img_x * s->img_n;
+   int window_len = ZWINDOW + 0x40000 + width + 1;
+   assert(out_n == s->img_n || out_n == s->img_n+1);
+   // room for the rows with alpha added and then with the palette expanded
+   a->out = (uint8 *) stbi_malloc(s->stream ? s->img_x * 8 : s->img_x * s->img_y * out_n);
+   // a row of zeroes above the first, then the two rows being unfiltered
+   // when they don't go straight to the output
+   a->rows = (uint8 *) stbi_malloc((out_n == s->img_n && !s->stream ? 1 : 3) * width);
+   a->window = (uint8 *) stbi_malloc(window_len);
+   if (!a->out || !a->rows || !a->window) return e("outofmem", "Out of memory");
+   memset(a->rows, 0, width);
+   a->row = 0;
+   z.zbuffer = idata;
+   z.zbuffer_end = idata + ilen;
+   z.z_refill = s->stream ? png_refill : NULL;
+   z.z_refill_user = a;
+   if (!do_zlib_sink(&z, (char *) a->window, window_len, unfilter_rows, a)) return 0;
+   if (a->row != s->img_y || z.z_unsunk != z.zout) return e("not enough pixels","Corrupt PNG");
+   stbi_free(a->window); a->window = NULL;
+   stbi_free(a->rows);   a->rows   = NULL;
    return 1;
 }
 
-static int compute_transparency(png *z, uint8 tc[3], int out_n)
+static int compute_transparency(uint8 *p, uint32 pixel_count, uint8 tc[3], int out_n)
 {
-   stbi *s = &z->s;
-   uint32 i, pixel_count = s->img_x * s->img_y;
-   uint8 *p = z->out;
+   uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 255 as the alpha value in the output
@@ -2120,17 +3320,9 @@ static int compute_transparency(png *z, uint8 tc[3], int out_n)
    return 1;
 }
 
-static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
+static void expand_palette_pixels(uint8 *p, uint8 const *orig, uint32 pixel_count, uint8 const *palette, int pal_img_n)
 {
-   uint32 i, pixel_count = a->s.img_x * a->s.img_y;
-   uint8 *p, *temp_out, *orig = a->out;
-
-   p = (uint8 *) malloc(pixel_count * pal_img_n);
-   if (p == NULL) return e("outofmem", "Out of memory");
-
-   // between here and free(out) below, exitting would leak
-   temp_out = p;
-
+   uint32 i;
    if (pal_img_n == 3) {
       for (i=0; i < pixel_count; ++i) {
          int n = orig[i]*4;
@@ -2149,7 +3341,15 @@ static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
          p += 4;
       }
    }
-   free(a->out);
+}
+
+static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
+{
+   uint32 pixel_count = a->s.img_x * a->s.img_y;
+   uint8 *temp_out = (uint8 *) stbi_malloc(pixel_count * pal_img_n);
+   if (temp_out == NULL) return e("outofmem", "Out of memory");
+   expand_palette_pixels(temp_out, a->out, pixel_count, palette, pal_img_n);
+   stbi_free(a->out);
    a->out = temp_out;
    return 1;
 }
@@ -2167,7 +3367,9 @@ static int parse_png_file(png *z, int scan, int req_comp)
    if (scan == SCAN_type) return 1;
 
    for(;;first=0) {
-      chunk c = get_chunk_header(s);
+      // png_refill may already have read the header after the last IDAT
+      chunk c = z->have_next ? z->next : get_chunk_header(s);
+      z->have_next = 0;
       if (first && c.type != PNG_TYPE('I','H','D','R'))
          return e("first not IHDR","Corrupt PNG");
       switch (c.type) {
@@ -2212,7 +3414,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
          }
 
          case PNG_TYPE('t','R','N','S'): {
-            if (z->idata) return e("tRNS after IDAT","Corrupt PNG");
+            if (z->idata || z->out) return e("tRNS after IDAT","Corrupt PNG");
             if (pal_img_n) {
                if (scan == SCAN_header) { s->img_n = 4; return 1; }
                if (pal_len == 0) return e("tRNS before PLTE","Corrupt PNG");
@@ -2233,12 +3435,36 @@ static int parse_png_file(png *z, int scan, int req_comp)
          case PNG_TYPE('I','D','A','T'): {
             if (pal_img_n && !pal_len) return e("no PLTE","Corrupt PNG");
             if (scan == SCAN_header) { s->img_n = pal_img_n; return 1; }
+            if (s->stream) {
+               // inflate the IDATs as they're read; any after a gap are ignored
+               if (z->out) { skip(s, c.length); break; }
+               if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
+                  s->img_out_n = s->img_n+1;
+               else
+                  s->img_out_n = s->img_n;
+               z->palette = palette;
+               memcpy(z->tc, tc, 3);
+               z->has_trans = has_trans;
+               z->pal_out_n = pal_img_n && req_comp >= 3 ? req_comp : pal_img_n;
+               z->req_comp = req_comp;
+               z->idat_left = c.length;
+               // the rows have the alpha tRNS adds, so count it as the
+               // file's (unlike a whole image, which leaves that out)
+               k = pal_img_n ? pal_img_n : s->img_n + has_trans;
+               stream_begin(s, k);
+               if (!create_png_image(z, NULL, 0, s->img_out_n)) return 0;
+               s->img_n = k;
+               // past the zlib checksum
+               skip(s, z->idat_left);
+               if (z->have_next) continue;
+               break;
+            }
             if (ioff + c.length > idata_limit) {
                uint8 *p;
                if (idata_limit == 0) idata_limit = c.length > 4096 ? c.length : 4096;
                while (ioff + c.length > idata_limit)
                   idata_limit *= 2;
-               p = (uint8 *) realloc(z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
+               p = (uint8 *) stbi_realloc(z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
                z->idata = p;
             }
             #ifndef STBI_NO_STDIO
@@ -2248,28 +3474,23 @@ static int parse_png_file(png *z, int scan, int req_comp)
             }
             else
             #endif
-            {
-               memcpy(z->idata+ioff, s->img_buffer, c.length);
-               s->img_buffer += c.length;
-            }
+            getn(s, z->idata+ioff, c.length);
             ioff += c.length;
             break;
          }
 
          case PNG_TYPE('I','E','N','D'): {
-            uint32 raw_len;
             if (scan != SCAN_load) return 1;
+            if (s->stream) return z->out ? 1 : e("no IDAT","Corrupt PNG");
             if (z->idata == NULL) return e("no IDAT","Corrupt PNG");
-            z->expanded = (uint8 *) stbi_zlib_decode_malloc((char *) z->idata, ioff, (int *) &raw_len);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            free(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
-            if (!create_png_image(z, z->expanded, raw_len, s->img_out_n)) return 0;
+            if (!create_png_image(z, z->idata, ioff, s->img_out_n)) return 0;
+            stbi_free(z->idata); z->idata = NULL;
             if (has_trans)
-               if (!compute_transparency(z, tc, s->img_out_n)) return 0;
+               if (!compute_transparency(z->out, s->img_x * s->img_y, tc, s->img_out_n)) return 0;
             if (pal_img_n) {
                // pal_img_n == 3 or 4
                s->img_n = pal_img_n; // record the actual colors we had
@@ -2278,7 +3499,6 @@ static int parse_png_file(png *z, int scan, int req_comp)
                if (!expand_palette(z, palette, pal_len, s->img_out_n))
                   return 0;
             }
-            free(z->expanded); z->expanded = NULL;
             return 1;
          }
 
@@ -2306,14 +3526,16 @@ static int parse_png_file(png *z, int scan, int req_comp)
 static unsigned char *do_png(png *p, int *x, int *y, int *n, int req_comp)
 {
    unsigned char *result=NULL;
-   p->expanded = NULL;
+   p->window = NULL;
+   p->rows = NULL;
    p->idata = NULL;
    p->out = NULL;
+   p->have_next = 0;
    if (req_comp < 0 || req_comp > 4) return epuc("bad req_comp", "Internal error");
    if (parse_png_file(p, SCAN_load, req_comp)) {
       result = p->out;
       p->out = NULL;
-      if (req_comp && req_comp != p->s.img_out_n) {
+      if (req_comp && req_comp != p->s.img_out_n && !p->s.stream) {
          result = convert_format(result, p->s.img_out_n, req_comp, p->s.img_x, p->s.img_y);
          p->s.img_out_n = req_comp;
          if (result == NULL) return result;
@@ -2322,9 +3544,10 @@ static unsigned char *do_png(png *p, int *x, int *y, int *n, int req_comp)
       *y = p->s.img_y;
       if (n) *n = p->s.img_n;
    }
-   free(p->out);      p->out      = NULL;
-   free(p->expanded); p->expanded = NULL;
-   free(p->idata);    p->idata    = NULL;
+   stbi_free(p->out);      p->out      = NULL;
+   stbi_free(p->window);   p->window   = NULL;
+   stbi_free(p->rows);     p->rows     = NULL;
+   stbi_free(p->idata);    p->idata    = NULL;
 
    return result;
 }
@@ -2340,10 +3563,10 @@ unsigned char *stbi_png_load_from_file(FILE *f, int *x, int *y, int *comp, int r
 unsigned char *stbi_png_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_png_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_png_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 #endif
@@ -2471,7 +3694,7 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
    offset = get32le(s);
    hsz = get32le(s);
    if (hsz != 12 && hsz != 40 && hsz != 56 && hsz != 108) return epuc("unknown BMP", "BMP type not supported: unknown");
-   failure_reason = "bad BMP";
+   set_failure_reason("bad BMP");
    if (hsz == 12) {
       s->img_x = get16le(s);
       s->img_y = get16le(s);
@@ -2544,11 +3767,13 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
       target = req_comp;
    else
       target = s->img_n; // if they want monochrome, we'll post-convert
-   out = (stbi_uc *) malloc(target * s->img_x * s->img_y);
+   // a streamed image is handed out a row at a time, in file order
+   out = (stbi_uc *) stbi_malloc(target * s->img_x * (s->stream ? 1 : s->img_y));
    if (!out) return epuc("outofmem", "Out of memory");
+   if (s->stream) stream_begin(s, target);
    if (bpp < 16) {
       int z=0;
-      if (psize == 0 || psize > 256) { free(out); return epuc("invalid", "Corrupt BMP"); }
+      if (psize == 0 || psize > 256) { stbi_free(out); return epuc("invalid", "Corrupt BMP"); }
       for (i=0; i < psize; ++i) {
          pal[i][2] = get8(s);
          pal[i][1] = get8(s);
@@ -2559,7 +3784,7 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
       skip(s, offset - 14 - hsz - psize * (hsz == 12 ? 3 : 4));
       if (bpp == 4) width = (s->img_x + 1) >> 1;
       else if (bpp == 8) width = s->img_x;
-      else { free(out); return epuc("bad bpp", "Corrupt BMP"); }
+      else { stbi_free(out); return epuc("bad bpp", "Corrupt BMP"); }
       pad = (-width)&3;
       for (j=0; j < (int) s->img_y; ++j) {
          for (i=0; i < (int) s->img_x; i += 2) {
@@ -2580,6 +3805,10 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
             if (target == 4) out[z++] = 255;
          }
          skip(s, pad);
+         if (s->stream) {
+            if (!stream_rows(s, out, target, req_comp, flip_vertically ? s->img_y-1-j : j, 1)) { stbi_free(out); return NULL; }
+            z = 0;
+         }
       }
    } else {
       int rshift=0,gshift=0,bshift=0,ashift=0,rcount=0,gcount=0,bcount=0,acount=0;
@@ -2627,9 +3856,13 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
             }
          }
          skip(s, pad);
+         if (s->stream) {
+            if (!stream_rows(s, out, target, req_comp, flip_vertically ? s->img_y-1-j : j, 1)) { stbi_free(out); return NULL; }
+            z = 0;
+         }
       }
    }
-   if (flip_vertically) {
+   if (flip_vertically && !s->stream) {
       stbi_uc t;
       for (j=0; j < (int) s->img_y>>1; ++j) {
          stbi_uc *p1 = out +      j     *s->img_x*target;
@@ -2640,7 +3873,7 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
       }
    }
 
-   if (req_comp && req_comp != target) {
+   if (req_comp && req_comp != target && !s->stream) {
       out = convert_format(out, target, req_comp, s->img_x, s->img_y);
       if (out == NULL) return out; // convert_format frees input on failure
    }
@@ -2655,10 +3888,10 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_bmp_load             (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_bmp_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_bmp_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 
@@ -2738,7 +3971,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	//	image data
 	unsigned char *tga_data;
 	unsigned char *tga_palette = NULL;
-	int i, j;
+	int i, j, o;
 	unsigned char raw_data[4];
 	unsigned char trans_data[] = { 0,0,0,0 };
 	int RLE_count = 0;
@@ -2783,7 +4016,14 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 		//	force a new number of components
 		*comp = tga_bits_per_pixel/8;
 	}
-	tga_data = (unsigned char*)malloc( tga_width * tga_height * req_comp );
+	//	a streamed image only needs room for one row
+	s->img_x = tga_width;
+	s->img_y = tga_height;
+	tga_data = (unsigned char*)stbi_malloc( tga_width * (s->stream ? 1 : tga_height) * req_comp );
+	if( s->stream )
+	{
+		stream_begin( s, tga_bits_per_pixel / 8 );
+	}
 
 	//	skip to the data's starting position (offset usually = 0)
 	skip(s, tga_offset );
@@ -2793,7 +4033,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 		//	any data to skip? (offset usually = 0)
 		skip(s, tga_palette_start );
 		//	load the palette
-		tga_palette = (unsigned char*)malloc( tga_palette_len * tga_palette_bits / 8 );
+		tga_palette = (unsigned char*)stbi_malloc( tga_palette_len * tga_palette_bits / 8 );
 		getn(s, tga_palette, tga_palette_len * tga_palette_bits / 8 );
 	}
 	//	load the data
@@ -2879,36 +4119,43 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 			read_next_pixel = 0;
 		} // end of reading a pixel
 		//	convert to final format
+		o = (s->stream ? i % tga_width : i) * req_comp;
 		switch( req_comp )
 		{
 		case 1:
 			//	RGBA => Luminance
-			tga_data[i*req_comp+0] = compute_y(trans_data[0],trans_data[1],trans_data[2]);
+			tga_data[o+0] = compute_y(trans_data[0],trans_data[1],trans_data[2]);
 			break;
 		case 2:
 			//	RGBA => Luminance,Alpha
-			tga_data[i*req_comp+0] = compute_y(trans_data[0],trans_data[1],trans_data[2]);
-			tga_data[i*req_comp+1] = trans_data[3];
+			tga_data[o+0] = compute_y(trans_data[0],trans_data[1],trans_data[2]);
+			tga_data[o+1] = trans_data[3];
 			break;
 		case 3:
 			//	RGBA => RGB
-			tga_data[i*req_comp+0] = trans_data[0];
-			tga_data[i*req_comp+1] = trans_data[1];
-			tga_data[i*req_comp+2] = trans_data[2];
+			tga_data[o+0] = trans_data[0];
+			tga_data[o+1] = trans_data[1];
+			tga_data[o+2] = trans_data[2];
 			break;
 		case 4:
 			//	RGBA => RGBA
-			tga_data[i*req_comp+0] = trans_data[0];
-			tga_data[i*req_comp+1] = trans_data[1];
-			tga_data[i*req_comp+2] = trans_data[2];
-			tga_data[i*req_comp+3] = trans_data[3];
+			tga_data[o+0] = trans_data[0];
+			tga_data[o+1] = trans_data[1];
+			tga_data[o+2] = trans_data[2];
+			tga_data[o+3] = trans_data[3];
 			break;
 		}
 		//	in case we're in RLE mode, keep counting down
 		--RLE_count;
+		//	a streamed image goes out as each row is finished
+		if( s->stream && (i+1) % tga_width == 0 )
+		{
+			int row = i / tga_width;
+			stream_rows( s, tga_data, req_comp, req_comp, tga_inverted ? tga_height-1-row : row, 1 );
+		}
 	}
 	//	do I need to invert the image?
-	if( tga_inverted )
+	if( tga_inverted && !s->stream )
 	{
 		for( j = 0; j*2 < tga_height; ++j )
 		{
@@ -2927,7 +4174,7 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	//	clear my palette, if I had one
 	if( tga_palette != NULL )
 	{
-		free( tga_palette );
+		stbi_free( tga_palette );
 	}
 	//	the things I do to get rid of an error message, and yet keep
 	//	Microsoft's C compilers happy... [8^(
@@ -2941,10 +4188,10 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_tga_load             (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_tga_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_tga_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 
@@ -3055,7 +4302,7 @@ static stbi_uc *psd_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 		return epuc("bad compression", "PSD has an unknown compression format");
 
 	// Create the destination image.
-	out = (stbi_uc *) malloc(4 * w*h);
+	out = (stbi_uc *) stbi_malloc(4 * w*h);
 	if (!out) return epuc("outofmem", "Out of memory");
    pixelCount = w*h;
 
@@ -3155,10 +4402,10 @@ static stbi_uc *psd_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_psd_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_psd_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_map map;
+   if (!stbi_map_file(filename, &map)) return NULL;
+   data = stbi_psd_load_from_memory(map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return data;
 }
 
@@ -3307,7 +4554,7 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 	if (req_comp == 0) req_comp = 3;
 
 	// Read data
-	hdr_data = (float *) malloc(height * width * req_comp * sizeof(float));
+	hdr_data = (float *) stbi_malloc(height * width * req_comp * sizeof(float));
 
 	// Load image data
    // image data is stored as some number of sca
@@ -3336,13 +4583,13 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp)
             hdr_convert(hdr_data, rgbe, req_comp);
             i = 1;
             j = 0;
-            free(scanline);
+            stbi_free(scanline);
             goto main_decode_loop; // yes, this is fucking insane; blame the fucking insane format
          }
          len <<= 8;
          len |= get8(s);
-         if (len != width) { free(hdr_data); free(scanline); return epf("invalid decoded scanline length", "corrupt HDR"); }
-         if (scanline == NULL) scanline = (stbi_uc *) malloc(width * 4);
+         if (len != width) { stbi_free(hdr_data); stbi_free(scanline); return epf("invalid decoded scanline length", "corrupt HDR"); }
+         if (scanline == NULL) scanline = (stbi_uc *) stbi_malloc(width * 4);
 
 			for (k = 0; k < 4; ++k) {
 				i = 0;
@@ -3364,7 +4611,7 @@ static float *hdr_load(stbi *s, int *x, int *y, int *comp, int req_comp)
          for (i=0; i < width; ++i)
             hdr_convert(hdr_data+(j*width + i)*req_comp, scanline + i*4, req_comp);
 		}
-      free(scanline);
+      stbi_free(scanline);
 	}
 
    return hdr_data;
@@ -3415,7 +4662,7 @@ static stbi_uc *hdr_load_rgbe(stbi *s, int *x, int *y, int *comp, int req_comp)
 	req_comp = 4;
 
 	// Read data
-	rgbe_data = (stbi_uc *) malloc(height * width * req_comp * sizeof(stbi_uc));
+	rgbe_data = (stbi_uc *) stbi_malloc(height * width * req_comp * sizeof(stbi_uc));
 	//	point to the beginning
 	scanline = rgbe_data;
 
@@ -3451,7 +4698,7 @@ static stbi_uc *hdr_load_rgbe(stbi *s, int *x, int *y, int *comp, int req_comp)
          }
          len <<= 8;
          len |= get8(s);
-         if (len != width) { free(rgbe_data); return epuc("invalid decoded scanline length", "corrupt HDR"); }
+         if (len != width) { stbi_free(rgbe_data); return epuc("invalid decoded scanline length", "corrupt HDR"); }
 			for (k = 0; k < 4; ++k) {
 				i = 0;
 				while (i < width) {
@@ -3494,11 +4741,11 @@ stbi_uc *stbi_hdr_load_rgbe_file(FILE *f, int *x, int *y, int *comp, int req_com
 
 stbi_uc *stbi_hdr_load_rgbe        (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_map map;
    unsigned char *result;
-   if (!f) return epuc("can't fopen", "Unable to open file");
-   result = stbi_hdr_load_rgbe_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!stbi_map_file(filename, &map)) return NULL;
+   result = stbi_hdr_load_rgbe_memory((stbi_uc *) map.data,map.len,x,y,comp,req_comp);
+   stbi_unmap_file(&map);
    return result;
 }
 #endif
@@ -3519,6 +4766,55 @@ stbi_uc *stbi_hdr_load_rgbe_memory(stbi_uc *buffer, int len, int *x, int *y, int
 
 #endif // STBI_NO_HDR
 
+/////////////////////// streaming load ///////////////////////
+
+int stbi_load_rows_from_callbacks(stbi_io_callbacks const *io, stbi_rows_callback rows, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stream *st = (stream *) stbi_malloc(sizeof(*st));
+   uint8 *result = NULL;
+   int len = 0, n;
+   if (!st) return e("outofmem", "Out of memory");
+   st->io = io;
+   st->rows = rows;
+   st->user = user;
+   st->x = x;
+   st->y = y;
+   st->comp = comp;
+   st->scratch = NULL;
+   st->scratch_len = 0;
+
+   // a buffer's worth of the start, to tell the type from
+   while (len < STREAM_BUFFER && (n = io->read(user, (char *) st->buffer + len, STREAM_BUFFER - len)) > 0)
+      len += n;
+
+   // each loader hands its rows out as it goes, and gives back the
+   // buffer it used for the last of them
+   if (stbi_jpeg_test_memory(st->buffer, len)) {
+      jpeg j;
+      start_stream(&j.s, st, len);
+      result = load_jpeg_image(&j, x,y,comp,req_comp);
+   } else if (stbi_png_test_memory(st->buffer, len)) {
+      png p;
+      start_stream(&p.s, st, len);
+      result = do_png(&p, x,y,comp,req_comp);
+   } else if (stbi_bmp_test_memory(st->buffer, len)) {
+      stbi s;
+      start_stream(&s, st, len);
+      result = bmp_load(&s, x,y,comp,req_comp);
+   } else if (stbi_tga_test_memory(st->buffer, len)) {
+      stbi s;
+      start_stream(&s, st, len);
+      result = tga_load(&s, x,y,comp,req_comp);
+   } else
+      e("unknown image type", "Image not of a type that can be streamed, or corrupt");
+
+   n = result != NULL;
+   stbi_free(result);
+   stbi_free(st->scratch);
+   stbi_free(st);
+   return n;
+}
+
 /////////////////////// write image ///////////////////////
 
 #ifndef STBI_NO_WRITE